@@ -10,13 +10,29 @@
 
 #define UCORO_IMPL
 #include "ucoro/ucoro.hpp"
+#include "ucoro/io.hpp"
 
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
 #include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
 #include <fmt/core.h>
 #include <numeric>
+#include <optional>
+#include <string>
+#include <string_view>
 #include <vector>
 
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__)
+#include <x86intrin.h>
+#endif
+
 // --- Optional Dependencies ---
 
 #ifdef HAVE_UCONTEXT
@@ -27,73 +43,308 @@
 #include <boost/context/fiber.hpp>
 #endif
 
+#if defined(__linux__)
+#include <fcntl.h>
+#include <linux/perf_event.h>
+#include <sched.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
 // ============================================================================
 // timing utilities
 // ============================================================================
 
+// Cycle counter (rdtsc on x86-64, cntvct_el0 on ARM64, steady_clock elsewhere), converted to
+// nanoseconds with a rate calibrated once against steady_clock. Cheap enough to read around
+// batches of a few hundred nanoseconds without the clock dominating what it measures.
+namespace ticks
+{
+    inline auto now() noexcept -> std::uint64_t
+    {
+#if defined(_MSC_VER) || defined(__x86_64__)
+        return __rdtsc();
+#elif defined(__aarch64__)
+        std::uint64_t value;
+        __asm__ __volatile__("isb; mrs %0, cntvct_el0" : "=r"(value));
+        return value;
+#else
+        return static_cast<std::uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+#endif
+    }
+
+    inline auto per_ns() -> double
+    {
+        static double const rate = []
+        {
+            auto const wall_start = std::chrono::steady_clock::now();
+            auto const start = now();
+            while (std::chrono::steady_clock::now() - wall_start < std::chrono::milliseconds{20})
+            {
+            }
+            auto const elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - wall_start).count();
+            return static_cast<double>(now() - start) / elapsed;
+        }();
+        return rate;
+    }
+}
+
+// Log-linear buckets in the style of HdrHistogram: 32 per power of two, so any recorded value
+// is reported within ~3%. Values are picoseconds per operation.
+class histogram
+{
+public:
+    void record(std::uint64_t value) noexcept
+    {
+        ++counts_[index(value)];
+        ++count_;
+        min_ = std::min(min_, value);
+        max_ = std::max(max_, value);
+    }
+
+    // Smallest value with at least fraction p of the samples at or below it (bucket midpoint).
+    [[nodiscard]] auto percentile(double p) const noexcept -> std::uint64_t
+    {
+        auto const rank = static_cast<std::uint64_t>(std::ceil(p * static_cast<double>(count_)));
+        std::uint64_t seen = 0;
+        for (std::size_t i = 0; i < counts_.size(); ++i)
+        {
+            seen += counts_[i];
+            if (seen >= std::max<std::uint64_t>(rank, 1))
+                return std::clamp(midpoint(i), min_, max_);
+        }
+        return max_;
+    }
+
+    [[nodiscard]] auto min() const noexcept -> std::uint64_t { return count_ != 0 ? min_ : 0; }
+    [[nodiscard]] auto max() const noexcept -> std::uint64_t { return max_; }
+
+private:
+    static constexpr unsigned sub_bits = 5;
+    static constexpr std::uint64_t sub = std::uint64_t{1} << sub_bits;
+
+    static auto index(std::uint64_t v) noexcept -> std::size_t
+    {
+        if (v < sub)
+            return static_cast<std::size_t>(v);
+        auto const shift = static_cast<unsigned>(std::bit_width(v)) - sub_bits - 1;
+        return static_cast<std::size_t>((shift + 1) * sub + ((v >> shift) - sub));
+    }
+
+    static auto midpoint(std::size_t i) noexcept -> std::uint64_t
+    {
+        if (i < sub)
+            return i;
+        auto const shift = static_cast<unsigned>(i / sub - 1);
+        std::uint64_t const low = (sub + i % sub) << shift;
+        return low + ((std::uint64_t{1} << shift) >> 1);
+    }
+
+    std::array<std::uint64_t, (64 - sub_bits) * sub> counts_{};
+    std::uint64_t count_ = 0;
+    std::uint64_t min_ = UINT64_MAX;
+    std::uint64_t max_ = 0;
+};
+
+// Hardware counters for the calling thread (Linux perf_event_open, user space only). Stays
+// unavailable when the kernel refuses (perf_event_paranoid, containers, no PMU in the VM).
+class perf_counters
+{
+public:
+    struct sample
+    {
+        std::uint64_t cycles = 0;
+        std::uint64_t instructions = 0;
+        std::uint64_t branch_misses = 0;
+        std::uint64_t l1d_misses = 0;
+    };
+
+    perf_counters() = default;
+    perf_counters(perf_counters const &) = delete;
+    auto operator=(perf_counters const &) -> perf_counters & = delete;
+
+#if defined(__linux__)
+    ~perf_counters()
+    {
+        for (int fd : fds_)
+            if (fd >= 0)
+                ::close(fd);
+    }
+
+    auto open() -> bool
+    {
+        constexpr std::uint64_t l1d_read_miss = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        std::array<std::pair<std::uint32_t, std::uint64_t>, 4> const events{{
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+            {PERF_TYPE_HW_CACHE, l1d_read_miss},
+        }};
+        for (std::size_t i = 0; i < events.size(); ++i)
+        {
+            perf_event_attr attr{};
+            attr.size = sizeof(attr);
+            attr.type = events[i].first;
+            attr.config = events[i].second;
+            attr.disabled = i == 0 ? 1 : 0;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_GROUP;
+            fds_[i] = static_cast<int>(::syscall(SYS_perf_event_open, &attr, 0, -1, i == 0 ? -1 : fds_[0], 0));
+            if (fds_[i] < 0)
+                return false;
+        }
+        return true;
+    }
+
+    [[nodiscard]] auto available() const noexcept -> bool { return fds_[3] >= 0; }
+
+    void start() noexcept
+    {
+        ::ioctl(fds_[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ::ioctl(fds_[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+
+    [[nodiscard]] auto stop() noexcept -> sample
+    {
+        ::ioctl(fds_[0], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+        std::array<std::uint64_t, 5> values{}; // nr, then one value per event
+        if (::read(fds_[0], values.data(), sizeof(values)) != static_cast<ssize_t>(sizeof(values)))
+            return {};
+        return {values[1], values[2], values[3], values[4]};
+    }
+
+private:
+    std::array<int, 4> fds_{-1, -1, -1, -1};
+#else
+    auto open() -> bool { return false; }
+    [[nodiscard]] auto available() const noexcept -> bool { return false; }
+    void start() noexcept {}
+    [[nodiscard]] auto stop() noexcept -> sample { return {}; }
+#endif
+};
+
 class benchmark
 {
 public:
-    using clock = std::chrono::high_resolution_clock;
-    using duration = std::chrono::nanoseconds;
+    using duration = std::chrono::duration<double, std::nano>;
 
     struct result
     {
         std::string name;
         std::size_t iterations;
+        std::size_t batch; // calls per timed sample
+        std::size_t ops_per_call;
         duration total_time;
         duration min_time;
         duration max_time;
         duration mean_time;
         duration median_time;
+        duration p99_time;
+        duration p999_time;
         double ops_per_second;
+        std::optional<perf_counters::sample> counters; // totals over all iterations
+    };
+
+    struct options
+    {
+        bool pin = true;
+        bool perf = false;
+        std::string json_path; // empty: no JSON
     };
 
+    static auto settings() -> options &
+    {
+        static options opts;
+        return opts;
+    }
+
+    // Everything run() measured, in order, for the JSON report.
+    static auto results() -> std::vector<result> &
+    {
+        static std::vector<result> all;
+        return all;
+    }
+
+    // Times `iterations` calls of func in batches long enough (~2 us) that reading the cycle
+    // counter costs under a percent. Percentiles are over per-batch averages, so they show
+    // drift and interference, not the spread inside a batch. ops_per_call divides the time
+    // when one call does several operations.
     template <typename F>
     [[nodiscard]] static auto run(
         std::string_view name,
         std::size_t iterations,
-        F &&func) -> result
+        F &&func,
+        std::size_t ops_per_call = 1) -> result
     {
-        std::vector<duration> times;
-        times.reserve(iterations);
-
         // warmup
         for (std::size_t i = 0; i < std::min(iterations / 10, std::size_t{100}); ++i)
         {
             func();
         }
 
-        // actual benchmark
-        for (std::size_t i = 0; i < iterations; ++i)
+        double const rate = ticks::per_ns();
+        auto const target = static_cast<std::uint64_t>(2'000.0 * rate);
+        auto const time_batch = [&func](std::size_t n)
         {
-            auto const start = clock::now();
-            func();
-            auto const end = clock::now();
-            times.push_back(std::chrono::duration_cast<duration>(end - start));
-        }
+            auto const start = ticks::now();
+            for (std::size_t i = 0; i < n; ++i)
+                func();
+            return ticks::now() - start;
+        };
+        std::size_t batch = 1;
+        // a single slow batch (first touch, an interrupt) must not settle the size
+        while (batch < iterations && (time_batch(batch) < target || time_batch(batch) < target))
+            batch *= 2;
+        batch = std::min(batch, std::max<std::size_t>(iterations / 16, 1));
 
-        // calculate statistics
-        std::ranges::sort(times);
+        static perf_counters counters;
+        static bool const have_counters = settings().perf && counters.open();
+        if (have_counters)
+            counters.start();
 
-        auto const total = std::accumulate(times.begin(), times.end(), duration{});
-        auto const mean = total / iterations;
-        auto const median = times[iterations / 2];
-        auto const min = times.front();
-        auto const max = times.back();
+        histogram samples;
+        std::uint64_t total_ticks = 0;
+        std::size_t done = 0;
+        while (done < iterations)
+        {
+            std::size_t const n = std::min(batch, iterations - done);
+            auto const start = ticks::now();
+            for (std::size_t i = 0; i < n; ++i)
+                func();
+            auto const elapsed = ticks::now() - start;
+            total_ticks += elapsed;
+            done += n;
+            double const ps = 1'000.0 * static_cast<double>(elapsed) / rate / static_cast<double>(n * ops_per_call);
+            samples.record(static_cast<std::uint64_t>(ps));
+        }
+
+        std::optional<perf_counters::sample> totals;
+        if (have_counters)
+            totals = counters.stop();
 
-        auto const seconds = std::chrono::duration<double>(total).count();
-        auto const ops = static_cast<double>(iterations) / seconds;
+        std::size_t const ops = iterations * ops_per_call;
+        duration const total{static_cast<double>(total_ticks) / rate};
+        auto const ns = [](std::uint64_t ps)
+        { return duration{static_cast<double>(ps) / 1'000.0}; };
 
-        return {
+        result r{
             .name = std::string{name},
             .iterations = iterations,
+            .batch = batch,
+            .ops_per_call = ops_per_call,
             .total_time = total,
-            .min_time = min,
-            .max_time = max,
-            .mean_time = mean,
-            .median_time = median,
-            .ops_per_second = ops};
+            .min_time = ns(samples.min()),
+            .max_time = ns(samples.max()),
+            .mean_time = total / static_cast<double>(ops),
+            .median_time = ns(samples.percentile(0.5)),
+            .p99_time = ns(samples.percentile(0.99)),
+            .p999_time = ns(samples.percentile(0.999)),
+            .ops_per_second = static_cast<double>(ops) / std::chrono::duration<double>(total).count(),
+            .counters = totals};
+        results().push_back(r);
+        return r;
     }
 
     static void print_result(result const &r)
@@ -101,17 +352,72 @@ public:
         fmt::println("┌─────────────────────────────────────────────────────────────");
         fmt::println("│ {}", r.name);
         fmt::println("├─────────────────────────────────────────────────────────────");
-        fmt::println("│ iterations:   {:15}", r.iterations);
+        fmt::println("│ iterations:   {:15} (batches of {})", r.iterations, r.batch);
         fmt::println("│ total time:   {:15.3f} ms", std::chrono::duration<double, std::milli>(r.total_time).count());
-        fmt::println("│ mean time:    {:15.1f} ns", static_cast<double>(r.mean_time.count()));
-        fmt::println("│ median time:  {:15.1f} ns", static_cast<double>(r.median_time.count()));
-        fmt::println("│ min time:     {:15.1f} ns", static_cast<double>(r.min_time.count()));
-        fmt::println("│ max time:     {:15.1f} ns", static_cast<double>(r.max_time.count()));
+        fmt::println("│ mean time:    {:15.1f} ns", r.mean_time.count());
+        fmt::println("│ median time:  {:15.1f} ns", r.median_time.count());
+        fmt::println("│ p99 / p99.9:  {:15.1f} ns / {:.1f} ns", r.p99_time.count(), r.p999_time.count());
+        fmt::println("│ min time:     {:15.1f} ns", r.min_time.count());
+        fmt::println("│ max time:     {:15.1f} ns", r.max_time.count());
         fmt::println("│ ops/sec:      {:15.0f}", r.ops_per_second);
+        if (r.counters)
+        {
+            auto const per_op = [&r](std::uint64_t v)
+            { return static_cast<double>(v) / static_cast<double>(r.iterations * r.ops_per_call); };
+            fmt::println("│ cycles/op:    {:15.1f}   (IPC {:.2f})", per_op(r.counters->cycles),
+                         r.counters->cycles != 0 ? static_cast<double>(r.counters->instructions) / static_cast<double>(r.counters->cycles) : 0.0);
+            fmt::println("│ instr/op:     {:15.1f}", per_op(r.counters->instructions));
+            fmt::println("│ br-miss/op:   {:15.3f}", per_op(r.counters->branch_misses));
+            fmt::println("│ L1d-miss/op:  {:15.3f}", per_op(r.counters->l1d_misses));
+        }
         fmt::println("└─────────────────────────────────────────────────────────────\n");
     }
+
+    // One JSON object per run() result, times in nanoseconds, for tracking across releases.
+    static auto write_json(std::string const &path) -> bool
+    {
+        std::FILE *out = std::fopen(path.c_str(), "w");
+        if (out == nullptr)
+            return false;
+        fmt::print(out, "{{\n  \"ticks_per_ns\": {:.4f},\n  \"benchmarks\": [", ticks::per_ns());
+        bool first = true;
+        for (auto const &r : results())
+        {
+            std::string name;
+            for (char c : r.name)
+            {
+                if (c == '"' || c == '\\')
+                    name += '\\';
+                name += c;
+            }
+            fmt::print(out, "{}\n    {{\"name\": \"{}\", \"iterations\": {}, \"batch\": {}, \"mean_ns\": {:.3f}, \"p50_ns\": {:.3f}, "
+                            "\"p99_ns\": {:.3f}, \"p999_ns\": {:.3f}, \"min_ns\": {:.3f}, \"max_ns\": {:.3f}, \"ops_per_sec\": {:.0f}",
+                       first ? "" : ",", name, r.iterations, r.batch, r.mean_time.count(), r.median_time.count(),
+                       r.p99_time.count(), r.p999_time.count(), r.min_time.count(), r.max_time.count(), r.ops_per_second);
+            if (r.counters)
+                fmt::print(out, ", \"cycles\": {}, \"instructions\": {}, \"branch_misses\": {}, \"l1d_misses\": {}",
+                           r.counters->cycles, r.counters->instructions, r.counters->branch_misses, r.counters->l1d_misses);
+            fmt::print(out, "}}");
+            first = false;
+        }
+        fmt::print(out, "\n  ]\n}}\n");
+        return std::fclose(out) == 0;
+    }
 };
 
+// Keeps the scheduler from migrating the benchmark between cores mid-measurement.
+static void pin_to_current_cpu()
+{
+#if defined(__linux__)
+    int const cpu = ::sched_getcpu();
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(static_cast<std::size_t>(cpu), &set);
+    if (cpu >= 0 && ::sched_setaffinity(0, sizeof(set), &set) == 0)
+        fmt::println("pinned to CPU {}", cpu);
+#endif
+}
+
 // ============================================================================
 // Raw C Functions (for comparison)
 // ============================================================================
@@ -147,6 +453,11 @@ void bench_create_destroy()
                                  { auto coro = coro::coroutine::create([](coro::coroutine_handle) {}); });
     benchmark::print_result(result);
 
+    // Type-erased callable (std::function stored in the frame)
+    auto result_erased = benchmark::run("coroutine create + destroy (std::function)", 100'000, []()
+                                        { auto coro = coro::coroutine::create(coro::coroutine::function_type{[](coro::coroutine_handle) {}}); });
+    benchmark::print_result(result_erased);
+
     // Raw C API
     auto result_raw = benchmark::run("coroutine create + destroy (Raw C API)", 100'000, []()
                                      {
@@ -155,6 +466,40 @@ void bench_create_destroy()
         coro::detail::mco_create(&co, &desc);
         coro::detail::mco_destroy(co); });
     benchmark::print_result(result_raw);
+
+    // Non-zeroing and cached allocators
+    coro::malloc_allocator malloc_alloc;
+    auto result_malloc = benchmark::run("coroutine create + destroy (malloc_allocator)", 100'000, [&malloc_alloc]()
+                                        { auto coro = coro::coroutine::create([](coro::coroutine_handle) {}, coro::default_stack_size, coro::default_storage_size, malloc_alloc); });
+    benchmark::print_result(result_malloc);
+
+    coro::freelist_allocator freelist_alloc;
+    auto result_freelist = benchmark::run("coroutine create + destroy (freelist_allocator)", 100'000, [&freelist_alloc]()
+                                          { auto coro = coro::coroutine::create([](coro::coroutine_handle) {}, coro::default_stack_size, coro::default_storage_size, freelist_alloc); });
+    benchmark::print_result(result_freelist);
+
+    // mmap per frame + guard page protect
+    coro::virtual_stack_allocator virtual_alloc;
+    auto result_virtual = benchmark::run("coroutine create + destroy (virtual_stack_allocator)", 100'000, [&virtual_alloc]()
+                                         { auto coro = coro::coroutine::create([](coro::coroutine_handle) {}, coro::default_stack_size, coro::default_storage_size, virtual_alloc); });
+    benchmark::print_result(result_virtual);
+
+    // Pooled frames (no frame allocation in steady state)
+    auto frames = coro::pool::create(1);
+    if (frames)
+    {
+        auto result_pool = benchmark::run("coroutine create + destroy (coro::pool)", 100'000, [&frames]()
+                                          { auto coro = frames->spawn([](coro::coroutine_handle) {}); });
+        benchmark::print_result(result_pool);
+    }
+
+    // Frame inline in the object: rebuilt in place, no allocator at all
+    static coro::static_coroutine<UCORO_STACK_SIZE> inline_frame;
+    auto result_static = benchmark::run("coroutine create + destroy (static_coroutine)", 100'000, []()
+                                        {
+        (void)inline_frame.emplace([](coro::coroutine_handle) {});
+        inline_frame.reset(); });
+    benchmark::print_result(result_static);
 }
 
 // ---------------------------------------------------------
@@ -212,6 +557,27 @@ void bench_context_switch()
         }
     }
 
+    // 1.6. ucoro UNCHECKED with the lean switch kinds (integer_only equals full on x86-64 System V)
+    {
+        auto lean = [](std::string_view name, auto kind)
+        {
+            constexpr coro::switch_kind Kind = decltype(kind)::value;
+            auto coro_result = coro::coroutine::create([](coro::coroutine_handle h)
+                                                       {
+                while(true) {
+                    h.yield_unchecked<Kind>();
+                } });
+            if (!coro_result)
+                return;
+            auto &coro = *coro_result;
+            auto result = benchmark::run(name, 1'000'000, [&coro]()
+                                         { coro.template resume_unchecked<Kind>(); });
+            benchmark::print_result(result);
+        };
+        lean("context switch (ucoro UNCHECKED integer_only)", std::integral_constant<coro::switch_kind, coro::switch_kind::integer_only>{});
+        lean("context switch (ucoro UNCHECKED clobber)", std::integral_constant<coro::switch_kind, coro::switch_kind::clobber>{});
+    }
+
     // 2. ucoro (Raw C API)
     {
         coro::detail::mco_desc desc = coro::detail::mco_desc_init(raw_yield_loop, 0);
@@ -265,6 +631,68 @@ void bench_context_switch()
 #endif
 }
 
+// ---------------------------------------------------------
+// Pipeline hops: scheduler bounce vs symmetric transfer
+// ---------------------------------------------------------
+
+void bench_pipeline_hops()
+{
+    constexpr std::size_t stages = 4;
+
+    // every hop goes back through the driver: 2 switches per stage
+    {
+        std::vector<coro::coroutine> pipeline;
+        for (std::size_t i = 0; i < stages; ++i)
+        {
+            auto stage = coro::coroutine::create([](coro::coroutine_handle h)
+                                                 {
+                while (true)
+                    h.yield_unchecked(); });
+            if (stage)
+                pipeline.push_back(std::move(*stage));
+        }
+
+        if (pipeline.size() == stages)
+        {
+            auto result = benchmark::run("4-stage pipeline pass (resume from driver)", 1'000'000, [&pipeline]()
+                                         {
+                for (auto &stage : pipeline)
+                    stage.resume_unchecked(); });
+            benchmark::print_result(result);
+        }
+    }
+
+    // each stage transfers to the next: 1 switch per hop, plus entry and exit
+    {
+        std::array<coro::coroutine_handle, stages> next{};
+        std::vector<coro::coroutine> pipeline;
+        for (std::size_t i = 0; i < stages; ++i)
+        {
+            auto stage = coro::coroutine::create([&next, i](coro::coroutine_handle h)
+                                                 {
+                while (true)
+                {
+                    if (i + 1 < stages)
+                        h.transfer_unchecked(next[i + 1]);
+                    else
+                        h.yield_unchecked();
+                } });
+            if (stage)
+            {
+                next[i] = stage->handle();
+                pipeline.push_back(std::move(*stage));
+            }
+        }
+
+        if (pipeline.size() == stages)
+        {
+            auto result = benchmark::run("4-stage pipeline pass (symmetric transfer)", 1'000'000, [&pipeline]()
+                                         { pipeline.front().resume_unchecked(); });
+            benchmark::print_result(result);
+        }
+    }
+}
+
 void bench_storage_push_pop()
 {
     // --- C++ Wrapper Setup (Safe) ---
@@ -309,6 +737,28 @@ void bench_storage_push_pop()
         }
     }
 
+    // --- typed_coroutine: one compile-time int slot each way ---
+    {
+        auto typed_result = coro::typed_coroutine<int, int>::create([](coro::typed_handle<int, int> h)
+                                                                   {
+            int request = h.receive();
+            while(true) {
+                request = h.reply_unchecked(request);
+            } });
+
+        if (typed_result)
+        {
+            auto &typed = *typed_result;
+            auto result = benchmark::run("typed send + receive (call)", 100'000, [&typed]()
+                                         { [[maybe_unused]] auto _ = typed.call(42); });
+            benchmark::print_result(result);
+
+            auto result_unchecked = benchmark::run("typed send + receive (call_unchecked)", 100'000, [&typed]()
+                                                   { [[maybe_unused]] auto _ = typed.call_unchecked(42); });
+            benchmark::print_result(result_unchecked);
+        }
+    }
+
     // --- Raw C API Setup ---
     {
         coro::detail::mco_desc desc = coro::detail::mco_desc_init(raw_storage_loop, 0);
@@ -345,6 +795,121 @@ void bench_generator_iteration()
     auto result = benchmark::run("generator iteration (C++ only)", 100'000, [&gen]()
                                  { [[maybe_unused]] auto value = gen.next(); });
     benchmark::print_result(result);
+
+    // small items: one switch per element vs one switch per batch
+    auto per_element = coro::generator<std::uint32_t>::create([](coro::coroutine_handle h)
+                                                              {
+        std::uint32_t i = 0;
+        while (true)
+            [[maybe_unused]] auto _ = coro::yield_value(h, i++); });
+    auto batched = coro::batch_generator<std::uint32_t>::create([](coro::coroutine_handle h)
+                                                                {
+        std::uint32_t i = 0;
+        while (true)
+            [[maybe_unused]] auto _ = coro::yield_batched(h, i++); });
+    if (per_element && batched)
+    {
+        volatile std::uint32_t sink = 0;
+        auto element_it = per_element->begin();
+        // 256 elements per sample so timer overhead doesn't swamp the per-element cost
+        auto result_element = benchmark::run("generator<uint32_t>, 256 elements", 10'000, [&element_it, &sink]()
+                                             {
+            for (int i = 0; i < 256; ++i, ++element_it)
+                sink = *element_it; });
+        benchmark::print_result(result_element);
+
+        auto batch_it = batched->begin();
+        auto result_batch = benchmark::run("batch_generator<uint32_t>, 256 elements (1 switch)", 10'000, [&batch_it, &sink]()
+                                           {
+            for (int i = 0; i < 256; ++i, ++batch_it)
+                sink = *batch_it; });
+        benchmark::print_result(result_batch);
+    }
+
+    // 1 KiB records: copied through storage vs read in place
+    struct record
+    {
+        std::array<std::byte, 1016> payload;
+        std::uint64_t seq;
+    };
+    static_assert(coro::storable<record>);
+
+    auto copying = coro::generator<record>::create([](coro::coroutine_handle h)
+                                                   {
+        record r{};
+        while (true) {
+            ++r.seq;
+            [[maybe_unused]] auto _ = coro::yield_value(h, r);
+        } });
+    auto in_place = coro::ref_generator<record>::create([](coro::coroutine_handle h)
+                                                        {
+        record r{};
+        while (true) {
+            ++r.seq;
+            [[maybe_unused]] auto _ = coro::yield_ref(h, r);
+        } });
+    if (copying && in_place)
+    {
+        volatile std::uint64_t sink = 0;
+        auto result_copy = benchmark::run("generator<1 KiB record> (push/pop copy)", 100'000, [&copying, &sink]()
+                                          {
+            auto value = copying->next();
+            if (value && *value)
+                sink = (*value)->seq; });
+        benchmark::print_result(result_copy);
+
+        auto result_ref = benchmark::run("ref_generator<1 KiB record> (in place)", 100'000, [&in_place, &sink]()
+                                         {
+            auto value = in_place->next();
+            if (value && *value)
+                sink = (*value)->seq; });
+        benchmark::print_result(result_ref);
+    }
+
+    // source | map | filter: fused views (1 switch per source element) vs a generator per stage
+    auto make_source = []()
+    {
+        return coro::generator<std::uint32_t>::create([](coro::coroutine_handle h)
+                                                      {
+            std::uint32_t i = 0;
+            while (true)
+                [[maybe_unused]] auto _ = coro::yield_value(h, i++); });
+    };
+    auto fused_source = make_source();
+    auto staged_source = make_source();
+    if (fused_source && staged_source)
+    {
+        auto fused = *fused_source | coro::map([](std::uint32_t x) { return x * 3; }) |
+                     coro::filter([](std::uint32_t x) { return x % 2 == 0; });
+        auto mapped = coro::generator<std::uint32_t>::create([&staged_source](coro::coroutine_handle h)
+                                                             {
+            for (std::uint32_t x : *staged_source)
+                [[maybe_unused]] auto _ = coro::yield_value(h, x * 3); });
+        if (!mapped)
+            return;
+        auto filtered = coro::generator<std::uint32_t>::create([&mapped](coro::coroutine_handle h)
+                                                               {
+            for (std::uint32_t x : *mapped)
+                if (x % 2 == 0)
+                    [[maybe_unused]] auto _ = coro::yield_value(h, x); });
+        if (!filtered)
+            return;
+
+        volatile std::uint32_t sink = 0;
+        auto fused_it = fused.begin();
+        auto result_fused = benchmark::run("map | filter views, 256 outputs (fused)", 10'000, [&fused_it, &sink]()
+                                           {
+            for (int i = 0; i < 256; ++i, ++fused_it)
+                sink = *fused_it; });
+        benchmark::print_result(result_fused);
+
+        auto staged_it = filtered->begin();
+        auto result_staged = benchmark::run("map, filter as generator stages, 256 outputs", 10'000, [&staged_it, &sink]()
+                                            {
+            for (int i = 0; i < 256; ++i, ++staged_it)
+                sink = *staged_it; });
+        benchmark::print_result(result_staged);
+    }
 }
 
 void bench_memory_overhead()
@@ -361,6 +926,13 @@ void bench_memory_overhead()
     fmt::println("│ sizeof(coro::task_runner): {:6} bytes", sizeof(coro::task_runner));
     fmt::println("│ default stack size:        {:6} bytes", coro::default_stack_size.value);
     fmt::println("│ default storage size:      {:6} bytes", coro::default_storage_size.value);
+    auto plain = coro::coroutine::create([](coro::coroutine_handle) {});
+    auto typed = coro::typed_coroutine<int, int>::create([](coro::typed_handle<int, int>) {});
+    if (plain && typed)
+    {
+        fmt::println("│ coroutine frame:           {:6} bytes", plain->raw()->coro_size);
+        fmt::println("│ typed_coroutine<int, int>: {:6} bytes", typed->raw()->coro_size);
+    }
     fmt::println("└─────────────────────────────────────────────────────────────\n");
 }
 
@@ -401,22 +973,1057 @@ void bench_allocation_pattern()
     fmt::println("└─────────────────────────────────────────────────────────────\n");
 }
 
+// task_runner scaling: many parked tasks, and many tasks finishing in one run
+void bench_task_runner_scaling()
+{
+    constexpr std::size_t count = 50'000;
+    coro::malloc_allocator alloc;
+    auto const min_stack = coro::min_stack_size;
+
+    {
+        coro::task_runner runner;
+        std::vector<coro::coroutine_handle> sleepers;
+        sleepers.reserve(count);
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            auto c = coro::coroutine::create([](coro::coroutine_handle h)
+                                             { [[maybe_unused]] auto _ = h.park(); },
+                                             min_stack, coro::default_storage_size, alloc);
+            if (!c)
+                break;
+            sleepers.push_back(c->handle());
+            runner.add(std::move(*c));
+        }
+        auto busy = coro::coroutine::create([](coro::coroutine_handle h)
+                                            {
+            while (true)
+                h.yield_unchecked(); });
+        if (busy)
+            runner.add(std::move(*busy));
+        (void)runner.step(); // sleepers park
+
+        auto result = benchmark::run("task_runner step (50k parked + 1 ready)", 100'000, [&runner]()
+                                     { [[maybe_unused]] auto _ = runner.step(); });
+        benchmark::print_result(result);
+
+        for (auto h : sleepers)
+            (void)runner.wake(h);
+        (void)runner.step();
+    }
+
+    {
+        coro::task_runner runner;
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            auto c = coro::coroutine::create([](coro::coroutine_handle h)
+                                             { [[maybe_unused]] auto _ = h.yield(); },
+                                             min_stack, coro::default_storage_size, alloc);
+            if (c)
+                runner.add(std::move(*c));
+        }
+        auto const start = std::chrono::high_resolution_clock::now();
+        (void)runner.run();
+        auto const ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+        fmt::println("┌─────────────────────────────────────────────────────────────");
+        fmt::println("│ task_runner run() finishing {} tasks", count);
+        fmt::println("├─────────────────────────────────────────────────────────────");
+        fmt::println("│ total: {:.2f} ms ({:.1f} ns per task, incl. frame free)", ms, ms * 1e6 / static_cast<double>(count));
+        fmt::println("└─────────────────────────────────────────────────────────────\n");
+    }
+}
+
+// multi-core throughput: imbalanced CPU-bound tasks, single task_runner vs work stealing
+static auto spin_work(std::uint64_t seed, int rounds) -> std::uint64_t
+{
+    for (int i = 0; i < rounds; ++i)
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+    return seed;
+}
+
+template <typename Runner>
+static auto run_imbalanced(Runner &runner, std::size_t tasks, int slices, std::atomic<std::uint64_t> &sink) -> double
+{
+    for (std::size_t i = 0; i < tasks; ++i)
+    {
+        // every 8th task is 16x heavier, so a static split leaves some workers idle
+        int const rounds = i % 8 == 0 ? 16'000 : 1'000;
+        auto coro = coro::coroutine::create([&sink, rounds, slices, i](coro::coroutine_handle h)
+                                            {
+            std::uint64_t acc = i;
+            for (int s = 0; s < slices; ++s)
+            {
+                acc = spin_work(acc, rounds);
+                h.yield_unchecked();
+            }
+            sink.fetch_add(acc, std::memory_order_relaxed); });
+        if (coro)
+            runner.add(std::move(*coro));
+    }
+
+    auto const start = std::chrono::high_resolution_clock::now();
+    [[maybe_unused]] auto _ = runner.run();
+    auto const end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+void bench_thread_pool_runner()
+{
+    fmt::println("┌─────────────────────────────────────────────────────────────");
+    fmt::println("│ multi-core throughput (imbalanced tasks)");
+    fmt::println("├─────────────────────────────────────────────────────────────");
+
+    constexpr std::size_t tasks = 2'048;
+    constexpr int slices = 32;
+    std::atomic<std::uint64_t> sink{0};
+    auto const resumes = static_cast<double>(tasks) * (slices + 1);
+
+    coro::task_runner single;
+    auto const single_ms = run_imbalanced(single, tasks, slices, sink);
+    fmt::println("│ task_runner (1 thread):        {:9.2f} ms  {:12.0f} resumes/sec", single_ms, resumes / single_ms * 1e3);
+
+    coro::thread_pool_runner pool_runner;
+    auto const pool_ms = run_imbalanced(pool_runner, tasks, slices, sink);
+    fmt::println("│ thread_pool_runner ({:2} thr):   {:9.2f} ms  {:12.0f} resumes/sec  ({:.2f}x)", pool_runner.worker_count(),
+                 pool_ms, resumes / pool_ms * 1e3, single_ms / pool_ms);
+    fmt::println("└─────────────────────────────────────────────────────────────\n");
+}
+
+// channel ping-pong: two tasks bouncing a counter, parked channels vs polling a shared slot
+void bench_channel_ping_pong()
+{
+    constexpr int rounds = 200'000;
+    volatile int sink = 0;
+
+    fmt::println("┌─────────────────────────────────────────────────────────────");
+    fmt::println("│ ping-pong round trips under task_runner ({} rounds)", rounds);
+    fmt::println("├─────────────────────────────────────────────────────────────");
+
+    {
+        auto ping = coro::channel<int>::create(1);
+        auto pong = coro::channel<int>::create(1);
+        if (!ping || !pong)
+            return;
+        coro::task_runner runner;
+        auto left = coro::coroutine::create([&](coro::coroutine_handle h)
+                                            {
+            for (int i = 0; i < rounds; ++i)
+            {
+                (void)ping->send(h, i);
+                if (auto v = pong->receive(h))
+                    sink = *v;
+            }
+            ping->close(); });
+        auto right = coro::coroutine::create([&](coro::coroutine_handle h)
+                                             {
+            while (auto v = ping->receive(h))
+                (void)pong->send(h, *v + 1); });
+        if (!left || !right)
+            return;
+        runner.add(std::move(*left)).add(std::move(*right));
+
+        auto const start = std::chrono::high_resolution_clock::now();
+        (void)runner.run();
+        auto const ns = std::chrono::duration<double, std::nano>(std::chrono::high_resolution_clock::now() - start).count();
+        fmt::println("│ channel (park/wake):     {:8.1f} ns per round trip", ns / rounds);
+    }
+
+    {
+        // the pattern channels replace: each side spins on yield() until its slot fills
+        std::optional<int> to_right;
+        std::optional<int> to_left;
+        bool done = false;
+        std::size_t empty_polls = 0;
+        coro::task_runner runner;
+        auto left = coro::coroutine::create([&](coro::coroutine_handle h)
+                                            {
+            for (int i = 0; i < rounds; ++i)
+            {
+                to_right = i;
+                while (!to_left)
+                    h.yield_unchecked();
+                sink = *std::exchange(to_left, std::nullopt);
+            }
+            done = true; });
+        auto right = coro::coroutine::create([&](coro::coroutine_handle h)
+                                             {
+            while (!done)
+            {
+                if (to_right)
+                    to_left = *std::exchange(to_right, std::nullopt) + 1;
+                else
+                    ++empty_polls;
+                h.yield_unchecked();
+            } });
+        if (!left || !right)
+            return;
+        runner.add(std::move(*left)).add(std::move(*right));
+
+        auto const start = std::chrono::high_resolution_clock::now();
+        (void)runner.run();
+        auto const ns = std::chrono::duration<double, std::nano>(std::chrono::high_resolution_clock::now() - start).count();
+        fmt::println("│ polling (yield loop):    {:8.1f} ns per round trip, {} empty polls", ns / rounds, empty_polls);
+    }
+    fmt::println("└─────────────────────────────────────────────────────────────\n");
+}
+
+// timers: wheel insert/cancel cost, and sleeping tasks vs ones polling the clock
+void bench_timers()
+{
+    constexpr std::size_t timers = 100'000;
+    constexpr int tasks = 1'000;
+    constexpr int naps = 5;
+    constexpr auto nap = std::chrono::milliseconds{2};
+
+    fmt::println("┌─────────────────────────────────────────────────────────────");
+    fmt::println("│ timer wheel ({} timers, deadlines over 10 minutes)", timers);
+    fmt::println("├─────────────────────────────────────────────────────────────");
+
+    {
+        std::vector<coro::detail::timer_node> nodes(timers);
+        auto const now = std::chrono::steady_clock::now();
+        coro::detail::timer_wheel wheel{now};
+        std::uint32_t seed = 12345;
+        auto const start = std::chrono::high_resolution_clock::now();
+        for (auto &node : nodes)
+        {
+            seed = seed * 1664525u + 1013904223u;
+            wheel.insert(&node, now + std::chrono::milliseconds{seed % 600'000});
+        }
+        auto const inserted = std::chrono::high_resolution_clock::now();
+        for (auto &node : nodes)
+            wheel.cancel(&node);
+        auto const cancelled = std::chrono::high_resolution_clock::now();
+        fmt::println("│ insert:                  {:8.1f} ns per timer",
+                     std::chrono::duration<double, std::nano>(inserted - start).count() / timers);
+        fmt::println("│ cancel:                  {:8.1f} ns per timer",
+                     std::chrono::duration<double, std::nano>(cancelled - inserted).count() / timers);
+    }
+
+    fmt::println("├─────────────────────────────────────────────────────────────");
+    fmt::println("│ {} tasks x {} naps of {} ms under task_runner", tasks, naps, nap.count());
+
+    {
+        std::size_t resumes = 0;
+        coro::task_runner runner;
+        for (int t = 0; t < tasks; ++t)
+        {
+            auto task = coro::coroutine::create([&](coro::coroutine_handle h)
+                                                {
+                for (int i = 0; i < naps; ++i)
+                {
+                    (void)coro::sleep_for(h, nap);
+                    ++resumes;
+                } });
+            if (!task)
+                return;
+            runner.add(std::move(*task));
+        }
+        auto const start = std::chrono::high_resolution_clock::now();
+        (void)runner.run();
+        auto const ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+        fmt::println("│ sleep_for (timer wheel): {:8.1f} ms, {} resumes", ms, resumes);
+    }
+
+    {
+        // the pattern sleep_for replaces: yield until the clock says the nap is over
+        std::size_t resumes = 0;
+        coro::task_runner runner;
+        for (int t = 0; t < tasks; ++t)
+        {
+            auto task = coro::coroutine::create([&](coro::coroutine_handle h)
+                                                {
+                for (int i = 0; i < naps; ++i)
+                {
+                    auto const until = std::chrono::steady_clock::now() + nap;
+                    while (std::chrono::steady_clock::now() < until)
+                    {
+                        h.yield_unchecked();
+                        ++resumes;
+                    }
+                } });
+            if (!task)
+                return;
+            runner.add(std::move(*task));
+        }
+        auto const start = std::chrono::high_resolution_clock::now();
+        (void)runner.run();
+        auto const ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+        fmt::println("│ polling (yield loop):    {:8.1f} ms, {} resumes", ms, resumes);
+    }
+    fmt::println("└─────────────────────────────────────────────────────────────\n");
+}
+
+// cancellation: evicting tasks stalled on a channel (wake, unwind, free the frame)
+void bench_cancellation()
+{
+    constexpr int stalled = 10'000;
+
+    fmt::println("┌─────────────────────────────────────────────────────────────");
+    fmt::println("│ cancelling {} tasks parked on an empty channel", stalled);
+    fmt::println("├─────────────────────────────────────────────────────────────");
+
+    {
+        auto ch = coro::channel<int>::create(1);
+        if (!ch)
+            return;
+        coro::task_runner runner;
+        for (int i = 0; i < stalled; ++i)
+        {
+            auto task = coro::coroutine::create([&](coro::coroutine_handle h)
+                                                { (void)ch->receive(h); });
+            if (!task)
+                return;
+            runner.add(std::move(*task));
+        }
+        (void)runner.run();
+        auto const start = std::chrono::high_resolution_clock::now();
+        runner.cancel_all();
+        (void)runner.run();
+        auto const ns = std::chrono::duration<double, std::nano>(std::chrono::high_resolution_clock::now() - start).count();
+        fmt::println("│ cancel_all + unwind:     {:8.1f} ns per stalled task ({} left)", ns / stalled, runner.size());
+    }
+    fmt::println("└─────────────────────────────────────────────────────────────\n");
+}
+
+// structured fan-out: a parent spawns N children and joins them, per request
+void bench_scope_fan_out()
+{
+    constexpr int requests = 50;
+    constexpr int children = 1'000;
+
+    fmt::println("┌─────────────────────────────────────────────────────────────");
+    fmt::println("│ fan-out / join ({} requests x {} children, {} KiB stacks)", requests, children, coro::min_stack_size.value / 1024);
+    fmt::println("├─────────────────────────────────────────────────────────────");
+
+    {
+        coro::task_runner runner;
+        std::size_t parent_resumes = 0;
+        auto parent = coro::coroutine::create([&](coro::coroutine_handle h)
+                                              {
+            auto sc = coro::scope::create(children, coro::min_stack_size);
+            if (!sc)
+                return;
+            for (int r = 0; r < requests; ++r)
+            {
+                for (int i = 0; i < children; ++i)
+                    (void)sc->spawn(runner, [](coro::coroutine_handle c)
+                                    { c.yield_unchecked(); });
+                (void)sc->join(h);
+                ++parent_resumes;
+            } });
+        if (!parent)
+            return;
+        runner.add(std::move(*parent));
+        auto const start = std::chrono::high_resolution_clock::now();
+        (void)runner.run();
+        auto const ns = std::chrono::duration<double, std::nano>(std::chrono::high_resolution_clock::now() - start).count();
+        fmt::println("│ scope (arena + join):    {:8.1f} ns per child, {} parent resumes", ns / (requests * children), parent_resumes);
+    }
+
+    {
+        // by hand: one heap frame per child, the parent polls a counter between yields
+        coro::task_runner runner;
+        std::size_t parent_resumes = 0;
+        auto parent = coro::coroutine::create([&](coro::coroutine_handle h)
+                                              {
+            for (int r = 0; r < requests; ++r)
+            {
+                int remaining = children;
+                for (int i = 0; i < children; ++i)
+                {
+                    auto child = coro::coroutine::create([&remaining](coro::coroutine_handle c)
+                                                         {
+                        c.yield_unchecked();
+                        --remaining; },
+                                                         coro::min_stack_size);
+                    if (child)
+                        runner.add(std::move(*child));
+                }
+                while (remaining != 0)
+                {
+                    h.yield_unchecked();
+                    ++parent_resumes;
+                }
+            } });
+        if (!parent)
+            return;
+        runner.add(std::move(*parent));
+        auto const start = std::chrono::high_resolution_clock::now();
+        (void)runner.run();
+        auto const ns = std::chrono::duration<double, std::nano>(std::chrono::high_resolution_clock::now() - start).count();
+        fmt::println("│ vector + polling:        {:8.1f} ns per child, {} parent resumes", ns / (requests * children), parent_resumes);
+    }
+    fmt::println("└─────────────────────────────────────────────────────────────\n");
+}
+
+void bench_select()
+{
+    constexpr int sources = 64;
+    constexpr int messages = 20'000;
+    constexpr int gap = 16; // producer yields between messages, so most consumer turns find nothing
+
+    fmt::println("┌─────────────────────────────────────────────────────────────");
+    fmt::println("│ fan-in over {} channels ({} messages, {} yields apart)", sources, messages, gap);
+    fmt::println("├─────────────────────────────────────────────────────────────");
+
+    for (bool use_select : {true, false})
+    {
+        std::vector<coro::channel<int>> owned;
+        std::vector<coro::channel<int> *> chans;
+        for (int i = 0; i < sources; ++i)
+            if (auto ch = coro::channel<int>::create(1))
+                owned.push_back(std::move(*ch));
+        if (owned.size() != sources)
+            return;
+        for (auto &ch : owned)
+            chans.push_back(&ch);
+
+        coro::task_runner runner;
+        auto producer = coro::coroutine::create([&](coro::coroutine_handle h)
+                                                {
+            for (int i = 0; i < messages; ++i)
+            {
+                (void)chans[static_cast<std::size_t>(i) % sources]->send(h, i);
+                for (int k = 0; k < gap; ++k)
+                    h.yield_unchecked();
+            }
+            for (auto *ch : chans)
+                ch->close(); });
+        std::size_t consumer_resumes = 0;
+        long long sum = 0;
+        auto consumer = coro::coroutine::create([&](coro::coroutine_handle h)
+                                                {
+            if (use_select)
+            {
+                while (auto got = coro::select(h, chans))
+                {
+                    sum += got->value;
+                    ++consumer_resumes;
+                }
+            }
+            else
+            {
+                // by hand: sweep every channel with try_receive, yield when all are empty
+                for (int open = sources; open != 0;)
+                {
+                    open = 0;
+                    for (auto *ch : chans)
+                    {
+                        auto got = ch->try_receive();
+                        if (got)
+                            sum += *got;
+                        if (got || got.error() != coro::error::closed)
+                            ++open;
+                    }
+                    h.yield_unchecked();
+                    ++consumer_resumes;
+                }
+            } });
+        if (!producer || !consumer)
+            return;
+        runner.add(std::move(*producer)).add(std::move(*consumer));
+        auto const start = std::chrono::high_resolution_clock::now();
+        (void)runner.run();
+        auto const ns = std::chrono::duration<double, std::nano>(std::chrono::high_resolution_clock::now() - start).count();
+        if (sum != static_cast<long long>(messages) * (messages - 1) / 2)
+            fmt::println("│ lost messages");
+        fmt::println("│ {:<24} {:8.1f} ns per message, {} consumer resumes", use_select ? "select:" : "try_receive sweep:", ns / messages, consumer_resumes);
+    }
+    fmt::println("└─────────────────────────────────────────────────────────────\n");
+}
+
+// ---------------------------------------------------------
+// Cache-cold switches, scheduler throughput, pool churn
+// ---------------------------------------------------------
+
+// The hot-loop switch above keeps one frame in L1. Round-robin over thousands of live
+// coroutines makes every resume touch a header, context and stack top that were evicted
+// since; at 10k the frame layout (header hot line, line-aligned contexts) is what counts.
+void bench_cold_switches()
+{
+    coro::malloc_allocator alloc;
+    for (std::size_t live : {std::size_t{4}, std::size_t{4'096}, std::size_t{10'000}})
+    {
+        std::vector<coro::coroutine> ring;
+        ring.reserve(live);
+        for (std::size_t i = 0; i < live; ++i)
+        {
+            auto c = coro::coroutine::create([](coro::coroutine_handle h)
+                                             {
+                while (true)
+                    h.yield_unchecked(); },
+                                             coro::min_stack_size, coro::default_storage_size, alloc);
+            if (!c)
+                return;
+            ring.push_back(std::move(*c));
+        }
+        for (auto &c : ring) // fault in every stack before timing
+            c.resume_unchecked();
+        std::size_t next = 0;
+        auto result = benchmark::run(fmt::format("context switch, round-robin over {} live coroutines", live), 1'000'000, [&ring, &next]()
+                                     {
+            ring[next].resume_unchecked();
+            if (++next == ring.size())
+                next = 0; });
+        benchmark::print_result(result);
+    }
+}
+
+// Resumes per second through task_runner with every task ready: queue pop, resume, re-queue.
+void bench_scheduler_throughput()
+{
+    constexpr std::size_t tasks = 1'000;
+    coro::malloc_allocator alloc;
+    coro::task_runner runner;
+    for (std::size_t i = 0; i < tasks; ++i)
+    {
+        auto c = coro::coroutine::create([](coro::coroutine_handle h)
+                                         {
+            while (true)
+                h.yield_unchecked(); },
+                                         coro::min_stack_size, coro::default_storage_size, alloc);
+        if (!c)
+            return;
+        runner.add(std::move(*c));
+    }
+    auto result = benchmark::run("task_runner step (1k ready tasks), per resume", 1'000, [&runner]()
+                                 { [[maybe_unused]] auto _ = runner.step(); },
+                                 tasks);
+    benchmark::print_result(result);
+}
+
+// Wake-up latency of one latency-critical task under bulk load: 1000 bulk tasks each burn a
+// little CPU and yield; one of them wakes the parked control task every other round, and the
+// control task records how long the wake took to reach it. Round-robin makes it wait out the
+// queue; the policies let it jump it.
+template <typename Runner, typename Key>
+void measure_wake_latency(char const *label, Runner &runner, Key urgent, Key bulk)
+{
+    constexpr std::size_t bulk_tasks = 1'000;
+    constexpr std::size_t samples = 1'000;
+
+    std::vector<double> latencies;
+    latencies.reserve(samples);
+    bool stop = false;
+    coro::coroutine_handle control;
+    std::chrono::steady_clock::time_point woke_at;
+
+    auto control_task = coro::coroutine::create([&](coro::coroutine_handle h)
+                                                {
+        control = h;
+        while (latencies.size() < samples)
+        {
+            (void)h.park();
+            latencies.push_back(std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - woke_at).count());
+        }
+        stop = true; });
+    if (!control_task)
+        return;
+    runner.add(std::move(*control_task), urgent);
+    for (std::size_t i = 0; i < bulk_tasks; ++i)
+    {
+        auto c = coro::coroutine::create([&, i](coro::coroutine_handle h)
+                                         {
+            volatile std::size_t burn = 0;
+            for (std::size_t round = 0; !stop; ++round)
+            {
+                for (std::size_t spin = 0; spin < 50; ++spin)
+                    burn = burn + spin;
+                if (i == 0 && round % 2 == 1)
+                {
+                    woke_at = std::chrono::steady_clock::now();
+                    (void)runner.wake(control);
+                }
+                h.yield_unchecked();
+            } },
+                                         coro::min_stack_size);
+        if (!c)
+            return;
+        runner.add(std::move(*c), bulk);
+    }
+    if (!runner.run())
+        return;
+
+    std::ranges::sort(latencies);
+    auto const at = [&](double q)
+    { return latencies[std::min(latencies.size() - 1, static_cast<std::size_t>(q * static_cast<double>(latencies.size())))]; };
+    fmt::println("│ {:<20} p50 {:9.0f} ns, p99 {:9.0f} ns, p99.9 {:9.0f} ns", label, at(0.5), at(0.99), at(0.999));
+}
+
+void bench_scheduling_policies()
+{
+    using namespace std::chrono_literals;
+
+    fmt::println("┌─────────────────────────────────────────────────────────────");
+    fmt::println("│ wake-to-run latency of an urgent task behind 1000 busy ones");
+    fmt::println("├─────────────────────────────────────────────────────────────");
+    {
+        coro::task_runner runner;
+        measure_wake_latency("round_robin:", runner, coro::round_robin::default_key, coro::round_robin::default_key);
+    }
+    {
+        coro::basic_task_runner<coro::priority_levels<>> runner;
+        measure_wake_latency("priority_levels:", runner, coro::priority{0}, coro::priority{32});
+    }
+    {
+        coro::basic_task_runner<coro::earliest_deadline> runner;
+        measure_wake_latency("earliest_deadline:", runner, std::chrono::steady_clock::time_point{}, coro::earliest_deadline::default_key);
+    }
+    {
+        coro::basic_task_runner<coro::fair_share<2>> runner;
+        measure_wake_latency("fair_share 1:1:", runner, coro::share_class{1}, coro::share_class{0});
+    }
+    fmt::println("└─────────────────────────────────────────────────────────────\n");
+}
+
+// Short-lived tasks with a window of 256 still alive: each call spawns one, runs it to its
+// first yield and retires the oldest, so frames cycle through the allocator out of order.
+void bench_pool_churn()
+{
+    constexpr std::size_t window = 256;
+    auto const body = [](coro::coroutine_handle h)
+    { h.yield_unchecked(); };
+
+    auto churn = [&](std::string_view name, auto spawn)
+    {
+        std::vector<std::optional<coro::coroutine>> live(window);
+        std::size_t oldest = 0;
+        auto result = benchmark::run(name, 200'000, [&]()
+                                     {
+            auto c = spawn();
+            if (!c)
+                return;
+            c->resume_unchecked();
+            live[oldest] = std::move(*c); // destroys the coroutine it replaces, mid-yield
+            if (++oldest == window)
+                oldest = 0; });
+        benchmark::print_result(result);
+    };
+
+    churn("churn: create, resume, destroy (calloc, 256 live)", [&]()
+          { return coro::coroutine::create(body); });
+
+    auto frames = coro::pool::create(window + 1);
+    if (frames)
+        churn("churn: spawn, resume, release (coro::pool, 256 live)", [&]()
+              { return frames->spawn(body); });
+}
+
+// spawn-heavy fan-out where most coroutines never run: eager vs lazy stacks
+void bench_lazy_fanout()
+{
+    constexpr std::size_t count = 10'000;
+    constexpr std::size_t every = 10; // only one in ten is ever resumed
+    constexpr coro::stack_size stack{64 * 1024};
+
+    struct peak_allocator
+    {
+        std::size_t live = 0;
+        std::size_t peak = 0;
+
+        auto allocate(std::size_t size) noexcept -> void *
+        {
+            live += size;
+            peak = std::max(peak, live);
+            return std::malloc(size);
+        }
+
+        void deallocate(void *ptr, std::size_t size) noexcept
+        {
+            live -= size;
+            std::free(ptr);
+        }
+    };
+
+    fmt::println("┌─────────────────────────────────────────────────────────────");
+    fmt::println("│ {} coroutines with {} KiB stacks, 1 in {} resumed", count, stack.value / 1024, every);
+    fmt::println("├─────────────────────────────────────────────────────────────");
+
+    for (bool lazy : {false, true})
+    {
+        peak_allocator alloc;
+        std::vector<coro::coroutine> live;
+        live.reserve(count);
+        std::size_t ran = 0;
+        auto const body = [&ran](coro::coroutine_handle)
+        { ++ran; };
+
+        auto const start = std::chrono::high_resolution_clock::now();
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            auto c = lazy ? coro::coroutine::create_lazy(body, stack, coro::default_storage_size, alloc)
+                          : coro::coroutine::create(body, stack, coro::default_storage_size, alloc);
+            if (!c)
+                return;
+            if (i % every == 0)
+                (void)c->resume();
+            live.push_back(std::move(*c));
+        }
+        live.clear();
+        auto const ns = std::chrono::duration<double, std::nano>(std::chrono::high_resolution_clock::now() - start).count();
+        if (ran != count / every)
+            fmt::println("│ lost coroutines");
+        fmt::println("│ {:<8} {:8.1f} ns per coroutine, peak {:8.1f} MiB", lazy ? "lazy:" : "eager:", ns / static_cast<double>(count),
+                     static_cast<double>(alloc.peak) / (1024.0 * 1024.0));
+    }
+    fmt::println("└─────────────────────────────────────────────────────────────\n");
+}
+
+// startup: one create() per worker against a single create_many slab
+void bench_bulk_create()
+{
+    constexpr std::size_t count = 10'000;
+
+    fmt::println("┌─────────────────────────────────────────────────────────────");
+    fmt::println("│ spawn {} workers ({} KiB stacks), then resume each once", count, coro::min_stack_size.value / 1024);
+    fmt::println("├─────────────────────────────────────────────────────────────");
+
+    std::size_t ran = 0;
+    auto const factory = [&ran](std::size_t)
+    {
+        return [&ran](coro::coroutine_handle)
+        { ++ran; };
+    };
+    auto const report = [](char const *label, auto const &created, auto const &started)
+    {
+        auto const create_ns = std::chrono::duration<double, std::nano>(created).count();
+        auto const first_ns = std::chrono::duration<double, std::nano>(started).count();
+        fmt::println("│ {:<22} create {:7.1f} ns, first resume {:7.1f} ns per coroutine", label, create_ns / count, first_ns / count);
+    };
+
+    {
+        auto const start = std::chrono::high_resolution_clock::now();
+        std::vector<coro::coroutine> workers;
+        workers.reserve(count);
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            auto c = coro::coroutine::create(factory(i), coro::min_stack_size);
+            if (!c)
+                return;
+            workers.push_back(std::move(*c));
+        }
+        auto const created = std::chrono::high_resolution_clock::now();
+        for (auto &c : workers)
+            (void)c.resume();
+        report("create() x N:", created - start, std::chrono::high_resolution_clock::now() - created);
+    }
+
+    for (auto const &[label, options] : {std::pair{"create_many:", coro::slab_options{}},
+                                         std::pair{"create_many prefault:", coro::slab_options{.prefault = true}},
+                                         std::pair{"create_many huge:", coro::slab_options{.prefault = true, .huge_pages = true}}})
+    {
+        auto const start = std::chrono::high_resolution_clock::now();
+        auto workers = coro::coroutine::create_many(count, factory, coro::min_stack_size, coro::default_storage_size, options);
+        if (!workers)
+            return;
+        auto const created = std::chrono::high_resolution_clock::now();
+        for (auto &c : *workers)
+            (void)c.resume();
+        report(label, created - start, std::chrono::high_resolution_clock::now() - created);
+    }
+    if (ran != 4 * count)
+        fmt::println("│ lost coroutines");
+    fmt::println("└─────────────────────────────────────────────────────────────\n");
+}
+
+// async I/O: many coroutines doing small reads, one reactor call per tick
+#if defined(__linux__)
+void bench_uring_reads()
+{
+    constexpr std::size_t tasks = 64;
+    constexpr std::size_t reads = 500;
+    constexpr std::size_t total = tasks * reads;
+
+    fmt::println("┌─────────────────────────────────────────────────────────────");
+    fmt::println("│ 4 KiB reads from /dev/zero ({} coroutines x {})", tasks, reads);
+    fmt::println("├─────────────────────────────────────────────────────────────");
+
+    int const fd = ::open("/dev/zero", O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return;
+
+    {
+        std::array<std::byte, 4096> buf{};
+        auto const start = std::chrono::high_resolution_clock::now();
+        for (std::size_t i = 0; i < total; ++i)
+            (void)!::read(fd, buf.data(), buf.size());
+        auto const ns = std::chrono::duration<double, std::nano>(std::chrono::high_resolution_clock::now() - start).count();
+        fmt::println("│ {:<27} {:8.1f} ns per read", "blocking read(2):", ns / static_cast<double>(total));
+    }
+
+    for (auto backend : {coro::io::backend::io_uring, coro::io::readiness_backend})
+    {
+        auto runner = coro::io::runner::create(backend);
+        if (!runner)
+        {
+            fmt::println("│ {:<9} unavailable (errno {})", coro::io::to_string(backend), coro::io::last_errno());
+            continue;
+        }
+        std::vector<std::array<std::byte, 4096>> buffers(tasks);
+        for (auto &buf : buffers)
+        {
+            auto coro = coro::coroutine::create([fd, &buf](coro::coroutine_handle h)
+                                                {
+                for (std::size_t i = 0; i < reads; ++i)
+                    (void)coro::io::read(h, fd, buf); });
+            if (coro)
+                runner->add(std::move(*coro));
+        }
+        auto const start = std::chrono::high_resolution_clock::now();
+        (void)runner->run();
+        auto const ns = std::chrono::duration<double, std::nano>(std::chrono::high_resolution_clock::now() - start).count();
+        fmt::println("│ {:<27} {:8.1f} ns per read, {} reactor calls", fmt::format("runner ({}):", coro::io::to_string(backend)),
+                     ns / static_cast<double>(total), runner->reactor_calls());
+    }
+    fmt::println("└─────────────────────────────────────────────────────────────\n");
+    ::close(fd);
+}
+#endif
+
+// resident memory of many parked coroutines: committed calloc frames vs lazily backed mmap stacks
+#if defined(__linux__)
+static auto resident_bytes() -> std::size_t
+{
+    std::FILE *f = std::fopen("/proc/self/statm", "r");
+    if (f == nullptr)
+        return 0;
+    unsigned long size = 0;
+    unsigned long resident = 0;
+    int const n = std::fscanf(f, "%lu %lu", &size, &resident);
+    std::fclose(f);
+    return n == 2 ? resident * static_cast<std::size_t>(sysconf(_SC_PAGESIZE)) : 0;
+}
+
+template <typename Create>
+static void measure_idle_footprint(char const *name, std::size_t count, Create create)
+{
+    std::vector<coro::coroutine> parked;
+    parked.reserve(count);
+    auto const before = resident_bytes();
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        auto coro = create();
+        if (!coro)
+            break;
+        (void)coro->resume();
+        parked.push_back(std::move(*coro));
+    }
+    auto const after = resident_bytes();
+    fmt::println("│ {:<28} {:6} coroutines, {:8.1f} KiB RSS each", name, parked.size(),
+                 static_cast<double>(after - before) / 1024.0 / static_cast<double>(std::max<std::size_t>(parked.size(), 1)));
+}
+#endif
+
+void bench_idle_footprint()
+{
+#if defined(__linux__)
+    fmt::println("┌─────────────────────────────────────────────────────────────");
+    fmt::println("│ idle footprint (one yield deep)");
+    fmt::println("├─────────────────────────────────────────────────────────────");
+
+    constexpr std::size_t count = 10'000;
+    auto const park = [](coro::coroutine_handle h)
+    { [[maybe_unused]] auto _ = h.yield(); };
+
+    measure_idle_footprint("calloc, default stack", count, [&park]()
+                           { return coro::coroutine::create(park); });
+
+    coro::virtual_stack_allocator alloc;
+    measure_idle_footprint("mmap, default stack", count, [&park, &alloc]()
+                           { return coro::coroutine::create(park, coro::default_stack_size, coro::default_storage_size, alloc); });
+    measure_idle_footprint("mmap, 1 MiB stack", count, [&park, &alloc]()
+                           { return coro::coroutine::create(park, coro::stack_size{1024 * 1024}, coro::default_storage_size, alloc); });
+    fmt::println("└─────────────────────────────────────────────────────────────\n");
+#endif
+}
+
+// Recurses until about `bytes` of stack are live, then yields forever from the bottom.
+[[gnu::noinline]] static void hold_stack_depth(coro::coroutine_handle h, std::size_t bytes)
+{
+    volatile unsigned char pad[240];
+    pad[0] = 1;
+    pad[sizeof(pad) - 1] = 1;
+    if (bytes > sizeof(pad))
+        hold_stack_depth(h, bytes - sizeof(pad));
+    else
+        while (true)
+            h.yield_unchecked();
+    pad[0] = 0;
+}
+
+// Copying stacks against one stack per coroutine: every resume lands on a different member,
+// so the shared mode copies the live stack out and in each time.
+void bench_shared_stacks()
+{
+    constexpr std::size_t members = 1'000;
+    constexpr coro::stack_size own_stack{64 * 1024};
+
+    fmt::println("┌─────────────────────────────────────────────────────────────");
+    fmt::println("│ {} parked coroutines, round-robin resume, by live stack depth", members);
+    fmt::println("├─────────────────────────────────────────────────────────────");
+
+    auto stack = coro::shared_stack::create();
+    if (!stack)
+        return;
+    coro::virtual_stack_allocator vm;
+    for (std::size_t depth : {std::size_t{256}, std::size_t{1024}, std::size_t{4096}, std::size_t{16384}})
+    {
+        for (bool shared : {false, true})
+        {
+            auto const body = [depth](coro::coroutine_handle h)
+            { hold_stack_depth(h, depth); };
+#if defined(__linux__)
+            auto const before = resident_bytes();
+#endif
+            std::vector<coro::coroutine> ring;
+            ring.reserve(members);
+            for (std::size_t i = 0; i < members; ++i)
+            {
+                auto c = shared ? coro::coroutine::create_shared(body, *stack)
+                                : coro::coroutine::create(body, own_stack, coro::default_storage_size, vm);
+                if (!c)
+                    return;
+                c->resume_unchecked();
+                ring.push_back(std::move(*c));
+            }
+#if defined(__linux__)
+            auto const per_coroutine = static_cast<double>(resident_bytes() - before) / static_cast<double>(members);
+#else
+            double const per_coroutine = 0;
+#endif
+            std::size_t next = 0;
+            auto const rounds = 200'000;
+            auto const start = std::chrono::high_resolution_clock::now();
+            for (int i = 0; i < rounds; ++i)
+            {
+                ring[next].resume_unchecked();
+                if (++next == ring.size())
+                    next = 0;
+            }
+            auto const ns = std::chrono::duration<double, std::nano>(std::chrono::high_resolution_clock::now() - start).count();
+            fmt::println("│ {:>6} B live, {:<7} {:7.1f} ns per resume, {:8.1f} KiB RSS each", depth, shared ? "shared:" : "own:",
+                         ns / rounds, per_coroutine / 1024.0);
+        }
+    }
+    fmt::println("└─────────────────────────────────────────────────────────────\n");
+}
+
+// TLB reach: 10k coroutines with 1 KiB live each, resumed round-robin, so every switch lands
+// on pages nobody touched for 10k switches. Node-local 2 MiB chunks against malloc'd stacks.
+void bench_numa_stacks()
+{
+    constexpr std::size_t live = 10'000;
+    constexpr coro::stack_size stack{16 * 1024};
+    int const node = coro::numa_stack_allocator::current_node();
+
+    auto const ring_over = [&](char const *label, auto &alloc)
+    {
+        std::vector<coro::coroutine> ring;
+        ring.reserve(live);
+        for (std::size_t i = 0; i < live; ++i)
+        {
+            auto c = coro::coroutine::create([](coro::coroutine_handle h)
+                                             { hold_stack_depth(h, 1024); },
+                                             stack, coro::default_storage_size, alloc);
+            if (!c)
+                return;
+            c->resume_unchecked();
+            ring.push_back(std::move(*c));
+        }
+        std::size_t next = 0;
+        auto result = benchmark::run(fmt::format("round-robin resume over {} coroutines, {} (node {})", live, label, node), 1'000'000, [&ring, &next]()
+                                     {
+            ring[next].resume_unchecked();
+            if (++next == ring.size())
+                next = 0; });
+        benchmark::print_result(result);
+    };
+
+    coro::malloc_allocator heap;
+    ring_over("malloc stacks", heap);
+    coro::numa_stack_allocator local;
+    ring_over("numa_stack_allocator, 4 KiB pages", local);
+    coro::numa_stack_allocator thp{coro::numa_stack_allocator::caller_node, coro::page_kind::transparent_huge};
+    ring_over("numa_stack_allocator, transparent huge pages", thp);
+    coro::numa_stack_allocator hugetlb{coro::numa_stack_allocator::caller_node, coro::page_kind::explicit_huge};
+    ring_over("numa_stack_allocator, explicit huge pages", hugetlb);
+}
+
 // ============================================================================
 // main
 // ============================================================================
 
-int main()
+// usage: benchmark_ucoro [--json <path>] [--perf] [--no-pin]
+int main(int argc, char **argv)
 {
+    auto &opts = benchmark::settings();
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string_view const arg{argv[i]};
+        if (arg == "--json" && i + 1 < argc)
+            opts.json_path = argv[++i];
+        else if (arg == "--perf")
+            opts.perf = true;
+        else if (arg == "--no-pin")
+            opts.pin = false;
+        else
+        {
+            fmt::println(stderr, "usage: {} [--json <path>] [--perf] [--no-pin]", argv[0]);
+            return 2;
+        }
+    }
+
     fmt::println("═══════════════════════════════════════════════════════════════");
     fmt::println("              ucoro C++23 wrapper benchmarks                ");
     fmt::println("═══════════════════════════════════════════════════════════════\n");
 
+    if (opts.pin)
+        pin_to_current_cpu();
+    fmt::println("cycle counter: {:.3f} ticks/ns\n", ticks::per_ns());
+    if (opts.perf)
+    {
+        perf_counters probe;
+        if (!probe.open())
+            fmt::println("perf counters unavailable (perf_event_paranoid or no PMU); timing only\n");
+    }
+
     bench_memory_overhead();
     bench_allocation_pattern();
+    bench_idle_footprint();
+    bench_shared_stacks();
+    bench_numa_stacks();
     bench_create_destroy();
     bench_context_switch();
+    bench_pipeline_hops();
     bench_storage_push_pop();
     bench_generator_iteration();
+    bench_task_runner_scaling();
+    bench_channel_ping_pong();
+    bench_timers();
+    bench_cancellation();
+    bench_scope_fan_out();
+    bench_select();
+    bench_cold_switches();
+    bench_scheduler_throughput();
+    bench_scheduling_policies();
+    bench_pool_churn();
+    bench_lazy_fanout();
+    bench_bulk_create();
+#if defined(__linux__)
+    bench_uring_reads();
+#endif
+    bench_thread_pool_runner();
+
+    if (!opts.json_path.empty())
+    {
+        if (!benchmark::write_json(opts.json_path))
+        {
+            fmt::println(stderr, "could not write {}", opts.json_path);
+            return 1;
+        }
+        fmt::println("wrote {} results to {}\n", benchmark::results().size(), opts.json_path);
+    }
 
     fmt::println("═══════════════════════════════════════════════════════════════");
     fmt::println("                     benchmarks complete                       ");
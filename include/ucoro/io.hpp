@@ -0,0 +1,1313 @@
+// io.hpp - async I/O for ucoro: io_uring (Linux 5.6+), epoll (Linux), kqueue (macOS/BSD)
+// Straight-line socket and file I/O inside coroutines; one reactor syscall per scheduler tick.
+// Header-only on top of ucoro.hpp; talks to the kernel through raw syscalls, no liburing.
+//
+// SPDX-License-Identifier: MIT OR Unlicense
+
+#pragma once
+
+#include "ucoro.hpp"
+
+#if defined(__linux__)
+#define UCORO_IO_AVAILABLE 1
+#define UCORO_IO_URING 1
+#define UCORO_IO_EPOLL 1
+#define UCORO_IO_KQUEUE 0
+#elif defined(__APPLE__) || defined(__FreeBSD__) || defined(__NetBSD__) || defined(__OpenBSD__) || defined(__DragonFly__)
+#define UCORO_IO_AVAILABLE 1
+#define UCORO_IO_URING 0
+#define UCORO_IO_EPOLL 0
+#define UCORO_IO_KQUEUE 1
+#endif
+
+#if defined(UCORO_IO_AVAILABLE)
+
+#include <cerrno>
+#include <climits>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#if UCORO_IO_URING
+#include <linux/io_uring.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+#if UCORO_IO_EPOLL
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#endif
+
+#if UCORO_IO_KQUEUE
+#include <sys/event.h>
+#include <sys/time.h>
+#endif
+
+namespace coro::io
+{
+    enum class backend : std::uint8_t
+    {
+        automatic, // io_uring if the kernel allows it, else the readiness poller
+        io_uring,  // completion based (Linux)
+        epoll,     // readiness based (Linux)
+        kqueue     // readiness based (macOS/BSD)
+    };
+
+    [[nodiscard]] constexpr auto to_string(backend b) noexcept -> std::string_view
+    {
+        switch (b)
+        {
+        case backend::automatic:
+            return "automatic";
+        case backend::io_uring:
+            return "io_uring";
+        case backend::epoll:
+            return "epoll";
+        case backend::kqueue:
+            return "kqueue";
+        }
+        return "unknown backend";
+    }
+
+    // The readiness backend of this platform.
+    inline constexpr backend readiness_backend = UCORO_IO_KQUEUE ? backend::kqueue : backend::epoll;
+
+    // Pass as `offset` to read/write at (and advance) the file's current position.
+    inline constexpr std::uint64_t current_offset = ~std::uint64_t{0};
+
+    // Index into the table given to runner::register_files().
+    struct fixed_file
+    {
+        unsigned index;
+    };
+
+    namespace detail
+    {
+        inline thread_local int last_errno = 0;
+
+        // Where an operation points: a plain descriptor or a slot in the registered file table.
+        struct target
+        {
+            int fd;
+            bool fixed;
+        };
+
+        inline auto fail(int err) noexcept -> std::unexpected<error>
+        {
+            last_errno = err;
+            return std::unexpected{error::io_error};
+        }
+
+        struct ops;
+
+#if UCORO_IO_EPOLL
+        // The descriptor other threads write to when they post to a runner asleep in its
+        // reactor (Linux; kqueue triggers an EVFILT_USER event instead).
+        class event_fd
+        {
+        public:
+            [[nodiscard]] static auto create() noexcept -> std::expected<event_fd, error>
+            {
+                int const fd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+                if (fd < 0)
+                    return fail(errno);
+                event_fd e;
+                e.fd_ = fd;
+                return e;
+            }
+
+            event_fd() noexcept = default;
+            event_fd(event_fd const &) = delete;
+            auto operator=(event_fd const &) -> event_fd & = delete;
+            event_fd(event_fd &&other) noexcept : fd_{std::exchange(other.fd_, -1)} {}
+
+            auto operator=(event_fd &&other) noexcept -> event_fd &
+            {
+                if (this != &other)
+                {
+                    if (fd_ >= 0)
+                        ::close(fd_);
+                    fd_ = std::exchange(other.fd_, -1);
+                }
+                return *this;
+            }
+
+            ~event_fd()
+            {
+                if (fd_ >= 0)
+                    ::close(fd_);
+            }
+
+            // The doorbell's signal: runs on the posting thread.
+            static void signal(int fd) noexcept
+            {
+                std::uint64_t const one = 1;
+                [[maybe_unused]] auto const n = ::write(fd, &one, sizeof(one));
+            }
+
+            // Resets the counter so the next signal is a fresh edge.
+            void drain() const noexcept
+            {
+                std::uint64_t count = 0;
+                [[maybe_unused]] auto const n = ::read(fd_, &count, sizeof(count));
+            }
+
+            [[nodiscard]] auto fd() const noexcept -> int { return fd_; }
+
+        private:
+            int fd_{-1};
+        };
+#endif
+
+#if UCORO_IO_URING
+        // One in-flight operation. Lives on the waiting coroutine's stack; its address is the
+        // SQE's user_data, so reaping a CQE needs no lookup.
+        struct uring_op
+        {
+            coro::detail::mco_coro *co = nullptr;
+            int res = 0;
+            bool done = false;
+        };
+
+        inline auto sys_io_uring_setup(unsigned entries, io_uring_params *params) noexcept -> int
+        {
+            return static_cast<int>(::syscall(__NR_io_uring_setup, entries, params));
+        }
+
+        inline auto sys_io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) noexcept -> int
+        {
+            return static_cast<int>(::syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0));
+        }
+
+        inline auto sys_io_uring_register(int fd, unsigned opcode, void const *arg, unsigned count) noexcept -> int
+        {
+            return static_cast<int>(::syscall(__NR_io_uring_register, fd, opcode, arg, count));
+        }
+
+        // The mapped submission and completion rings. Only the owning thread touches them.
+        class uring
+        {
+        public:
+            [[nodiscard]] static auto create(unsigned entries) noexcept -> std::expected<uring, error>
+            {
+                if (entries == 0)
+                    return std::unexpected{error::invalid_arguments};
+                io_uring_params params{};
+                int const fd = sys_io_uring_setup(entries, &params);
+                if (fd < 0)
+                    return fail(errno);
+
+                uring ring;
+                ring.fd_ = fd;
+                ring.ext_arg_ = (params.features & IORING_FEAT_EXT_ARG) != 0;
+                ring.sq_map_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+                ring.cq_map_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+                bool const single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+                if (single_mmap)
+                    ring.sq_map_size_ = ring.cq_map_size_ = std::max(ring.sq_map_size_, ring.cq_map_size_);
+
+                ring.sq_map_ = ::mmap(nullptr, ring.sq_map_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+                if (ring.sq_map_ == MAP_FAILED)
+                {
+                    ring.sq_map_ = nullptr;
+                    return fail(errno);
+                }
+                if (single_mmap)
+                {
+                    ring.cq_map_ = ring.sq_map_;
+                }
+                else
+                {
+                    ring.cq_map_ = ::mmap(nullptr, ring.cq_map_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+                    if (ring.cq_map_ == MAP_FAILED)
+                    {
+                        ring.cq_map_ = nullptr;
+                        return fail(errno);
+                    }
+                }
+                ring.sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+                void *sqes = ::mmap(nullptr, ring.sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+                if (sqes == MAP_FAILED)
+                    return fail(errno);
+                ring.sqes_ = static_cast<io_uring_sqe *>(sqes);
+
+                auto *sq = static_cast<unsigned char *>(ring.sq_map_);
+                auto *cq = static_cast<unsigned char *>(ring.cq_map_);
+                ring.sq_head_ = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+                ring.sq_tail_ = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+                ring.sq_mask_ = *reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+                ring.sq_entries_ = params.sq_entries;
+                ring.cq_head_ = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+                ring.cq_tail_ = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+                ring.cq_mask_ = *reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+                ring.cqes_ = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+
+                // slot i always holds SQE i; submission order comes from the tail alone
+                auto *array = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+                for (unsigned i = 0; i < params.sq_entries; ++i)
+                    array[i] = i;
+                ring.local_tail_ = *ring.sq_tail_;
+                return ring;
+            }
+
+            uring() noexcept = default;
+            uring(uring const &) = delete;
+            auto operator=(uring const &) -> uring & = delete;
+
+            uring(uring &&other) noexcept { swap(other); }
+
+            auto operator=(uring &&other) noexcept -> uring &
+            {
+                if (this != &other)
+                {
+                    uring{std::move(other)}.swap(*this);
+                }
+                return *this;
+            }
+
+            ~uring()
+            {
+                if (sqes_ != nullptr)
+                    ::munmap(sqes_, sqes_size_);
+                if (cq_map_ != nullptr && cq_map_ != sq_map_)
+                    ::munmap(cq_map_, cq_map_size_);
+                if (sq_map_ != nullptr)
+                    ::munmap(sq_map_, sq_map_size_);
+                if (fd_ >= 0)
+                    ::close(fd_);
+            }
+
+            // Next free SQE, zeroed. Pushes queued entries to the kernel first if the ring is full.
+            [[nodiscard]] auto get_sqe() noexcept -> io_uring_sqe *
+            {
+                if (local_tail_ - std::atomic_ref{*sq_head_}.load(std::memory_order_acquire) == sq_entries_)
+                {
+                    if (!enter(0) || local_tail_ - std::atomic_ref{*sq_head_}.load(std::memory_order_acquire) == sq_entries_)
+                        return nullptr;
+                }
+                io_uring_sqe *sqe = &sqes_[local_tail_ & sq_mask_];
+                *sqe = io_uring_sqe{};
+                return sqe;
+            }
+
+            // Publishes the SQE from get_sqe(); the kernel sees it on the next enter().
+            void commit() noexcept
+            {
+                ++local_tail_;
+                ++unsubmitted_;
+                std::atomic_ref{*sq_tail_}.store(local_tail_, std::memory_order_release);
+            }
+
+            // One io_uring_enter: submits everything queued and, if min_complete > 0, blocks
+            // until that many completions are posted.
+            [[nodiscard]] auto enter(unsigned min_complete) noexcept -> bool
+            {
+                for (;;)
+                {
+                    unsigned const flags = min_complete != 0 ? IORING_ENTER_GETEVENTS : 0;
+                    int const submitted = sys_io_uring_enter(fd_, unsubmitted_, min_complete, flags);
+                    if (submitted >= 0)
+                    {
+                        unsubmitted_ -= static_cast<unsigned>(submitted);
+                        ++enters_;
+                        return true;
+                    }
+                    if (errno != EINTR)
+                    {
+                        last_errno = errno;
+                        return false;
+                    }
+                }
+            }
+
+            // Like enter(1), but gives up after timeout_ms. Kernels before 5.11 lack the timed
+            // enter, so there the submit and the wait (poll() on the ring fd) are two calls.
+            [[nodiscard]] auto enter_for(int timeout_ms) noexcept -> bool
+            {
+                if (!ext_arg_)
+                {
+                    if (unsubmitted_ != 0 && !enter(0))
+                        return false;
+                    pollfd pfd{.fd = fd_, .events = POLLIN, .revents = 0};
+                    if (completions() == 0 && ::poll(&pfd, 1, timeout_ms) < 0 && errno != EINTR)
+                    {
+                        last_errno = errno;
+                        return false;
+                    }
+                    return true;
+                }
+                __kernel_timespec ts{.tv_sec = timeout_ms / 1000, .tv_nsec = static_cast<long long>(timeout_ms % 1000) * 1'000'000};
+                io_uring_getevents_arg arg{};
+                arg.ts = reinterpret_cast<std::uint64_t>(&ts);
+                unsigned const flags = IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG;
+                int const submitted = static_cast<int>(::syscall(__NR_io_uring_enter, fd_, unsubmitted_, 1u, flags, &arg, sizeof(arg)));
+                if (submitted >= 0)
+                    unsubmitted_ -= static_cast<unsigned>(submitted);
+                else if (errno != ETIME && errno != EINTR)
+                {
+                    last_errno = errno;
+                    return false;
+                }
+                ++enters_;
+                return true;
+            }
+
+            // CQEs posted and not yet reaped.
+            [[nodiscard]] auto completions() const noexcept -> unsigned
+            {
+                return std::atomic_ref{*cq_tail_}.load(std::memory_order_acquire) - *cq_head_;
+            }
+
+            // Hands every posted CQE to fn(user_data, res) and releases the slots in one store.
+            template <typename F>
+            auto reap(F &&fn) noexcept -> unsigned
+            {
+                unsigned head = *cq_head_;
+                unsigned const tail = std::atomic_ref{*cq_tail_}.load(std::memory_order_acquire);
+                unsigned const count = tail - head;
+                for (; head != tail; ++head)
+                {
+                    io_uring_cqe const &cqe = cqes_[head & cq_mask_];
+                    fn(cqe.user_data, cqe.res);
+                }
+                std::atomic_ref{*cq_head_}.store(head, std::memory_order_release);
+                return count;
+            }
+
+            [[nodiscard]] auto fd() const noexcept -> int { return fd_; }
+            [[nodiscard]] auto unsubmitted() const noexcept -> unsigned { return unsubmitted_; }
+            [[nodiscard]] auto enters() const noexcept -> std::size_t { return enters_; }
+
+        private:
+            void swap(uring &other) noexcept
+            {
+                std::swap(fd_, other.fd_);
+                std::swap(sq_map_, other.sq_map_);
+                std::swap(cq_map_, other.cq_map_);
+                std::swap(sq_map_size_, other.sq_map_size_);
+                std::swap(cq_map_size_, other.cq_map_size_);
+                std::swap(sqes_, other.sqes_);
+                std::swap(sqes_size_, other.sqes_size_);
+                std::swap(sq_head_, other.sq_head_);
+                std::swap(sq_tail_, other.sq_tail_);
+                std::swap(sq_mask_, other.sq_mask_);
+                std::swap(sq_entries_, other.sq_entries_);
+                std::swap(cq_head_, other.cq_head_);
+                std::swap(cq_tail_, other.cq_tail_);
+                std::swap(cq_mask_, other.cq_mask_);
+                std::swap(cqes_, other.cqes_);
+                std::swap(local_tail_, other.local_tail_);
+                std::swap(unsubmitted_, other.unsubmitted_);
+                std::swap(enters_, other.enters_);
+                std::swap(ext_arg_, other.ext_arg_);
+            }
+
+            int fd_{-1};
+            void *sq_map_{nullptr};
+            void *cq_map_{nullptr};
+            std::size_t sq_map_size_{0};
+            std::size_t cq_map_size_{0};
+            io_uring_sqe *sqes_{nullptr};
+            std::size_t sqes_size_{0};
+            unsigned *sq_head_{nullptr};
+            unsigned *sq_tail_{nullptr};
+            unsigned sq_mask_{0};
+            unsigned sq_entries_{0};
+            unsigned *cq_head_{nullptr};
+            unsigned *cq_tail_{nullptr};
+            unsigned cq_mask_{0};
+            io_uring_cqe *cqes_{nullptr};
+            unsigned local_tail_{0};
+            unsigned unsubmitted_{0};
+            std::size_t enters_{0};
+            bool ext_arg_{false}; // IORING_FEAT_EXT_ARG: enter() takes a timeout
+        };
+#endif // UCORO_IO_URING
+
+        // Coroutines parked on one descriptor, one FIFO per direction.
+        struct fd_state
+        {
+            coro::detail::wait_list readers;
+            coro::detail::wait_list writers;
+            bool registered = false;
+        };
+
+        // epoll / kqueue instance plus a table indexed by fd. Every descriptor is registered once,
+        // edge-triggered for both directions, and stays armed for as long as it is open, so
+        // waiting costs no epoll_ctl/kevent change. Operations try the syscall first and only
+        // park on EAGAIN; the next edge wakes every waiter on that side to retry.
+        class poller
+        {
+        public:
+            [[nodiscard]] static auto create() noexcept -> std::expected<poller, error>
+            {
+#if UCORO_IO_EPOLL
+                int const fd = ::epoll_create1(EPOLL_CLOEXEC);
+#else
+                int const fd = ::kqueue();
+#endif
+                if (fd < 0)
+                    return fail(errno);
+#if UCORO_IO_KQUEUE
+                (void)::fcntl(fd, F_SETFD, FD_CLOEXEC);
+#endif
+                poller p;
+                p.fd_ = fd;
+                return p;
+            }
+
+            poller() noexcept = default;
+            poller(poller const &) = delete;
+            auto operator=(poller const &) -> poller & = delete;
+
+            poller(poller &&other) noexcept
+                : fd_{std::exchange(other.fd_, -1)},
+                  bell_{std::exchange(other.bell_, -1)},
+                  table_{std::move(other.table_)},
+                  table_size_{std::exchange(other.table_size_, 0)},
+                  waiting_{std::exchange(other.waiting_, 0)},
+                  calls_{std::exchange(other.calls_, 0)}
+            {
+            }
+
+            auto operator=(poller &&other) noexcept -> poller &
+            {
+                if (this != &other)
+                {
+                    if (fd_ >= 0)
+                        ::close(fd_);
+                    fd_ = std::exchange(other.fd_, -1);
+                    bell_ = std::exchange(other.bell_, -1);
+                    table_ = std::move(other.table_);
+                    table_size_ = std::exchange(other.table_size_, 0);
+                    waiting_ = std::exchange(other.waiting_, 0);
+                    calls_ = std::exchange(other.calls_, 0);
+                }
+                return *this;
+            }
+
+            ~poller()
+            {
+                if (fd_ >= 0)
+                    ::close(fd_);
+            }
+
+            // Makes fd non-blocking and adds it to the interest set, once. The cached entry is
+            // trusted until forget(): a number closed behind our back and reused is neither
+            // re-registered nor made non-blocking, and O_NONBLOCK is never cleared again.
+            [[nodiscard]] auto arm(int fd) noexcept -> std::expected<void, error>
+            {
+                if (fd < 0)
+                    return fail(EBADF);
+                auto const index = static_cast<std::size_t>(fd);
+                if (index >= table_size_)
+                {
+                    std::size_t const grown_size = std::max<std::size_t>(64, std::bit_ceil(index + 1));
+                    auto *grown = new (std::nothrow) fd_state[grown_size];
+                    if (grown == nullptr)
+                        return std::unexpected{error::out_of_memory};
+                    std::copy_n(table_.get(), table_size_, grown);
+                    table_.reset(grown);
+                    table_size_ = grown_size;
+                }
+                fd_state &st = table_[index];
+                if (st.registered)
+                    return {};
+
+                int const flags = ::fcntl(fd, F_GETFL);
+                if (flags < 0)
+                    return fail(errno);
+                if ((flags & O_NONBLOCK) == 0 && ::fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0)
+                    return fail(errno);
+#if UCORO_IO_EPOLL
+                epoll_event ev{};
+                ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+                ev.data.fd = fd;
+                // regular files can't be polled (EPERM) but never return EAGAIN either
+                if (::epoll_ctl(fd_, EPOLL_CTL_ADD, fd, &ev) < 0 && errno != EEXIST && errno != EPERM)
+                    return fail(errno);
+#else
+                struct kevent changes[2];
+                EV_SET(&changes[0], static_cast<uintptr_t>(fd), EVFILT_READ, EV_ADD | EV_CLEAR, 0, 0, nullptr);
+                EV_SET(&changes[1], static_cast<uintptr_t>(fd), EVFILT_WRITE, EV_ADD | EV_CLEAR, 0, 0, nullptr);
+                if (::kevent(fd_, changes, 2, nullptr, 0, nullptr) < 0)
+                    return fail(errno);
+#endif
+                st.registered = true;
+                return {};
+            }
+
+            // Makes poll() return when the doorbell rings. epoll watches the runner's eventfd
+            // (bell); kqueue needs no descriptor, ring() triggers an EVFILT_USER event.
+            [[nodiscard]] auto watch_doorbell([[maybe_unused]] int bell) noexcept -> std::expected<void, error>
+            {
+#if UCORO_IO_EPOLL
+                epoll_event ev{};
+                ev.events = EPOLLIN | EPOLLET;
+                ev.data.fd = bell;
+                if (::epoll_ctl(fd_, EPOLL_CTL_ADD, bell, &ev) < 0)
+                    return fail(errno);
+                bell_ = bell;
+#else
+                struct kevent change;
+                EV_SET(&change, doorbell_ident, EVFILT_USER, EV_ADD | EV_CLEAR, 0, 0, nullptr);
+                if (::kevent(fd_, &change, 1, nullptr, 0, nullptr) < 0)
+                    return fail(errno);
+#endif
+                return {};
+            }
+
+#if UCORO_IO_KQUEUE
+            // The doorbell's signal, with the kqueue descriptor as fd: runs on the posting thread.
+            static void trigger(int kq) noexcept
+            {
+                struct kevent change;
+                EV_SET(&change, doorbell_ident, EVFILT_USER, 0, NOTE_TRIGGER, 0, nullptr);
+                (void)::kevent(kq, &change, 1, nullptr, 0, nullptr);
+            }
+#endif
+
+            // Parks h until the next readiness edge on fd in that direction.
+            [[nodiscard]] auto wait(coroutine_handle h, int fd, bool for_write) noexcept -> std::expected<void, error>
+            {
+                coro::detail::wait_node node{h.raw()};
+                side(fd, for_write).push_back(&node);
+                ++waiting_;
+                auto const result = coro::detail::mco_park_pinned(node.co);
+                side(fd, for_write).erase(&node); // the table may have grown meanwhile
+                --waiting_;
+                if (result != coro::detail::mco_result::success)
+                    return std::unexpected{from_impl_result(result)};
+                return {};
+            }
+
+            // Drops fd from the table before it is closed, so a reused number registers afresh.
+            // Waiters are woken and will see the error from their retried syscall.
+            void forget(int fd) noexcept
+            {
+                if (fd < 0 || static_cast<std::size_t>(fd) >= table_size_)
+                    return;
+                fd_state &st = table_[static_cast<std::size_t>(fd)];
+                wake_all(st.readers);
+                wake_all(st.writers);
+                st.registered = false;
+            }
+
+            // One epoll_wait/kevent, blocking up to timeout_ms (-1: no limit). Wakes the
+            // waiters of every descriptor that saw an edge.
+            [[nodiscard]] auto poll(int timeout_ms) noexcept -> bool
+            {
+                constexpr int max_events = 64;
+#if UCORO_IO_EPOLL
+                std::array<epoll_event, max_events> events;
+                int const n = ::epoll_wait(fd_, events.data(), max_events, timeout_ms);
+#else
+                std::array<struct kevent, max_events> events;
+                timespec const timeout{.tv_sec = timeout_ms / 1000, .tv_nsec = static_cast<long>(timeout_ms % 1000) * 1'000'000};
+                int const n = ::kevent(fd_, nullptr, 0, events.data(), max_events, timeout_ms < 0 ? nullptr : &timeout);
+#endif
+                if (n < 0)
+                {
+                    if (errno == EINTR)
+                        return true;
+                    last_errno = errno;
+                    return false;
+                }
+                ++calls_;
+                for (int i = 0; i < n; ++i)
+                {
+                    auto const &ev = events[static_cast<std::size_t>(i)];
+#if UCORO_IO_EPOLL
+                    if (ev.data.fd == bell_)
+                    {
+                        std::uint64_t count = 0;
+                        [[maybe_unused]] auto const drained = ::read(bell_, &count, sizeof(count));
+                        continue;
+                    }
+                    auto const index = static_cast<std::size_t>(ev.data.fd);
+                    bool const readable = (ev.events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) != 0;
+                    bool const writable = (ev.events & (EPOLLOUT | EPOLLHUP | EPOLLERR)) != 0;
+#else
+                    if (ev.filter == EVFILT_USER)
+                        continue;
+                    auto const index = static_cast<std::size_t>(ev.ident);
+                    bool const failed = (ev.flags & (EV_EOF | EV_ERROR)) != 0;
+                    bool const readable = ev.filter == EVFILT_READ || failed;
+                    bool const writable = ev.filter == EVFILT_WRITE || failed;
+#endif
+                    if (index >= table_size_)
+                        continue;
+                    if (readable)
+                        wake_all(table_[index].readers);
+                    if (writable)
+                        wake_all(table_[index].writers);
+                }
+                return true;
+            }
+
+            [[nodiscard]] auto fd() const noexcept -> int { return fd_; }
+            [[nodiscard]] auto waiting() const noexcept -> std::size_t { return waiting_; }
+            [[nodiscard]] auto calls() const noexcept -> std::size_t { return calls_; }
+
+        private:
+            [[nodiscard]] auto side(int fd, bool for_write) noexcept -> coro::detail::wait_list &
+            {
+                fd_state &st = table_[static_cast<std::size_t>(fd)];
+                return for_write ? st.writers : st.readers;
+            }
+
+            static void wake_all(coro::detail::wait_list &waiters) noexcept
+            {
+                while (coro::detail::wait_node *node = waiters.pop_front())
+                    (void)coro::detail::mco_wake(node->co);
+            }
+
+#if UCORO_IO_KQUEUE
+            static constexpr uintptr_t doorbell_ident = 0; // EVFILT_USER idents are their own namespace
+#endif
+
+            int fd_{-1};
+            int bell_{-1}; // the eventfd poll() drains instead of dispatching (epoll)
+            std::unique_ptr<fd_state[]> table_;
+            std::size_t table_size_{0};
+            std::size_t waiting_{0};
+            std::size_t calls_{0};
+        };
+    } // namespace detail
+
+    // errno of the last coro::io call on this thread that failed with error::io_error.
+    // Read it right after the failing call, before the next yield.
+    [[nodiscard]] inline auto last_errno() noexcept -> int { return detail::last_errno; }
+
+    // task_runner plus an I/O reactor. Each tick resumes the ready tasks, which park inside
+    // coro::io calls; then one reactor syscall (io_uring_enter, epoll_wait or kevent) handles
+    // the whole batch, sleeping only if nothing else is ready, and wakes whoever it unblocked.
+    // With sleepers (coro::sleep_for) it sleeps no longer than the next one is due, and other
+    // threads' post() / wake_remote() cut the sleep short through an eventfd (Linux) or an
+    // EVFILT_USER event (kqueue) the reactor watches alongside the I/O.
+    // Application code is the same whichever backend create() picked.
+    // Don't destroy it while I/O is in flight: the buffers live in the tasks' frames.
+    class [[nodiscard]] runner
+    {
+    public:
+        static constexpr unsigned default_entries = 256;
+
+        // entries sizes the io_uring submission queue; the readiness backends ignore it.
+        [[nodiscard]] static auto create(io::backend which = backend::automatic, unsigned entries = default_entries) noexcept -> std::expected<runner, error>
+        {
+#if UCORO_IO_URING
+            if (which == backend::automatic || which == backend::io_uring)
+            {
+                auto ring = detail::uring::create(entries);
+                if (ring)
+                    return with_doorbell(runner{std::move(*ring)});
+                if (which == backend::io_uring)
+                    return std::unexpected{ring.error()};
+            }
+#else
+            (void)entries;
+#endif
+            if (which != backend::automatic && which != readiness_backend)
+                return std::unexpected{error::invalid_arguments};
+            auto poller = detail::poller::create();
+            if (!poller)
+                return std::unexpected{poller.error()};
+            return with_doorbell(runner{std::move(*poller)});
+        }
+
+        runner(runner &&) noexcept = default;
+        auto operator=(runner &&) noexcept -> runner & = default;
+        runner(runner const &) = delete;
+        auto operator=(runner const &) -> runner & = delete;
+        ~runner() = default;
+
+        auto add(coroutine &&coro) -> runner &
+        {
+            tasks_.add(std::move(coro));
+            return *this;
+        }
+
+        // Thread-safe; see task_runner::post(). A runner blocked in its reactor wakes for it.
+        [[nodiscard]] auto post(coroutine &&coro) noexcept -> std::expected<void, error>
+        {
+            return tasks_.post(std::move(coro));
+        }
+
+        template <coroutine_body F>
+        [[nodiscard]] auto post(F &&func) noexcept -> std::expected<void, error>
+        {
+            return tasks_.post(std::forward<F>(func));
+        }
+
+        // Thread-safe; see task_runner::wake_remote().
+        [[nodiscard]] auto wake_remote(coroutine_handle h) noexcept -> std::expected<void, error>
+        {
+            return tasks_.wake_remote(h);
+        }
+
+        // Runs until every task finished, or the rest are parked with no I/O or timer pending.
+        [[nodiscard]] auto run() noexcept -> std::expected<void, error>
+        {
+            runner *const outer = std::exchange(current_, this);
+            auto result = run_loop(nullptr);
+            current_ = outer;
+            return result;
+        }
+
+        // Keeps serving, blocked in the reactor whenever nothing is ready, until stop is requested.
+        [[nodiscard]] auto run(std::stop_token stop) noexcept -> std::expected<void, error>
+        {
+            std::stop_callback const ring_on_stop{stop, [this]() noexcept
+                                                  { tasks_.bell_.ring(); }};
+            runner *const outer = std::exchange(current_, this);
+            auto result = run_loop(&stop);
+            current_ = outer;
+            return result;
+        }
+
+        // Buffers for read_fixed/write_fixed, pinned once instead of mapped per operation.
+        // Nothing to pin for the readiness backends, where the fixed calls are plain ones.
+        [[nodiscard]] auto register_buffers(std::span<iovec const> buffers) noexcept -> std::expected<void, error>
+        {
+            if (buffers.empty() || buffers.size() > UINT32_MAX)
+                return std::unexpected{error::invalid_arguments};
+#if UCORO_IO_URING
+            if (ring_)
+                return uring_register(IORING_REGISTER_BUFFERS, buffers.data(), buffers.size());
+#endif
+            return {};
+        }
+
+        // Descriptors addressed as fixed_file{index}. io_uring skips its per-op fd lookup for
+        // them; the readiness backends just translate the index.
+        [[nodiscard]] auto register_files(std::span<int const> fds) noexcept -> std::expected<void, error>
+        {
+            if (fds.empty() || fds.size() > UINT32_MAX)
+                return std::unexpected{error::invalid_arguments};
+#if UCORO_IO_URING
+            if (ring_)
+                return uring_register(IORING_REGISTER_FILES, fds.data(), fds.size());
+#endif
+            auto *table = new (std::nothrow) int[fds.size()];
+            if (table == nullptr)
+                return std::unexpected{error::out_of_memory};
+            std::copy(fds.begin(), fds.end(), table);
+            files_.reset(table);
+            file_count_ = fds.size();
+            return {};
+        }
+
+        // Call before closing a descriptor this runner has seen (coro::io::close does). A
+        // number closed with plain ::close and then reused keeps the stale registration: the
+        // new descriptor stays blocking and unwatched, so its operations block this thread or
+        // park forever.
+        void forget(int fd) noexcept
+        {
+            if (poller_)
+                poller_->forget(fd);
+        }
+
+        [[nodiscard]] auto backend() const noexcept -> io::backend { return backend_; }
+        [[nodiscard]] auto size() const noexcept -> std::size_t { return tasks_.size(); }
+        [[nodiscard]] auto empty() const noexcept -> bool { return tasks_.empty(); }
+
+        // Operations submitted but not completed (io_uring) or coroutines waiting on readiness.
+        [[nodiscard]] auto in_flight() const noexcept -> std::size_t
+        {
+            return poller_ ? poller_->waiting() : in_flight_;
+        }
+
+        // io_uring_enter / epoll_wait / kevent calls made by run().
+        [[nodiscard]] auto reactor_calls() const noexcept -> std::size_t
+        {
+#if UCORO_IO_URING
+            if (ring_)
+                return ring_->enters();
+#endif
+            return poller_ ? poller_->calls() : 0;
+        }
+
+        // The runner whose run() is executing on this thread, if any.
+        [[nodiscard]] static auto current() noexcept -> runner * { return current_; }
+
+    private:
+        friend struct detail::ops;
+
+#if UCORO_IO_URING
+        explicit runner(detail::uring ring) noexcept : ring_{std::move(ring)}, backend_{backend::io_uring} {}
+#endif
+        explicit runner(detail::poller poller) noexcept : poller_{std::move(poller)}, backend_{readiness_backend} {}
+
+        // Points the task_runner's doorbell at the reactor, so a ring interrupts its sleep.
+        [[nodiscard]] static auto with_doorbell(runner r) noexcept -> std::expected<runner, error>
+        {
+#if UCORO_IO_EPOLL
+            auto bell = detail::event_fd::create();
+            if (!bell)
+                return std::unexpected{bell.error()};
+            r.bell_ = std::move(*bell);
+            r.tasks_.bell_.set_signal(&detail::event_fd::signal, r.bell_.fd());
+#if UCORO_IO_URING
+            if (r.ring_)
+            {
+                if (!r.arm_doorbell())
+                    return std::unexpected{error::io_error};
+                return r;
+            }
+#endif
+            if (auto watched = r.poller_->watch_doorbell(r.bell_.fd()); !watched)
+                return std::unexpected{watched.error()};
+#else
+            if (auto watched = r.poller_->watch_doorbell(-1); !watched)
+                return std::unexpected{watched.error()};
+            r.tasks_.bell_.set_signal(&detail::poller::trigger, r.poller_->fd());
+#endif
+            return r;
+        }
+
+        [[nodiscard]] auto run_loop(std::stop_token const *stop) noexcept -> std::expected<void, error>
+        {
+            while (stop != nullptr ? !stop->stop_requested() : !tasks_.empty())
+            {
+                auto stepped = tasks_.step();
+                if (!stepped)
+                    return std::unexpected{stepped.error()};
+                bool const idle = tasks_.ready() == 0;
+                if (idle && stop == nullptr && in_flight() == 0 && tasks_.sleeping() == 0)
+                    break;
+                if (!(idle ? sleep(stop) : poll(0)))
+                    return std::unexpected{error::io_error};
+            }
+            return {};
+        }
+
+        // Nothing is ready: block in the reactor, unless another thread already posted (or stop
+        // came) between the step and arming the doorbell.
+        [[nodiscard]] auto sleep(std::stop_token const *stop) noexcept -> bool
+        {
+            (void)tasks_.bell_.arm();
+            bool const quiet = tasks_.inbox_.empty() && (stop == nullptr || !stop->stop_requested());
+            bool const polled = poll(quiet ? idle_timeout() : 0);
+            tasks_.bell_.settle();
+            return polled;
+        }
+
+        // How long the reactor may block with nothing ready: until the next sleeper is due,
+        // rounded up so it doesn't wake a hair early and spin.
+        [[nodiscard]] auto idle_timeout() const noexcept -> int
+        {
+            auto const deadline = tasks_.next_deadline();
+            if (!deadline)
+                return -1;
+            auto const left = std::chrono::ceil<std::chrono::milliseconds>(*deadline - std::chrono::steady_clock::now()).count();
+            return static_cast<int>(std::clamp<decltype(left)>(left, 0, INT_MAX));
+        }
+
+        [[nodiscard]] auto poll(int timeout_ms) noexcept -> bool
+        {
+#if UCORO_IO_URING
+            if (ring_)
+            {
+                bool const entered = timeout_ms < 0    ? ring_->enter(1)
+                                     : timeout_ms > 0  ? ring_->enter_for(timeout_ms)
+                                     : ring_->unsubmitted() == 0 || ring_->enter(0);
+                if (!entered)
+                    return false;
+                bool rang = false;
+                unsigned const reaped = ring_->reap([&rang](std::uint64_t user_data, int res)
+                                                    {
+                    if (user_data == 0) // an IORING_OP_ASYNC_CANCEL's own completion
+                        return;
+                    if (user_data == doorbell_tag)
+                    {
+                        rang = true;
+                        return;
+                    }
+                    auto *op = reinterpret_cast<detail::uring_op *>(user_data);
+                    op->res = res;
+                    op->done = true;
+                    (void)coro::detail::mco_wake(op->co); });
+                in_flight_ -= reaped - (rang ? 1u : 0u);
+                if (rang)
+                {
+                    bell_.drain();
+                    return arm_doorbell();
+                }
+                return true;
+            }
+#endif
+            if (timeout_ms == 0 && poller_->waiting() == 0)
+                return true;
+            return poller_->poll(timeout_ms);
+        }
+
+        [[nodiscard]] auto resolve(detail::target t) const noexcept -> std::expected<int, error>
+        {
+            if (!t.fixed)
+                return t.fd;
+            if (t.fd < 0 || static_cast<std::size_t>(t.fd) >= file_count_)
+                return detail::fail(EBADF);
+            return files_[static_cast<std::size_t>(t.fd)];
+        }
+
+#if UCORO_IO_URING
+        // Queues an SQE for the running coroutine h and parks it until the CQE is reaped.
+        // prep fills in opcode and operands; the result is the CQE's res (>= 0). If h is
+        // cancelled meanwhile, the op is cancelled in the kernel too, but h stays parked until
+        // its CQE arrives: the kernel may still be writing into h's buffer until then.
+        template <typename Prep>
+        [[nodiscard]] auto submit(coroutine_handle h, Prep &&prep) noexcept -> std::expected<int, error>
+        {
+            if (h.raw()->shared_stack != nullptr) // op and buffers would move under the kernel
+                return std::unexpected{error::invalid_operation};
+            io_uring_sqe *sqe = ring_->get_sqe();
+            if (sqe == nullptr)
+                return std::unexpected{error::io_error};
+            detail::uring_op op{h.raw()};
+            prep(*sqe);
+            sqe->user_data = reinterpret_cast<std::uint64_t>(&op);
+            ring_->commit();
+            ++in_flight_;
+
+            bool cancelling = false;
+            while (!op.done)
+            {
+                if (coro::detail::mco_park(op.co, !cancelling) != coro::detail::mco_result::cancelled)
+                    continue;
+                cancelling = true;
+                if (io_uring_sqe *cancel = ring_->get_sqe())
+                {
+                    cancel->opcode = IORING_OP_ASYNC_CANCEL;
+                    cancel->addr = reinterpret_cast<std::uint64_t>(&op);
+                    ring_->commit();
+                    ++in_flight_;
+                }
+            }
+            // an op that beat the cancel keeps its result; the next wait reports the cancel
+            if (cancelling && (op.res == -ECANCELED || op.res == -EINTR))
+                return std::unexpected{error::cancelled};
+            if (op.res < 0)
+                return detail::fail(-op.res);
+            return op.res;
+        }
+
+        // user_data of the doorbell's poll; an op's address is never this small.
+        static constexpr std::uint64_t doorbell_tag = 1;
+
+        // One-shot poll on the eventfd, re-armed each time it fires (multishot needs 5.13).
+        // It isn't counted in in_flight(), so an idle run() still returns.
+        [[nodiscard]] auto arm_doorbell() noexcept -> bool
+        {
+            io_uring_sqe *sqe = ring_->get_sqe();
+            if (sqe == nullptr)
+                return false;
+            sqe->opcode = IORING_OP_POLL_ADD;
+            sqe->fd = bell_.fd();
+            sqe->poll_events = POLLIN;
+            sqe->user_data = doorbell_tag;
+            ring_->commit();
+            return true;
+        }
+
+        [[nodiscard]] auto uring_register(unsigned opcode, void const *arg, std::size_t count) noexcept -> std::expected<void, error>
+        {
+            if (detail::sys_io_uring_register(ring_->fd(), opcode, arg, static_cast<unsigned>(count)) < 0)
+                return detail::fail(errno);
+            return {};
+        }
+#endif
+
+        // Readiness path: retries call(fd) until it stops failing with EAGAIN, parking on
+        // the matching edge in between.
+        template <typename Call>
+        [[nodiscard]] auto until_ready(coroutine_handle h, detail::target t, bool for_write, Call &&call) noexcept -> std::expected<std::size_t, error>
+        {
+            auto fd = resolve(t);
+            if (!fd)
+                return std::unexpected{fd.error()};
+            if (auto armed = poller_->arm(*fd); !armed)
+                return std::unexpected{armed.error()};
+            for (;;)
+            {
+                auto const n = call(*fd);
+                if (n >= 0)
+                    return static_cast<std::size_t>(n);
+                int const err = errno;
+                if (err == EINTR)
+                    continue;
+                if (err != EAGAIN && err != EWOULDBLOCK)
+                    return detail::fail(err);
+                if (auto waited = poller_->wait(h, *fd, for_write); !waited)
+                    return std::unexpected{waited.error()};
+            }
+        }
+
+        static inline thread_local runner *current_ = nullptr;
+
+        task_runner tasks_;
+        // declared after tasks_ so the reactor (and any in-flight I/O) goes first
+#if UCORO_IO_URING
+        std::optional<detail::uring> ring_;
+#endif
+        std::optional<detail::poller> poller_;
+#if UCORO_IO_EPOLL
+        detail::event_fd bell_; // what post() / wake_remote() write to while the reactor sleeps
+#endif
+        std::unique_ptr<int[]> files_; // fixed_file table for the readiness backends
+        std::size_t file_count_{0};
+        std::size_t in_flight_{0};
+        io::backend backend_;
+    };
+
+    namespace detail
+    {
+        // Backend dispatch for the free functions below.
+        struct ops
+        {
+            [[nodiscard]] static auto enter(coroutine_handle h) noexcept -> std::expected<runner *, error>
+            {
+                coro::detail::mco_coro *co = h.raw();
+                if (co == nullptr)
+                    return std::unexpected{error::invalid_coroutine};
+                runner *r = runner::current();
+                if (r == nullptr || co->scheduler == nullptr || co != coro::detail::mco_running())
+                    return std::unexpected{error::invalid_operation};
+                if (co->cancelled)
+                    return std::unexpected{error::cancelled};
+                return r;
+            }
+
+#if UCORO_IO_URING
+            static void prep_target(io_uring_sqe &sqe, target t) noexcept
+            {
+                sqe.fd = t.fd;
+                if (t.fixed)
+                    sqe.flags |= IOSQE_FIXED_FILE;
+            }
+
+            static void prep_rw(io_uring_sqe &sqe, std::uint8_t opcode, target t, void const *buffer, std::size_t size, std::uint64_t offset) noexcept
+            {
+                sqe.opcode = opcode;
+                prep_target(sqe, t);
+                sqe.addr = reinterpret_cast<std::uint64_t>(buffer);
+                sqe.len = static_cast<std::uint32_t>(std::min<std::size_t>(size, UINT32_MAX));
+                sqe.off = offset;
+            }
+
+            [[nodiscard]] static auto uring_rw(runner &r, coroutine_handle h, std::uint8_t opcode, target t, void const *buffer, std::size_t size, std::uint64_t offset, unsigned buffer_index) noexcept -> std::expected<std::size_t, error>
+            {
+                auto res = r.submit(h, [&](io_uring_sqe &sqe)
+                                    {
+                    prep_rw(sqe, opcode, t, buffer, size, offset);
+                    sqe.buf_index = static_cast<std::uint16_t>(buffer_index); });
+                if (!res)
+                    return std::unexpected{res.error()};
+                return static_cast<std::size_t>(*res);
+            }
+#endif
+
+            [[nodiscard]] static auto read(coroutine_handle h, target t, std::span<std::byte> buffer, std::uint64_t offset, bool fixed_buffer = false, unsigned buffer_index = 0) noexcept -> std::expected<std::size_t, error>
+            {
+                auto r = enter(h);
+                if (!r)
+                    return std::unexpected{r.error()};
+#if UCORO_IO_URING
+                if ((*r)->ring_)
+                    return uring_rw(**r, h, fixed_buffer ? IORING_OP_READ_FIXED : IORING_OP_READ, t, buffer.data(), buffer.size(), offset, buffer_index);
+#else
+                (void)fixed_buffer;
+                (void)buffer_index;
+#endif
+                return (*r)->until_ready(h, t, false, [&](int fd)
+                                         { return offset == current_offset ? ::read(fd, buffer.data(), buffer.size())
+                                                                           : ::pread(fd, buffer.data(), buffer.size(), static_cast<off_t>(offset)); });
+            }
+
+            [[nodiscard]] static auto write(coroutine_handle h, target t, std::span<std::byte const> buffer, std::uint64_t offset, bool fixed_buffer = false, unsigned buffer_index = 0) noexcept -> std::expected<std::size_t, error>
+            {
+                auto r = enter(h);
+                if (!r)
+                    return std::unexpected{r.error()};
+#if UCORO_IO_URING
+                if ((*r)->ring_)
+                    return uring_rw(**r, h, fixed_buffer ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE, t, buffer.data(), buffer.size(), offset, buffer_index);
+#else
+                (void)fixed_buffer;
+                (void)buffer_index;
+#endif
+                return (*r)->until_ready(h, t, true, [&](int fd)
+                                         { return offset == current_offset ? ::write(fd, buffer.data(), buffer.size())
+                                                                           : ::pwrite(fd, buffer.data(), buffer.size(), static_cast<off_t>(offset)); });
+            }
+
+            [[nodiscard]] static auto accept(coroutine_handle h, target t, sockaddr *addr, socklen_t *addr_len, int flags) noexcept -> std::expected<int, error>
+            {
+                auto r = enter(h);
+                if (!r)
+                    return std::unexpected{r.error()};
+#if UCORO_IO_URING
+                if ((*r)->ring_)
+                {
+                    return (*r)->submit(h, [&](io_uring_sqe &sqe)
+                                        {
+                        sqe.opcode = IORING_OP_ACCEPT;
+                        prep_target(sqe, t);
+                        sqe.addr = reinterpret_cast<std::uint64_t>(addr);
+                        sqe.addr2 = reinterpret_cast<std::uint64_t>(addr_len);
+                        sqe.accept_flags = static_cast<std::uint32_t>(flags); });
+                }
+#endif
+                auto fd = (*r)->until_ready(h, t, false, [&](int listener)
+                                            {
+#if defined(__APPLE__)
+                    (void)flags; // no accept4 on macOS
+                    return ::accept(listener, addr, addr_len);
+#else
+                    return ::accept4(listener, addr, addr_len, flags);
+#endif
+                                            });
+                if (!fd)
+                    return std::unexpected{fd.error()};
+                return static_cast<int>(*fd);
+            }
+
+            [[nodiscard]] static auto connect(coroutine_handle h, target t, sockaddr const *addr, socklen_t addr_len) noexcept -> std::expected<void, error>
+            {
+                auto r = enter(h);
+                if (!r)
+                    return std::unexpected{r.error()};
+#if UCORO_IO_URING
+                if ((*r)->ring_)
+                {
+                    auto res = (*r)->submit(h, [&](io_uring_sqe &sqe)
+                                            {
+                        sqe.opcode = IORING_OP_CONNECT;
+                        prep_target(sqe, t);
+                        sqe.addr = reinterpret_cast<std::uint64_t>(addr);
+                        sqe.off = addr_len; });
+                    if (!res)
+                        return std::unexpected{res.error()};
+                    return {};
+                }
+#endif
+                // a non-blocking connect reports EINPROGRESS, then writability once it settles
+                bool started = false;
+                auto done = (*r)->until_ready(h, t, true, [&](int fd) -> int
+                                              {
+                    if (started)
+                    {
+                        int so_error = 0;
+                        socklen_t len = sizeof(so_error);
+                        if (::getsockopt(fd, SOL_SOCKET, SO_ERROR, &so_error, &len) < 0)
+                            return -1;
+                        if (so_error != 0)
+                        {
+                            errno = so_error;
+                            return -1;
+                        }
+                    }
+                    started = true;
+                    if (::connect(fd, addr, addr_len) == 0 || errno == EISCONN)
+                        return 0;
+                    if (errno == EINPROGRESS || errno == EALREADY || errno == EINTR)
+                        errno = EAGAIN;
+                    return -1; });
+                if (!done)
+                    return std::unexpected{done.error()};
+                return {};
+            }
+        };
+    } // namespace detail
+
+    // ============================================================================
+    // Operations (call from a coroutine running under runner::run())
+    // ============================================================================
+    //
+    // On the readiness backends (epoll/kqueue) the first operation on a descriptor switches it
+    // to O_NONBLOCK for good and registers it with the runner until coro::io::close (or
+    // runner::forget). Close such descriptors through io::close; after a plain ::close a
+    // reused number is taken for the old, already-registered one, and reads/accepts on it
+    // block the runner thread or never wake. Clear O_NONBLOCK yourself if the descriptor
+    // outlives the runner and is used with blocking calls.
+
+    // Bytes read; 0 at end of file. error::io_error with last_errno() on failure.
+    [[nodiscard]] inline auto read(coroutine_handle h, int fd, std::span<std::byte> buffer, std::uint64_t offset = current_offset) noexcept -> std::expected<std::size_t, error>
+    {
+        return detail::ops::read(h, {fd, false}, buffer, offset);
+    }
+
+    [[nodiscard]] inline auto read(coroutine_handle h, fixed_file file, std::span<std::byte> buffer, std::uint64_t offset = current_offset) noexcept -> std::expected<std::size_t, error>
+    {
+        return detail::ops::read(h, {static_cast<int>(file.index), true}, buffer, offset);
+    }
+
+    // Bytes written, which may be short (sockets, pipes).
+    [[nodiscard]] inline auto write(coroutine_handle h, int fd, std::span<std::byte const> buffer, std::uint64_t offset = current_offset) noexcept -> std::expected<std::size_t, error>
+    {
+        return detail::ops::write(h, {fd, false}, buffer, offset);
+    }
+
+    [[nodiscard]] inline auto write(coroutine_handle h, fixed_file file, std::span<std::byte const> buffer, std::uint64_t offset = current_offset) noexcept -> std::expected<std::size_t, error>
+    {
+        return detail::ops::write(h, {static_cast<int>(file.index), true}, buffer, offset);
+    }
+
+    // Zero-copy variants on io_uring: buffer must lie inside registered buffer `buffer_index`.
+    [[nodiscard]] inline auto read_fixed(coroutine_handle h, int fd, std::span<std::byte> buffer, unsigned buffer_index, std::uint64_t offset = current_offset) noexcept -> std::expected<std::size_t, error>
+    {
+        return detail::ops::read(h, {fd, false}, buffer, offset, true, buffer_index);
+    }
+
+    [[nodiscard]] inline auto read_fixed(coroutine_handle h, fixed_file file, std::span<std::byte> buffer, unsigned buffer_index, std::uint64_t offset = current_offset) noexcept -> std::expected<std::size_t, error>
+    {
+        return detail::ops::read(h, {static_cast<int>(file.index), true}, buffer, offset, true, buffer_index);
+    }
+
+    [[nodiscard]] inline auto write_fixed(coroutine_handle h, int fd, std::span<std::byte const> buffer, unsigned buffer_index, std::uint64_t offset = current_offset) noexcept -> std::expected<std::size_t, error>
+    {
+        return detail::ops::write(h, {fd, false}, buffer, offset, true, buffer_index);
+    }
+
+    [[nodiscard]] inline auto write_fixed(coroutine_handle h, fixed_file file, std::span<std::byte const> buffer, unsigned buffer_index, std::uint64_t offset = current_offset) noexcept -> std::expected<std::size_t, error>
+    {
+        return detail::ops::write(h, {static_cast<int>(file.index), true}, buffer, offset, true, buffer_index);
+    }
+
+    // The accepted descriptor. addr/addr_len may be null; flags as for accept4 (ignored on macOS).
+    [[nodiscard]] inline auto accept(coroutine_handle h, int listen_fd, sockaddr *addr = nullptr, socklen_t *addr_len = nullptr, int flags = 0) noexcept -> std::expected<int, error>
+    {
+        return detail::ops::accept(h, {listen_fd, false}, addr, addr_len, flags);
+    }
+
+    [[nodiscard]] inline auto accept(coroutine_handle h, fixed_file listener, sockaddr *addr = nullptr, socklen_t *addr_len = nullptr, int flags = 0) noexcept -> std::expected<int, error>
+    {
+        return detail::ops::accept(h, {static_cast<int>(listener.index), true}, addr, addr_len, flags);
+    }
+
+    [[nodiscard]] inline auto connect(coroutine_handle h, int fd, sockaddr const *addr, socklen_t addr_len) noexcept -> std::expected<void, error>
+    {
+        return detail::ops::connect(h, {fd, false}, addr, addr_len);
+    }
+
+    [[nodiscard]] inline auto connect(coroutine_handle h, fixed_file file, sockaddr const *addr, socklen_t addr_len) noexcept -> std::expected<void, error>
+    {
+        return detail::ops::connect(h, {static_cast<int>(file.index), true}, addr, addr_len);
+    }
+
+    // Closes fd, first dropping it from the current runner's readiness table (if any) so the
+    // number can be reused safely.
+    [[nodiscard]] inline auto close(int fd) noexcept -> std::expected<void, error>
+    {
+        if (runner *r = runner::current())
+            r->forget(fd);
+        if (::close(fd) != 0)
+            return detail::fail(errno);
+        return {};
+    }
+} // namespace coro::io
+
+#endif // UCORO_IO_AVAILABLE
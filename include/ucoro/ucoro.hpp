@@ -6,19 +6,31 @@
 
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
 #include <concepts>
 #include <cstddef>
 #include <cstdint>
 #include <cstdlib>
 #include <cstring>
+#include <exception>
 #include <expected>
 #include <functional>
 #include <memory>
+#include <mutex>
+#include <new>
 #include <optional>
+#include <ranges>
 #include <span>
+#include <stop_token>
 #include <string_view>
+#include <thread>
 #include <type_traits>
 #include <utility>
+#include <variant>
 #include <vector>
 
 #include <fmt/core.h> // Replaces <format> and <print>
@@ -39,11 +51,46 @@
 #define UCORO_STORAGE_SIZE 1024
 #endif
 
+// Debug aid: fill every stack with a known byte at creation so stack_peak() can report the
+// high-water mark. Costs a memset of the whole stack per coroutine (and commits lazily
+// mapped pages), so it is off by default. Define it the same way in every TU.
+#ifndef UCORO_STACK_PAINT
+#define UCORO_STACK_PAINT 0
+#endif
+
+// Profiling aid: count resumes and yields per coroutine and the time it spends on the CPU in
+// cycle-counter ticks (rdtsc on x86-64, cntvct_el0 on ARM64), reported by stats(). Adds a
+// counter read to every switch, so it is off by default. UCORO_TRACY also reports every
+// switch to Tracy as a fiber enter/leave (build Tracy with TRACY_FIBERS and make
+// <tracy/Tracy.hpp> reachable) and implies UCORO_INSTRUMENT. Define both the same way in
+// every TU.
+#ifndef UCORO_TRACY
+#define UCORO_TRACY 0
+#endif
+
+#ifndef UCORO_INSTRUMENT
+#define UCORO_INSTRUMENT UCORO_TRACY
+#endif
+
+#if UCORO_TRACY && !UCORO_INSTRUMENT
+#error "UCORO_TRACY needs UCORO_INSTRUMENT"
+#endif
+
+#if UCORO_INSTRUMENT && defined(_MSC_VER)
+#include <intrin.h>
+#elif UCORO_INSTRUMENT && defined(__x86_64__)
+#include <x86intrin.h>
+#endif
+
+#if UCORO_TRACY
+#include <tracy/Tracy.hpp>
+#endif
+
 namespace coro
 {
     namespace detail
     {
-        static constexpr std::size_t magic_number = 0x7E3CB1A9;
+        static constexpr std::uint32_t magic_number = 0x7E3CB1A9;
 
         enum class mco_result
         {
@@ -59,7 +106,12 @@ namespace coro
             out_of_memory,
             invalid_arguments,
             invalid_operation,
-            stack_overflow
+            stack_overflow,
+            closed,
+            would_block,
+            io_error,
+            timeout,
+            cancelled
         };
 
         enum class mco_state
@@ -86,6 +138,8 @@ namespace coro
     inline constexpr stack_size default_stack_size{UCORO_STACK_SIZE};
     inline constexpr storage_size default_storage_size{UCORO_STORAGE_SIZE};
     inline constexpr stack_size min_stack_size{UCORO_MIN_STACK_SIZE};
+    inline constexpr bool stack_painting = UCORO_STACK_PAINT != 0;
+    inline constexpr bool instrumented = UCORO_INSTRUMENT != 0;
 
     // ============================================================================
     // Public API Types
@@ -105,7 +159,12 @@ namespace coro
         out_of_memory = static_cast<std::uint8_t>(detail::mco_result::out_of_memory),
         invalid_arguments = static_cast<std::uint8_t>(detail::mco_result::invalid_arguments),
         invalid_operation = static_cast<std::uint8_t>(detail::mco_result::invalid_operation),
-        stack_overflow = static_cast<std::uint8_t>(detail::mco_result::stack_overflow)
+        stack_overflow = static_cast<std::uint8_t>(detail::mco_result::stack_overflow),
+        closed = static_cast<std::uint8_t>(detail::mco_result::closed),
+        would_block = static_cast<std::uint8_t>(detail::mco_result::would_block),
+        io_error = static_cast<std::uint8_t>(detail::mco_result::io_error),
+        timeout = static_cast<std::uint8_t>(detail::mco_result::timeout),
+        cancelled = static_cast<std::uint8_t>(detail::mco_result::cancelled)
     };
 
     [[nodiscard]] constexpr auto to_string(error e) noexcept -> std::string_view
@@ -138,6 +197,16 @@ namespace coro
             return "invalid operation";
         case error::stack_overflow:
             return "stack overflow";
+        case error::closed:
+            return "closed";
+        case error::would_block:
+            return "would block";
+        case error::io_error:
+            return "I/O error";
+        case error::timeout:
+            return "timed out";
+        case error::cancelled:
+            return "cancelled";
         }
         return "unknown error";
     }
@@ -170,6 +239,33 @@ namespace coro
         }
         return "unknown state";
     }
+
+    // How the *_unchecked calls save registers, picked per call site. Every kind restores the
+    // full register set, so a context saved by one kind can be resumed by any other and the
+    // checked API keeps working on the same coroutine.
+    //   full:         every callee-saved register, out of line; what the checked API uses.
+    //   integer_only: skips storing FP/SIMD callee-saved registers (xmm6-xmm15 on Windows,
+    //                 d8-d15 on ARM64) and declares them clobbered instead, so the compiler
+    //                 spills only the FP values live at the call site. Same as full on x86-64
+    //                 System V, which has none, and with MSVC, which has no inline asm.
+    //   clobber:      inline asm storing only pc, sp and fp; everything else is declared
+    //                 clobbered, so the compiler spills just what is live. Same as full on Windows.
+    enum class switch_kind : std::uint8_t
+    {
+        full,
+        integer_only,
+        clobber,
+    };
+
+    // What numa_stack_allocator maps its memory with. Huge pages put many stacks under one TLB
+    // entry. transparent_huge is advice the kernel may ignore; explicit_huge takes hugetlbfs
+    // pages (reserved via vm.nr_hugepages) and falls back to transparent ones when none are free.
+    enum class page_kind : std::uint8_t
+    {
+        normal,
+        transparent_huge,
+        explicit_huge,
+    };
 }
 
 // ============================================================================
@@ -208,6 +304,21 @@ namespace coro
 
         extern thread_local struct mco_coro *mco_current_co;
 
+        // Coroutines may resume on a different thread than they yielded on (thread_pool_runner),
+        // so the thread_local must never be addressed from code running on a coroutine stack:
+        // a compiler may keep a TLS address computed before a switch. These out-of-line
+        // accessors recompute it on every call.
+#if defined(_MSC_VER)
+#define UCORO_NOINLINE __declspec(noinline)
+#elif defined(__clang__)
+#define UCORO_NOINLINE __attribute__((noinline))
+#else
+#define UCORO_NOINLINE __attribute__((noipa))
+#endif
+        UCORO_NOINLINE mco_coro *mco_get_current_co(void);
+        UCORO_NOINLINE void mco_set_current_co(mco_coro *co);
+        UCORO_NOINLINE mco_coro *mco_exchange_current_co(mco_coro *co);
+
         // Default Allocators
         inline void *mco_alloc(std::size_t size, void *allocator_data)
         {
@@ -222,27 +333,166 @@ namespace coro
             std::free(ptr);
         }
 
-        struct mco_coro
+        struct mco_coro;
+
+        // Implemented by whatever queues parked coroutines (task_runner); wake() re-queues one.
+        // handoff() is asked when `from` parks: it may dequeue and return the coroutine it would
+        // resume next, which `from` then transfers to directly instead of bouncing through the
+        // scheduler loop. nullptr declines. What it returns must be ready to enter (suspended,
+        // stack attached), since by then its bookkeeping is done and there is no handing it
+        // back. timers is the wheel sleep_for() arms, if the scheduler keeps one.
+        class timer_wheel;
+
+        struct mco_scheduler
+        {
+            void (*wake)(mco_scheduler *self, mco_coro *co) noexcept;
+            mco_coro *(*handoff)(mco_scheduler *self, mco_coro *from) noexcept;
+            timer_wheel *timers;
+        };
+
+        // A coroutine blocked on a channel or on another coroutine finishing. The node lives on
+        // the waiter's stack for the duration of the call, so waiting never allocates.
+        struct wait_node
+        {
+            mco_coro *co = nullptr;
+            wait_node *prev = nullptr;
+            wait_node *next = nullptr;
+            bool linked = false;
+        };
+
+        // FIFO of waiters. Doubly linked so a waiter resumed for another reason (plain driver,
+        // close, error, another source of a select) can unlink itself in O(1).
+        class wait_list
+        {
+        public:
+            void push_back(wait_node *node) noexcept
+            {
+                node->prev = tail_;
+                node->next = nullptr;
+                if (tail_ != nullptr)
+                    tail_->next = node;
+                else
+                    head_ = node;
+                tail_ = node;
+                node->linked = true;
+            }
+
+            [[nodiscard]] auto pop_front() noexcept -> wait_node *
+            {
+                wait_node *node = head_;
+                if (node != nullptr)
+                    erase(node);
+                return node;
+            }
+
+            void erase(wait_node *node) noexcept
+            {
+                if (!node->linked)
+                    return;
+                (node->prev != nullptr ? node->prev->next : head_) = node->next;
+                (node->next != nullptr ? node->next->prev : tail_) = node->prev;
+                node->prev = node->next = nullptr;
+                node->linked = false;
+            }
+
+            [[nodiscard]] auto empty() const noexcept -> bool { return head_ == nullptr; }
+
+        private:
+            wait_node *head_{nullptr};
+            wait_node *tail_{nullptr};
+        };
+        inline constexpr std::uint32_t mco_sched_parked = 1u << 0;   // suspended until woken
+        inline constexpr std::uint32_t mco_sched_notified = 1u << 1; // woken before it parked
+
+#if UCORO_INSTRUMENT
+#if UCORO_TRACY
+        struct mco_fiber;
+#endif
+
+        struct mco_counters
+        {
+            std::uint64_t resumes;
+            std::uint64_t yields;
+            std::uint64_t ticks;   // on the CPU, summed over every stint
+            std::uint64_t entered; // tick the current stint began
+            char const *name;      // set_trace_name(); nullptr until then
+#if UCORO_TRACY
+            mco_fiber *fiber; // leased on the first switch in, see mco_fiber_lease()
+#endif
+        };
+#endif
+
+        // Frames start on a cache line (mco_create rounds the allocator's block up to one).
+        inline constexpr std::size_t mco_frame_align = 64;
+
+        // A stack several coroutines take turns on (coro::shared_stack). occupant is the one whose
+        // frames are on it now; the others keep theirs in a save buffer until they next run.
+        struct mco_shared_stack
+        {
+            void *base = nullptr;
+            std::size_t size = 0;
+            mco_coro *occupant = nullptr;
+            std::size_t copies = 0; // occupants moved off so far
+        };
+
+        // Fields are grouped by how often a switch touches them. The first line holds what
+        // resume, yield (canary and range check), push/pop and the runner's ready queue read and
+        // write; the scheduler's bookkeeping comes next, then everything only creation, teardown,
+        // lazy stacks, sanitizers and instrumentation need. The static_asserts below pin the
+        // split. The context is not pointed to: it always directly follows the header.
+        struct alignas(mco_frame_align) mco_coro
         {
-            void *context;
+            // every switch
+            mco_coro *prev_co;
+            void *stack_base;
+            std::size_t stack_size;
+            unsigned char *storage;
+            mco_scheduler *scheduler;
+            mco_coro *sched_next;
             mco_state state;
+            std::uint32_t sched_flags;
+            std::uint32_t bytes_stored; // mco_init caps storage_size to fit
+            std::uint32_t magic_number;
+            // scheduler bookkeeping, storage bounds
+            std::size_t sched_index;
+            std::uint64_t sched_key; // the runner policy's ordering key: level, deadline, class
+            std::size_t storage_size;
+            std::size_t guard_size;
             void (*func)(mco_coro *co);
-            mco_coro *prev_co;
             void *user_data;
+            bool cancelled; // cancel() was called; owned by the scheduler's thread
+            // setup and teardown
             std::size_t coro_size;
+            std::size_t frame_offset; // how far the allocator's block starts before the header
             void *allocator_data;
             void (*dealloc_cb)(void *ptr, std::size_t size, void *allocator_data);
-            void *stack_base;
-            std::size_t stack_size;
-            unsigned char *storage;
-            std::size_t bytes_stored;
-            std::size_t storage_size;
+            void *(*stack_alloc_cb)(std::size_t size, void *allocator_data); // lazy frames only
+            bool (*guard_cb)(void *guard, std::size_t size, void *allocator_data);
+            void *stack_block; // a lazy frame's separately allocated stack, while it has one
+            std::size_t released_peak; // mco_stack_peak() of a lazy stack already given back
+            mco_shared_stack *shared_stack; // stack-copying frames: the stack they take turns on
+            unsigned char *stack_copy;      // their live stack while another frame is on it
+            std::size_t stack_copy_size;
+            std::size_t stack_copy_capacity;
+            wait_list done_waiters; // select_any() callers, woken once the coroutine finishes
             void *asan_prev_stack;
             void *tsan_prev_fiber;
             void *tsan_fiber;
-            std::size_t magic_number;
+#if UCORO_INSTRUMENT
+            mco_counters counters;
+#endif
         };
 
+        static_assert(offsetof(mco_coro, prev_co) < mco_frame_align && offsetof(mco_coro, stack_base) < mco_frame_align &&
+                          offsetof(mco_coro, stack_size) < mco_frame_align && offsetof(mco_coro, storage) < mco_frame_align &&
+                          offsetof(mco_coro, scheduler) < mco_frame_align && offsetof(mco_coro, sched_next) < mco_frame_align &&
+                          offsetof(mco_coro, state) < mco_frame_align && offsetof(mco_coro, sched_flags) < mco_frame_align &&
+                          offsetof(mco_coro, bytes_stored) < mco_frame_align &&
+                          offsetof(mco_coro, magic_number) + sizeof(std::uint32_t) <= mco_frame_align,
+                      "every per-switch field must stay in the header's first cache line");
+        static_assert(offsetof(mco_coro, sched_index) >= mco_frame_align && offsetof(mco_coro, cancelled) < 2 * mco_frame_align,
+                      "the scheduler's bookkeeping must fill exactly the header's second cache line");
+
         struct mco_desc
         {
             void (*func)(mco_coro *co) = nullptr;
@@ -253,6 +503,21 @@ namespace coro
             std::size_t storage_size = 0;
             std::size_t coro_size = 0;
             std::size_t stack_size = 0;
+            // Non-zero: reserve a 16-byte aligned area of this size right after the context and
+            // point the coroutine's user_data at it (desc.user_data is then ignored).
+            std::size_t user_size = 0;
+            // Non-zero: the stack is page-aligned with an inaccessible guard region of this size
+            // right below stack_base. guard_cb (optional) protects it on freshly allocated frames;
+            // false fails the allocation rather than hand out a stack with no guard below it.
+            std::size_t guard_size = 0;
+            bool (*guard_cb)(void *guard, std::size_t size, void *allocator_data) = nullptr;
+            // The frame holds only header, context, user area and storage. The stack (and its
+            // guard) is a second alloc_cb block taken on the first resume and handed back to
+            // dealloc_cb as soon as the coroutine finishes.
+            bool lazy_stack = false;
+            // Set together with lazy_stack: instead of a block of its own the coroutine runs on
+            // this stack, whose size stack_size must be, copying its frames off and back on.
+            mco_shared_stack *shared_stack = nullptr;
         };
 
         // ------------------- Architecture Detection -------------------
@@ -268,8 +533,10 @@ namespace coro
             void *stack_limit;
             void *stack_base;
         };
+        inline void *mco_ctx_sp(mco_ctxbuf const &ctx) { return ctx.rsp; }
         // Function pointers for Windows assembly blobs
         extern void (*_mco_switch)(mco_ctxbuf *from, mco_ctxbuf *to);
+        extern void (*_mco_switch_int)(mco_ctxbuf *from, mco_ctxbuf *to);
 
 #elif defined(__x86_64__) && !defined(_WIN32)
         // x86_64 Linux/macOS
@@ -277,6 +544,7 @@ namespace coro
         {
             void *rip, *rsp, *rbp, *rbx, *r12, *r13, *r14, *r15;
         };
+        inline void *mco_ctx_sp(mco_ctxbuf const &ctx) { return ctx.rsp; }
         extern "C" void _mco_switch(mco_ctxbuf *from, mco_ctxbuf *to);
 
 #elif defined(__aarch64__) && !defined(_WIN32)
@@ -288,17 +556,174 @@ namespace coro
             void *lr;
             void *d[8]; /* d8-d15 */
         };
+        inline void *mco_ctx_sp(mco_ctxbuf const &ctx) { return ctx.sp; }
         extern "C" void _mco_switch(mco_ctxbuf *from, mco_ctxbuf *to);
+        extern "C" void _mco_switch_int(mco_ctxbuf *from, mco_ctxbuf *to);
 #else
 #error "Only x86_64/ARM64 Linux/macOS and Windows x64 supported in this version."
 #endif
 
+        // Bytes below sp a leaf function may keep live without moving sp. A clobber switch
+        // saves sp with no call in between, so a suspended stack extends this far below it.
+#if (defined(__x86_64__) && !defined(_WIN32)) || (defined(__aarch64__) && defined(__APPLE__))
+        inline constexpr std::size_t mco_red_zone = 128;
+#else
+        inline constexpr std::size_t mco_red_zone = 0;
+#endif
+
+        // Follows the header. Each buffer starts its own cache line; on x86-64 SysV one buffer
+        // is exactly a line, so a resume touches the header's first line plus these two.
         struct mco_context
         {
-            mco_ctxbuf ctx;
-            mco_ctxbuf back_ctx;
+            alignas(mco_frame_align) mco_ctxbuf ctx;
+            alignas(mco_frame_align) mco_ctxbuf back_ctx;
         };
 
+        // The header is a whole number of lines, so the context starts right at its end.
+        inline mco_context *mco_context_of(mco_coro *co) noexcept { return reinterpret_cast<mco_context *>(co + 1); }
+        inline mco_context const *mco_context_of(mco_coro const *co) noexcept { return reinterpret_cast<mco_context const *>(co + 1); }
+
+        // ------------------- Switch Flavours -------------------
+
+        // Saves pc, sp and fp, then restores the full register set of `to` exactly like
+        // _mco_switch, so it lands correctly in contexts saved by either. Everything else is
+        // declared clobbered: the compiler keeps nothing in registers across the switch and
+        // spills only the values that are actually live at this call site.
+#if defined(__GNUC__) && defined(__x86_64__) && !defined(_WIN32)
+        inline void mco_switch_clobber(mco_ctxbuf *from, mco_ctxbuf *to) noexcept
+        {
+            __asm__ volatile(
+                "leaq 1f(%%rip), %%rax\n\t"
+                "movq %%rax, (%0)\n\t"
+                "movq %%rsp, 8(%0)\n\t"
+                "movq %%rbp, 16(%0)\n\t"
+                "movq 56(%1), %%r15\n\t"
+                "movq 48(%1), %%r14\n\t"
+                "movq 40(%1), %%r13\n\t"
+                "movq 32(%1), %%r12\n\t"
+                "movq 24(%1), %%rbx\n\t"
+                "movq 16(%1), %%rbp\n\t"
+                "movq 8(%1), %%rsp\n\t"
+                "jmpq *(%1)\n"
+                "1:\n\t"
+                : "+D"(from), "+S"(to)
+                :
+                : "rax", "rbx", "rcx", "rdx", "r8", "r9", "r10", "r11", "r12", "r13", "r14", "r15",
+                  "xmm0", "xmm1", "xmm2", "xmm3", "xmm4", "xmm5", "xmm6", "xmm7",
+                  "xmm8", "xmm9", "xmm10", "xmm11", "xmm12", "xmm13", "xmm14", "xmm15",
+#if defined(__AVX512F__)
+                  "xmm16", "xmm17", "xmm18", "xmm19", "xmm20", "xmm21", "xmm22", "xmm23",
+                  "xmm24", "xmm25", "xmm26", "xmm27", "xmm28", "xmm29", "xmm30", "xmm31",
+                  "k1", "k2", "k3", "k4", "k5", "k6", "k7",
+#endif
+                  "st", "st(1)", "st(2)", "st(3)", "st(4)", "st(5)", "st(6)", "st(7)",
+                  "cc", "memory");
+        }
+#elif defined(__GNUC__) && defined(__aarch64__) && !defined(_WIN32)
+        inline void mco_switch_clobber(mco_ctxbuf *from, mco_ctxbuf *to) noexcept
+        {
+            register mco_ctxbuf *from_reg __asm__("x0") = from;
+            register mco_ctxbuf *to_reg __asm__("x1") = to;
+            __asm__ volatile(
+                "adr x11, 1f\n\t"
+                "mov x10, sp\n\t"
+                "str x29, [x0, #(5*16)]\n\t"
+                "stp x10, x11, [x0, #(6*16)]\n\t"
+                "ldp x19, x20, [x1, #(0*16)]\n\t"
+                "ldp x21, x22, [x1, #(1*16)]\n\t"
+                "ldp d8, d9, [x1, #(7*16)]\n\t"
+                "ldp x23, x24, [x1, #(2*16)]\n\t"
+                "ldp d10, d11, [x1, #(8*16)]\n\t"
+                "ldp x25, x26, [x1, #(3*16)]\n\t"
+                "ldp d12, d13, [x1, #(9*16)]\n\t"
+                "ldp x27, x28, [x1, #(4*16)]\n\t"
+                "ldp d14, d15, [x1, #(10*16)]\n\t"
+                "ldp x29, x30, [x1, #(5*16)]\n\t"
+                "ldp x10, x11, [x1, #(6*16)]\n\t"
+                "mov sp, x10\n\t"
+                "br x11\n"
+                "1:\n\t"
+                : "+r"(from_reg), "+r"(to_reg)
+                :
+                : "x2", "x3", "x4", "x5", "x6", "x7", "x8", "x9", "x10", "x11", "x12", "x13", "x14", "x15",
+                  "x16", "x17",
+#if !defined(__APPLE__)
+                  "x18", // platform register on Apple targets, a temporary elsewhere
+#endif
+                  "x19", "x20", "x21", "x22", "x23", "x24", "x25", "x26", "x27", "x28", "x30",
+                  "v0", "v1", "v2", "v3", "v4", "v5", "v6", "v7", "v8", "v9", "v10", "v11", "v12", "v13", "v14", "v15",
+                  "v16", "v17", "v18", "v19", "v20", "v21", "v22", "v23", "v24", "v25", "v26", "v27", "v28", "v29", "v30", "v31",
+                  "cc", "memory");
+        }
+#else
+        // No inline asm for the Windows blobs (MSVC has none on x64): fall back to the full switch.
+        inline void mco_switch_clobber(mco_ctxbuf *from, mco_ctxbuf *to) noexcept { _mco_switch(from, to); }
+#endif
+
+        // Calls _mco_switch_int, which leaves the FP/SIMD callee-saved registers unsaved, so
+        // the call is made from inline asm that declares them clobbered along with everything
+        // the ABI lets a call destroy.
+#if defined(__GNUC__) && defined(__aarch64__) && !defined(_WIN32)
+        inline void mco_switch_int(mco_ctxbuf *from, mco_ctxbuf *to) noexcept
+        {
+            register mco_ctxbuf *from_reg __asm__("x0") = from;
+            register mco_ctxbuf *to_reg __asm__("x1") = to;
+            __asm__ volatile(
+#ifdef __APPLE__
+                "bl __mco_switch_int\n\t"
+#else
+                "bl _mco_switch_int\n\t"
+#endif
+                : "+r"(from_reg), "+r"(to_reg)
+                :
+                : "x2", "x3", "x4", "x5", "x6", "x7", "x8", "x9", "x10", "x11", "x12", "x13", "x14", "x15",
+                  "x16", "x17",
+#if !defined(__APPLE__)
+                  "x18",
+#endif
+                  "x30",
+                  "v0", "v1", "v2", "v3", "v4", "v5", "v6", "v7", "v8", "v9", "v10", "v11", "v12", "v13", "v14", "v15",
+                  "v16", "v17", "v18", "v19", "v20", "v21", "v22", "v23", "v24", "v25", "v26", "v27", "v28", "v29", "v30", "v31",
+                  "cc", "memory");
+        }
+#elif defined(__GNUC__) && defined(_WIN32)
+        inline void mco_switch_int(mco_ctxbuf *from, mco_ctxbuf *to) noexcept
+        {
+            void (*fn)(mco_ctxbuf *, mco_ctxbuf *) = _mco_switch_int;
+            // The compiler doesn't know this is a call: align rsp and leave the shadow space
+            // ourselves. rbp is callee-saved, so it survives the switch.
+            __asm__ volatile(
+                "pushq %%rbp\n\t"
+                "movq %%rsp, %%rbp\n\t"
+                "andq $-16, %%rsp\n\t"
+                "subq $32, %%rsp\n\t"
+                "callq *%2\n\t"
+                "movq %%rbp, %%rsp\n\t"
+                "popq %%rbp\n\t"
+                : "+c"(from), "+d"(to), "+a"(fn)
+                :
+                : "r8", "r9", "r10", "r11",
+                  "xmm0", "xmm1", "xmm2", "xmm3", "xmm4", "xmm5", "xmm6", "xmm7",
+                  "xmm8", "xmm9", "xmm10", "xmm11", "xmm12", "xmm13", "xmm14", "xmm15",
+                  "st", "st(1)", "st(2)", "st(3)", "st(4)", "st(5)", "st(6)", "st(7)",
+                  "cc", "memory");
+        }
+#else
+        // Nothing to skip (x86-64 System V), or no way to declare the clobbers (MSVC).
+        inline void mco_switch_int(mco_ctxbuf *from, mco_ctxbuf *to) noexcept { _mco_switch(from, to); }
+#endif
+
+        template <switch_kind Kind>
+        inline void mco_switch(mco_ctxbuf *from, mco_ctxbuf *to) noexcept
+        {
+            if constexpr (Kind == switch_kind::clobber)
+                mco_switch_clobber(from, to);
+            else if constexpr (Kind == switch_kind::integer_only)
+                mco_switch_int(from, to);
+            else
+                _mco_switch(from, to);
+        }
+
         // ============================================================================
         // Constexpr Helpers
         // ============================================================================
@@ -308,12 +733,48 @@ namespace coro
             return (addr + (align - 1)) & ~(align - 1);
         }
 
+        // Allocators only promise 16-byte blocks; this much extra lets mco_create round the
+        // header up to mco_frame_align. Guarded frames are page-aligned and need none.
+        inline constexpr std::size_t mco_frame_slack = mco_frame_align - 16;
+
+        // Bytes in front of the stack: header, context, user area and storage.
+        [[nodiscard]] constexpr std::size_t mco_prefix_size(mco_desc const *desc)
+        {
+            return mco_align_forward(sizeof(mco_coro), mco_frame_align) +
+                   mco_align_forward(sizeof(mco_context), mco_frame_align) +
+                   mco_align_forward(desc->user_size, 16) +
+                   mco_align_forward(desc->storage_size, 16);
+        }
+
+        // Offset of the guard region from the frame start (only meaningful with guard_size != 0).
+        [[nodiscard]] constexpr std::size_t mco_guard_offset(mco_desc const *desc)
+        {
+            return mco_align_forward(mco_prefix_size(desc), desc->guard_size);
+        }
+
+        // A lazy frame's stack block: guard region (if any) and stack, or stack plus alignment slack.
+        [[nodiscard]] constexpr std::size_t mco_stack_block_size(std::size_t guard_size, std::size_t stack_size)
+        {
+            return guard_size != 0 ? guard_size + stack_size : stack_size + 16;
+        }
+
         constexpr void mco_init_desc_sizes(mco_desc *desc, std::size_t stack_size)
         {
-            desc->coro_size = mco_align_forward(sizeof(mco_coro), 16) +
-                              mco_align_forward(sizeof(mco_context), 16) +
-                              mco_align_forward(desc->storage_size, 16) +
-                              stack_size + 16;
+            if (desc->lazy_stack)
+            {
+                if (desc->guard_size != 0)
+                    stack_size = mco_align_forward(stack_size, desc->guard_size);
+                desc->coro_size = mco_prefix_size(desc) + mco_frame_slack;
+            }
+            else if (desc->guard_size != 0)
+            {
+                stack_size = mco_align_forward(stack_size, desc->guard_size);
+                desc->coro_size = mco_guard_offset(desc) + desc->guard_size + stack_size;
+            }
+            else
+            {
+                desc->coro_size = mco_prefix_size(desc) + stack_size + 16 + mco_frame_slack;
+            }
             desc->stack_size = stack_size;
         }
 
@@ -345,13 +806,140 @@ namespace coro
         // Runtime Inline Helpers
         // ============================================================================
 
+#if UCORO_INSTRUMENT
+        inline std::uint64_t mco_ticks() noexcept
+        {
+#if defined(_MSC_VER) || defined(__x86_64__)
+            return __rdtsc();
+#elif defined(__aarch64__)
+            std::uint64_t ticks;
+            __asm__ __volatile__("mrs %0, cntvct_el0" : "=r"(ticks));
+            return ticks;
+#endif
+        }
+
+        inline char const *mco_trace_name(mco_coro const *co) noexcept
+        {
+            return co->counters.name != nullptr ? co->counters.name : "coroutine";
+        }
+#endif
+
+#if UCORO_TRACY
+        // Tracy tells fibers apart by the name pointer and may read the string at any time, so
+        // every live coroutine leases a "<name> #<n>" string of its own. Strings are never
+        // freed: a released one waits on its name's idle list for the next coroutine of that
+        // name, keeping the fiber count at the most that were ever alive at once.
+        struct mco_fiber_kind;
+
+        struct mco_fiber
+        {
+            mco_fiber *next;
+            mco_fiber_kind *kind;
+            char text[64];
+        };
+
+        struct mco_fiber_kind
+        {
+            mco_fiber_kind *next;
+            char const *name;
+            mco_fiber *idle;
+            unsigned count;
+        };
+
+        struct mco_fiber_registry
+        {
+            std::mutex lock;
+            mco_fiber_kind *kinds = nullptr;
+        };
+
+        inline mco_fiber_registry &mco_fibers() noexcept
+        {
+            static mco_fiber_registry registry;
+            return registry;
+        }
+
+        // nullptr when out of memory; the caller then falls back to the shared name.
+        inline mco_fiber *mco_fiber_lease(char const *name) noexcept
+        {
+            mco_fiber_registry &registry = mco_fibers();
+            std::lock_guard guard{registry.lock};
+            mco_fiber_kind *kind = registry.kinds;
+            while (kind != nullptr && kind->name != name)
+                kind = kind->next;
+            if (kind == nullptr)
+            {
+                kind = new (std::nothrow) mco_fiber_kind{registry.kinds, name, nullptr, 0};
+                if (kind == nullptr)
+                    return nullptr;
+                registry.kinds = kind;
+            }
+            if (mco_fiber *fiber = kind->idle; fiber != nullptr)
+            {
+                kind->idle = fiber->next;
+                return fiber;
+            }
+            auto *fiber = new (std::nothrow) mco_fiber{nullptr, kind, {}};
+            if (fiber == nullptr)
+                return nullptr;
+            auto const end = fmt::format_to_n(fiber->text, sizeof(fiber->text) - 1, "{} #{}", name, ++kind->count).out;
+            *end = '\0';
+            return fiber;
+        }
+
+        inline void mco_fiber_release(mco_fiber *fiber) noexcept
+        {
+            mco_fiber_registry &registry = mco_fibers();
+            std::lock_guard guard{registry.lock};
+            fiber->next = fiber->kind->idle;
+            fiber->kind->idle = fiber;
+        }
+
+        // The fiber `co` is entered as, re-leased if set_trace_name() changed the name since.
+        // Only called while co is being switched to, so its old fiber is not current anywhere.
+        inline char const *mco_fiber_name(mco_coro *co) noexcept
+        {
+            char const *name = mco_trace_name(co);
+            mco_fiber *&fiber = co->counters.fiber;
+            if (fiber != nullptr && fiber->kind->name != name)
+            {
+                mco_fiber_release(fiber);
+                fiber = nullptr;
+            }
+            if (fiber == nullptr)
+                fiber = mco_fiber_lease(name);
+            return fiber != nullptr ? fiber->text : name;
+        }
+#endif
+
+        // Instrumentation hook, empty unless UCORO_INSTRUMENT: the thread stops running `from`
+        // and starts running `to`. Either may be null, meaning the thread's own stack.
+        inline void mco_trace_switch([[maybe_unused]] mco_coro *from, [[maybe_unused]] mco_coro *to) noexcept
+        {
+#if UCORO_INSTRUMENT
+            std::uint64_t const now = mco_ticks();
+            if (from)
+                from->counters.ticks += now - from->counters.entered;
+            if (to)
+                to->counters.entered = now;
+#if UCORO_TRACY
+            if (to)
+                TracyFiberEnter(mco_fiber_name(to));
+            else
+                TracyFiberLeave;
+#endif
+#endif
+        }
+
         inline void mco_prepare_jumpin(mco_coro *co)
         {
-            mco_coro *prev_co = mco_current_co;
+            mco_coro *prev_co = mco_exchange_current_co(co);
             co->prev_co = prev_co;
             if (prev_co)
                 prev_co->state = mco_state::normal;
-            mco_current_co = co;
+#if UCORO_INSTRUMENT
+            ++co->counters.resumes;
+#endif
+            mco_trace_switch(prev_co, co);
         }
 
         inline void mco_prepare_jumpout(mco_coro *co)
@@ -360,7 +948,76 @@ namespace coro
             co->prev_co = nullptr;
             if (prev_co)
                 prev_co->state = mco_state::running;
-            mco_current_co = prev_co;
+            mco_set_current_co(prev_co);
+#if UCORO_INSTRUMENT
+            if (co->state != mco_state::dead)
+                ++co->counters.yields;
+#endif
+            mco_trace_switch(co, prev_co);
+        }
+
+        // Returns true if co was parked (and is now queued again). A wake that arrives before
+        // the park is remembered, so the next park() returns immediately instead of sleeping.
+        inline bool mco_wake(mco_coro *co) noexcept
+        {
+            if ((co->sched_flags & mco_sched_parked) == 0)
+            {
+                co->sched_flags |= mco_sched_notified;
+                return false;
+            }
+            co->sched_flags &= ~mco_sched_parked;
+            if (co->scheduler != nullptr)
+                co->scheduler->wake(co->scheduler, co);
+            return true;
+        }
+
+        // Wakes the first waiter still parked. One a different source already re-queued (the
+        // other channel of a select(), a cancel) is dropped rather than handed the wake, since it
+        // re-checks everything when it runs. Coroutines driven by hand are always handed it.
+        inline void mco_wake_one(wait_list &waiters) noexcept
+        {
+            while (wait_node *node = waiters.pop_front())
+            {
+                if (node->co->scheduler == nullptr || (node->co->sched_flags & mco_sched_parked) != 0)
+                {
+                    (void)mco_wake(node->co);
+                    return;
+                }
+            }
+        }
+
+        inline void mco_wake_all(wait_list &waiters) noexcept
+        {
+            while (!waiters.empty())
+                mco_wake_one(waiters);
+        }
+
+        // Flags co as cancelled and, if it is parked, re-queues it so the wait it is blocked in
+        // returns error::cancelled now rather than at its deadline or never.
+        inline void mco_cancel(mco_coro *co) noexcept
+        {
+            co->cancelled = true;
+            if ((co->sched_flags & mco_sched_parked) != 0)
+                (void)mco_wake(co);
+        }
+
+        // Symmetric transfer: `to` takes over from's resumer (back_ctx) and prev_co, so both
+        // hops of a yield-then-resume collapse into one switch and `to` yields straight back there.
+        inline void mco_prepare_transfer(mco_coro *from, mco_coro *to)
+        {
+            mco_context *from_context = mco_context_of(from);
+            mco_context *to_context = mco_context_of(to);
+            to_context->back_ctx = from_context->back_ctx;
+            to->prev_co = from->prev_co;
+            from->prev_co = nullptr;
+            from->state = mco_state::suspended;
+            to->state = mco_state::running;
+            mco_set_current_co(to);
+#if UCORO_INSTRUMENT
+            ++from->counters.yields;
+            ++to->counters.resumes;
+#endif
+            mco_trace_switch(from, to);
         }
 
         // Internal API Declarations
@@ -368,6 +1025,7 @@ namespace coro
         mco_state mco_status(mco_coro *co);
         mco_result mco_resume(mco_coro *co);
         mco_result mco_yield(mco_coro *co);
+        mco_result mco_transfer(mco_coro *from, mco_coro *to);
         mco_result mco_push(mco_coro *co, const void *src, std::size_t len);
         mco_result mco_pop(mco_coro *co, void *dest, std::size_t len);
         mco_result mco_peek(mco_coro *co, void *dest, std::size_t len);
@@ -376,6 +1034,130 @@ namespace coro
         mco_coro *mco_running(void);
         mco_result mco_destroy(mco_coro *co);
         mco_result mco_create(mco_coro **out_co, mco_desc *desc);
+        mco_result mco_attach_stack(mco_coro *co);
+        void mco_release_stack(mco_coro *co);
+
+        // Virtual memory (mmap / VirtualAlloc). Reserved pages are only backed once touched.
+        std::size_t mco_vm_page_size(void);
+        void *mco_vm_reserve(std::size_t size);
+        void mco_vm_release(void *ptr, std::size_t size);
+        bool mco_vm_protect_none(void *ptr, std::size_t size);
+        // A read-write region for a frame slab. prefault backs every page now (MAP_POPULATE, or
+        // one touch per page where that is missing); huge_pages maps it 2 MiB-aligned and asks
+        // for transparent huge pages. Both are hints: the region is usable either way.
+        void *mco_vm_reserve_slab(std::size_t size, bool prefault, bool huge_pages);
+        // NUMA node of the CPU the caller is running on; 0 where that can't be told.
+        int mco_numa_node(void);
+        // mco_vm_reserve with pages preferred from `node` (mbind MPOL_PREFERRED on Linux,
+        // VirtualAllocExNuma on Windows; < 0 or unsupported: no preference). Huge kinds come
+        // 2 MiB-aligned. *size is rounded up to the length actually mapped, which is what
+        // mco_vm_release must be given (hugetlb mappings only unmap in whole huge pages).
+        void *mco_vm_reserve_node(std::size_t *size, int node, page_kind kind);
+
+        // Futex-style sleep on a 32-bit word: returns once *word != seen, after a wake, or when
+        // timeout_ns (< 0: no limit) runs out; spurious returns are allowed. Linux uses the futex
+        // syscall; elsewhere a process-wide condition variable stands in.
+        void mco_futex_wait(std::atomic<std::uint32_t> *word, std::uint32_t seen, std::int64_t timeout_ns);
+        void mco_futex_wake(std::atomic<std::uint32_t> *word);
+
+        // Whether a switch into co can go ahead from wherever we are. Only a stack-copying frame
+        // can be refused: its shared stack is held by a coroutine still executing on it.
+        inline bool mco_can_enter(mco_coro const *co) noexcept
+        {
+            if (co->stack_base != nullptr || co->shared_stack == nullptr)
+                return true;
+            mco_coro const *occupant = co->shared_stack->occupant;
+            return occupant == nullptr || occupant->state == mco_state::suspended;
+        }
+
+        // Suspends co until mco_wake(); a wake that already arrived is consumed instead. Under a
+        // scheduler that offers a handoff this is one context switch into the next ready coroutine.
+        // A cancelled coroutine gets mco_result::cancelled, before or after suspending, unless
+        // the caller must stay parked regardless (waiting for the kernel to release a buffer).
+        inline mco_result mco_park(mco_coro *co, bool cancellable = true) noexcept
+        {
+            if (cancellable && co->cancelled)
+                return mco_result::cancelled;
+            if ((co->sched_flags & mco_sched_notified) != 0)
+            {
+                co->sched_flags &= ~mco_sched_notified;
+                return mco_result::success;
+            }
+            mco_scheduler *sched = co->scheduler;
+            if (sched == nullptr)
+                return mco_yield(co);
+            co->sched_flags |= mco_sched_parked;
+            mco_coro *next = co == mco_running() && sched->handoff != nullptr ? sched->handoff(sched, co) : nullptr;
+            mco_result const result = next != nullptr ? mco_transfer(co, next) : mco_yield(co);
+            if (result != mco_result::success)
+                co->sched_flags &= ~mco_sched_parked;
+            else if (cancellable && co->cancelled)
+                return mco_result::cancelled;
+            return result;
+        }
+
+        // mco_park for waits whose nodes live on co's stack and are linked into lists that other
+        // coroutines walk (channels, select, timers, io). A stack-copying frame can't take part:
+        // its stack is overwritten by the next member while it is parked.
+        inline mco_result mco_park_pinned(mco_coro *co, bool cancellable = true) noexcept
+        {
+            if (co->shared_stack != nullptr)
+                return mco_result::invalid_operation;
+            return mco_park(co, cancellable);
+        }
+
+        // ============================================================================
+        // Stack Introspection
+        // ============================================================================
+
+        inline constexpr unsigned char mco_stack_paint_byte = 0xCD;
+
+        // Bytes between the top of co's stack and its current stack pointer. The sp of a
+        // suspended coroutine is in its own ctx; a normal one (it resumed a child) saved it
+        // in that child's back_ctx, found by walking down from the running coroutine.
+        inline std::size_t mco_stack_used(mco_coro *co)
+        {
+            if (!co || co->state == mco_state::dead)
+                return 0;
+            if (co->stack_base == nullptr) // a stack-copying frame off its stack: what it saved
+                return co->stack_copy_size;
+            std::uintptr_t const top = reinterpret_cast<std::uintptr_t>(co->stack_base) + co->stack_size;
+            std::uintptr_t sp = 0;
+            if (co->state == mco_state::running)
+            {
+                volatile unsigned char probe = 0;
+                sp = reinterpret_cast<std::uintptr_t>(&probe);
+            }
+            else if (co->state == mco_state::suspended)
+            {
+                sp = reinterpret_cast<std::uintptr_t>(mco_ctx_sp(mco_context_of(co)->ctx));
+            }
+            else
+            {
+                for (mco_coro *child = mco_running(); child; child = child->prev_co)
+                {
+                    if (child->prev_co == co)
+                    {
+                        sp = reinterpret_cast<std::uintptr_t>(mco_ctx_sp(mco_context_of(child)->back_ctx));
+                        break;
+                    }
+                }
+            }
+            return sp >= reinterpret_cast<std::uintptr_t>(co->stack_base) && sp <= top ? top - sp : 0;
+        }
+
+        // Deepest usage since creation: scan up from the bottom for the first overwritten byte.
+        // A lazy frame remembers the peak of the stack it gave back (0 before its first resume).
+        inline std::size_t mco_stack_peak(mco_coro const *co)
+        {
+            if (co->stack_base == nullptr)
+                return co->released_peak;
+            auto const *bottom = static_cast<unsigned char const *>(co->stack_base);
+            std::size_t untouched = 0;
+            while (untouched < co->stack_size && bottom[untouched] == mco_stack_paint_byte)
+                ++untouched;
+            return co->stack_size - untouched;
+        }
 
     } // namespace detail
 
@@ -389,391 +1171,4632 @@ namespace coro
     template <typename T>
     concept storable = std::is_trivially_copyable_v<T> && std::is_standard_layout_v<T> && (sizeof(T) <= 1024);
 
+    // Allocates whole coroutine frames (header + context + storage + stack).
+    // Blocks must be 16-byte aligned; they don't need to be zeroed.
+    template <typename A>
+    concept stack_allocator = requires(A &a, void *ptr, std::size_t size) {
+        { a.allocate(size) } noexcept -> std::same_as<void *>;
+        { a.deallocate(ptr, size) } noexcept;
+    };
+
+    // A stack_allocator that also wants an inaccessible guard region below every stack.
+    // guard_size() must be a multiple of the page size and allocate() must return page-aligned blocks.
+    // protect() returns false if the region couldn't be made inaccessible; that allocation fails.
+    template <typename A>
+    concept guarded_stack_allocator = stack_allocator<A> && requires(A &a, void *ptr, std::size_t size) {
+        { a.guard_size() } noexcept -> std::convertible_to<std::size_t>;
+        { a.protect(ptr, size) } noexcept -> std::same_as<bool>;
+    };
+
     // ============================================================================
-    // Classes
+    // Stack Allocators
     // ============================================================================
 
-    class coroutine_handle
+    namespace detail
     {
-    public:
-        constexpr coroutine_handle() noexcept = default;
-        constexpr explicit coroutine_handle(detail::mco_coro *co) noexcept : handle_{co} {}
-
-        [[nodiscard]] auto yield() const noexcept -> std::expected<void, error>
+        template <stack_allocator Alloc>
+        struct allocator_callbacks
         {
-            if (handle_ == nullptr)
-                return std::unexpected{error::invalid_coroutine};
-            auto const result = from_impl_result(detail::mco_yield(handle_));
-            if (result != error::success)
-                return std::unexpected{result};
-            return {};
-        }
+            static void *allocate(std::size_t size, void *allocator_data)
+            {
+                return static_cast<Alloc *>(allocator_data)->allocate(size);
+            }
 
-        void yield_unchecked() const noexcept
-        {
-            handle_->state = detail::mco_state::suspended;
-            detail::mco_prepare_jumpout(handle_);
-            detail::mco_context *context = static_cast<detail::mco_context *>(handle_->context);
-            detail::_mco_switch(&context->ctx, &context->back_ctx);
-        }
+            static void deallocate(void *ptr, std::size_t size, void *allocator_data)
+            {
+                static_cast<Alloc *>(allocator_data)->deallocate(ptr, size);
+            }
 
-        template <storable T>
-        void push_unchecked(T const &value) const noexcept
+            static bool protect(void *guard, std::size_t size, void *allocator_data)
+            {
+                if constexpr (guarded_stack_allocator<Alloc>)
+                    return static_cast<Alloc *>(allocator_data)->protect(guard, size);
+                else
+                    return true;
+            }
+        };
+
+        // Call before mco_init_desc_sizes: guarded allocators change the frame layout.
+        template <stack_allocator Alloc>
+        void mco_desc_set_allocator(mco_desc &desc, Alloc &alloc) noexcept
         {
-            std::memcpy(&handle_->storage[handle_->bytes_stored], std::addressof(value), sizeof(T));
-            handle_->bytes_stored += sizeof(T);
+            desc.alloc_cb = &allocator_callbacks<Alloc>::allocate;
+            desc.dealloc_cb = &allocator_callbacks<Alloc>::deallocate;
+            desc.allocator_data = static_cast<void *>(std::addressof(alloc));
+            if constexpr (guarded_stack_allocator<Alloc>)
+            {
+                desc.guard_size = alloc.guard_size();
+                desc.guard_cb = &allocator_callbacks<Alloc>::protect;
+            }
         }
 
-        template <storable T>
-        T pop_unchecked() const noexcept
+        // Per-thread cache of freed frames, one bucket per distinct coro_size.
+        struct freelist_cache
         {
-            T value;
-            handle_->bytes_stored -= sizeof(T);
-            std::memcpy(&value, &handle_->storage[handle_->bytes_stored], sizeof(T));
-            return value;
-        }
+            static constexpr std::size_t bucket_count = 8;
 
-        [[nodiscard]] auto status() const noexcept -> state { return static_cast<state>(detail::mco_status(handle_)); }
-        [[nodiscard]] constexpr auto valid() const noexcept -> bool { return handle_ != nullptr; }
-        [[nodiscard]] constexpr explicit operator bool() const noexcept { return valid(); }
+            struct node
+            {
+                node *next;
+            };
 
-        template <typename T>
-        [[nodiscard]] auto get_user_data() const noexcept -> T *
-        {
-            return static_cast<T *>(detail::mco_get_user_data(handle_));
-        }
+            struct bucket
+            {
+                std::size_t size = 0;
+                node *head = nullptr;
+                std::size_t count = 0;
+            };
 
-        template <storable T>
-        [[nodiscard]] auto push(T const &value) const noexcept -> std::expected<void, error>
-        {
-            auto const result = from_impl_result(detail::mco_push(handle_, std::addressof(value), sizeof(T)));
-            if (result != error::success)
-                return std::unexpected{result};
-            return {};
-        }
+            std::array<bucket, bucket_count> buckets{};
 
-        [[nodiscard]] auto push_bytes(std::span<std::byte const> data) const noexcept -> std::expected<void, error>
-        {
-            auto const result = from_impl_result(detail::mco_push(handle_, data.data(), data.size()));
-            if (result != error::success)
-                return std::unexpected{result};
-            return {};
-        }
+            freelist_cache() = default;
+            freelist_cache(freelist_cache const &) = delete;
+            auto operator=(freelist_cache const &) -> freelist_cache & = delete;
 
-        template <storable T>
-        [[nodiscard]] auto pop() const noexcept -> std::expected<T, error>
-        {
-            T value{};
-            auto const result = from_impl_result(detail::mco_pop(handle_, std::addressof(value), sizeof(T)));
-            if (result != error::success)
-                return std::unexpected{result};
-            return value;
-        }
+            ~freelist_cache() { clear(); }
 
-        template <storable T>
-        [[nodiscard]] auto peek() const noexcept -> std::expected<T, error>
-        {
-            T value{};
-            auto const result = from_impl_result(detail::mco_peek(handle_, std::addressof(value), sizeof(T)));
-            if (result != error::success)
-                return std::unexpected{result};
-            return value;
-        }
+            [[nodiscard]] static auto local() noexcept -> freelist_cache &
+            {
+                thread_local freelist_cache cache;
+                return cache;
+            }
 
-        [[nodiscard]] auto bytes_stored() const noexcept -> std::size_t { return detail::mco_get_bytes_stored(handle_); }
-        [[nodiscard]] auto storage_capacity() const noexcept -> std::size_t { return detail::mco_get_storage_size(handle_); }
-        [[nodiscard]] constexpr auto raw() const noexcept -> detail::mco_coro * { return handle_; }
+            [[nodiscard]] auto find(std::size_t size) noexcept -> bucket *
+            {
+                for (auto &b : buckets)
+                {
+                    if (b.size == size)
+                        return &b;
+                }
+                for (auto &b : buckets)
+                {
+                    if (b.count == 0)
+                    {
+                        b.size = size;
+                        return &b;
+                    }
+                }
+                return nullptr;
+            }
 
-    private:
-        detail::mco_coro *handle_{nullptr};
-    };
+            void clear() noexcept
+            {
+                for (auto &b : buckets)
+                {
+                    while (b.head != nullptr)
+                    {
+                        node *next = b.head->next;
+                        std::free(b.head);
+                        b.head = next;
+                    }
+                    b.count = 0;
+                }
+            }
+        };
 
-    [[nodiscard]] inline auto running() noexcept -> coroutine_handle
-    {
-        return coroutine_handle{detail::mco_running()};
-    }
+        // One node's share of a numa_stack_allocator: 2 MiB chunks placed on the node and carved
+        // front to back, plus per-size free lists of blocks handed back. Every block carries a
+        // header naming its pool, so a stack freed on another node's thread still goes home.
+        struct numa_node_pool
+        {
+            static constexpr std::size_t chunk_size = std::size_t{2} << 20;
+            static constexpr std::size_t header_size = 64; // keeps blocks cache-line aligned
+            static constexpr std::size_t bucket_count = 8;
 
-    [[nodiscard]] inline auto yield() noexcept -> std::expected<void, error>
-    {
-        return running().yield();
-    }
+            struct header
+            {
+                numa_node_pool *home;
+                std::size_t mapped; // non-zero: the block is a mapping of its own, this long
+            };
 
-    class [[nodiscard]] coroutine
-    {
-    public:
-        using function_type = std::function<void(coroutine_handle)>;
+            struct chunk
+            {
+                chunk *next;
+            };
 
-        [[nodiscard]] static auto create(function_type func) noexcept -> std::expected<coroutine, error>
-        {
-            return create(std::move(func), default_stack_size, default_storage_size);
-        }
+            struct node
+            {
+                node *next;
+            };
 
-        [[nodiscard]] static auto create(function_type func, stack_size stack, storage_size storage = default_storage_size) noexcept -> std::expected<coroutine, error>
-        {
-            if (!func)
-                return std::unexpected{error::invalid_arguments};
+            struct bucket
+            {
+                std::size_t size = 0; // never reassigned: carved blocks stay this size
+                node *head = nullptr;
+            };
+
+            int numa_node;
+            page_kind pages;
+            std::mutex lock;
+            chunk *chunks = nullptr;
+            unsigned char *bump = nullptr;
+            unsigned char *bump_end = nullptr;
+            std::array<bucket, bucket_count> buckets{};
+
+            numa_node_pool(int n, page_kind kind) noexcept : numa_node{n}, pages{kind} {}
+            numa_node_pool(numa_node_pool const &) = delete;
+            auto operator=(numa_node_pool const &) -> numa_node_pool & = delete;
+
+            ~numa_node_pool()
+            {
+                while (chunks != nullptr)
+                    mco_vm_release(std::exchange(chunks, chunks->next), chunk_size);
+            }
 
-            auto *wrapper = new (std::nothrow) function_type{std::move(func)};
-            if (wrapper == nullptr)
-                return std::unexpected{error::out_of_memory};
+            [[nodiscard]] auto allocate(std::size_t size) noexcept -> void *
+            {
+                std::size_t const block = mco_align_forward(header_size + size, header_size);
+                // stacks over a quarter chunk would waste too much of one; they get a mapping each
+                if (block <= chunk_size / 4)
+                {
+                    std::lock_guard const guard{lock};
+                    if (bucket *b = claim(size); b != nullptr)
+                    {
+                        if (b->head != nullptr)
+                            return std::exchange(b->head, b->head->next);
+                        if (static_cast<std::size_t>(bump_end - bump) < block && !grow())
+                            return nullptr;
+                        auto *h = ::new (static_cast<void *>(bump)) header{this, 0};
+                        bump += block;
+                        return reinterpret_cast<unsigned char *>(h) + header_size;
+                    }
+                }
+                std::size_t mapped = header_size + size;
+                void *raw = mco_vm_reserve_node(&mapped, numa_node, pages);
+                if (raw == nullptr)
+                    return nullptr;
+                auto *h = ::new (raw) header{this, mapped};
+                return reinterpret_cast<unsigned char *>(h) + header_size;
+            }
 
-            detail::mco_desc desc = detail::mco_desc_init(&coroutine::entry_point, stack.value);
-            desc.user_data = wrapper;
+            static void deallocate(void *ptr, std::size_t size) noexcept
+            {
+                auto *h = reinterpret_cast<header *>(static_cast<unsigned char *>(ptr) - header_size);
+                if (h->mapped != 0)
+                {
+                    mco_vm_release(h, h->mapped);
+                    return;
+                }
+                numa_node_pool *home = h->home;
+                std::lock_guard const guard{home->lock};
+                // Carving claimed the bucket and buckets are never reassigned, so this finds it.
+                // A caller passing a size the block wasn't allocated with leaves it in its chunk
+                // until the pool goes away.
+                if (bucket *b = home->find(size); b != nullptr)
+                    b->head = ::new (ptr) node{b->head};
+            }
 
-            if (storage.value != default_storage_size.value)
+            // The bucket for blocks of this size, if one was claimed.
+            [[nodiscard]] auto find(std::size_t size) noexcept -> bucket *
             {
-                desc.storage_size = storage.value;
-                detail::mco_init_desc_sizes(&desc, stack.value);
+                for (auto &b : buckets)
+                {
+                    if (b.size == size)
+                        return &b;
+                }
+                return nullptr;
             }
 
-            detail::mco_coro *co = nullptr;
-            auto const result = from_impl_result(detail::mco_create(&co, &desc));
+            // find(), claiming a free bucket for a new size.
+            [[nodiscard]] auto claim(std::size_t size) noexcept -> bucket *
+            {
+                if (bucket *b = find(size); b != nullptr)
+                    return b;
+                for (auto &b : buckets)
+                {
+                    if (b.size == 0)
+                    {
+                        b.size = size;
+                        return &b;
+                    }
+                }
+                return nullptr;
+            }
 
-            if (result != error::success)
+            [[nodiscard]] auto grow() noexcept -> bool
             {
-                delete wrapper;
-                return std::unexpected{result};
+                std::size_t mapped = chunk_size; // already a multiple of any page size
+                void *raw = mco_vm_reserve_node(&mapped, numa_node, pages);
+                if (raw == nullptr)
+                    return false;
+                chunks = ::new (raw) chunk{chunks};
+                bump = static_cast<unsigned char *>(raw) + header_size;
+                bump_end = static_cast<unsigned char *>(raw) + chunk_size;
+                return true;
             }
-            return coroutine{co, wrapper};
-        }
+        };
+    } // namespace detail
 
-        coroutine(coroutine const &) = delete;
-        auto operator=(coroutine const &) -> coroutine & = delete;
+    // Plain malloc/free: skips calloc's zero-fill so untouched stack pages stay out of RSS.
+    // malloc already returns 16-byte aligned blocks on every supported target.
+    struct malloc_allocator
+    {
+        [[nodiscard]] auto allocate(std::size_t size) noexcept -> void * { return std::malloc(size); }
+        void deallocate(void *ptr, std::size_t) noexcept { std::free(ptr); }
+    };
 
-        coroutine(coroutine &&other) noexcept
-            : handle_{std::exchange(other.handle_, nullptr)}, func_wrapper_{std::exchange(other.func_wrapper_, nullptr)} {}
+    // Bump allocator over one contiguous buffer. Frames are only reclaimed when freed in
+    // LIFO order or by reset(); the arena must outlive every coroutine carved from it.
+    class arena_allocator
+    {
+    public:
+        static constexpr std::size_t alignment = 16;
 
-        auto operator=(coroutine &&other) noexcept -> coroutine &
+        explicit arena_allocator(std::span<std::byte> buffer) noexcept
+            : begin_{buffer.data()}, capacity_{buffer.size()} {}
+
+        // Owning arena; check capacity() to see whether the backing allocation succeeded.
+        explicit arena_allocator(std::size_t capacity) noexcept
+            : begin_{static_cast<std::byte *>(std::malloc(capacity))}, capacity_{begin_ ? capacity : 0}, owned_{true} {}
+
+        arena_allocator(arena_allocator const &) = delete;
+        auto operator=(arena_allocator const &) -> arena_allocator & = delete;
+
+        arena_allocator(arena_allocator &&other) noexcept
+            : begin_{std::exchange(other.begin_, nullptr)},
+              capacity_{std::exchange(other.capacity_, 0)},
+              offset_{std::exchange(other.offset_, 0)},
+              owned_{std::exchange(other.owned_, false)} {}
+
+        auto operator=(arena_allocator &&other) noexcept -> arena_allocator &
         {
             if (this != &other)
             {
-                destroy();
-                handle_ = std::exchange(other.handle_, nullptr);
-                func_wrapper_ = std::exchange(other.func_wrapper_, nullptr);
+                if (owned_)
+                    std::free(begin_);
+                begin_ = std::exchange(other.begin_, nullptr);
+                capacity_ = std::exchange(other.capacity_, 0);
+                offset_ = std::exchange(other.offset_, 0);
+                owned_ = std::exchange(other.owned_, false);
             }
             return *this;
         }
 
-        ~coroutine() { destroy(); }
-
-        [[nodiscard]] auto resume() noexcept -> std::expected<void, error>
+        ~arena_allocator()
         {
-            if (handle_ == nullptr)
-                return std::unexpected{error::invalid_coroutine};
-            auto const result = from_impl_result(detail::mco_resume(handle_));
-            if (result != error::success)
-                return std::unexpected{result};
-            return {};
+            if (owned_)
+                std::free(begin_);
         }
 
-        void resume_unchecked() const noexcept
+        [[nodiscard]] auto allocate(std::size_t size) noexcept -> void *
         {
-            handle_->state = detail::mco_state::running;
-            detail::mco_prepare_jumpin(handle_);
-            detail::mco_context *context = static_cast<detail::mco_context *>(handle_->context);
-            detail::_mco_switch(&context->back_ctx, &context->ctx);
+            auto const base = reinterpret_cast<std::uintptr_t>(begin_);
+            std::size_t const start = detail::mco_align_forward(base + offset_, alignment) - base;
+            if (begin_ == nullptr || start > capacity_ || size > capacity_ - start)
+                return nullptr;
+            offset_ = start + size;
+            return begin_ + start;
         }
 
-        template <storable T>
-        void push_unchecked(T const &value) const noexcept { handle().push_unchecked(value); }
-
-        template <storable T>
-        T pop_unchecked() const noexcept { return handle().pop_unchecked<T>(); }
-
-        [[nodiscard]] auto status() const noexcept -> state { return static_cast<state>(detail::mco_status(handle_)); }
-        [[nodiscard]] auto done() const noexcept -> bool { return status() == state::dead; }
-        [[nodiscard]] auto suspended() const noexcept -> bool { return status() == state::suspended; }
-        [[nodiscard]] auto is_running() const noexcept -> bool { return status() == state::running; }
-        [[nodiscard]] auto valid() const noexcept -> bool { return handle_ != nullptr; }
-        [[nodiscard]] explicit operator bool() const noexcept { return valid(); }
-        [[nodiscard]] auto handle() const noexcept -> coroutine_handle { return coroutine_handle{handle_}; }
-        [[nodiscard]] auto raw() const noexcept -> detail::mco_coro * { return handle_; }
+        void deallocate(void *ptr, std::size_t size) noexcept
+        {
+            auto *p = static_cast<std::byte *>(ptr);
+            if (p + size == begin_ + offset_)
+                offset_ = static_cast<std::size_t>(p - begin_);
+        }
 
-        template <storable T>
-        [[nodiscard]] auto push(T const &value) const noexcept -> std::expected<void, error> { return handle().push(value); }
+        // Reclaims everything at once. No coroutine allocated from the arena may still be alive.
+        void reset() noexcept { offset_ = 0; }
 
-        template <storable T>
-        [[nodiscard]] auto pop() const noexcept -> std::expected<T, error> { return handle().pop<T>(); }
+        [[nodiscard]] auto used() const noexcept -> std::size_t { return offset_; }
+        [[nodiscard]] auto capacity() const noexcept -> std::size_t { return capacity_; }
+        [[nodiscard]] auto remaining() const noexcept -> std::size_t { return capacity_ - offset_; }
 
-        template <storable T>
-        [[nodiscard]] auto peek() const noexcept -> std::expected<T, error> { return handle().peek<T>(); }
+    private:
+        std::byte *begin_{nullptr};
+        std::size_t capacity_{0};
+        std::size_t offset_{0};
+        bool owned_{false};
+    };
 
-        [[nodiscard]] auto bytes_stored() const noexcept -> std::size_t { return handle().bytes_stored(); }
-        [[nodiscard]] auto storage_capacity() const noexcept -> std::size_t { return handle().storage_capacity(); }
+    // Thread-local free lists bucketed by frame size. Freed frames are parked on the
+    // current thread's list (up to max_cached per size) and handed out again by allocate.
+    class freelist_allocator
+    {
+    public:
+        static constexpr std::size_t default_max_cached = 64;
 
-    private:
-        explicit coroutine(detail::mco_coro *co, function_type *wrapper) noexcept
-            : handle_{co}, func_wrapper_{wrapper} {}
+        constexpr freelist_allocator() noexcept = default;
+        constexpr explicit freelist_allocator(std::size_t max_cached) noexcept : max_cached_{max_cached} {}
 
-        void destroy() noexcept
+        [[nodiscard]] auto allocate(std::size_t size) noexcept -> void *
         {
-            if (handle_ != nullptr)
-            {
-                detail::mco_destroy(handle_);
-                handle_ = nullptr;
-            }
-            if (func_wrapper_ != nullptr)
+            auto &cache = detail::freelist_cache::local();
+            if (auto *b = cache.find(size); b != nullptr && b->head != nullptr)
             {
-                delete func_wrapper_;
-                func_wrapper_ = nullptr;
+                auto *n = b->head;
+                b->head = n->next;
+                --b->count;
+                return n;
             }
+            return std::malloc(size);
         }
 
-        static void entry_point(detail::mco_coro *co)
+        void deallocate(void *ptr, std::size_t size) noexcept
         {
-            auto *wrapper = static_cast<function_type *>(detail::mco_get_user_data(co));
-            if (wrapper != nullptr && *wrapper)
+            auto &cache = detail::freelist_cache::local();
+            auto *b = cache.find(size);
+            if (b == nullptr || b->count >= max_cached_)
             {
-                (*wrapper)(coroutine_handle{co});
+                std::free(ptr);
+                return;
             }
+            auto *n = static_cast<detail::freelist_cache::node *>(ptr);
+            n->next = b->head;
+            b->head = n;
+            ++b->count;
         }
 
-        detail::mco_coro *handle_{nullptr};
-        function_type *func_wrapper_{nullptr};
+        // Frees every frame cached on the calling thread.
+        static void trim() noexcept { detail::freelist_cache::local().clear(); }
+
+    private:
+        std::size_t max_cached_{default_max_cached};
     };
 
-    template <storable T>
-    class [[nodiscard]] generator
+    // Each frame is its own mmap (MAP_NORESERVE) / VirtualAlloc region, so only touched pages
+    // become resident and large stacks cost what they use. A PROT_NONE guard page sits right
+    // below stack_base and turns an overflow into a fault instead of silent corruption.
+    struct virtual_stack_allocator
+    {
+        [[nodiscard]] auto allocate(std::size_t size) noexcept -> void * { return detail::mco_vm_reserve(size); }
+        void deallocate(void *ptr, std::size_t size) noexcept { detail::mco_vm_release(ptr, size); }
+        [[nodiscard]] auto guard_size() const noexcept -> std::size_t { return detail::mco_vm_page_size(); }
+        [[nodiscard]] auto protect(void *guard, std::size_t size) noexcept -> bool { return detail::mco_vm_protect_none(guard, size); }
+    };
+
+    // Stacks carved from memory on one NUMA node, so a runner pinned there touches local DRAM
+    // on every switch. caller_node picks the node of whichever thread allocates; a fixed node
+    // serves every caller from there. Each node gets its own pool of 2 MiB chunks, which with
+    // page_kind::transparent_huge / explicit_huge sit under one TLB entry per ~100 small stacks.
+    // Memory is returned to the system only by the destructor, so the allocator must outlive
+    // every coroutine it served. Not copyable or movable: frames point back into it.
+    class numa_stack_allocator
     {
     public:
-        class iterator;
+        static constexpr int caller_node = -1;
+        static constexpr std::size_t max_nodes = 64;
 
-        [[nodiscard]] static auto create(std::function<void(coroutine_handle)> func) noexcept -> std::expected<generator, error>
+        explicit numa_stack_allocator(int node = caller_node, page_kind pages = page_kind::normal) noexcept
+            : node_{node}, pages_{pages} {}
+
+        numa_stack_allocator(numa_stack_allocator const &) = delete;
+        auto operator=(numa_stack_allocator const &) -> numa_stack_allocator & = delete;
+
+        ~numa_stack_allocator()
         {
-            auto coro_result = coroutine::create(std::move(func));
-            if (!coro_result)
-                return std::unexpected{coro_result.error()};
-            return generator{std::move(*coro_result)};
+            for (auto &p : pools_)
+                delete p.load(std::memory_order_acquire);
         }
 
-        [[nodiscard]] auto next() noexcept -> std::expected<std::optional<T>, error>
+        [[nodiscard]] auto allocate(std::size_t size) noexcept -> void *
         {
-            if (coro_.done())
-                return std::optional<T>{std::nullopt};
-            auto resume_result = coro_.resume();
-            if (!resume_result)
-                return std::unexpected{resume_result.error()};
-            if (coro_.done())
-                return std::optional<T>{std::nullopt};
-            auto value_result = coro_.pop<T>();
-            if (!value_result)
-                return std::unexpected{value_result.error()};
-            return std::optional<T>{std::move(*value_result)};
+            detail::numa_node_pool *pool = pool_for(node_ == caller_node ? current_node() : node_);
+            return pool != nullptr ? pool->allocate(size) : nullptr;
         }
 
-        [[nodiscard]] auto done() const noexcept -> bool { return coro_.done(); }
-        [[nodiscard]] auto begin() -> iterator { return iterator{*this}; }
-        [[nodiscard]] static auto end() noexcept -> std::default_sentinel_t { return std::default_sentinel; }
-
-    private:
-        explicit generator(coroutine coro) noexcept : coro_{std::move(coro)} {}
-        coroutine coro_;
-    };
+        void deallocate(void *ptr, std::size_t size) noexcept { detail::numa_node_pool::deallocate(ptr, size); }
 
-    template <storable T>
-    class generator<T>::iterator
-    {
-    public:
-        using value_type = T;
-        using difference_type = std::ptrdiff_t;
+        // Node the calling thread is running on right now; 0 without NUMA support.
+        [[nodiscard]] static auto current_node() noexcept -> int { return detail::mco_numa_node(); }
 
-        explicit iterator(generator &gen) : gen_{&gen} { advance(); }
-        [[nodiscard]] auto operator*() const noexcept -> T const & { return *current_; }
-        auto operator++() -> iterator &
-        {
-            advance();
-            return *this;
-        }
-        auto operator++(int) -> iterator
+        // Node whose pool a block from allocate() belongs to.
+        [[nodiscard]] static auto node_of(void const *block) noexcept -> int
         {
-            auto copy = *this;
-            advance();
-            return copy;
+            auto const *h = reinterpret_cast<detail::numa_node_pool::header const *>(static_cast<unsigned char const *>(block) - detail::numa_node_pool::header_size);
+            return h->home->numa_node;
         }
-        [[nodiscard]] auto operator==(std::default_sentinel_t) const noexcept -> bool { return !current_.has_value(); }
+
+        [[nodiscard]] auto node() const noexcept -> int { return node_; }
+        [[nodiscard]] auto pages() const noexcept -> page_kind { return pages_; }
 
     private:
-        void advance()
+        [[nodiscard]] auto pool_for(int node) noexcept -> detail::numa_node_pool *
         {
-            auto result = gen_->next();
-            if (result && *result)
-                current_ = std::move(**result);
-            else
-                current_ = std::nullopt;
+            if (node < 0 || static_cast<std::size_t>(node) >= max_nodes)
+                node = 0;
+            auto &slot = pools_[static_cast<std::size_t>(node)];
+            if (auto *pool = slot.load(std::memory_order_acquire); pool != nullptr)
+                return pool;
+            auto *fresh = new (std::nothrow) detail::numa_node_pool{node, pages_};
+            detail::numa_node_pool *expected = nullptr;
+            if (fresh == nullptr || slot.compare_exchange_strong(expected, fresh, std::memory_order_acq_rel))
+                return fresh;
+            delete fresh; // another thread installed this node's pool first
+            return expected;
         }
-        generator *gen_;
-        std::optional<T> current_;
+
+        int node_;
+        page_kind pages_;
+        std::array<std::atomic<detail::numa_node_pool *>, max_nodes> pools_{};
     };
 
-    template <storable T>
-    [[nodiscard]] inline auto yield_value(coroutine_handle h, T const &value) noexcept -> std::expected<void, error>
+    // ============================================================================
+    // Classes
+    // ============================================================================
+
+    // What a coroutine has cost so far (UCORO_INSTRUMENT builds). cpu_ticks is in cycle-counter
+    // ticks: comparable between coroutines, not calibrated to wall time.
+    struct coroutine_stats
     {
-        auto push_result = h.push(value);
-        if (!push_result)
-            return push_result;
-        return h.yield();
-    }
+        std::uint64_t resumes = 0;
+        std::uint64_t yields = 0;
+        std::uint64_t cpu_ticks = 0;
+        char const *name = nullptr; // as given to set_trace_name(), or "coroutine"
+    };
 
-    class task_runner
+    // Read-only view of one coroutine's cancel flag, for code that should notice cancellation
+    // but has no business suspending or cancelling the coroutine itself. A default-constructed
+    // token is never cancelled. Valid while the coroutine's frame is.
+    class cancellation_token
     {
     public:
-        auto add(coroutine &&coro) -> task_runner &
-        {
-            if (coro.valid() && !coro.done())
-                tasks_.push_back(std::move(coro));
-            return *this;
+        constexpr cancellation_token() noexcept = default;
+
+        [[nodiscard]] auto requested() const noexcept -> bool { return flag_ != nullptr && *flag_; }
+
+    private:
+        friend class coroutine_handle;
+
+        constexpr explicit cancellation_token(bool const *flag) noexcept : flag_{flag} {}
+
+        bool const *flag_{nullptr};
+    };
+
+    class coroutine_handle
+    {
+    public:
+        constexpr coroutine_handle() noexcept = default;
+        constexpr explicit coroutine_handle(detail::mco_coro *co) noexcept : handle_{co} {}
+
+        [[nodiscard]] auto yield() const noexcept -> std::expected<void, error>
+        {
+            if (handle_ == nullptr)
+                return std::unexpected{error::invalid_coroutine};
+            auto const result = from_impl_result(detail::mco_yield(handle_));
+            if (result != error::success)
+                return std::unexpected{result};
+            if (handle_->cancelled)
+                return std::unexpected{error::cancelled};
+            return {};
+        }
+
+        template <switch_kind Kind = switch_kind::full>
+        void yield_unchecked() const noexcept
+        {
+            handle_->state = detail::mco_state::suspended;
+            detail::mco_prepare_jumpout(handle_);
+            detail::mco_context *context = detail::mco_context_of(handle_);
+            detail::mco_switch<Kind>(&context->ctx, &context->back_ctx);
+        }
+
+        // Yields and stays off the scheduler's ready queue until someone wakes this coroutine
+        // (task_runner::wake). Returns at once if a wake already arrived. Without a scheduler
+        // this is a plain yield.
+        [[nodiscard]] auto park() const noexcept -> std::expected<void, error>
+        {
+            if (handle_ == nullptr)
+                return std::unexpected{error::invalid_coroutine};
+            auto const result = from_impl_result(detail::mco_park(handle_));
+            if (result != error::success)
+                return std::unexpected{result};
+            return {};
+        }
+
+        // Cooperative cancellation: from here on every wait (park, sleep_for, channel and
+        // coro::io calls) and every checked yield() returns error::cancelled, and a task parked
+        // in one is re-queued now. The body is expected to unwind and return. Call it on the
+        // thread that runs the coroutine's scheduler; cancelling a finished coroutine is a no-op.
+        [[nodiscard]] auto cancel() const noexcept -> std::expected<void, error>
+        {
+            if (handle_ == nullptr)
+                return std::unexpected{error::invalid_coroutine};
+            if (handle_->state != detail::mco_state::dead)
+                detail::mco_cancel(handle_);
+            return {};
+        }
+
+        // One load of a field in the frame; cheap enough for a hot loop.
+        [[nodiscard]] auto cancellation_requested() const noexcept -> bool { return handle_ != nullptr && handle_->cancelled; }
+        [[nodiscard]] auto token() const noexcept -> cancellation_token
+        {
+            return handle_ ? cancellation_token{&handle_->cancelled} : cancellation_token{};
+        }
+
+        // Suspends this coroutine and resumes `other` in a single context switch. `other`
+        // inherits our resumer: its next yield returns to whoever resumed us, not to us.
+        [[nodiscard]] auto transfer(coroutine_handle other) const noexcept -> std::expected<void, error>
+        {
+            if (handle_ == nullptr || other.handle_ == nullptr)
+                return std::unexpected{error::invalid_coroutine};
+            auto const result = from_impl_result(detail::mco_transfer(handle_, other.handle_));
+            if (result != error::success)
+                return std::unexpected{result};
+            return {};
+        }
+
+        template <switch_kind Kind = switch_kind::full>
+        void transfer_unchecked(coroutine_handle other) const noexcept
+        {
+            if (other.handle_->stack_base == nullptr && detail::mco_attach_stack(other.handle_) != detail::mco_result::success) [[unlikely]]
+                return;
+            detail::mco_prepare_transfer(handle_, other.handle_);
+            detail::mco_context *from = detail::mco_context_of(handle_);
+            detail::mco_context *to = detail::mco_context_of(other.handle_);
+            detail::mco_switch<Kind>(&from->ctx, &to->ctx);
+        }
+
+        template <storable T>
+        void push_unchecked(T const &value) const noexcept
+        {
+            std::memcpy(&handle_->storage[handle_->bytes_stored], std::addressof(value), sizeof(T));
+            handle_->bytes_stored += static_cast<std::uint32_t>(sizeof(T));
+        }
+
+        template <storable T>
+        T pop_unchecked() const noexcept
+        {
+            T value;
+            handle_->bytes_stored -= static_cast<std::uint32_t>(sizeof(T));
+            std::memcpy(&value, &handle_->storage[handle_->bytes_stored], sizeof(T));
+            return value;
+        }
+
+        [[nodiscard]] auto status() const noexcept -> state { return static_cast<state>(detail::mco_status(handle_)); }
+        [[nodiscard]] constexpr auto valid() const noexcept -> bool { return handle_ != nullptr; }
+        [[nodiscard]] constexpr explicit operator bool() const noexcept { return valid(); }
+
+        template <typename T>
+        [[nodiscard]] auto get_user_data() const noexcept -> T *
+        {
+            return static_cast<T *>(detail::mco_get_user_data(handle_));
+        }
+
+        template <storable T>
+        [[nodiscard]] auto push(T const &value) const noexcept -> std::expected<void, error>
+        {
+            auto const result = from_impl_result(detail::mco_push(handle_, std::addressof(value), sizeof(T)));
+            if (result != error::success)
+                return std::unexpected{result};
+            return {};
+        }
+
+        [[nodiscard]] auto push_bytes(std::span<std::byte const> data) const noexcept -> std::expected<void, error>
+        {
+            auto const result = from_impl_result(detail::mco_push(handle_, data.data(), data.size()));
+            if (result != error::success)
+                return std::unexpected{result};
+            return {};
+        }
+
+        template <storable T>
+        [[nodiscard]] auto pop() const noexcept -> std::expected<T, error>
+        {
+            T value{};
+            auto const result = from_impl_result(detail::mco_pop(handle_, std::addressof(value), sizeof(T)));
+            if (result != error::success)
+                return std::unexpected{result};
+            return value;
+        }
+
+        template <storable T>
+        [[nodiscard]] auto peek() const noexcept -> std::expected<T, error>
+        {
+            T value{};
+            auto const result = from_impl_result(detail::mco_peek(handle_, std::addressof(value), sizeof(T)));
+            if (result != error::success)
+                return std::unexpected{result};
+            return value;
+        }
+
+        [[nodiscard]] auto bytes_stored() const noexcept -> std::size_t { return detail::mco_get_bytes_stored(handle_); }
+        [[nodiscard]] auto storage_capacity() const noexcept -> std::size_t { return detail::mco_get_storage_size(handle_); }
+
+        [[nodiscard]] auto stack_capacity() const noexcept -> std::size_t { return handle_ ? handle_->stack_size : 0; }
+        // Current depth: from the top of the stack down to the (saved) stack pointer.
+        [[nodiscard]] auto stack_used() const noexcept -> std::size_t { return detail::mco_stack_used(handle_); }
+        [[nodiscard]] auto stack_remaining() const noexcept -> std::size_t { return stack_capacity() - stack_used(); }
+
+        // Deepest usage since creation; needs UCORO_STACK_PAINT.
+        [[nodiscard]] auto stack_peak() const noexcept -> std::expected<std::size_t, error>
+        {
+            if (handle_ == nullptr)
+                return std::unexpected{error::invalid_coroutine};
+            if constexpr (!stack_painting)
+                return std::unexpected{error::invalid_operation};
+            else
+                return detail::mco_stack_peak(handle_);
+        }
+
+        // Labels the coroutine in stats() and, with UCORO_TRACY, its Tracy fiber ("<name> #<n>",
+        // one per live coroutine; a rename takes effect on the next resume). Give every
+        // coroutine of one kind the same string literal; the pointer must stay valid. A no-op
+        // without UCORO_INSTRUMENT.
+        void set_trace_name([[maybe_unused]] char const *name) const noexcept
+        {
+#if UCORO_INSTRUMENT
+            if (handle_ != nullptr)
+                handle_->counters.name = name;
+#endif
+        }
+
+        // Resumes, yields and time on the CPU since creation; needs UCORO_INSTRUMENT. The stint
+        // of a coroutine that is running right now is not included yet.
+        [[nodiscard]] auto stats() const noexcept -> std::expected<coroutine_stats, error>
+        {
+            if (handle_ == nullptr)
+                return std::unexpected{error::invalid_coroutine};
+#if UCORO_INSTRUMENT
+            detail::mco_counters const &c = handle_->counters;
+            return coroutine_stats{c.resumes, c.yields, c.ticks, detail::mco_trace_name(handle_)};
+#else
+            return std::unexpected{error::invalid_operation};
+#endif
+        }
+
+        [[nodiscard]] constexpr auto raw() const noexcept -> detail::mco_coro * { return handle_; }
+
+    private:
+        detail::mco_coro *handle_{nullptr};
+    };
+
+    // Called with a coroutine that is about to be torn down and its stack_peak() in bytes.
+    // Only invoked when UCORO_STACK_PAINT is on.
+    using stack_peak_hook = std::function<void(coroutine_handle, std::size_t peak)>;
+
+    // Called with a finished task and its stats(). Only invoked when UCORO_INSTRUMENT is on.
+    using stats_hook = std::function<void(coroutine_handle, coroutine_stats const &)>;
+
+    [[nodiscard]] inline auto running() noexcept -> coroutine_handle
+    {
+        return coroutine_handle{detail::mco_running()};
+    }
+
+    [[nodiscard]] inline auto yield() noexcept -> std::expected<void, error>
+    {
+        return running().yield();
+    }
+
+    // Anything create() can run: invoked with the coroutine's handle, stored by value in the frame.
+    template <typename F>
+    concept coroutine_body = std::invocable<std::decay_t<F> &, coroutine_handle> &&
+                             std::constructible_from<std::decay_t<F>, F> &&
+                             std::destructible<std::decay_t<F>>;
+
+    namespace detail
+    {
+        // Frame user areas are 16-byte aligned; callables needing more live on the heap.
+        inline constexpr std::size_t frame_callable_align = 16;
+
+        template <typename Fn>
+        struct boxed_callable
+        {
+            Fn *fn;
+
+            explicit boxed_callable(Fn *p) noexcept : fn{p} {}
+            boxed_callable(boxed_callable const &) = delete;
+            auto operator=(boxed_callable const &) -> boxed_callable & = delete;
+            ~boxed_callable() { delete fn; }
+
+            void operator()(coroutine_handle h) { (*fn)(h); }
+        };
+
+        template <typename Fn>
+        inline constexpr bool fits_frame = alignof(Fn) <= frame_callable_align;
+
+        template <typename Fn>
+        inline constexpr std::size_t frame_callable_size = fits_frame<Fn> ? sizeof(Fn) : sizeof(boxed_callable<Fn>);
+    } // namespace detail
+
+    // One stack taken in turns by the coroutines made with coroutine::create_shared (libco's
+    // copying stacks). A member runs on it directly; when a different member is resumed, the
+    // part of the current one's stack that is live (saved sp up to the top) is copied into a
+    // buffer sized to fit, and copied back when that member next runs. A parked member costs its
+    // frame header plus the bytes it actually had in use, at the price of one memcpy each way
+    // whenever the member on the stack changes. Resume members from outside the group (a
+    // runner, main): a member resuming or transferring to another member of its own group gets
+    // error::invalid_operation. Members stay on the thread that made them, and the shared_stack
+    // must outlive them.
+    class [[nodiscard]] shared_stack
+    {
+    public:
+        static constexpr stack_size default_size{256 * 1024};
+
+        // The stack is reserved like virtual_stack_allocator's, so only touched pages are resident.
+        [[nodiscard]] static auto create(stack_size size = default_size) noexcept -> std::expected<shared_stack, error>
+        {
+            std::size_t const bytes = detail::mco_align_forward(std::max(size.value, min_stack_size.value), detail::mco_vm_page_size());
+            auto *state = new (std::nothrow) detail::mco_shared_stack{};
+            if (state == nullptr)
+                return std::unexpected{error::out_of_memory};
+            state->base = detail::mco_vm_reserve(bytes);
+            if (state->base == nullptr)
+            {
+                delete state;
+                return std::unexpected{error::out_of_memory};
+            }
+            state->size = bytes;
+            if constexpr (stack_painting)
+                std::memset(state->base, detail::mco_stack_paint_byte, bytes);
+            return shared_stack{state};
+        }
+
+        shared_stack(shared_stack const &) = delete;
+        auto operator=(shared_stack const &) -> shared_stack & = delete;
+
+        shared_stack(shared_stack &&other) noexcept : state_{std::exchange(other.state_, nullptr)} {}
+
+        auto operator=(shared_stack &&other) noexcept -> shared_stack &
+        {
+            if (this != &other)
+            {
+                release();
+                state_ = std::exchange(other.state_, nullptr);
+            }
+            return *this;
+        }
+
+        ~shared_stack() { release(); }
+
+        [[nodiscard]] auto size() const noexcept -> std::size_t { return state_ ? state_->size : 0; }
+        // Times a member had to be copied off so another could run.
+        [[nodiscard]] auto copies() const noexcept -> std::size_t { return state_ ? state_->copies : 0; }
+        [[nodiscard]] auto occupied() const noexcept -> bool { return state_ != nullptr && state_->occupant != nullptr; }
+        [[nodiscard]] auto valid() const noexcept -> bool { return state_ != nullptr; }
+        [[nodiscard]] explicit operator bool() const noexcept { return valid(); }
+
+    private:
+        friend class coroutine;
+
+        explicit shared_stack(detail::mco_shared_stack *state) noexcept : state_{state} {}
+
+        void release() noexcept
+        {
+            if (state_ == nullptr)
+                return;
+            detail::mco_vm_release(state_->base, state_->size);
+            delete state_;
+            state_ = nullptr;
+        }
+
+        detail::mco_shared_stack *state_{nullptr};
+    };
+
+    // How coroutine::create_many backs its slab. Both are off by default: pages are then
+    // faulted in as the coroutines first touch them, like any other frame.
+    struct slab_options
+    {
+        bool prefault = false;   // fault the whole slab in up front (MAP_POPULATE on Linux)
+        bool huge_pages = false; // 2 MiB-aligned, with transparent huge pages where available
+    };
+
+    class slab;
+
+    template <std::size_t StackSize, std::size_t StorageSize = UCORO_STORAGE_SIZE, typename F = void (*)(coroutine_handle)>
+    class static_coroutine;
+
+    class [[nodiscard]] coroutine
+    {
+    public:
+        using function_type = std::function<void(coroutine_handle)>;
+
+        // The callable is constructed inside the coroutine frame (right after the context) and
+        // invoked through a type-specific trampoline: one allocation per coroutine, none from a pool.
+        template <coroutine_body F>
+        [[nodiscard]] static auto create(F &&func) noexcept -> std::expected<coroutine, error>
+        {
+            return create(std::forward<F>(func), default_stack_size, default_storage_size);
+        }
+
+        template <coroutine_body F>
+        [[nodiscard]] static auto create(F &&func, stack_size stack, storage_size storage = default_storage_size) noexcept -> std::expected<coroutine, error>
+        {
+            detail::mco_desc desc = detail::mco_desc_init(&coroutine::invoke<std::decay_t<F>>, stack.value);
+            desc.storage_size = storage.value;
+            desc.user_size = detail::frame_callable_size<std::decay_t<F>>;
+            detail::mco_init_desc_sizes(&desc, desc.stack_size);
+            return create_with_desc(std::forward<F>(func), desc);
+        }
+
+        // Frames come from alloc, which must outlive the coroutine.
+        template <coroutine_body F, stack_allocator Alloc>
+        [[nodiscard]] static auto create(F &&func, stack_size stack, storage_size storage, Alloc &alloc) noexcept -> std::expected<coroutine, error>
+        {
+            detail::mco_desc desc = detail::mco_desc_init(&coroutine::invoke<std::decay_t<F>>, stack.value);
+            desc.storage_size = storage.value;
+            desc.user_size = detail::frame_callable_size<std::decay_t<F>>;
+            detail::mco_desc_set_allocator(desc, alloc);
+            detail::mco_init_desc_sizes(&desc, desc.stack_size);
+            return create_with_desc(std::forward<F>(func), desc);
+        }
+
+        // Lazy frames allocate only header, callable and storage here. The stack is taken from
+        // the same allocator on the first resume or transfer and returned the moment the
+        // coroutine finishes, so thousands of coroutines that may never run cost no stack memory.
+        // Pair with freelist_allocator to recycle stacks between short-lived tasks. A coroutine
+        // that fails to obtain its stack reports out_of_memory from resume() and stays suspended.
+        template <coroutine_body F>
+        [[nodiscard]] static auto create_lazy(F &&func) noexcept -> std::expected<coroutine, error>
+        {
+            return create_lazy(std::forward<F>(func), default_stack_size, default_storage_size);
+        }
+
+        template <coroutine_body F>
+        [[nodiscard]] static auto create_lazy(F &&func, stack_size stack, storage_size storage = default_storage_size) noexcept -> std::expected<coroutine, error>
+        {
+            detail::mco_desc desc = detail::mco_desc_init(&coroutine::invoke<std::decay_t<F>>, stack.value);
+            desc.storage_size = storage.value;
+            desc.user_size = detail::frame_callable_size<std::decay_t<F>>;
+            desc.lazy_stack = true;
+            detail::mco_init_desc_sizes(&desc, desc.stack_size);
+            return create_with_desc(std::forward<F>(func), desc);
+        }
+
+        // Frame and stack both come from alloc, which must outlive the coroutine.
+        template <coroutine_body F, stack_allocator Alloc>
+        [[nodiscard]] static auto create_lazy(F &&func, stack_size stack, storage_size storage, Alloc &alloc) noexcept -> std::expected<coroutine, error>
+        {
+            detail::mco_desc desc = detail::mco_desc_init(&coroutine::invoke<std::decay_t<F>>, stack.value);
+            desc.storage_size = storage.value;
+            desc.user_size = detail::frame_callable_size<std::decay_t<F>>;
+            desc.lazy_stack = true;
+            detail::mco_desc_set_allocator(desc, alloc);
+            detail::mco_init_desc_sizes(&desc, desc.stack_size);
+            return create_with_desc(std::forward<F>(func), desc);
+        }
+
+        // A coroutine that runs on `stack` (see shared_stack) instead of a stack of its own: the
+        // frame is only header, callable and storage, and stack_capacity() is the shared size.
+        template <coroutine_body F>
+        [[nodiscard]] static auto create_shared(F &&func, shared_stack &stack, storage_size storage = default_storage_size) noexcept
+            -> std::expected<coroutine, error>
+        {
+            if (stack.state_ == nullptr)
+                return std::unexpected{error::invalid_arguments};
+            detail::mco_desc desc = detail::mco_desc_init(&coroutine::invoke<std::decay_t<F>>, stack.size());
+            desc.storage_size = storage.value;
+            desc.user_size = detail::frame_callable_size<std::decay_t<F>>;
+            desc.lazy_stack = true;
+            desc.shared_stack = stack.state_;
+            detail::mco_init_desc_sizes(&desc, desc.stack_size);
+            return create_with_desc(std::forward<F>(func), desc);
+        }
+
+        // n coroutines in one allocation: factory(i) builds the i-th body and the frames are
+        // laid out back to back, each on its own cache line, with their contexts set up in one
+        // pass. The slab owns the coroutines; ones moved out of it keep the memory alive until
+        // they are destroyed too. Slab frames have no guard pages.
+        template <typename Factory>
+            requires std::invocable<Factory &, std::size_t> && coroutine_body<std::invoke_result_t<Factory &, std::size_t>>
+        [[nodiscard]] static auto create_many(std::size_t n, Factory &&factory, stack_size stack = default_stack_size,
+                                              storage_size storage = default_storage_size, slab_options options = {}) noexcept
+            -> std::expected<slab, error>;
+
+        // Type-erased overloads; also what a null function (invalid_arguments) binds to.
+        [[nodiscard]] static auto create(function_type func) noexcept -> std::expected<coroutine, error>
+        {
+            return create(std::move(func), default_stack_size, default_storage_size);
+        }
+
+        [[nodiscard]] static auto create(function_type func, stack_size stack, storage_size storage = default_storage_size) noexcept -> std::expected<coroutine, error>
+        {
+            return create<function_type>(std::move(func), stack, storage);
+        }
+
+        coroutine(coroutine const &) = delete;
+        auto operator=(coroutine const &) -> coroutine & = delete;
+
+        coroutine(coroutine &&other) noexcept
+            : handle_{std::exchange(other.handle_, nullptr)}, drop_{std::exchange(other.drop_, nullptr)} {}
+
+        auto operator=(coroutine &&other) noexcept -> coroutine &
+        {
+            if (this != &other)
+            {
+                destroy();
+                handle_ = std::exchange(other.handle_, nullptr);
+                drop_ = std::exchange(other.drop_, nullptr);
+            }
+            return *this;
+        }
+
+        ~coroutine() { destroy(); }
+
+        [[nodiscard]] auto resume() noexcept -> std::expected<void, error>
+        {
+            if (handle_ == nullptr)
+                return std::unexpected{error::invalid_coroutine};
+            auto const result = from_impl_result(detail::mco_resume(handle_));
+            if (result != error::success)
+                return std::unexpected{result};
+            return {};
+        }
+
+        // Lazy frames still get their stack attached on the first call; if that allocation
+        // fails the coroutine simply does not run. See switch_kind for the register-saving choices.
+        template <switch_kind Kind = switch_kind::full>
+        void resume_unchecked() const noexcept
+        {
+            if (handle_->stack_base == nullptr && detail::mco_attach_stack(handle_) != detail::mco_result::success) [[unlikely]]
+                return;
+            handle_->state = detail::mco_state::running;
+            detail::mco_prepare_jumpin(handle_);
+            detail::mco_context *context = detail::mco_context_of(handle_);
+            detail::mco_switch<Kind>(&context->back_ctx, &context->ctx);
+            if (handle_->state == detail::mco_state::dead && handle_->stack_block != nullptr) [[unlikely]]
+                detail::mco_release_stack(handle_);
+        }
+
+        template <storable T>
+        void push_unchecked(T const &value) const noexcept { handle().push_unchecked(value); }
+
+        template <storable T>
+        T pop_unchecked() const noexcept { return handle().pop_unchecked<T>(); }
+
+        [[nodiscard]] auto status() const noexcept -> state { return static_cast<state>(detail::mco_status(handle_)); }
+        [[nodiscard]] auto done() const noexcept -> bool { return status() == state::dead; }
+        [[nodiscard]] auto suspended() const noexcept -> bool { return status() == state::suspended; }
+        [[nodiscard]] auto is_running() const noexcept -> bool { return status() == state::running; }
+        [[nodiscard]] auto valid() const noexcept -> bool { return handle_ != nullptr; }
+        [[nodiscard]] explicit operator bool() const noexcept { return valid(); }
+        [[nodiscard]] auto handle() const noexcept -> coroutine_handle { return coroutine_handle{handle_}; }
+        [[nodiscard]] auto raw() const noexcept -> detail::mco_coro * { return handle_; }
+
+        template <storable T>
+        [[nodiscard]] auto push(T const &value) const noexcept -> std::expected<void, error> { return handle().push(value); }
+
+        template <storable T>
+        [[nodiscard]] auto pop() const noexcept -> std::expected<T, error> { return handle().pop<T>(); }
+
+        template <storable T>
+        [[nodiscard]] auto peek() const noexcept -> std::expected<T, error> { return handle().peek<T>(); }
+
+        [[nodiscard]] auto bytes_stored() const noexcept -> std::size_t { return handle().bytes_stored(); }
+        [[nodiscard]] auto storage_capacity() const noexcept -> std::size_t { return handle().storage_capacity(); }
+
+        [[nodiscard]] auto stack_capacity() const noexcept -> std::size_t { return handle().stack_capacity(); }
+        [[nodiscard]] auto stack_used() const noexcept -> std::size_t { return handle().stack_used(); }
+        [[nodiscard]] auto stack_remaining() const noexcept -> std::size_t { return handle().stack_remaining(); }
+        [[nodiscard]] auto stack_peak() const noexcept -> std::expected<std::size_t, error> { return handle().stack_peak(); }
+
+        void set_trace_name(char const *name) const noexcept { handle().set_trace_name(name); }
+        [[nodiscard]] auto stats() const noexcept -> std::expected<coroutine_stats, error> { return handle().stats(); }
+
+        [[nodiscard]] auto cancel() const noexcept -> std::expected<void, error> { return handle().cancel(); }
+        [[nodiscard]] auto cancellation_requested() const noexcept -> bool { return handle().cancellation_requested(); }
+        [[nodiscard]] auto token() const noexcept -> cancellation_token { return handle().token(); }
+
+    private:
+        friend class pool;
+        friend class scope;
+        friend class slab;
+        template <std::size_t, std::size_t, typename>
+        friend class static_coroutine;
+
+        using drop_fn = void (*)(detail::mco_coro *co);
+
+        explicit coroutine(detail::mco_coro *co, drop_fn dropper) noexcept
+            : handle_{co}, drop_{dropper} {}
+
+        // desc carries the frame layout and allocator. The callable goes into the frame's user
+        // area when it fits (desc.user_size), otherwise it is boxed on the heap.
+        template <typename F>
+        [[nodiscard]] static auto create_with_desc(F &&func, detail::mco_desc &desc) noexcept -> std::expected<coroutine, error>
+        {
+            using Fn = std::decay_t<F>;
+            if constexpr (std::is_pointer_v<Fn> || std::same_as<Fn, function_type>)
+            {
+                if (!func)
+                    return std::unexpected{error::invalid_arguments};
+            }
+
+            if constexpr (detail::fits_frame<Fn>)
+            {
+                if (sizeof(Fn) <= desc.user_size)
+                    return create_in_frame<Fn>(desc, std::forward<F>(func));
+            }
+
+            auto *boxed = new (std::nothrow) Fn(std::forward<F>(func));
+            if (boxed == nullptr)
+                return std::unexpected{error::out_of_memory};
+            auto created = create_in_frame<detail::boxed_callable<Fn>>(desc, boxed);
+            if (!created)
+                delete boxed;
+            return created;
+        }
+
+        template <typename Stored, typename Arg>
+        [[nodiscard]] static auto create_in_frame(detail::mco_desc &desc, Arg &&arg) noexcept -> std::expected<coroutine, error>
+        {
+            desc.func = &coroutine::invoke<Stored>;
+            desc.user_data = nullptr;
+
+            detail::mco_coro *co = nullptr;
+            auto const result = from_impl_result(detail::mco_create(&co, &desc));
+            if (result != error::success)
+                return std::unexpected{result};
+
+            ::new (co->user_data) Stored(std::forward<Arg>(arg));
+            return coroutine{co, &coroutine::drop<Stored>};
+        }
+
+        template <typename Stored>
+        static void invoke(detail::mco_coro *co)
+        {
+            (*static_cast<Stored *>(co->user_data))(coroutine_handle{co});
+        }
+
+        template <typename Stored>
+        static void drop(detail::mco_coro *co)
+        {
+            static_cast<Stored *>(co->user_data)->~Stored();
+        }
+
+        void destroy() noexcept
+        {
+            if (handle_ != nullptr)
+            {
+                if (drop_ != nullptr)
+                    drop_(handle_);
+                detail::mco_destroy(handle_);
+                handle_ = nullptr;
+            }
+            drop_ = nullptr;
+        }
+
+        detail::mco_coro *handle_{nullptr};
+        drop_fn drop_{nullptr};
+    };
+
+    // ============================================================================
+    // Coroutine Pool
+    // ============================================================================
+
+    namespace detail
+    {
+        // Frames are recycled through mco_desc's alloc_cb/dealloc_cb: mco_create pops an
+        // already-mapped block and re-runs mco_init on it, mco_destroy pushes it back.
+        struct pool_state
+        {
+            struct idle_frame
+            {
+                idle_frame *next;
+            };
+
+            mco_desc desc{};
+            void *(*upstream_alloc)(std::size_t size, void *allocator_data) = mco_alloc;
+            void (*upstream_dealloc)(void *ptr, std::size_t size, void *allocator_data) = mco_dealloc;
+            bool (*upstream_guard)(void *guard, std::size_t size, void *allocator_data) = nullptr;
+            void *upstream_data = nullptr;
+            idle_frame *idle_head = nullptr;
+            std::size_t idle = 0;
+            std::size_t active = 0;
+            std::size_t high_watermark = 0;
+            bool orphaned = false;
+            stack_peak_hook peak_hook;
+
+            [[nodiscard]] auto frame_size() const noexcept -> std::size_t { return desc.coro_size; }
+
+            [[nodiscard]] auto grow() noexcept -> bool
+            {
+                void *block = upstream_alloc(frame_size(), upstream_data);
+                if (block == nullptr)
+                    return false;
+                // guard pages are protected once per mapping; recycled frames keep them
+                if (upstream_guard != nullptr &&
+                    !upstream_guard(static_cast<unsigned char *>(block) + mco_guard_offset(&desc), desc.guard_size, upstream_data))
+                {
+                    upstream_dealloc(block, frame_size(), upstream_data);
+                    return false;
+                }
+                push_idle(block);
+                return true;
+            }
+
+            void push_idle(void *block) noexcept
+            {
+                auto *frame = static_cast<idle_frame *>(block);
+                frame->next = idle_head;
+                idle_head = frame;
+                ++idle;
+            }
+
+            void free_idle() noexcept
+            {
+                while (idle_head != nullptr)
+                {
+                    idle_frame *next = idle_head->next;
+                    upstream_dealloc(idle_head, frame_size(), upstream_data);
+                    idle_head = next;
+                }
+                idle = 0;
+            }
+
+            static void *acquire(std::size_t size, void *allocator_data)
+            {
+                auto *self = static_cast<pool_state *>(allocator_data);
+                if (size != self->frame_size())
+                    return nullptr;
+                if (self->idle_head == nullptr && !self->grow())
+                    return nullptr;
+
+                idle_frame *frame = self->idle_head;
+                self->idle_head = frame->next;
+                --self->idle;
+                if (++self->active > self->high_watermark)
+                    self->high_watermark = self->active;
+                return frame;
+            }
+
+            static void release(void *ptr, std::size_t size, void *allocator_data)
+            {
+                auto *self = static_cast<pool_state *>(allocator_data);
+                --self->active;
+                if constexpr (stack_painting)
+                {
+                    if (self->peak_hook)
+                        self->peak_hook(coroutine_handle{static_cast<mco_coro *>(ptr)}, mco_stack_peak(static_cast<mco_coro *>(ptr)));
+                }
+                if (!self->orphaned)
+                {
+                    self->push_idle(ptr);
+                    return;
+                }
+                // the pool object is gone; the last outstanding coroutine cleans up
+                self->upstream_dealloc(ptr, size, self->upstream_data);
+                if (self->active == 0)
+                    delete self;
+            }
+        };
+    } // namespace detail
+
+    class [[nodiscard]] pool
+    {
+    public:
+        static constexpr std::size_t inline_callable_size = 64;
+
+        [[nodiscard]] static auto create(std::size_t capacity, stack_size stack = default_stack_size, storage_size storage = default_storage_size) noexcept -> std::expected<pool, error>
+        {
+            auto *state = new (std::nothrow) detail::pool_state{};
+            if (state == nullptr)
+                return std::unexpected{error::out_of_memory};
+            return create_with_state(state, capacity, stack, storage);
+        }
+
+        // Frames are mapped from alloc, which must outlive the pool and all its coroutines.
+        template <stack_allocator Alloc>
+        [[nodiscard]] static auto create(std::size_t capacity, stack_size stack, storage_size storage, Alloc &alloc) noexcept -> std::expected<pool, error>
+        {
+            auto *state = new (std::nothrow) detail::pool_state{};
+            if (state == nullptr)
+                return std::unexpected{error::out_of_memory};
+            state->upstream_alloc = &detail::allocator_callbacks<Alloc>::allocate;
+            state->upstream_dealloc = &detail::allocator_callbacks<Alloc>::deallocate;
+            state->upstream_data = static_cast<void *>(std::addressof(alloc));
+            if constexpr (guarded_stack_allocator<Alloc>)
+            {
+                state->desc.guard_size = alloc.guard_size();
+                state->upstream_guard = &detail::allocator_callbacks<Alloc>::protect;
+            }
+            return create_with_state(state, capacity, stack, storage);
+        }
+
+        pool(pool const &) = delete;
+        auto operator=(pool const &) -> pool & = delete;
+
+        pool(pool &&other) noexcept : state_{std::exchange(other.state_, nullptr)} {}
+
+        auto operator=(pool &&other) noexcept -> pool &
+        {
+            if (this != &other)
+            {
+                release();
+                state_ = std::exchange(other.state_, nullptr);
+            }
+            return *this;
+        }
+
+        ~pool() { release(); }
+
+        // Takes an idle frame (growing the pool if none is left) and starts func on it.
+        // The frame returns to the pool when the coroutine is destroyed.
+        // Callables up to inline_callable_size bytes are stored in the frame, so a warm pool
+        // spawns without touching the heap; larger ones are boxed.
+        template <coroutine_body F>
+        [[nodiscard]] auto spawn(F &&func) noexcept -> std::expected<coroutine, error>
+        {
+            if (state_ == nullptr)
+                return std::unexpected{error::invalid_operation};
+            detail::mco_desc desc = state_->desc;
+            return coroutine::create_with_desc(std::forward<F>(func), desc);
+        }
+
+        [[nodiscard]] auto spawn(coroutine::function_type func) noexcept -> std::expected<coroutine, error>
+        {
+            return spawn<coroutine::function_type>(std::move(func));
+        }
+
+        // Ensures at least `count` idle frames are mapped and ready.
+        [[nodiscard]] auto reserve(std::size_t count) noexcept -> std::expected<void, error>
+        {
+            if (state_ == nullptr)
+                return std::unexpected{error::invalid_operation};
+            while (state_->idle < count)
+            {
+                if (!state_->grow())
+                    return std::unexpected{error::out_of_memory};
+            }
+            return {};
+        }
+
+        // Reports every returning frame's stack_peak() (UCORO_STACK_PAINT builds only).
+        void on_stack_peak(stack_peak_hook hook) noexcept
+        {
+            if (state_ != nullptr)
+                state_->peak_hook = std::move(hook);
+        }
+
+        // Unmaps every idle frame; active coroutines are unaffected.
+        void shrink() noexcept
+        {
+            if (state_ != nullptr)
+                state_->free_idle();
+        }
+
+        [[nodiscard]] auto active() const noexcept -> std::size_t { return state_ ? state_->active : 0; }
+        [[nodiscard]] auto idle() const noexcept -> std::size_t { return state_ ? state_->idle : 0; }
+        [[nodiscard]] auto capacity() const noexcept -> std::size_t { return active() + idle(); }
+        [[nodiscard]] auto high_watermark() const noexcept -> std::size_t { return state_ ? state_->high_watermark : 0; }
+        [[nodiscard]] auto frame_size() const noexcept -> std::size_t { return state_ ? state_->frame_size() : 0; }
+        [[nodiscard]] auto valid() const noexcept -> bool { return state_ != nullptr; }
+        [[nodiscard]] explicit operator bool() const noexcept { return valid(); }
+
+    private:
+        explicit pool(detail::pool_state *state) noexcept : state_{state} {}
+
+        [[nodiscard]] static auto create_with_state(detail::pool_state *state, std::size_t capacity, stack_size stack, storage_size storage) noexcept -> std::expected<pool, error>
+        {
+            std::size_t const guard = state->desc.guard_size;
+            state->desc = detail::mco_desc_init(&coroutine::invoke<coroutine::function_type>, stack.value);
+            state->desc.storage_size = storage.value;
+            state->desc.user_size = inline_callable_size;
+            state->desc.guard_size = guard;
+            detail::mco_init_desc_sizes(&state->desc, state->desc.stack_size);
+            state->desc.alloc_cb = &detail::pool_state::acquire;
+            state->desc.dealloc_cb = &detail::pool_state::release;
+            state->desc.allocator_data = state;
+
+            pool p{state};
+            auto reserved = p.reserve(capacity);
+            if (!reserved)
+                return std::unexpected{reserved.error()};
+            return p;
+        }
+
+        void release() noexcept
+        {
+            if (state_ == nullptr)
+                return;
+            state_->free_idle();
+            if (state_->active == 0)
+                delete state_;
+            else
+                state_->orphaned = true;
+            state_ = nullptr;
+        }
+
+        detail::pool_state *state_{nullptr};
+    };
+
+    // ============================================================================
+    // Frame Slabs
+    // ============================================================================
+
+    namespace detail
+    {
+        // The head of one create_many mapping, laid out as [slab_state][coroutine objects][frames].
+        // Frames are carved once, in order, and never recycled; the mapping goes away when the
+        // slab is gone and the last frame has been released. It is the allocator_data of the
+        // slab's mco_desc.
+        struct slab_state
+        {
+            std::size_t region_size = 0;
+            std::size_t stride = 0; // frame size rounded up to mco_frame_align
+            std::size_t count = 0;  // coroutine objects constructed in the region
+            std::size_t frames = 0; // handed out, not yet released
+            unsigned char *bump = nullptr;
+            unsigned char *bump_end = nullptr;
+            bool orphaned = false;
+
+            [[nodiscard]] static constexpr auto header_size() noexcept -> std::size_t
+            {
+                return mco_align_forward(sizeof(slab_state), mco_frame_align);
+            }
+
+            [[nodiscard]] auto items() noexcept -> coroutine *
+            {
+                return reinterpret_cast<coroutine *>(reinterpret_cast<unsigned char *>(this) + header_size());
+            }
+
+            void unmap() noexcept { mco_vm_release(this, region_size); }
+
+            static void *acquire(std::size_t size, void *allocator_data)
+            {
+                auto *self = static_cast<slab_state *>(allocator_data);
+                if (size > self->stride || self->bump == self->bump_end)
+                    return nullptr;
+                ++self->frames;
+                return std::exchange(self->bump, self->bump + self->stride);
+            }
+
+            static void release(void *, std::size_t, void *allocator_data)
+            {
+                auto *self = static_cast<slab_state *>(allocator_data);
+                if (--self->frames == 0 && self->orphaned)
+                    self->unmap();
+            }
+        };
+    } // namespace detail
+
+    // The coroutines made by coroutine::create_many, as a contiguous range. Destroying the slab
+    // destroys the coroutines still in it; any moved out (into a task_runner, say) keep the
+    // mapping alive until they are destroyed as well.
+    class [[nodiscard]] slab
+    {
+    public:
+        using value_type = coroutine;
+        using iterator = coroutine *;
+        using const_iterator = coroutine const *;
+
+        slab(slab const &) = delete;
+        auto operator=(slab const &) -> slab & = delete;
+
+        slab(slab &&other) noexcept : state_{std::exchange(other.state_, nullptr)} {}
+
+        auto operator=(slab &&other) noexcept -> slab &
+        {
+            if (this != &other)
+            {
+                release();
+                state_ = std::exchange(other.state_, nullptr);
+            }
+            return *this;
+        }
+
+        ~slab() { release(); }
+
+        [[nodiscard]] auto begin() noexcept -> iterator { return state_ ? state_->items() : nullptr; }
+        [[nodiscard]] auto end() noexcept -> iterator { return state_ ? state_->items() + state_->count : nullptr; }
+        [[nodiscard]] auto begin() const noexcept -> const_iterator { return state_ ? state_->items() : nullptr; }
+        [[nodiscard]] auto end() const noexcept -> const_iterator { return state_ ? state_->items() + state_->count : nullptr; }
+        [[nodiscard]] auto operator[](std::size_t i) noexcept -> coroutine & { return state_->items()[i]; }
+
+        [[nodiscard]] auto size() const noexcept -> std::size_t { return state_ ? state_->count : 0; }
+        [[nodiscard]] auto empty() const noexcept -> bool { return size() == 0; }
+        // Frames not yet destroyed, whether their coroutine is still here or was moved out.
+        [[nodiscard]] auto frames() const noexcept -> std::size_t { return state_ ? state_->frames : 0; }
+        // Distance between neighbouring frames.
+        [[nodiscard]] auto frame_size() const noexcept -> std::size_t { return state_ ? state_->stride : 0; }
+        [[nodiscard]] auto valid() const noexcept -> bool { return state_ != nullptr; }
+        [[nodiscard]] explicit operator bool() const noexcept { return valid(); }
+
+    private:
+        friend class coroutine;
+
+        explicit slab(detail::slab_state *state) noexcept : state_{state} {}
+
+        template <typename Factory>
+        [[nodiscard]] static auto create(std::size_t n, Factory &factory, stack_size stack, storage_size storage, slab_options options) noexcept
+            -> std::expected<slab, error>
+        {
+            using Fn = std::decay_t<std::invoke_result_t<Factory &, std::size_t>>;
+            detail::mco_desc desc = detail::mco_desc_init(&coroutine::invoke<Fn>, stack.value);
+            desc.storage_size = storage.value;
+            desc.user_size = detail::frame_callable_size<Fn>;
+            detail::mco_init_desc_sizes(&desc, desc.stack_size);
+            desc.coro_size -= detail::mco_frame_slack; // every slab frame starts on a cache line
+
+            std::size_t const stride = detail::mco_align_forward(desc.coro_size, detail::mco_frame_align);
+            std::size_t const header = detail::slab_state::header_size();
+            if (n > (SIZE_MAX / 2 - header) / (stride + sizeof(coroutine)))
+                return std::unexpected{error::out_of_memory};
+            std::size_t const items = detail::mco_align_forward(n * sizeof(coroutine), detail::mco_frame_align);
+            std::size_t const region_size = header + items + n * stride;
+
+            void *region = detail::mco_vm_reserve_slab(region_size, options.prefault, options.huge_pages);
+            if (region == nullptr)
+                return std::unexpected{error::out_of_memory};
+            auto *state = ::new (region) detail::slab_state{};
+            state->region_size = region_size;
+            state->stride = stride;
+            state->bump = static_cast<unsigned char *>(region) + header + items;
+            state->bump_end = state->bump + n * stride;
+            desc.alloc_cb = &detail::slab_state::acquire;
+            desc.dealloc_cb = &detail::slab_state::release;
+            desc.allocator_data = state;
+
+            slab s{state};
+            coroutine *out = state->items();
+            for (std::size_t i = 0; i < n; ++i)
+            {
+                auto created = coroutine::create_with_desc(std::invoke(factory, i), desc);
+                if (!created)
+                    return std::unexpected{created.error()};
+                ::new (static_cast<void *>(out + i)) coroutine{std::move(*created)};
+                ++state->count;
+            }
+            return s;
+        }
+
+        void release() noexcept
+        {
+            if (state_ == nullptr)
+                return;
+            coroutine *items = state_->items();
+            for (std::size_t i = state_->count; i-- > 0;)
+                std::destroy_at(items + i);
+            state_->count = 0;
+            if (state_->frames == 0)
+                state_->unmap();
+            else
+                state_->orphaned = true;
+            state_ = nullptr;
+        }
+
+        detail::slab_state *state_{nullptr};
+    };
+
+    template <typename Factory>
+        requires std::invocable<Factory &, std::size_t> && coroutine_body<std::invoke_result_t<Factory &, std::size_t>>
+    auto coroutine::create_many(std::size_t n, Factory &&factory, stack_size stack, storage_size storage, slab_options options) noexcept
+        -> std::expected<slab, error>
+    {
+        return slab::create(n, factory, stack, storage, options);
+    }
+
+    // A coroutine whose whole frame (header, context, callable, storage and a StackSize stack)
+    // is this object, so it can be a member, a global or an array element and never touches
+    // the heap. emplace() builds the coroutine in place, as many times as needed; the
+    // frame's alloc/dealloc callbacks only claim and release the inline buffer.
+    //
+    // What it holds is an ordinary coroutine: resume it through ->, or move get() into a
+    // task_runner or generator<T>::from. That hands over the coroutine, not the memory, so
+    // this object must outlive it; once it finishes and is destroyed, emplace() works again.
+    // Not copyable or movable: the frame points into itself.
+    template <std::size_t StackSize, std::size_t StorageSize, typename F>
+    class static_coroutine
+    {
+        static_assert(StackSize >= UCORO_MIN_STACK_SIZE, "StackSize is below min_stack_size");
+        static_assert(coroutine_body<F>, "F must be callable with a coroutine_handle");
+        static_assert(detail::fits_frame<F>, "F is aligned past 16 bytes and would have to be boxed on the heap");
+
+        [[nodiscard]] static constexpr auto layout() noexcept -> detail::mco_desc
+        {
+            detail::mco_desc desc{};
+            desc.storage_size = StorageSize;
+            desc.user_size = sizeof(F);
+            detail::mco_init_desc_sizes(&desc, detail::mco_align_forward(StackSize, 16));
+            desc.coro_size -= detail::mco_frame_slack; // the buffer already starts on a cache line
+            return desc;
+        }
+
+    public:
+        static constexpr std::size_t frame_size = layout().coro_size;
+
+        static_coroutine() noexcept = default;
+
+        // Check valid(): a null function pointer is not built.
+        explicit static_coroutine(F func) noexcept { (void)emplace(std::move(func)); }
+
+        static_coroutine(static_coroutine const &) = delete;
+        auto operator=(static_coroutine const &) -> static_coroutine & = delete;
+
+        ~static_coroutine() = default; // coro_ is declared after frame_: torn down first
+
+        // Builds a fresh coroutine from func, tearing down the one held here first (suspended
+        // or finished, it is simply dropped). invalid_operation while that one is
+        // running, or while a coroutine moved out of get() is still alive.
+        [[nodiscard]] auto emplace(F func) noexcept -> std::expected<void, error>
+        {
+            if (coro_.valid() && coro_.is_running())
+                return std::unexpected{error::invalid_operation};
+            coro_.destroy();
+            if (in_use_)
+                return std::unexpected{error::invalid_operation};
+            detail::mco_desc desc = layout();
+            desc.alloc_cb = &static_coroutine::claim;
+            desc.dealloc_cb = &static_coroutine::release;
+            desc.allocator_data = this;
+            auto made = coroutine::create_with_desc(std::move(func), desc);
+            if (!made)
+                return std::unexpected{made.error()};
+            coro_ = std::move(*made);
+            return {};
+        }
+
+        // Tears down the coroutine held here, if any (not while it runs).
+        void reset() noexcept
+        {
+            if (!coro_.valid() || !coro_.is_running())
+                coro_.destroy();
+        }
+
+        [[nodiscard]] auto get() noexcept -> coroutine & { return coro_; }
+        [[nodiscard]] auto operator*() noexcept -> coroutine & { return coro_; }
+        [[nodiscard]] auto operator->() noexcept -> coroutine * { return &coro_; }
+        [[nodiscard]] auto operator->() const noexcept -> coroutine const * { return &coro_; }
+
+        // Held here, as opposed to never built, torn down, or moved out of get().
+        [[nodiscard]] auto valid() const noexcept -> bool { return coro_.valid(); }
+        [[nodiscard]] explicit operator bool() const noexcept { return valid(); }
+        // The frame holds a live coroutine, here or wherever get() moved it.
+        [[nodiscard]] auto in_use() const noexcept -> bool { return in_use_; }
+
+    private:
+        static auto claim(std::size_t, void *self) noexcept -> void *
+        {
+            auto *sc = static_cast<static_coroutine *>(self);
+            sc->in_use_ = true;
+            return sc->frame_;
+        }
+
+        static void release(void *, std::size_t, void *self) noexcept { static_cast<static_coroutine *>(self)->in_use_ = false; }
+
+        alignas(detail::mco_frame_align) unsigned char frame_[frame_size];
+        bool in_use_{false};
+        coroutine coro_{nullptr, nullptr};
+    };
+
+    template <storable T>
+    class [[nodiscard]] generator
+    {
+    public:
+        class iterator;
+
+        [[nodiscard]] static auto create(std::function<void(coroutine_handle)> func) noexcept -> std::expected<generator, error>
+        {
+            auto coro_result = coroutine::create(std::move(func));
+            if (!coro_result)
+                return std::unexpected{coro_result.error()};
+            return generator{std::move(*coro_result)};
+        }
+
+        // Drives an existing coroutine, e.g. one built in a static_coroutine or a pool.
+        [[nodiscard]] static auto from(coroutine &&coro) noexcept -> std::expected<generator, error>
+        {
+            if (!coro.valid())
+                return std::unexpected{error::invalid_coroutine};
+            return generator{std::move(coro)};
+        }
+
+        [[nodiscard]] auto next() noexcept -> std::expected<std::optional<T>, error>
+        {
+            if (coro_.done())
+                return std::optional<T>{std::nullopt};
+            auto resume_result = coro_.resume();
+            if (!resume_result)
+                return std::unexpected{resume_result.error()};
+            if (coro_.done())
+                return std::optional<T>{std::nullopt};
+            auto value_result = coro_.pop<T>();
+            if (!value_result)
+                return std::unexpected{value_result.error()};
+            return std::optional<T>{std::move(*value_result)};
+        }
+
+        [[nodiscard]] auto done() const noexcept -> bool { return coro_.done(); }
+        [[nodiscard]] auto begin() -> iterator { return iterator{*this}; }
+        [[nodiscard]] static auto end() noexcept -> std::default_sentinel_t { return std::default_sentinel; }
+
+    private:
+        explicit generator(coroutine coro) noexcept : coro_{std::move(coro)} {}
+        coroutine coro_;
+    };
+
+    template <storable T>
+    class generator<T>::iterator
+    {
+    public:
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+
+        explicit iterator(generator &gen) : gen_{&gen} { advance(); }
+        [[nodiscard]] auto operator*() const noexcept -> T const & { return *current_; }
+        auto operator++() -> iterator &
+        {
+            advance();
+            return *this;
+        }
+        auto operator++(int) -> iterator
+        {
+            auto copy = *this;
+            advance();
+            return copy;
+        }
+        [[nodiscard]] auto operator==(std::default_sentinel_t) const noexcept -> bool { return !current_.has_value(); }
+
+    private:
+        void advance()
+        {
+            auto result = gen_->next();
+            if (result && *result)
+                current_ = std::move(**result);
+            else
+                current_ = std::nullopt;
+        }
+        generator *gen_;
+        std::optional<T> current_;
+    };
+
+    template <storable T>
+    [[nodiscard]] inline auto yield_value(coroutine_handle h, T const &value) noexcept -> std::expected<void, error>
+    {
+        auto push_result = h.push(value);
+        if (!push_result)
+            return push_result;
+        return h.yield();
+    }
+
+    // Generator that yields by reference: the producer publishes the address of a value on its
+    // own stack (yield_ref) and the consumer reads it in place while the producer is suspended.
+    // No copies and no storable limit; the reference is valid until the next resume.
+    template <typename T>
+        requires std::is_object_v<T>
+    class [[nodiscard]] ref_generator
+    {
+    public:
+        class iterator;
+
+        template <coroutine_body F>
+        [[nodiscard]] static auto create(F &&func, stack_size stack = default_stack_size) noexcept -> std::expected<ref_generator, error>
+        {
+            auto coro_result = coroutine::create(std::forward<F>(func), stack, storage_size{sizeof(T const *)});
+            if (!coro_result)
+                return std::unexpected{coro_result.error()};
+            return ref_generator{std::move(*coro_result)};
+        }
+
+        // nullptr once the producer has finished
+        [[nodiscard]] auto next() noexcept -> std::expected<T const *, error>
+        {
+            if (coro_.done())
+                return static_cast<T const *>(nullptr);
+            auto resume_result = coro_.resume();
+            if (!resume_result)
+                return std::unexpected{resume_result.error()};
+            if (coro_.done())
+                return static_cast<T const *>(nullptr);
+            return coro_.pop<T const *>();
+        }
+
+        [[nodiscard]] auto done() const noexcept -> bool { return coro_.done(); }
+        [[nodiscard]] auto begin() -> iterator { return iterator{*this}; }
+        [[nodiscard]] static auto end() noexcept -> std::default_sentinel_t { return std::default_sentinel; }
+
+    private:
+        explicit ref_generator(coroutine coro) noexcept : coro_{std::move(coro)} {}
+        coroutine coro_;
+    };
+
+    template <typename T>
+        requires std::is_object_v<T>
+    class ref_generator<T>::iterator
+    {
+    public:
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+
+        explicit iterator(ref_generator &gen) : gen_{&gen} { advance(); }
+        [[nodiscard]] auto operator*() const noexcept -> T const & { return *current_; }
+        [[nodiscard]] auto operator->() const noexcept -> T const * { return current_; }
+        auto operator++() -> iterator &
+        {
+            advance();
+            return *this;
+        }
+        void operator++(int) { advance(); }
+        [[nodiscard]] auto operator==(std::default_sentinel_t) const noexcept -> bool { return current_ == nullptr; }
+
+    private:
+        void advance()
+        {
+            auto result = gen_->next();
+            current_ = result ? *result : nullptr;
+        }
+        ref_generator *gen_;
+        T const *current_{nullptr};
+    };
+
+    // Publishes &value to a ref_generator's consumer and suspends until it asks for the next one.
+    template <typename T>
+    [[nodiscard]] inline auto yield_ref(coroutine_handle h, T const &value) noexcept -> std::expected<void, error>
+    {
+        auto push_result = h.push(std::addressof(value));
+        if (!push_result)
+            return push_result;
+        return h.yield();
+    }
+
+    // Generator that hands out whole batches: the producer appends values to its storage area
+    // (yield_batched) and only switches when it is full, so one context switch moves up to
+    // capacity() values. Each batch is valid until the next call to next().
+    template <storable T>
+    class [[nodiscard]] batch_generator
+    {
+        static_assert(alignof(T) <= 16, "batches are read in place from the 16-byte aligned storage area");
+
+    public:
+        class iterator;
+
+        // storage / sizeof(T) values per batch
+        template <coroutine_body F>
+        [[nodiscard]] static auto create(F &&func, storage_size storage = default_storage_size, stack_size stack = default_stack_size) noexcept -> std::expected<batch_generator, error>
+        {
+            if (storage.value < sizeof(T))
+                return std::unexpected{error::invalid_arguments};
+            auto coro_result = coroutine::create(std::forward<F>(func), stack, storage_size{storage.value - storage.value % sizeof(T)});
+            if (!coro_result)
+                return std::unexpected{coro_result.error()};
+            return batch_generator{std::move(*coro_result)};
+        }
+
+        // Drops the previous batch and returns the next one; empty once the producer is done.
+        [[nodiscard]] auto next() noexcept -> std::expected<std::span<T const>, error>
+        {
+            detail::mco_coro *co = coro_.raw();
+            co->bytes_stored = 0;
+            if (coro_.done())
+                return std::span<T const>{};
+            auto resume_result = coro_.resume();
+            if (!resume_result)
+                return std::unexpected{resume_result.error()};
+            return std::span<T const>{reinterpret_cast<T const *>(co->storage), co->bytes_stored / sizeof(T)};
+        }
+
+        [[nodiscard]] auto capacity() const noexcept -> std::size_t { return coro_.storage_capacity() / sizeof(T); }
+        [[nodiscard]] auto done() const noexcept -> bool { return coro_.done(); }
+        [[nodiscard]] auto begin() -> iterator { return iterator{*this}; }
+        [[nodiscard]] static auto end() noexcept -> std::default_sentinel_t { return std::default_sentinel; }
+
+    private:
+        explicit batch_generator(coroutine coro) noexcept : coro_{std::move(coro)} {}
+        coroutine coro_;
+    };
+
+    // Element-at-a-time view over the batches; only refills cost a context switch.
+    template <storable T>
+    class batch_generator<T>::iterator
+    {
+    public:
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+
+        explicit iterator(batch_generator &gen) : gen_{&gen} { refill(); }
+        [[nodiscard]] auto operator*() const noexcept -> T const & { return batch_[index_]; }
+        auto operator++() -> iterator &
+        {
+            if (++index_ == batch_.size())
+                refill();
+            return *this;
+        }
+        void operator++(int) { ++*this; }
+        [[nodiscard]] auto operator==(std::default_sentinel_t) const noexcept -> bool { return batch_.empty(); }
+
+    private:
+        void refill()
+        {
+            index_ = 0;
+            while (true)
+            {
+                auto result = gen_->next();
+                batch_ = result ? *result : std::span<T const>{};
+                if (!result || !batch_.empty() || gen_->done())
+                    return;
+            }
+        }
+
+        batch_generator *gen_;
+        std::span<T const> batch_{};
+        std::size_t index_{0};
+    };
+
+    // Appends value to the current batch, yielding first if the batch is full.
+    template <storable T>
+    [[nodiscard]] inline auto yield_batched(coroutine_handle h, T const &value) noexcept -> std::expected<void, error>
+    {
+        detail::mco_coro *co = h.raw();
+        if (co == nullptr)
+            return std::unexpected{error::invalid_coroutine};
+        if (co->bytes_stored + sizeof(T) > co->storage_size)
+        {
+            auto yielded = h.yield();
+            if (!yielded)
+                return yielded;
+        }
+        h.push_unchecked(value);
+        return {};
+    }
+
+    // Hands a partially filled batch to the consumer now (e.g. before blocking on input).
+    [[nodiscard]] inline auto flush_batch(coroutine_handle h) noexcept -> std::expected<void, error>
+    {
+        if (!h.valid())
+            return std::unexpected{error::invalid_coroutine};
+        if (h.bytes_stored() == 0)
+            return {};
+        return h.yield();
+    }
+
+    // ============================================================================
+    // Generator Combinators
+    // ============================================================================
+
+    // map, filter, take, zip, enumerate and flatten are single-pass views that run inside the
+    // consumer's iterator: `gen | map(f) | filter(p) | take(n)` still costs one switch per source
+    // element, however deep the chain. They take any input range (every generator kind, each
+    // other, std containers) and model std::ranges::input_range themselves. Like the generators
+    // they wrap, a pipeline must not be moved once begin() has been called.
+
+    namespace detail
+    {
+        // Captured callables (lambdas) are not assignable; views have to be.
+        template <std::move_constructible F>
+        class callable_box
+        {
+        public:
+            explicit callable_box(F fn) noexcept(std::is_nothrow_move_constructible_v<F>) : fn_{std::in_place, std::move(fn)} {}
+
+            callable_box(callable_box const &) = default;
+            callable_box(callable_box &&) = default;
+
+            auto operator=(callable_box const &other) -> callable_box &
+                requires std::copy_constructible<F>
+            {
+                if (this != &other)
+                {
+                    fn_.reset();
+                    fn_.emplace(*other.fn_);
+                }
+                return *this;
+            }
+
+            auto operator=(callable_box &&other) noexcept(std::is_nothrow_move_constructible_v<F>) -> callable_box &
+            {
+                if (this != &other)
+                {
+                    fn_.reset();
+                    fn_.emplace(std::move(*other.fn_));
+                }
+                return *this;
+            }
+
+            [[nodiscard]] auto operator*() noexcept -> F & { return *fn_; }
+
+        private:
+            std::optional<F> fn_;
+        };
+
+        // `range | closure` builds the closure's view over std::views::all(range).
+        template <typename Make>
+        struct range_closure
+        {
+            Make make;
+
+            template <std::ranges::viewable_range R>
+                requires std::invocable<Make const &, std::views::all_t<R>>
+            friend constexpr auto operator|(R &&range, range_closure const &self)
+            {
+                return self.make(std::views::all(std::forward<R>(range)));
+            }
+
+            template <std::ranges::viewable_range R>
+                requires std::invocable<Make, std::views::all_t<R>>
+            friend constexpr auto operator|(R &&range, range_closure &&self)
+            {
+                return std::move(self.make)(std::views::all(std::forward<R>(range)));
+            }
+        };
+
+        template <typename Make>
+        range_closure(Make) -> range_closure<Make>;
+    } // namespace detail
+
+    template <std::ranges::input_range V, std::move_constructible F>
+        requires std::ranges::view<V> && std::invocable<F &, std::ranges::range_reference_t<V>>
+    class map_view : public std::ranges::view_interface<map_view<V, F>>
+    {
+    public:
+        class iterator
+        {
+        public:
+            using iterator_concept = std::input_iterator_tag;
+            using value_type = std::remove_cvref_t<std::invoke_result_t<F &, std::ranges::range_reference_t<V>>>;
+            using difference_type = std::ptrdiff_t;
+
+            explicit iterator(map_view &parent) : parent_{&parent}, cur_{std::ranges::begin(parent.base_)} {}
+
+            [[nodiscard]] auto operator*() const -> decltype(auto) { return std::invoke(*parent_->fn_, *cur_); }
+            auto operator++() -> iterator &
+            {
+                ++cur_;
+                return *this;
+            }
+            void operator++(int) { ++*this; }
+            [[nodiscard]] auto operator==(std::default_sentinel_t) const -> bool { return cur_ == std::ranges::end(parent_->base_); }
+
+        private:
+            map_view *parent_;
+            std::ranges::iterator_t<V> cur_;
+        };
+
+        map_view(V base, F fn) : base_{std::move(base)}, fn_{std::move(fn)} {}
+
+        [[nodiscard]] auto begin() -> iterator { return iterator{*this}; }
+        [[nodiscard]] static auto end() noexcept -> std::default_sentinel_t { return std::default_sentinel; }
+
+    private:
+        V base_;
+        detail::callable_box<F> fn_;
+    };
+
+    template <std::ranges::input_range V, std::move_constructible P>
+        requires std::ranges::view<V> && std::predicate<P &, std::ranges::range_reference_t<V>>
+    class filter_view : public std::ranges::view_interface<filter_view<V, P>>
+    {
+    public:
+        class iterator
+        {
+        public:
+            using iterator_concept = std::input_iterator_tag;
+            using value_type = std::ranges::range_value_t<V>;
+            using difference_type = std::ptrdiff_t;
+
+            explicit iterator(filter_view &parent) : parent_{&parent}, cur_{std::ranges::begin(parent.base_)} { skip(); }
+
+            [[nodiscard]] auto operator*() const -> decltype(auto) { return *cur_; }
+            auto operator++() -> iterator &
+            {
+                ++cur_;
+                skip();
+                return *this;
+            }
+            void operator++(int) { ++*this; }
+            [[nodiscard]] auto operator==(std::default_sentinel_t) const -> bool { return cur_ == std::ranges::end(parent_->base_); }
+
+        private:
+            void skip()
+            {
+                while (cur_ != std::ranges::end(parent_->base_) && !std::invoke(*parent_->pred_, *cur_))
+                    ++cur_;
+            }
+
+            filter_view *parent_;
+            std::ranges::iterator_t<V> cur_;
+        };
+
+        filter_view(V base, P pred) : base_{std::move(base)}, pred_{std::move(pred)} {}
+
+        [[nodiscard]] auto begin() -> iterator { return iterator{*this}; }
+        [[nodiscard]] static auto end() noexcept -> std::default_sentinel_t { return std::default_sentinel; }
+
+    private:
+        V base_;
+        detail::callable_box<P> pred_;
+    };
+
+    // Stops without advancing the source past the n-th element, so a generator is resumed
+    // exactly n times (take(0) does not even begin it).
+    template <std::ranges::input_range V>
+        requires std::ranges::view<V>
+    class take_view : public std::ranges::view_interface<take_view<V>>
+    {
+    public:
+        class iterator
+        {
+        public:
+            using iterator_concept = std::input_iterator_tag;
+            using value_type = std::ranges::range_value_t<V>;
+            using difference_type = std::ptrdiff_t;
+
+            explicit iterator(take_view &parent) : parent_{&parent}, remaining_{parent.count_}
+            {
+                if (remaining_ != 0)
+                    cur_.emplace(std::ranges::begin(parent.base_));
+            }
+
+            [[nodiscard]] auto operator*() const -> decltype(auto) { return **cur_; }
+            auto operator++() -> iterator &
+            {
+                if (--remaining_ != 0)
+                    ++*cur_;
+                return *this;
+            }
+            void operator++(int) { ++*this; }
+            [[nodiscard]] auto operator==(std::default_sentinel_t) const -> bool
+            {
+                return remaining_ == 0 || *cur_ == std::ranges::end(parent_->base_);
+            }
+
+        private:
+            take_view *parent_;
+            std::optional<std::ranges::iterator_t<V>> cur_;
+            std::size_t remaining_;
+        };
+
+        take_view(V base, std::size_t count) : base_{std::move(base)}, count_{count} {}
+
+        [[nodiscard]] auto begin() -> iterator { return iterator{*this}; }
+        [[nodiscard]] static auto end() noexcept -> std::default_sentinel_t { return std::default_sentinel; }
+
+    private:
+        V base_;
+        std::size_t count_;
+    };
+
+    // Elements are (index, reference) pairs; value_type is the same pair, so nothing is copied.
+    template <std::ranges::input_range V>
+        requires std::ranges::view<V>
+    class enumerate_view : public std::ranges::view_interface<enumerate_view<V>>
+    {
+    public:
+        class iterator
+        {
+        public:
+            using iterator_concept = std::input_iterator_tag;
+            using value_type = std::pair<std::size_t, std::ranges::range_reference_t<V>>;
+            using difference_type = std::ptrdiff_t;
+
+            explicit iterator(enumerate_view &parent) : parent_{&parent}, cur_{std::ranges::begin(parent.base_)} {}
+
+            [[nodiscard]] auto operator*() const -> value_type { return value_type{index_, *cur_}; }
+            auto operator++() -> iterator &
+            {
+                ++cur_;
+                ++index_;
+                return *this;
+            }
+            void operator++(int) { ++*this; }
+            [[nodiscard]] auto operator==(std::default_sentinel_t) const -> bool { return cur_ == std::ranges::end(parent_->base_); }
+
+        private:
+            enumerate_view *parent_;
+            std::ranges::iterator_t<V> cur_;
+            std::size_t index_{0};
+        };
+
+        explicit enumerate_view(V base) : base_{std::move(base)} {}
+
+        [[nodiscard]] auto begin() -> iterator { return iterator{*this}; }
+        [[nodiscard]] static auto end() noexcept -> std::default_sentinel_t { return std::default_sentinel; }
+
+    private:
+        V base_;
+    };
+
+    // (left, right) reference pairs; ends with the shorter input.
+    template <std::ranges::input_range V, std::ranges::input_range W>
+        requires std::ranges::view<V> && std::ranges::view<W>
+    class zip_view : public std::ranges::view_interface<zip_view<V, W>>
+    {
+    public:
+        class iterator
+        {
+        public:
+            using iterator_concept = std::input_iterator_tag;
+            using value_type = std::pair<std::ranges::range_reference_t<V>, std::ranges::range_reference_t<W>>;
+            using difference_type = std::ptrdiff_t;
+
+            explicit iterator(zip_view &parent)
+                : parent_{&parent}, left_{std::ranges::begin(parent.left_)}, right_{std::ranges::begin(parent.right_)} {}
+
+            [[nodiscard]] auto operator*() const -> value_type { return value_type{*left_, *right_}; }
+            auto operator++() -> iterator &
+            {
+                ++left_;
+                ++right_;
+                return *this;
+            }
+            void operator++(int) { ++*this; }
+            [[nodiscard]] auto operator==(std::default_sentinel_t) const -> bool
+            {
+                return left_ == std::ranges::end(parent_->left_) || right_ == std::ranges::end(parent_->right_);
+            }
+
+        private:
+            zip_view *parent_;
+            std::ranges::iterator_t<V> left_;
+            std::ranges::iterator_t<W> right_;
+        };
+
+        zip_view(V left, W right) : left_{std::move(left)}, right_{std::move(right)} {}
+
+        [[nodiscard]] auto begin() -> iterator { return iterator{*this}; }
+        [[nodiscard]] static auto end() noexcept -> std::default_sentinel_t { return std::default_sentinel; }
+
+    private:
+        V left_;
+        W right_;
+    };
+
+    // Concatenates the ranges an outer range produces, e.g. a map() that returns a generator per
+    // element. The current inner range lives in the view, so inner generators are owned here.
+    template <std::ranges::input_range V>
+        requires std::ranges::view<V> && std::ranges::input_range<std::ranges::range_reference_t<V>> &&
+                 std::ranges::viewable_range<std::ranges::range_reference_t<V>>
+    class flatten_view : public std::ranges::view_interface<flatten_view<V>>
+    {
+        using inner_view = std::views::all_t<std::ranges::range_reference_t<V>>;
+
+    public:
+        class iterator
+        {
+        public:
+            using iterator_concept = std::input_iterator_tag;
+            using value_type = std::ranges::range_value_t<inner_view>;
+            using difference_type = std::ptrdiff_t;
+
+            explicit iterator(flatten_view &parent) : parent_{&parent} {}
+
+            [[nodiscard]] auto operator*() const -> decltype(auto) { return **parent_->inner_it_; }
+            auto operator++() -> iterator &
+            {
+                parent_->advance();
+                return *this;
+            }
+            void operator++(int) { ++*this; }
+            [[nodiscard]] auto operator==(std::default_sentinel_t) const -> bool { return !parent_->inner_it_; }
+
+        private:
+            flatten_view *parent_;
+        };
+
+        explicit flatten_view(V base) : base_{std::move(base)} {}
+
+        [[nodiscard]] auto begin() -> iterator
+        {
+            outer_.emplace(std::ranges::begin(base_));
+            open_next();
+            return iterator{*this};
+        }
+        [[nodiscard]] static auto end() noexcept -> std::default_sentinel_t { return std::default_sentinel; }
+
+    private:
+        void advance()
+        {
+            if (++*inner_it_ != std::ranges::end(*inner_))
+                return;
+            ++*outer_;
+            open_next();
+        }
+
+        // Moves to the first non-empty inner range at or after *outer_.
+        void open_next()
+        {
+            for (; *outer_ != std::ranges::end(base_); ++*outer_)
+            {
+                inner_it_.reset();
+                inner_.reset();
+                inner_.emplace(std::views::all(**outer_));
+                inner_it_.emplace(std::ranges::begin(*inner_));
+                if (*inner_it_ != std::ranges::end(*inner_))
+                    return;
+            }
+            inner_it_.reset();
+            inner_.reset();
+        }
+
+        V base_;
+        std::optional<std::ranges::iterator_t<V>> outer_;
+        std::optional<inner_view> inner_;
+        std::optional<std::ranges::iterator_t<inner_view>> inner_it_; // empty once exhausted
+    };
+
+    template <typename F>
+    [[nodiscard]] constexpr auto map(F fn)
+    {
+        return detail::range_closure{[fn = std::move(fn)]<typename V>(V base)
+                                     { return map_view<V, F>{std::move(base), fn}; }};
+    }
+
+    template <typename P>
+    [[nodiscard]] constexpr auto filter(P pred)
+    {
+        return detail::range_closure{[pred = std::move(pred)]<typename V>(V base)
+                                     { return filter_view<V, P>{std::move(base), pred}; }};
+    }
+
+    [[nodiscard]] constexpr auto take(std::size_t count)
+    {
+        return detail::range_closure{[count]<typename V>(V base)
+                                     { return take_view<V>{std::move(base), count}; }};
+    }
+
+    [[nodiscard]] constexpr auto enumerate()
+    {
+        return detail::range_closure{[]<typename V>(V base)
+                                     { return enumerate_view<V>{std::move(base)}; }};
+    }
+
+    // Apply the result once: `left | zip(right)`. An lvalue `right` is referenced, an rvalue
+    // (e.g. a generator) is moved into the view.
+    template <std::ranges::viewable_range R>
+    [[nodiscard]] constexpr auto zip(R &&right)
+    {
+        return detail::range_closure{[right = std::views::all(std::forward<R>(right))]<typename V>(V base) mutable
+                                     { return zip_view<V, std::views::all_t<R>>{std::move(base), std::move(right)}; }};
+    }
+
+    [[nodiscard]] constexpr auto flatten()
+    {
+        return detail::range_closure{[]<typename V>(V base)
+                                     { return flatten_view<V>{std::move(base)}; }};
+    }
+
+    // ============================================================================
+    // Typed Coroutines
+    // ============================================================================
+
+    namespace detail
+    {
+        // The whole storage area of a typed coroutine: one request and one response, value
+        // initialised at creation. Both are trivially copyable, so a message is a plain store.
+        template <storable In, storable Out>
+        struct typed_slots
+        {
+            In in{};
+            Out out{};
+        };
+    } // namespace detail
+
+    // The body's view of a typed_coroutine: reads the current request, writes the response.
+    template <storable In, storable Out>
+    class typed_handle
+    {
+    public:
+        constexpr typed_handle() noexcept = default;
+
+        [[nodiscard]] auto receive() const noexcept -> In { return slots_->in; }
+        void send(Out const &value) const noexcept { slots_->out = value; }
+
+        // send(value), suspend, then receive() the next request.
+        [[nodiscard]] auto reply(Out const &value) const noexcept -> std::expected<In, error>
+        {
+            slots_->out = value;
+            auto yielded = handle_.yield();
+            if (!yielded)
+                return std::unexpected{yielded.error()};
+            return slots_->in;
+        }
+
+        [[nodiscard]] auto reply_unchecked(Out const &value) const noexcept -> In
+        {
+            slots_->out = value;
+            handle_.yield_unchecked();
+            return slots_->in;
+        }
+
+        [[nodiscard]] auto yield() const noexcept -> std::expected<void, error> { return handle_.yield(); }
+        // The untyped handle, for channels, timers, cancellation and the like.
+        [[nodiscard]] auto handle() const noexcept -> coroutine_handle { return handle_; }
+
+    private:
+        template <storable, storable>
+        friend class typed_coroutine;
+
+        typed_handle(coroutine_handle h) noexcept
+            : handle_{h}, slots_{reinterpret_cast<detail::typed_slots<In, Out> *>(h.raw()->storage)} {}
+
+        coroutine_handle handle_{};
+        detail::typed_slots<In, Out> *slots_{nullptr};
+    };
+
+    // A coroutine whose storage area is exactly one In and one Out slot, laid out at compile
+    // time. send()/receive() are a store and a load with no bounds checks, and the frame carries
+    // none of the default_storage_size byte buffer. The body is invoked with a typed_handle.
+    template <storable In, storable Out>
+    class [[nodiscard]] typed_coroutine
+    {
+        using slots = detail::typed_slots<In, Out>;
+        static_assert(alignof(slots) <= 16, "slots are placed in the 16-byte aligned storage area");
+
+        template <typename Fn>
+        struct body
+        {
+            Fn fn;
+            void operator()(coroutine_handle h) { fn(typed_handle<In, Out>{h}); }
+        };
+
+    public:
+        template <typename F>
+            requires std::invocable<std::decay_t<F> &, typed_handle<In, Out>> && std::constructible_from<std::decay_t<F>, F>
+        [[nodiscard]] static auto create(F &&func, stack_size stack = default_stack_size) noexcept -> std::expected<typed_coroutine, error>
+        {
+            return adopt(coroutine::create(body<std::decay_t<F>>{std::forward<F>(func)}, stack, storage_size{sizeof(slots)}));
+        }
+
+        // Frames come from alloc, which must outlive the coroutine.
+        template <typename F, stack_allocator Alloc>
+            requires std::invocable<std::decay_t<F> &, typed_handle<In, Out>> && std::constructible_from<std::decay_t<F>, F>
+        [[nodiscard]] static auto create(F &&func, stack_size stack, Alloc &alloc) noexcept -> std::expected<typed_coroutine, error>
+        {
+            return adopt(coroutine::create(body<std::decay_t<F>>{std::forward<F>(func)}, stack, storage_size{sizeof(slots)}, alloc));
+        }
+
+        void send(In const &value) const noexcept { slots_->in = value; }
+        [[nodiscard]] auto receive() const noexcept -> Out { return slots_->out; }
+
+        // send(request), resume, receive(). A body that returns instead of replying leaves the
+        // previous response in place; calling a finished coroutine is error::not_suspended.
+        [[nodiscard]] auto call(In const &request) noexcept -> std::expected<Out, error>
+        {
+            slots_->in = request;
+            auto resumed = coro_.resume();
+            if (!resumed)
+                return std::unexpected{resumed.error()};
+            return slots_->out;
+        }
+
+        [[nodiscard]] auto call_unchecked(In const &request) const noexcept -> Out
+        {
+            slots_->in = request;
+            coro_.resume_unchecked();
+            return slots_->out;
+        }
+
+        [[nodiscard]] auto resume() noexcept -> std::expected<void, error> { return coro_.resume(); }
+        void resume_unchecked() const noexcept { coro_.resume_unchecked(); }
+
+        [[nodiscard]] auto done() const noexcept -> bool { return coro_.done(); }
+        [[nodiscard]] auto suspended() const noexcept -> bool { return coro_.suspended(); }
+        [[nodiscard]] auto handle() const noexcept -> coroutine_handle { return coro_.handle(); }
+        [[nodiscard]] auto raw() const noexcept -> detail::mco_coro * { return coro_.raw(); }
+        [[nodiscard]] auto cancel() const noexcept -> std::expected<void, error> { return coro_.cancel(); }
+        // Moves out the underlying coroutine, e.g. to hand it to a task_runner.
+        [[nodiscard]] auto release() && noexcept -> coroutine { return std::move(coro_); }
+
+    private:
+        explicit typed_coroutine(coroutine coro) noexcept
+            : coro_{std::move(coro)}, slots_{::new (static_cast<void *>(coro_.raw()->storage)) slots{}} {}
+
+        [[nodiscard]] static auto adopt(std::expected<coroutine, error> created) noexcept -> std::expected<typed_coroutine, error>
+        {
+            if (!created)
+                return std::unexpected{created.error()};
+            return typed_coroutine{std::move(*created)};
+        }
+
+        coroutine coro_;
+        slots *slots_;
+    };
+
+    // ============================================================================
+    // Timers
+    // ============================================================================
+
+    namespace detail
+    {
+        // Lives on the sleeping coroutine's stack. slot remembers which list holds it, so
+        // cancel() unlinks in O(1) without searching.
+        struct timer_node
+        {
+            mco_coro *co{nullptr};
+            timer_node *prev{nullptr};
+            timer_node *next{nullptr};
+            std::uint64_t expiry{0}; // in ticks since the wheel's epoch
+            std::uint32_t slot{0};
+            bool linked{false};
+            bool fired{false}; // the timer, not a wake, resumed co
+        };
+
+        // Hierarchical timing wheel: four levels of 64 slots at 1 ms ticks cover ~4.7 hours
+        // directly (later deadlines park in the top level and are re-placed as it turns).
+        // Insert and cancel are O(1); each tick expires one level-0 slot, and every 64th tick
+        // cascades the next level's slot down. An empty wheel skips ahead instead of ticking.
+        class timer_wheel
+        {
+        public:
+            using clock = std::chrono::steady_clock;
+            static constexpr auto resolution = std::chrono::milliseconds{1};
+
+            explicit timer_wheel(clock::time_point epoch = clock::now()) noexcept : epoch_{epoch} {}
+            timer_wheel(timer_wheel const &) = delete;
+            auto operator=(timer_wheel const &) -> timer_wheel & = delete;
+
+            timer_wheel(timer_wheel &&other) noexcept
+                : slots_{other.slots_}, epoch_{other.epoch_}, current_{other.current_}, size_{std::exchange(other.size_, 0)}
+            {
+                other.slots_ = {};
+            }
+
+            auto operator=(timer_wheel &&other) noexcept -> timer_wheel &
+            {
+                if (this != &other)
+                {
+                    slots_ = std::exchange(other.slots_, {});
+                    epoch_ = other.epoch_;
+                    current_ = other.current_;
+                    size_ = std::exchange(other.size_, 0);
+                }
+                return *this;
+            }
+
+            ~timer_wheel() = default;
+
+            // Arms node to fire at the first tick at or after deadline, so never early.
+            void insert(timer_node *node, clock::time_point deadline) noexcept
+            {
+                auto const since = deadline - epoch_;
+                node->expiry = since <= clock::duration::zero()
+                                   ? 0
+                                   : static_cast<std::uint64_t>(std::chrono::ceil<std::chrono::milliseconds>(since).count());
+                node->fired = false;
+                place(node);
+                ++size_;
+            }
+
+            void cancel(timer_node *node) noexcept
+            {
+                if (!node->linked)
+                    return;
+                unlink(node);
+                --size_;
+            }
+
+            // Runs every tick up to now, calling fire(node) for each expired timer (already
+            // unlinked, so fire may re-arm it; one re-armed already due fires on the next tick).
+            // Returns the number fired.
+            template <typename Fire>
+            auto advance(clock::time_point now, Fire &&fire) noexcept -> std::size_t
+            {
+                auto const since = now - epoch_;
+                if (since < clock::duration::zero())
+                    return 0;
+                auto const target = static_cast<std::uint64_t>(std::chrono::floor<std::chrono::milliseconds>(since).count());
+                std::size_t fired = 0;
+                while (current_ <= target)
+                {
+                    if (size_ == 0)
+                    {
+                        current_ = target + 1;
+                        break;
+                    }
+                    fired += tick(fire);
+                    ++current_;
+                }
+                return fired;
+            }
+
+            // Earliest time advance() could fire or cascade anything: exact for timers due
+            // within 64 ticks, otherwise the cascade that brings the next one closer.
+            [[nodiscard]] auto next_deadline() const noexcept -> std::optional<clock::time_point>
+            {
+                if (size_ == 0)
+                    return std::nullopt;
+                std::uint64_t best = UINT64_MAX;
+                for (std::uint64_t k = 0; k < slot_count; ++k)
+                {
+                    if (slots_[index(0, current_ + k)] != nullptr)
+                    {
+                        best = current_ + k;
+                        break;
+                    }
+                }
+                for (unsigned level = 1; level < levels; ++level)
+                {
+                    unsigned const shift = level_bits * level;
+                    std::uint64_t const first = (current_ + (std::uint64_t{1} << shift) - 1) >> shift;
+                    for (std::uint64_t k = 0; k < slot_count; ++k)
+                    {
+                        if (slots_[index(level, first + k)] != nullptr)
+                        {
+                            best = std::min(best, (first + k) << shift);
+                            break;
+                        }
+                    }
+                }
+                return epoch_ + std::chrono::duration_cast<clock::duration>(resolution * best);
+            }
+
+            [[nodiscard]] auto size() const noexcept -> std::size_t { return size_; }
+            [[nodiscard]] auto empty() const noexcept -> bool { return size_ == 0; }
+
+        private:
+            static constexpr unsigned level_bits = 6;
+            static constexpr unsigned levels = 4;
+            static constexpr std::uint64_t slot_count = std::uint64_t{1} << level_bits;
+            static constexpr std::uint64_t slot_mask = slot_count - 1;
+            static constexpr std::uint64_t span = std::uint64_t{1} << (level_bits * levels);
+
+            [[nodiscard]] static constexpr auto index(unsigned level, std::uint64_t block) noexcept -> std::uint32_t
+            {
+                return static_cast<std::uint32_t>(level * slot_count + (block & slot_mask));
+            }
+
+            // Lowest level whose range covers the remaining delay; past-due nodes fire next tick:
+            // current_'s, or the one after while current_'s slot is being fired.
+            void place(timer_node *node) noexcept
+            {
+                std::uint64_t const earliest = current_ + (firing_ ? 1 : 0);
+                std::uint64_t const delta = (node->expiry > earliest ? node->expiry : earliest) - current_;
+                std::uint64_t expiry = delta >= span ? current_ + span - 1 : current_ + delta;
+                unsigned level = 0;
+                while (level + 1 < levels && (expiry - current_) >= (std::uint64_t{1} << (level_bits * (level + 1))))
+                    ++level;
+                link(node, index(level, expiry >> (level_bits * level)));
+            }
+
+            void link(timer_node *node, std::uint32_t slot) noexcept
+            {
+                node->slot = slot;
+                node->prev = nullptr;
+                node->next = slots_[slot];
+                if (node->next != nullptr)
+                    node->next->prev = node;
+                slots_[slot] = node;
+                node->linked = true;
+            }
+
+            void unlink(timer_node *node) noexcept
+            {
+                if (node->prev != nullptr)
+                    node->prev->next = node->next;
+                else
+                    slots_[node->slot] = node->next;
+                if (node->next != nullptr)
+                    node->next->prev = node->prev;
+                node->prev = node->next = nullptr;
+                node->linked = false;
+            }
+
+            // Detaches a slot's whole list so its nodes can be re-placed or fired.
+            [[nodiscard]] auto take(std::uint32_t slot) noexcept -> timer_node *
+            {
+                timer_node *head = std::exchange(slots_[slot], nullptr);
+                for (timer_node *node = head; node != nullptr; node = node->next)
+                    node->linked = false;
+                return head;
+            }
+
+            template <typename Fire>
+            auto tick(Fire &fire) noexcept -> std::size_t
+            {
+                // On a level-0 wrap, pull the next block of each higher level down, stopping
+                // at the first level that didn't wrap as well.
+                if ((current_ & slot_mask) == 0)
+                {
+                    for (unsigned level = 1; level < levels; ++level)
+                    {
+                        std::uint64_t const block = current_ >> (level_bits * level);
+                        for (timer_node *node = take(index(level, block)); node != nullptr;)
+                            place(std::exchange(node, node->next));
+                        if ((block & slot_mask) != 0)
+                            break;
+                    }
+                }
+                std::size_t fired = 0;
+                firing_ = true;
+                for (timer_node *node = take(index(0, current_)); node != nullptr;)
+                {
+                    timer_node *next = node->next;
+                    node->prev = node->next = nullptr;
+                    if (node->expiry <= current_)
+                    {
+                        --size_;
+                        ++fired;
+                        fire(node);
+                    }
+                    else
+                        place(node);
+                    node = next;
+                }
+                firing_ = false;
+                return fired;
+            }
+
+            std::array<timer_node *, levels * slot_count> slots_{};
+            clock::time_point epoch_;
+            std::uint64_t current_{0}; // next tick to process
+            std::size_t size_{0};
+            bool firing_{false}; // current_'s slot is taken: nothing placed there would fire
+        };
+
+        // Work another thread handed to a task_runner: a coroutine to adopt, or one to wake.
+        struct remote_node
+        {
+            remote_node *next{nullptr};
+            mco_coro *wake{nullptr};
+            std::optional<coroutine> spawn{};
+        };
+
+        // Lock-free MPSC inbox. Producers CAS nodes onto a stack; the owner takes the whole
+        // stack with one exchange and reverses it, so each producer's nodes come out in order.
+        class remote_inbox
+        {
+        public:
+            remote_inbox() noexcept = default;
+            remote_inbox(remote_inbox const &) = delete;
+            auto operator=(remote_inbox const &) -> remote_inbox & = delete;
+
+            // Moving is the owner's business: no producer may push meanwhile.
+            remote_inbox(remote_inbox &&other) noexcept : head_{other.head_.exchange(nullptr, std::memory_order_acquire)} {}
+
+            auto operator=(remote_inbox &&other) noexcept -> remote_inbox &
+            {
+                if (this != &other)
+                {
+                    clear();
+                    head_.store(other.head_.exchange(nullptr, std::memory_order_acquire), std::memory_order_release);
+                }
+                return *this;
+            }
+
+            ~remote_inbox() { clear(); }
+
+            void push(remote_node *node) noexcept
+            {
+                remote_node *head = head_.load(std::memory_order_relaxed);
+                do
+                    node->next = head;
+                while (!head_.compare_exchange_weak(head, node, std::memory_order_seq_cst, std::memory_order_relaxed));
+            }
+
+            // Everything pushed so far, oldest first.
+            [[nodiscard]] auto take() noexcept -> remote_node *
+            {
+                remote_node *node = head_.exchange(nullptr, std::memory_order_acquire);
+                remote_node *fifo = nullptr;
+                while (node != nullptr)
+                {
+                    remote_node *next = node->next;
+                    node->next = fifo;
+                    fifo = node;
+                    node = next;
+                }
+                return fifo;
+            }
+
+            [[nodiscard]] auto empty() const noexcept -> bool { return head_.load(std::memory_order_seq_cst) == nullptr; }
+
+        private:
+            void clear() noexcept
+            {
+                for (remote_node *node = take(); node != nullptr;)
+                    delete std::exchange(node, node->next);
+            }
+
+            alignas(64) std::atomic<remote_node *> head_{nullptr};
+        };
+
+        // What an idle task_runner sleeps on. Producers ring() after publishing work: that bumps
+        // the epoch, and only the first ring after the owner fell asleep pays for a wake-up
+        // syscall. The owner arm()s, checks for work once more, then blocks until the epoch
+        // moves. An owner that sleeps in a reactor instead (io::runner) sets a signal, which
+        // replaces the futex wake, e.g. with an eventfd write.
+        class doorbell
+        {
+        public:
+            using signal_fn = void (*)(int fd) noexcept;
+
+            doorbell() noexcept = default;
+            doorbell(doorbell const &) = delete;
+            auto operator=(doorbell const &) -> doorbell & = delete;
+
+            // Like the inbox, moved only while nobody rings.
+            doorbell(doorbell &&other) noexcept : signal_{other.signal_}, signal_fd_{other.signal_fd_} {}
+
+            auto operator=(doorbell &&other) noexcept -> doorbell &
+            {
+                signal_ = other.signal_;
+                signal_fd_ = other.signal_fd_;
+                return *this;
+            }
+
+            ~doorbell() = default;
+
+            void ring() noexcept
+            {
+                epoch_.fetch_add(1, std::memory_order_seq_cst);
+                if (asleep_.load(std::memory_order_seq_cst) && asleep_.exchange(false, std::memory_order_seq_cst))
+                {
+                    if (signal_ != nullptr)
+                        signal_(signal_fd_);
+                    else
+                        mco_futex_wake(&epoch_);
+                }
+            }
+
+            // Marks the owner as about to sleep; returns the epoch to wait() on. Work published
+            // before this is seen by the owner's next check, anything later rings.
+            [[nodiscard]] auto arm() noexcept -> std::uint32_t
+            {
+                asleep_.store(true, std::memory_order_seq_cst);
+                return epoch_.load(std::memory_order_seq_cst);
+            }
+
+            // Blocks until a ring() after arm() returned seen, or until deadline.
+            void wait(std::uint32_t seen, std::optional<std::chrono::steady_clock::time_point> deadline) noexcept
+            {
+                std::int64_t timeout_ns = -1;
+                if (deadline)
+                {
+                    timeout_ns = std::chrono::ceil<std::chrono::nanoseconds>(*deadline - std::chrono::steady_clock::now()).count();
+                    if (timeout_ns <= 0)
+                        return;
+                }
+                mco_futex_wait(&epoch_, seen, timeout_ns);
+            }
+
+            void settle() noexcept { asleep_.store(false, std::memory_order_relaxed); }
+
+            void set_signal(signal_fn signal, int fd) noexcept
+            {
+                signal_ = signal;
+                signal_fd_ = fd;
+            }
+
+        private:
+            alignas(64) std::atomic<std::uint32_t> epoch_{0};
+            std::atomic<bool> asleep_{false};
+            signal_fn signal_{nullptr};
+            int signal_fd_{-1};
+        };
+
+        // Intrusive FIFO of ready frames, threaded through sched_next.
+        class ready_queue
+        {
+        public:
+            void push(mco_coro *co) noexcept
+            {
+                co->sched_next = nullptr;
+                if (tail_ != nullptr)
+                    tail_->sched_next = co;
+                else
+                    head_ = co;
+                tail_ = co;
+            }
+
+            [[nodiscard]] auto pop() noexcept -> mco_coro *
+            {
+                mco_coro *co = head_;
+                if (co == nullptr)
+                    return nullptr;
+                head_ = co->sched_next;
+                if (head_ == nullptr)
+                    tail_ = nullptr;
+                return co;
+            }
+
+            [[nodiscard]] auto front() const noexcept -> mco_coro * { return head_; }
+            [[nodiscard]] auto empty() const noexcept -> bool { return head_ == nullptr; }
+
+        private:
+            mco_coro *head_{nullptr};
+            mco_coro *tail_{nullptr};
+        };
+    } // namespace detail
+
+    // ============================================================================
+    // Scheduling Policies
+    // ============================================================================
+
+    // A basic_task_runner's ready set, chosen at compile time. The runner owns and counts the
+    // tasks; the policy only orders the ready ones. add() stores encode(key) in the frame's
+    // sched_key, which push() reads. front() is what the next pop() returns. pop() may hold
+    // tasks back until next_tick(), which the runner calls at the start of every step() and
+    // when run() finds tasks ready but none poppable. push() must not allocate: reserve(n) is
+    // called from add() with the number of tasks the runner is about to own.
+    template <typename P>
+    concept scheduling_policy =
+        std::default_initializable<P> && std::movable<P> &&
+        requires(P &p, detail::mco_coro *co, std::size_t n, typename P::key_type key) {
+            { P::default_key } -> std::convertible_to<typename P::key_type>;
+            { P::encode(key) } noexcept -> std::same_as<std::uint64_t>;
+            { p.push(co) } noexcept;
+            { p.pop() } noexcept -> std::same_as<detail::mco_coro *>;
+            { p.front() } noexcept -> std::same_as<detail::mco_coro *>;
+            { p.next_tick() } noexcept;
+            p.reserve(n);
+        };
+
+    // Strict priority level; 0 is the most urgent.
+    struct priority
+    {
+        unsigned value;
+        [[nodiscard]] constexpr explicit priority(unsigned v) noexcept : value{v} {}
+    };
+
+    // Which fair_share class a task belongs to.
+    struct share_class
+    {
+        std::size_t value;
+        [[nodiscard]] constexpr explicit share_class(std::size_t v) noexcept : value{v} {}
+    };
+
+    // Insertion order, every task alike.
+    class round_robin
+    {
+    public:
+        using key_type = std::monostate;
+        static constexpr key_type default_key{};
+
+        [[nodiscard]] static constexpr auto encode(key_type) noexcept -> std::uint64_t { return 0; }
+
+        void push(detail::mco_coro *co) noexcept { queue_.push(co); }
+        [[nodiscard]] auto pop() noexcept -> detail::mco_coro * { return queue_.pop(); }
+        [[nodiscard]] auto front() noexcept -> detail::mco_coro * { return queue_.front(); }
+        void next_tick() noexcept {}
+        void reserve(std::size_t) noexcept {}
+
+    private:
+        detail::ready_queue queue_;
+    };
+
+    // Strict priority, FIFO within a level: one queue per level and a bitmap of the non-empty
+    // ones, so push and pop are O(1) however many tasks wait. Out-of-range levels count as the
+    // last one. A level that always has work ready starves every level below it.
+    template <std::size_t Levels = 64>
+        requires(Levels >= 1 && Levels <= 64)
+    class priority_levels
+    {
+    public:
+        using key_type = priority;
+        static constexpr key_type default_key{static_cast<unsigned>(Levels / 2)};
+
+        [[nodiscard]] static constexpr auto encode(key_type key) noexcept -> std::uint64_t
+        {
+            return key.value < Levels ? key.value : Levels - 1;
+        }
+
+        void push(detail::mco_coro *co) noexcept
+        {
+            queues_[co->sched_key].push(co);
+            nonempty_ |= std::uint64_t{1} << co->sched_key;
+        }
+
+        [[nodiscard]] auto pop() noexcept -> detail::mco_coro *
+        {
+            if (nonempty_ == 0)
+                return nullptr;
+            auto const level = static_cast<std::size_t>(std::countr_zero(nonempty_));
+            detail::mco_coro *co = queues_[level].pop();
+            if (queues_[level].empty())
+                nonempty_ &= ~(std::uint64_t{1} << level);
+            return co;
+        }
+
+        [[nodiscard]] auto front() noexcept -> detail::mco_coro *
+        {
+            return nonempty_ == 0 ? nullptr : queues_[static_cast<std::size_t>(std::countr_zero(nonempty_))].front();
+        }
+
+        void next_tick() noexcept {}
+        void reserve(std::size_t) noexcept {}
+
+    private:
+        std::array<detail::ready_queue, Levels> queues_{};
+        std::uint64_t nonempty_{0};
+    };
+
+    // Earliest deadline first: a binary min-heap on each task's deadline, ties (including the
+    // tasks without one, default_key) in FIFO order. O(log n) push and pop. A deadline only
+    // orders tasks; nothing happens to one that misses it.
+    class earliest_deadline
+    {
+    public:
+        using key_type = std::chrono::steady_clock::time_point;
+        static constexpr key_type default_key = key_type::max();
+
+        [[nodiscard]] static constexpr auto encode(key_type key) noexcept -> std::uint64_t
+        {
+            auto const ticks = key.time_since_epoch().count();
+            return ticks < 0 ? 0 : static_cast<std::uint64_t>(ticks);
+        }
+
+        void push(detail::mco_coro *co) noexcept
+        {
+            heap_.push_back({co->sched_key, order_++, co}); // reserve() made room
+            std::ranges::push_heap(heap_, later);
+        }
+
+        [[nodiscard]] auto pop() noexcept -> detail::mco_coro *
+        {
+            if (heap_.empty())
+                return nullptr;
+            std::ranges::pop_heap(heap_, later);
+            detail::mco_coro *co = heap_.back().co;
+            heap_.pop_back();
+            return co;
+        }
+
+        [[nodiscard]] auto front() noexcept -> detail::mco_coro * { return heap_.empty() ? nullptr : heap_.front().co; }
+        void next_tick() noexcept {}
+
+        void reserve(std::size_t tasks)
+        {
+            if (tasks > heap_.capacity())
+                heap_.reserve(std::max(tasks, 2 * heap_.capacity()));
+        }
+
+    private:
+        struct entry
+        {
+            std::uint64_t deadline;
+            std::uint64_t order;
+            detail::mco_coro *co;
+        };
+
+        static constexpr auto later = [](entry const &a, entry const &b) noexcept
+        { return a.deadline != b.deadline ? a.deadline > b.deadline : a.order > b.order; };
+
+        std::vector<entry> heap_;
+        std::uint64_t order_{0};
+    };
+
+    // Weighted fair share between Classes classes of tasks, FIFO within a class. Classes take
+    // turns, each running up to its weight in tasks per turn, so while they are all busy the
+    // resumes split in proportion to the weights. A cap bounds a class's resumes per tick
+    // (one step(); in run(), until every busy class is capped), so however many tasks a bulk
+    // class has queued, the rest of the tick belongs to the others. Out-of-range classes
+    // count as the last one.
+    template <std::size_t Classes = 8>
+        requires(Classes >= 1)
+    class fair_share
+    {
+    public:
+        using key_type = share_class;
+        static constexpr key_type default_key{0};
+
+        [[nodiscard]] static constexpr auto encode(key_type key) noexcept -> std::uint64_t
+        {
+            return key.value < Classes ? key.value : Classes - 1;
+        }
+
+        // weight: resumes per turn; cap: resumes per tick. 0 counts as 1 for both: a class
+        // that could never run would keep run() waiting on it forever.
+        void configure(share_class cls, std::size_t weight, std::size_t cap = SIZE_MAX) noexcept
+        {
+            auto &c = classes_[static_cast<std::size_t>(encode(cls))];
+            c.weight = std::max<std::size_t>(weight, 1);
+            c.cap = std::max<std::size_t>(cap, 1);
+            c.credit = c.weight;
+        }
+
+        void push(detail::mco_coro *co) noexcept { classes_[co->sched_key].queue.push(co); }
+
+        [[nodiscard]] auto pop() noexcept -> detail::mco_coro *
+        {
+            std::size_t const picked = pick();
+            if (picked == Classes)
+                return nullptr;
+            auto &c = classes_[picked];
+            ++c.used;
+            if (--c.credit == 0)
+                turn_ = picked + 1 == Classes ? 0 : picked + 1;
+            return c.queue.pop();
+        }
+
+        [[nodiscard]] auto front() noexcept -> detail::mco_coro *
+        {
+            std::size_t const picked = pick();
+            return picked == Classes ? nullptr : classes_[picked].queue.front();
+        }
+
+        void next_tick() noexcept
+        {
+            for (auto &c : classes_)
+                c.used = 0;
+        }
+
+        void reserve(std::size_t) noexcept {}
+
+    private:
+        struct share
+        {
+            detail::ready_queue queue;
+            std::size_t weight = 1;
+            std::size_t cap = SIZE_MAX;
+            std::size_t credit = 1; // resumes left in this turn
+            std::size_t used = 0;   // resumes this tick
+        };
+
+        // The class whose turn it is, or Classes if none may run. When every class that could
+        // run has spent its turn, all turns are refilled and the scan starts over.
+        [[nodiscard]] auto pick() noexcept -> std::size_t
+        {
+            for (int round = 0; round < 2; ++round)
+            {
+                bool runnable = false;
+                for (std::size_t i = 0; i < Classes; ++i)
+                {
+                    std::size_t const at = turn_ + i < Classes ? turn_ + i : turn_ + i - Classes;
+                    auto const &c = classes_[at];
+                    if (c.queue.empty() || c.used >= c.cap)
+                        continue;
+                    if (c.credit != 0)
+                    {
+                        turn_ = at;
+                        return at;
+                    }
+                    runnable = true;
+                }
+                if (!runnable)
+                    break;
+                for (auto &c : classes_)
+                    c.credit = c.weight;
+            }
+            return Classes;
+        }
+
+        std::array<share, Classes> classes_{};
+        std::size_t turn_{0};
+    };
+
+    namespace io
+    {
+        class runner;
+    }
+
+    // Cooperative scheduler. Ready coroutines are held by the Policy: round_robin (task_runner)
+    // keeps an intrusive FIFO threaded through their frames; parked ones are on no list at all,
+    // so they cost nothing per tick until wake() re-queues them. Finished tasks are removed
+    // with swap-and-pop. Sleepers (sleep_for, park_for) are parked too, with a node in the
+    // runner's timer wheel. Everything runs on the owning thread; other threads reach it only
+    // through post() and wake_remote(), which go through a lock-free inbox drained at the top
+    // of every tick.
+    template <scheduling_policy Policy>
+    class basic_task_runner
+    {
+    public:
+        using policy_type = Policy;
+        using key_type = typename Policy::key_type;
+
+        basic_task_runner() noexcept = default;
+        basic_task_runner(basic_task_runner const &) = delete;
+        auto operator=(basic_task_runner const &) -> basic_task_runner & = delete;
+
+        basic_task_runner(basic_task_runner &&other) noexcept
+            : tasks_{std::move(other.tasks_)},
+              policy_{std::exchange(other.policy_, Policy{})},
+              ready_{std::exchange(other.ready_, 0)},
+              parked_{std::exchange(other.parked_, 0)},
+              timers_{std::move(other.timers_)},
+              peak_hook_{std::move(other.peak_hook_)},
+              stats_hook_{std::move(other.stats_hook_)},
+              inbox_{std::move(other.inbox_)},
+              bell_{std::move(other.bell_)}
+        {
+            adopt();
+        }
+
+        auto operator=(basic_task_runner &&other) noexcept -> basic_task_runner &
+        {
+            if (this != &other)
+            {
+                tasks_ = std::move(other.tasks_);
+                policy_ = std::exchange(other.policy_, Policy{});
+                ready_ = std::exchange(other.ready_, 0);
+                parked_ = std::exchange(other.parked_, 0);
+                timers_ = std::move(other.timers_);
+                peak_hook_ = std::move(other.peak_hook_);
+                stats_hook_ = std::move(other.stats_hook_);
+                inbox_ = std::move(other.inbox_);
+                bell_ = std::move(other.bell_);
+                adopt();
+            }
+            return *this;
+        }
+
+        ~basic_task_runner() = default;
+
+        auto add(coroutine &&coro) -> basic_task_runner & { return add(std::move(coro), Policy::default_key); }
+
+        // add() with the policy's key: a priority, a deadline, a share_class.
+        auto add(coroutine &&coro, key_type key) -> basic_task_runner &
+        {
+            if (coro.valid() && !coro.done())
+            {
+                coro.raw()->sched_key = Policy::encode(key);
+                enroll(std::move(coro));
+            }
+            return *this;
+        }
+
+        // Runs until no task is ready: all finished, or the rest are parked. While only
+        // sleepers remain, the thread sleeps until the next one is due, or until another
+        // thread post()s or wake_remote()s.
+        [[nodiscard]] auto run() noexcept -> std::expected<void, error>
+        {
+            return run_loop(nullptr);
+        }
+
+        // run() for a runner fed from other threads: with nothing ready it sleeps on the inbox's
+        // doorbell (no longer than the next sleeper is due) instead of returning, until stop is
+        // requested. Tasks still unfinished then are kept.
+        [[nodiscard]] auto run(std::stop_token stop) noexcept -> std::expected<void, error>
+        {
+            std::stop_callback const ring_on_stop{stop, [this]() noexcept
+                                                  { bell_.ring(); }};
+            return run_loop(&stop);
+        }
+
+        // Resumes every task that was ready when the step began (after adopting what other
+        // threads posted and waking the sleepers now due); true while tasks remain. Never
+        // sleeps: see next_deadline().
+        [[nodiscard]] auto step() noexcept -> std::expected<bool, error>
+        {
+            if (auto drained = drain_remote(); !drained)
+                return std::unexpected{drained.error()};
+            expire_timers();
+            policy_.next_tick();
+            // handoffs draw from the same budget, so tasks woken during the step still wait
+            for (budget_ = ready_; budget_ != 0;)
+            {
+                --budget_;
+                detail::mco_coro *co = pop_ready();
+                if (co == nullptr)
+                    break;
+                auto result = resume_one(co);
+                if (!result)
+                    return std::unexpected{result.error()};
+            }
+            return !tasks_.empty();
+        }
+
+        // Re-queues a parked task (h.park()); a task that isn't parked yet skips its next park.
+        [[nodiscard]] auto wake(coroutine_handle h) noexcept -> std::expected<void, error>
+        {
+            detail::mco_coro *co = h.raw();
+            if (co == nullptr)
+                return std::unexpected{error::invalid_coroutine};
+            if (co->scheduler != &hook_)
+                return std::unexpected{error::invalid_operation};
+            (void)detail::mco_wake(co);
+            return {};
+        }
+
+        // Thread-safe add(): the coroutine is adopted on the owning thread at the start of its
+        // next tick, and a runner sleeping in run() wakes for it. out_of_memory if the inbox
+        // node can't be allocated (coro is dropped). If the runner then has no room to adopt it,
+        // it is dropped there and that tick's step() or run() returns out_of_memory.
+        [[nodiscard]] auto post(coroutine &&coro) noexcept -> std::expected<void, error>
+        {
+            return post(std::move(coro), Policy::default_key);
+        }
+
+        // post() with the policy's key.
+        [[nodiscard]] auto post(coroutine &&coro, key_type key) noexcept -> std::expected<void, error>
+        {
+            if (!coro.valid() || coro.done())
+                return std::unexpected{error::invalid_coroutine};
+            coro.raw()->sched_key = Policy::encode(key);
+            auto *node = new (std::nothrow) detail::remote_node{.spawn = std::move(coro)};
+            if (node == nullptr)
+                return std::unexpected{error::out_of_memory};
+            inbox_.push(node);
+            bell_.ring();
+            return {};
+        }
+
+        // Creates the coroutine on the calling thread, then post()s it.
+        template <coroutine_body F>
+        [[nodiscard]] auto post(F &&func) noexcept -> std::expected<void, error>
+        {
+            auto coro = coroutine::create(std::forward<F>(func));
+            if (!coro)
+                return std::unexpected{coro.error()};
+            return post(std::move(*coro));
+        }
+
+        // Thread-safe wake(), applied on the owning thread at the start of its next tick. h must
+        // still be alive then, so only wake a task that waits for exactly this wake (e.g. it
+        // parked after handing its handle to the other thread). A handle that isn't this
+        // runner's by then is ignored.
+        [[nodiscard]] auto wake_remote(coroutine_handle h) noexcept -> std::expected<void, error>
+        {
+            if (h.raw() == nullptr)
+                return std::unexpected{error::invalid_coroutine};
+            auto *node = new (std::nothrow) detail::remote_node{.wake = h.raw()};
+            if (node == nullptr)
+                return std::unexpected{error::out_of_memory};
+            inbox_.push(node);
+            bell_.ring();
+            return {};
+        }
+
+        // Changes a task's key, e.g. its next deadline. It applies from the next time the task is
+        // queued: when it yields or is woken, not while it already waits in the ready set.
+        [[nodiscard]] auto set_key(coroutine_handle h, key_type key) noexcept -> std::expected<void, error>
+        {
+            detail::mco_coro *co = h.raw();
+            if (co == nullptr)
+                return std::unexpected{error::invalid_coroutine};
+            if (co->scheduler != &hook_)
+                return std::unexpected{error::invalid_operation};
+            co->sched_key = Policy::encode(key);
+            return {};
+        }
+
+        // The ready set, e.g. to configure() a fair_share.
+        [[nodiscard]] auto policy() noexcept -> Policy & { return policy_; }
+        [[nodiscard]] auto policy() const noexcept -> Policy const & { return policy_; }
+
+        // Makes room for `tasks` tasks up front, so add() doesn't allocate after startup.
+        void reserve(std::size_t tasks)
+        {
+            tasks_.reserve(tasks);
+            policy_.reserve(tasks);
+        }
+
+        // h.cancel() for every task: parked ones are re-queued to unwind on the next run()/step().
+        void cancel_all() noexcept
+        {
+            for (auto &task : tasks_)
+                detail::mco_cancel(task.raw());
+        }
+
+        [[nodiscard]] auto size() const noexcept -> std::size_t { return tasks_.size(); }
+        [[nodiscard]] auto empty() const noexcept -> bool { return tasks_.empty(); }
+        [[nodiscard]] auto ready() const noexcept -> std::size_t { return ready_; }
+        [[nodiscard]] auto parked() const noexcept -> std::size_t { return parked_; }
+        [[nodiscard]] auto sleeping() const noexcept -> std::size_t { return timers_.size(); }
+
+        // When the next sleeper may be due (possibly already past), or nullopt with none armed.
+        // An event loop driving step() blocks in its poller for at most this long.
+        [[nodiscard]] auto next_deadline() const noexcept -> std::optional<std::chrono::steady_clock::time_point>
+        {
+            return timers_.next_deadline();
+        }
+
+        // Reports each finished task's stack_peak() (UCORO_STACK_PAINT builds only).
+        void on_stack_peak(stack_peak_hook callback) noexcept { peak_hook_ = std::move(callback); }
+
+        // Reports each finished task's stats() (UCORO_INSTRUMENT builds only), e.g. to total the
+        // CPU time per trace name.
+        void on_task_stats(stats_hook callback) noexcept { stats_hook_ = std::move(callback); }
+
+    private:
+        friend class io::runner; // sleeps in its reactor, so it rings the doorbell its own way
+
+        struct hook : detail::mco_scheduler
+        {
+            explicit hook(basic_task_runner *runner) noexcept
+                : detail::mco_scheduler{&hook::on_wake, &hook::on_handoff, &runner->timers_}, owner{runner} {}
+
+            static void on_wake(detail::mco_scheduler *self, detail::mco_coro *co) noexcept
+            {
+                auto *runner = static_cast<hook *>(self)->owner;
+                --runner->parked_;
+                runner->push_ready(co);
+            }
+
+            // The parking task transfers straight into the next ready one. Count it as parked here,
+            // since resume_one only sees whichever task finally yields back to it.
+            static auto on_handoff(detail::mco_scheduler *self, detail::mco_coro *from) noexcept -> detail::mco_coro *
+            {
+                auto *runner = static_cast<hook *>(self)->owner;
+                if (from != runner->current_ || runner->budget_ == 0)
+                    return nullptr;
+                detail::mco_coro *next = runner->policy_.front();
+                if (next == nullptr || !detail::mco_can_enter(next))
+                    return nullptr;
+                // attach a lazy or shared stack while declining is still possible; if it fails,
+                // the loop's resume of next reports it
+                if (next->stack_base == nullptr && detail::mco_attach_stack(next) != detail::mco_result::success)
+                    return nullptr;
+                (void)runner->pop_ready();
+                --runner->budget_;
+                ++runner->parked_;
+                runner->current_ = next;
+                return next;
+            }
+
+            basic_task_runner *owner;
+        };
+
+        [[nodiscard]] auto run_loop(std::stop_token const *stop) noexcept -> std::expected<void, error>
+        {
+            budget_ = SIZE_MAX;
+            while (stop == nullptr || !stop->stop_requested())
+            {
+                if (auto drained = drain_remote(); !drained)
+                    return drained;
+                expire_timers();
+                detail::mco_coro *co = pop_ready();
+                if (co == nullptr && ready_ != 0)
+                {
+                    policy_.next_tick(); // every ready task is held back until the next tick
+                    continue;
+                }
+                if (co == nullptr)
+                {
+                    auto const deadline = timers_.next_deadline();
+                    if (!deadline && stop == nullptr)
+                        return {};
+                    idle(deadline, stop);
+                    continue;
+                }
+                auto result = resume_one(co);
+                if (!result)
+                    return result;
+            }
+            return {};
+        }
+
+        // Sleeps until another thread posts or wakes, stop is requested, or deadline passes.
+        void idle(std::optional<std::chrono::steady_clock::time_point> deadline, std::stop_token const *stop) noexcept
+        {
+            auto const seen = bell_.arm();
+            if (inbox_.empty() && (stop == nullptr || !stop->stop_requested()))
+                bell_.wait(seen, deadline);
+            bell_.settle();
+        }
+
+        // Adopts what other threads posted and wakes the tasks they woke, in arrival order. A
+        // posted coroutine there is no memory to adopt is dropped; the rest of the inbox is still
+        // applied, then out_of_memory reports it.
+        [[nodiscard]] auto drain_remote() noexcept -> std::expected<void, error>
+        {
+            if (inbox_.empty())
+                return {};
+            bool dropped = false;
+            for (detail::remote_node *node = inbox_.take(); node != nullptr;)
+            {
+                std::unique_ptr<detail::remote_node> const owned{std::exchange(node, node->next)};
+                if (owned->spawn)
+                {
+#if defined(__cpp_exceptions)
+                    try
+                    {
+                        enroll(std::move(*owned->spawn)); // keyed by post()
+                    }
+                    catch (std::bad_alloc const &)
+                    {
+                        dropped = true;
+                    }
+#else
+                    enroll(std::move(*owned->spawn));
+#endif
+                }
+                else if (owned->wake->scheduler == &hook_)
+                    (void)detail::mco_wake(owned->wake);
+            }
+            if (dropped)
+                return std::unexpected{error::out_of_memory};
+            return {};
+        }
+
+        // Wakes sleepers that are due. One that a wake() already re-queued isn't woken twice
+        // (that would leave a stray notification), and its node reports it wasn't the timer.
+        void expire_timers() noexcept
+        {
+            if (timers_.empty())
+                return;
+            (void)timers_.advance(detail::timer_wheel::clock::now(), [](detail::timer_node *node) noexcept
+                                  {
+                                      if ((node->co->sched_flags & detail::mco_sched_parked) == 0)
+                                          return;
+                                      node->fired = true;
+                                      (void)detail::mco_wake(node->co); });
+        }
+
+        void enroll(coroutine &&coro)
+        {
+            if (!coro.valid() || coro.done())
+                return;
+            // both allocations come first: if either throws, nothing here has changed
+            policy_.reserve(tasks_.size() + 1);
+            detail::mco_coro *co = coro.raw();
+            tasks_.push_back(std::move(coro));
+            co->scheduler = &hook_;
+            co->sched_index = tasks_.size() - 1;
+            co->sched_flags = 0;
+            push_ready(co);
+        }
+
+        void push_ready(detail::mco_coro *co) noexcept
+        {
+            policy_.push(co);
+            ++ready_;
+        }
+
+        [[nodiscard]] auto pop_ready() noexcept -> detail::mco_coro *
+        {
+            detail::mco_coro *co = policy_.pop();
+            if (co != nullptr)
+                --ready_;
+            return co;
+        }
+
+        [[nodiscard]] auto resume_one(detail::mco_coro *co) noexcept -> std::expected<void, error>
+        {
+            current_ = co;
+            auto result = tasks_[co->sched_index].resume();
+            co = std::exchange(current_, nullptr); // differs from the resumed task after a handoff
+            coroutine &task = tasks_[co->sched_index];
+            if (!result && result.error() != error::not_suspended)
+            {
+                push_ready(co);
+                return result;
+            }
+            if (task.done())
+            {
+                if constexpr (stack_painting)
+                {
+                    if (peak_hook_)
+                        peak_hook_(task.handle(), detail::mco_stack_peak(co));
+                }
+                if constexpr (instrumented)
+                {
+                    if (stats_hook_)
+                        stats_hook_(task.handle(), *task.stats());
+                }
+                remove(co->sched_index);
+            }
+            else if ((co->sched_flags & detail::mco_sched_parked) != 0)
+                ++parked_;
+            else
+                push_ready(co);
+            return {};
+        }
+
+        void remove(std::size_t index) noexcept
+        {
+            tasks_[index].raw()->scheduler = nullptr;
+            if (index + 1 != tasks_.size())
+            {
+                tasks_[index] = std::move(tasks_.back());
+                tasks_[index].raw()->sched_index = index;
+            }
+            tasks_.pop_back();
+        }
+
+        // Coroutines point back at hook_; re-point them after the runner moved.
+        void adopt() noexcept
+        {
+            for (auto &task : tasks_)
+                task.raw()->scheduler = &hook_;
+        }
+
+        std::vector<coroutine> tasks_;
+        hook hook_{this};
+        Policy policy_;
+        detail::mco_coro *current_{nullptr}; // task whose yield will come back to resume_one
+        std::size_t budget_{0};              // resumptions left in this run()/step()
+        std::size_t ready_{0};
+        std::size_t parked_{0};
+        detail::timer_wheel timers_;
+        stack_peak_hook peak_hook_;
+        stats_hook stats_hook_;
+        detail::remote_inbox inbox_;
+        detail::doorbell bell_;
+    };
+
+    using task_runner = basic_task_runner<round_robin>;
+
+    // Suspends h on its task_runner until deadline. It is parked, not yielding, so it isn't
+    // resumed at all before then; a wake() in between is absorbed and the sleep carries on.
+    // invalid_operation outside a scheduler with timers; a past deadline returns at once.
+    // cancel() ends the sleep early with error::cancelled.
+    [[nodiscard]] inline auto sleep_until(coroutine_handle h, std::chrono::steady_clock::time_point deadline) noexcept
+        -> std::expected<void, error>
+    {
+        detail::mco_coro *co = h.raw();
+        if (co == nullptr)
+            return std::unexpected{error::invalid_coroutine};
+        if (co->scheduler == nullptr || co->scheduler->timers == nullptr)
+            return std::unexpected{error::invalid_operation};
+        if (co->cancelled)
+            return std::unexpected{error::cancelled};
+        detail::timer_node node{.co = co};
+        while (std::chrono::steady_clock::now() < deadline)
+        {
+            // re-read the wheel each time: the runner may have moved while we slept
+            if (!node.linked)
+                co->scheduler->timers->insert(&node, deadline);
+            auto const result = detail::mco_park_pinned(co);
+            if (result != detail::mco_result::success)
+            {
+                co->scheduler->timers->cancel(&node);
+                return std::unexpected{from_impl_result(result)};
+            }
+        }
+        co->scheduler->timers->cancel(&node);
+        return {};
+    }
+
+    template <typename Rep, typename Period>
+    [[nodiscard]] inline auto sleep_for(coroutine_handle h, std::chrono::duration<Rep, Period> duration) noexcept
+        -> std::expected<void, error>
+    {
+        return sleep_until(h, std::chrono::steady_clock::now() + std::chrono::ceil<std::chrono::steady_clock::duration>(duration));
+    }
+
+    // h.park() with a deadline: success once woken, error::timeout if the deadline passed
+    // first. The timer is disarmed either way, so a late wake only sets up the next park.
+    [[nodiscard]] inline auto park_until(coroutine_handle h, std::chrono::steady_clock::time_point deadline) noexcept
+        -> std::expected<void, error>
+    {
+        detail::mco_coro *co = h.raw();
+        if (co == nullptr)
+            return std::unexpected{error::invalid_coroutine};
+        if (co->scheduler == nullptr || co->scheduler->timers == nullptr)
+            return std::unexpected{error::invalid_operation};
+        if (co->cancelled)
+            return std::unexpected{error::cancelled};
+        if ((co->sched_flags & detail::mco_sched_notified) != 0)
+        {
+            co->sched_flags &= ~detail::mco_sched_notified; // the wake already came
+            return {};
+        }
+        if (std::chrono::steady_clock::now() >= deadline)
+            return std::unexpected{error::timeout};
+        detail::timer_node node{.co = co};
+        co->scheduler->timers->insert(&node, deadline);
+        auto const result = detail::mco_park_pinned(co);
+        co->scheduler->timers->cancel(&node);
+        if (result != detail::mco_result::success)
+            return std::unexpected{from_impl_result(result)};
+        if (node.fired)
+            return std::unexpected{error::timeout};
+        return {};
+    }
+
+    template <typename Rep, typename Period>
+    [[nodiscard]] inline auto park_for(coroutine_handle h, std::chrono::duration<Rep, Period> duration) noexcept
+        -> std::expected<void, error>
+    {
+        return park_until(h, std::chrono::steady_clock::now() + std::chrono::ceil<std::chrono::steady_clock::duration>(duration));
+    }
+
+    // ============================================================================
+    // Thread Pool Runner
+    // ============================================================================
+
+    namespace detail
+    {
+        // Chase-Lev deque. The owner pushes at the bottom; everyone, the owner included, takes
+        // from the top, so each worker round-robins its own tasks oldest-first and steals the
+        // same way. Capacity is fixed at run() to cover every task, so it never has to grow.
+        template <typename T>
+        class work_stealing_deque
+        {
+        public:
+            explicit work_stealing_deque(std::size_t capacity)
+                : slots_(std::bit_ceil(capacity < 2 ? std::size_t{2} : capacity)), mask_{slots_.size() - 1} {}
+
+            void push(T *item) noexcept
+            {
+                auto const b = bottom_.load(std::memory_order_relaxed);
+                slots_[static_cast<std::size_t>(b) & mask_].store(item, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_release);
+                bottom_.store(b + 1, std::memory_order_relaxed);
+            }
+
+            [[nodiscard]] auto steal() noexcept -> T *
+            {
+                auto t = top_.load(std::memory_order_acquire);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                auto const b = bottom_.load(std::memory_order_acquire);
+                if (t >= b)
+                    return nullptr;
+                T *item = slots_[static_cast<std::size_t>(t) & mask_].load(std::memory_order_relaxed);
+                if (!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                    return nullptr;
+                return item;
+            }
+
+        private:
+            std::vector<std::atomic<T *>> slots_;
+            std::size_t mask_;
+            alignas(64) std::atomic<std::int64_t> top_{0};
+            alignas(64) std::atomic<std::int64_t> bottom_{0};
+        };
+    } // namespace detail
+
+    // Runs coroutines on N threads, one work-stealing deque per worker; the thread calling run()
+    // is worker 0. A yielded coroutine may be resumed on another worker, so task code must
+    // not cache thread-local state across yields. Don't add() while run() is in progress.
+    // An idle worker steals from workers on its own NUMA node before crossing to another, so
+    // stacks from a caller_node numa_stack_allocator tend to stay local. The node is read once
+    // per run(): pin the workers (or the process) for it to be more than a hint.
+    // A finished frame is freed on whichever worker ran it last, and lazy stacks are released
+    // there too, so the allocator behind every task must be thread-safe. Coroutines spawned
+    // from a pool or a scope, or carved from an arena_allocator, must not be added: their
+    // free lists aren't synchronized.
+    class thread_pool_runner
+    {
+    public:
+        explicit thread_pool_runner(std::size_t workers = std::thread::hardware_concurrency()) noexcept
+            : workers_{workers == 0 ? std::size_t{1} : workers} {}
+
+        auto add(coroutine &&coro) -> thread_pool_runner &
+        {
+            if (coro.valid() && !coro.done())
+                tasks_.push_back(std::move(coro));
+            return *this;
+        }
+
+        // Returns once every task has finished, or with the first error any worker hit
+        // (unfinished tasks are kept and can be run again).
+        [[nodiscard]] auto run() noexcept -> std::expected<void, error>
+        {
+            std::erase_if(tasks_, [](coroutine const &c)
+                          { return !c.valid() || c.done(); });
+            if (tasks_.empty())
+                return {};
+
+            std::size_t const count = std::min(workers_, tasks_.size());
+            shared state{tasks_.size(), count};
+            state.queues.reserve(count);
+            for (std::size_t i = 0; i < count; ++i)
+                state.queues.push_back(std::make_unique<detail::work_stealing_deque<coroutine>>(tasks_.size()));
+            for (std::size_t i = 0; i < tasks_.size(); ++i)
+                state.queues[i % count]->push(&tasks_[i]);
+
+            std::vector<std::thread> threads;
+            threads.reserve(count - 1);
+            for (std::size_t i = 1; i < count; ++i)
+                threads.emplace_back([&state, i]
+                                     { work(state, i); });
+            work(state, 0);
+            for (auto &t : threads)
+                t.join();
+
+            std::erase_if(tasks_, [](coroutine const &c)
+                          { return !c.valid(); });
+            if (state.failure.load(std::memory_order_relaxed) != error::success)
+                return std::unexpected{state.failure.load(std::memory_order_relaxed)};
+            return {};
+        }
+
+        [[nodiscard]] auto size() const noexcept -> std::size_t { return tasks_.size(); }
+        [[nodiscard]] auto empty() const noexcept -> bool { return tasks_.empty(); }
+        [[nodiscard]] auto worker_count() const noexcept -> std::size_t { return workers_; }
+
+    private:
+        struct shared
+        {
+            shared(std::size_t tasks, std::size_t workers) : nodes(workers), remaining{tasks}
+            {
+                for (auto &n : nodes)
+                    n.store(-1, std::memory_order_relaxed); // not started: belongs to no node
+            }
+
+            std::vector<std::unique_ptr<detail::work_stealing_deque<coroutine>>> queues;
+            std::vector<std::atomic<int>> nodes;
+            std::atomic<std::size_t> remaining;
+            std::atomic<error> failure{error::success};
+            // Idle workers sleep on epoch; it moves when a task is pushed back while someone
+            // sleeps (wakes one) and when the run ends (wakes all).
+            alignas(64) std::atomic<std::uint32_t> epoch{0};
+            std::atomic<std::size_t> sleepers{0};
+        };
+
+        // Rounds an idle worker polls the other queues before it goes to sleep.
+        static constexpr int idle_spins = 64;
+
+        static void push_back(shared &state, detail::work_stealing_deque<coroutine> &own, coroutine *task) noexcept
+        {
+            own.push(task);
+            // pairs with the fence in idle(): a sleeper either sees the task or is counted here
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (state.sleepers.load(std::memory_order_relaxed) != 0)
+            {
+                state.epoch.fetch_add(1, std::memory_order_release);
+                state.epoch.notify_one();
+            }
+        }
+
+        static void finish(shared &state) noexcept
+        {
+            state.epoch.fetch_add(1, std::memory_order_release);
+            state.epoch.notify_all();
+        }
+
+        [[nodiscard]] static auto running(shared const &state) noexcept -> bool
+        {
+            return state.remaining.load(std::memory_order_acquire) != 0 &&
+                   state.failure.load(std::memory_order_relaxed) == error::success;
+        }
+
+        // Takes a task from this worker's queue, else from a worker on this node, else from
+        // anyone; nullptr if every queue is empty.
+        [[nodiscard]] static auto find(shared &state, std::size_t self, std::size_t &victim, int node) noexcept -> coroutine *
+        {
+            coroutine *task = state.queues[self]->steal();
+            std::size_t const count = state.queues.size();
+            // first pass: workers on this node; second: everyone else
+            for (int pass = 0; task == nullptr && pass < 2; ++pass)
+            {
+                for (std::size_t tries = 1; task == nullptr && tries < count; ++tries)
+                {
+                    victim = victim + 1 == count ? 0 : victim + 1;
+                    bool const local = state.nodes[victim].load(std::memory_order_relaxed) == node;
+                    if (victim != self && local == (pass == 0))
+                        task = state.queues[victim]->steal();
+                }
+            }
+            return task;
+        }
+
+        // Polls for idle_spins rounds, then sleeps until a task is pushed back or the run ends,
+        // so one long task doesn't keep every other worker spinning.
+        [[nodiscard]] static auto idle(shared &state, std::size_t self, std::size_t &victim, int node) noexcept -> coroutine *
+        {
+            for (int spin = 0; spin < idle_spins; ++spin)
+            {
+                std::this_thread::yield();
+                if (!running(state))
+                    return nullptr;
+                if (coroutine *task = find(state, self, victim, node))
+                    return task;
+            }
+            for (;;)
+            {
+                std::uint32_t const seen = state.epoch.load(std::memory_order_acquire);
+                state.sleepers.fetch_add(1, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                coroutine *task = running(state) ? find(state, self, victim, node) : nullptr;
+                if (task == nullptr && running(state))
+                    state.epoch.wait(seen, std::memory_order_acquire);
+                state.sleepers.fetch_sub(1, std::memory_order_relaxed);
+                if (task != nullptr || !running(state))
+                    return task;
+                if ((task = find(state, self, victim, node)) != nullptr)
+                    return task;
+            }
+        }
+
+        static void work(shared &state, std::size_t self) noexcept
+        {
+            auto &own = *state.queues[self];
+            std::size_t victim = self;
+            int const node = detail::mco_numa_node();
+            state.nodes[self].store(node, std::memory_order_relaxed);
+
+            while (running(state))
+            {
+                coroutine *task = find(state, self, victim, node);
+                if (task == nullptr && (task = idle(state, self, victim, node)) == nullptr)
+                    continue;
+
+                auto result = task->resume();
+                if (!result && result.error() != error::not_suspended)
+                {
+                    auto expected = error::success;
+                    state.failure.compare_exchange_strong(expected, result.error(), std::memory_order_relaxed);
+                    own.push(task);
+                    finish(state);
+                    continue;
+                }
+                if (task->done())
+                {
+                    {
+                        coroutine finished{std::move(*task)}; // frees the frame on this worker
+                    }
+                    if (state.remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                        finish(state);
+                }
+                else
+                {
+                    push_back(state, own, task);
+                }
+            }
         }
 
-        [[nodiscard]] auto run() noexcept -> std::expected<void, error>
+        std::size_t workers_;
+        std::vector<coroutine> tasks_;
+    };
+
+    // ============================================================================
+    // Channels
+    // ============================================================================
+
+    namespace detail
+    {
+        // The part of a channel's state that does not depend on T, so select() can arm and
+        // scan channels of different element types through one loop.
+        struct channel_core
+        {
+            std::size_t capacity = 0;
+            std::size_t head = 0;
+            std::size_t count = 0;
+            bool closed = false;
+            wait_list senders;
+            wait_list receivers;
+        };
+
+        struct channel_access;
+    } // namespace detail
+
+    // Bounded FIFO between coroutines on one thread. send() parks the caller while the ring is
+    // full and receive() while it is empty; the other side wakes them through their scheduler
+    // (task_runner), which hands the CPU straight to the next ready task. Coroutines driven by
+    // hand see a plain yield and retry when resumed. Must outlive any coroutine blocked on it.
+    template <typename T>
+        requires std::movable<T> && std::is_nothrow_move_constructible_v<T>
+    class [[nodiscard]] channel
+    {
+    public:
+        [[nodiscard]] static auto create(std::size_t capacity) noexcept -> std::expected<channel, error>
+        {
+            if (capacity == 0 || capacity > SIZE_MAX / sizeof(T))
+                return std::unexpected{error::invalid_arguments};
+            auto *slots = static_cast<T *>(::operator new(capacity * sizeof(T), std::align_val_t{alignof(T)}, std::nothrow));
+            if (slots == nullptr)
+                return std::unexpected{error::out_of_memory};
+            auto *s = new (std::nothrow) state{};
+            if (s == nullptr)
+            {
+                ::operator delete(slots, std::align_val_t{alignof(T)});
+                return std::unexpected{error::out_of_memory};
+            }
+            s->slots = slots;
+            s->capacity = capacity;
+            return channel{s};
+        }
+
+        channel(channel &&) noexcept = default;
+        auto operator=(channel &&) noexcept -> channel & = default;
+        channel(channel const &) = delete;
+        auto operator=(channel const &) -> channel & = delete;
+        ~channel() = default;
+
+        // Parks h while the channel is full. error::closed if it is (or becomes) closed.
+        [[nodiscard]] auto send(coroutine_handle h, T value) noexcept -> std::expected<void, error>
+        {
+            if (!h.valid())
+                return std::unexpected{error::invalid_coroutine};
+            if (state_ == nullptr)
+                return std::unexpected{error::invalid_operation};
+            state &s = *state_;
+            detail::wait_node self{h.raw()};
+            for (;;)
+            {
+                if (s.closed || s.count < s.capacity)
+                    break;
+                if (!self.linked)
+                    s.senders.push_back(&self);
+                auto const result = detail::mco_park_pinned(self.co);
+                if (result != detail::mco_result::success)
+                {
+                    // a cancelled sender may have been the one a pop() woke; pass that on
+                    s.senders.erase(&self);
+                    if (s.count < s.capacity)
+                        detail::mco_wake_one(s.senders);
+                    return std::unexpected{from_impl_result(result)};
+                }
+            }
+            s.senders.erase(&self);
+            if (s.closed)
+                return std::unexpected{error::closed};
+            s.push(std::move(value));
+            return {};
+        }
+
+        // Parks h while the channel is empty. error::closed once it is closed and drained.
+        [[nodiscard]] auto receive(coroutine_handle h) noexcept -> std::expected<T, error>
+        {
+            if (!h.valid())
+                return std::unexpected{error::invalid_coroutine};
+            if (state_ == nullptr)
+                return std::unexpected{error::invalid_operation};
+            state &s = *state_;
+            detail::wait_node self{h.raw()};
+            for (;;)
+            {
+                if (s.closed || s.count != 0)
+                    break;
+                if (!self.linked)
+                    s.receivers.push_back(&self);
+                auto const result = detail::mco_park_pinned(self.co);
+                if (result != detail::mco_result::success)
+                {
+                    s.receivers.erase(&self);
+                    if (s.count != 0)
+                        detail::mco_wake_one(s.receivers);
+                    return std::unexpected{from_impl_result(result)};
+                }
+            }
+            s.receivers.erase(&self);
+            if (s.count == 0)
+                return std::unexpected{error::closed};
+            return s.pop();
+        }
+
+        // error::would_block instead of parking; usable from outside any coroutine.
+        [[nodiscard]] auto try_send(T value) noexcept -> std::expected<void, error>
+        {
+            if (state_ == nullptr)
+                return std::unexpected{error::invalid_operation};
+            if (state_->closed)
+                return std::unexpected{error::closed};
+            if (state_->count == state_->capacity)
+                return std::unexpected{error::would_block};
+            state_->push(std::move(value));
+            return {};
+        }
+
+        [[nodiscard]] auto try_receive() noexcept -> std::expected<T, error>
+        {
+            if (state_ == nullptr)
+                return std::unexpected{error::invalid_operation};
+            if (state_->count == 0)
+                return std::unexpected{state_->closed ? error::closed : error::would_block};
+            return state_->pop();
+        }
+
+        // No more sends. Buffered values can still be received; every waiter is woken.
+        void close() noexcept
+        {
+            if (state_ == nullptr || state_->closed)
+                return;
+            state_->closed = true;
+            detail::mco_wake_all(state_->senders);
+            detail::mco_wake_all(state_->receivers);
+        }
+
+        [[nodiscard]] auto size() const noexcept -> std::size_t { return state_ ? state_->count : 0; }
+        [[nodiscard]] auto capacity() const noexcept -> std::size_t { return state_ ? state_->capacity : 0; }
+        [[nodiscard]] auto empty() const noexcept -> bool { return size() == 0; }
+        [[nodiscard]] auto full() const noexcept -> bool { return state_ && state_->count == state_->capacity; }
+        [[nodiscard]] auto closed() const noexcept -> bool { return state_ && state_->closed; }
+
+    private:
+        // Heap-allocated so moving the channel never disturbs a waiter's view of it.
+        friend struct detail::channel_access;
+
+        struct state : detail::channel_core
+        {
+            T *slots = nullptr;
+
+            state() noexcept = default;
+            state(state const &) = delete;
+            auto operator=(state const &) -> state & = delete;
+
+            ~state()
+            {
+                while (count != 0)
+                    (void)pop();
+                ::operator delete(slots, std::align_val_t{alignof(T)});
+            }
+
+            void push(T &&value) noexcept
+            {
+                std::size_t tail = head + count;
+                if (tail >= capacity)
+                    tail -= capacity;
+                std::construct_at(slots + tail, std::move(value));
+                ++count;
+                detail::mco_wake_one(receivers);
+            }
+
+            auto pop() noexcept -> T
+            {
+                T value = std::move(slots[head]);
+                std::destroy_at(slots + head);
+                if (++head == capacity)
+                    head = 0;
+                --count;
+                detail::mco_wake_one(senders);
+                return value;
+            }
+        };
+
+        explicit channel(state *s) noexcept : state_{s} {}
+
+        std::unique_ptr<state> state_;
+    };
+
+    // ============================================================================
+    // Select
+    // ============================================================================
+
+    namespace detail
+    {
+        struct channel_access
+        {
+            template <typename T>
+            [[nodiscard]] static auto core(channel<T> &ch) noexcept -> channel_core * { return ch.state_.get(); }
+
+            template <typename T>
+            [[nodiscard]] static auto pop(channel<T> &ch) noexcept -> T { return ch.state_->pop(); }
+        };
+
+        // One channel a select() waits on, with the waiter's node for its receiver list.
+        struct select_arm
+        {
+            channel_core *core = nullptr;
+            wait_node node{};
+        };
+
+        // Drops every registration still linked. A channel that popped our node and still holds
+        // a value (we are taking another) passes the wake to its next receiver.
+        inline void select_disarm(select_arm *arms, std::size_t n, std::size_t taken) noexcept
+        {
+            for (std::size_t i = 0; i < n; ++i)
+            {
+                channel_core &core = *arms[i].core;
+                if (arms[i].node.linked)
+                    core.receivers.erase(&arms[i].node);
+                else if (i != taken && arms[i].node.co != nullptr && core.count != 0)
+                    mco_wake_one(core.receivers);
+            }
+        }
+
+        // Parks co until one of the channels has a value or all are closed and drained, with one
+        // node armed on each receiver list. Returns the index of a channel to pop from now,
+        // preferring the one whose push woke us. Channels are scanned in order before parking.
+        inline auto select_wait(mco_coro *co, select_arm *arms, std::size_t n) noexcept
+            -> std::expected<std::size_t, error>
         {
-            while (!tasks_.empty())
+            for (bool woken = false;; woken = true)
             {
-                auto it = tasks_.begin();
-                while (it != tasks_.end())
+                for (std::size_t i = 0; woken && i < n; ++i)
                 {
-                    if (it->done())
+                    if (!arms[i].node.linked && arms[i].core->count != 0)
                     {
-                        it = tasks_.erase(it);
-                        continue;
+                        select_disarm(arms, n, i);
+                        return i;
                     }
-                    auto result = it->resume();
-                    if (!result && result.error() != error::not_suspended)
-                        return result;
-                    if (it->done())
-                        it = tasks_.erase(it);
+                }
+                bool open = false;
+                for (std::size_t i = 0; i < n; ++i)
+                {
+                    channel_core &core = *arms[i].core;
+                    if (core.count != 0)
+                    {
+                        select_disarm(arms, n, i);
+                        return i;
+                    }
+                    open = open || !core.closed;
+                }
+                if (!open)
+                {
+                    select_disarm(arms, n, n);
+                    return std::unexpected{error::closed};
+                }
+                for (std::size_t i = 0; i < n; ++i)
+                {
+                    // node.co doubles as "armed at least once", so disarm knows who may owe a wake
+                    if (!arms[i].node.linked && !arms[i].core->closed)
+                    {
+                        arms[i].node.co = co;
+                        arms[i].core->receivers.push_back(&arms[i].node);
+                    }
+                }
+                auto const result = mco_park_pinned(co);
+                if (result != mco_result::success)
+                {
+                    select_disarm(arms, n, n);
+                    return std::unexpected{from_impl_result(result)};
+                }
+            }
+        }
+
+        template <std::size_t I, typename Result, typename T, typename... Rest>
+        [[nodiscard]] auto select_take(std::size_t index, channel<T> &ch, channel<Rest> &...rest) noexcept -> Result
+        {
+            if constexpr (sizeof...(Rest) == 0)
+                return Result{std::in_place_index<I>, channel_access::pop(ch)};
+            else
+            {
+                if (index == I)
+                    return Result{std::in_place_index<I>, channel_access::pop(ch)};
+                return select_take<I + 1, Result>(index, rest...);
+            }
+        }
+
+        template <typename P>
+        struct channel_pointee
+        {
+        };
+
+        template <typename T>
+        struct channel_pointee<channel<T> *>
+        {
+            using type = T;
+        };
+
+        template <typename R>
+        using select_range_value = typename channel_pointee<std::remove_cv_t<std::ranges::range_value_t<R>>>::type;
+
+        // Parks co until one of the coroutines finishes or is destroyed; nodes[i] waits on coros[i].
+        inline auto select_any_wait(mco_coro *co, coroutine_handle const *coros, wait_node *nodes, std::size_t n) noexcept
+            -> std::expected<std::size_t, error>
+        {
+            for (std::size_t i = 0; i < n; ++i)
+            {
+                if (!coros[i].valid())
+                    return std::unexpected{error::invalid_coroutine};
+                if (coros[i].raw() == co)
+                    return std::unexpected{error::invalid_operation};
+            }
+            for (std::size_t i = 0; i < n; ++i)
+                if (mco_status(coros[i].raw()) == mco_state::dead)
+                    return i;
+            for (std::size_t i = 0; i < n; ++i)
+            {
+                nodes[i].co = co;
+                coros[i].raw()->done_waiters.push_back(&nodes[i]);
+            }
+            for (;;)
+            {
+                auto const result = mco_park_pinned(co);
+                std::size_t fired = n;
+                for (std::size_t i = 0; i < n && fired == n; ++i)
+                    if (!nodes[i].linked)
+                        fired = i;
+                if (fired != n || result != mco_result::success)
+                {
+                    // a linked node means its coroutine is still alive, so its list is too
+                    for (std::size_t i = 0; i < n; ++i)
+                        if (nodes[i].linked)
+                            coros[i].raw()->done_waiters.erase(&nodes[i]);
+                    if (fired != n)
+                        return fired;
+                    return std::unexpected{from_impl_result(result)};
+                }
+            }
+        }
+    } // namespace detail
+
+    template <typename T>
+    struct select_result
+    {
+        std::size_t index; // position of the channel the value came from
+        T value;
+    };
+
+    // Receives from whichever channel has a value first, parking h with one registration on each
+    // channel until one does. The result's index() says which channel it came from. Skips closed
+    // channels and fails with error::closed once all are closed and drained. No allocation: the
+    // registrations live in this frame and the losers are unlinked in O(1) each.
+    template <typename... Ts>
+        requires(sizeof...(Ts) > 0)
+    [[nodiscard]] auto select(coroutine_handle h, channel<Ts> &...chs) noexcept -> std::expected<std::variant<Ts...>, error>
+    {
+        if (!h.valid())
+            return std::unexpected{error::invalid_coroutine};
+        std::array<detail::select_arm, sizeof...(Ts)> arms{detail::select_arm{detail::channel_access::core(chs)}...};
+        for (detail::select_arm const &arm : arms)
+            if (arm.core == nullptr)
+                return std::unexpected{error::invalid_operation};
+        auto const index = detail::select_wait(h.raw(), arms.data(), arms.size());
+        if (!index)
+            return std::unexpected{index.error()};
+        return detail::select_take<0, std::variant<Ts...>>(*index, chs...);
+    }
+
+    // select() over a run-time set of channels of one type, e.g. a std::vector<channel<T> *>.
+    // Registrations for up to 16 channels live on h's stack; beyond that they take one allocation
+    // per call that has to park.
+    template <std::ranges::random_access_range Channels>
+        requires std::ranges::sized_range<Channels>
+    [[nodiscard]] auto select(coroutine_handle h, Channels const &chs) noexcept
+        -> std::expected<select_result<detail::select_range_value<Channels>>, error>
+    {
+        using value_type = detail::select_range_value<Channels>;
+        if (!h.valid())
+            return std::unexpected{error::invalid_coroutine};
+        std::size_t const n = std::ranges::size(chs);
+        if (n == 0)
+            return std::unexpected{error::invalid_arguments};
+        auto const first = std::ranges::begin(chs);
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            auto *ch = first[static_cast<std::ranges::range_difference_t<Channels>>(i)];
+            if (ch == nullptr || detail::channel_access::core(*ch) == nullptr)
+                return std::unexpected{error::invalid_operation};
+            if (!ch->empty())
+                return select_result<value_type>{i, detail::channel_access::pop(*ch)};
+        }
+
+        constexpr std::size_t inline_arms = 16;
+        std::array<detail::select_arm, inline_arms> local{};
+        std::unique_ptr<detail::select_arm[]> heap;
+        detail::select_arm *arms = local.data();
+        if (n > inline_arms)
+        {
+            heap.reset(new (std::nothrow) detail::select_arm[n]);
+            if (heap == nullptr)
+                return std::unexpected{error::out_of_memory};
+            arms = heap.get();
+        }
+        for (std::size_t i = 0; i < n; ++i)
+            arms[i].core = detail::channel_access::core(*first[static_cast<std::ranges::range_difference_t<Channels>>(i)]);
+        auto const index = detail::select_wait(h.raw(), arms, n);
+        if (!index)
+            return std::unexpected{index.error()};
+        auto *ch = first[static_cast<std::ranges::range_difference_t<Channels>>(*index)];
+        return select_result<value_type>{*index, detail::channel_access::pop(*ch)};
+    }
+
+    // Parks h until one of the coroutines finishes (or is destroyed) and returns its position.
+    // One already finished is reported without parking. The coroutines must be alive when
+    // called and driven on h's thread; they need not belong to h's runner.
+    template <std::same_as<coroutine_handle>... Hs>
+        requires(sizeof...(Hs) > 0)
+    [[nodiscard]] auto select_any(coroutine_handle h, Hs... coros) noexcept -> std::expected<std::size_t, error>
+    {
+        if (!h.valid())
+            return std::unexpected{error::invalid_coroutine};
+        std::array<coroutine_handle, sizeof...(Hs)> const handles{coros...};
+        std::array<detail::wait_node, sizeof...(Hs)> nodes{};
+        return detail::select_any_wait(h.raw(), handles.data(), nodes.data(), handles.size());
+    }
+
+    // select_any() over a run-time set; allocates the registrations once per call that parks.
+    [[nodiscard]] inline auto select_any(coroutine_handle h, std::span<coroutine_handle const> coros) noexcept
+        -> std::expected<std::size_t, error>
+    {
+        if (!h.valid())
+            return std::unexpected{error::invalid_coroutine};
+        if (coros.empty())
+            return std::unexpected{error::invalid_arguments};
+        for (std::size_t i = 0; i < coros.size(); ++i)
+            if (coros[i].valid() && detail::mco_status(coros[i].raw()) == detail::mco_state::dead)
+                return i;
+        std::unique_ptr<detail::wait_node[]> nodes{new (std::nothrow) detail::wait_node[coros.size()]};
+        if (nodes == nullptr)
+            return std::unexpected{error::out_of_memory};
+        return detail::select_any_wait(h.raw(), coros.data(), nodes.get(), coros.size());
+    }
+
+    // ============================================================================
+    // Structured Concurrency
+    // ============================================================================
+
+    namespace detail
+    {
+        // One scope's frames, carved from a few large chunks (each twice the last) instead of
+        // one allocation per child. Released frames go on a free list for the next spawn; the
+        // chunks are freed together once the scope and all of its frames are gone. It is the
+        // allocator_data of the scope's mco_desc and outlives the scope if children linger.
+        struct scope_state
+        {
+            // A started, unfinished child, so cancel() can reach it. Lives in the child's callable.
+            struct child_link
+            {
+                mco_coro *co{nullptr};
+                child_link *prev{nullptr};
+                child_link *next{nullptr};
+            };
+
+            struct chunk
+            {
+                chunk *next;
+            };
+
+            struct idle_frame
+            {
+                idle_frame *next;
+            };
+
+            static constexpr std::size_t frame_align = 64;
+
+            mco_desc desc{};
+            std::size_t stride = 0; // frame size rounded up to frame_align
+            std::size_t next_chunk_frames = 0;
+            chunk *chunks = nullptr;
+            unsigned char *bump = nullptr;
+            unsigned char *bump_end = nullptr;
+            idle_frame *idle_head = nullptr;
+            std::size_t frames = 0;  // handed out, not yet released
+            std::size_t carved = 0;  // ever carved from the chunks
+            std::size_t running = 0; // spawned, not yet finished
+            child_link *children = nullptr;
+            mco_coro *joiner = nullptr;
+            bool cancelling = false;
+            bool orphaned = false;
+#if defined(__cpp_exceptions)
+            std::exception_ptr failure;
+#endif
+
+            scope_state() noexcept = default;
+            scope_state(scope_state const &) = delete;
+            auto operator=(scope_state const &) -> scope_state & = delete;
+
+            ~scope_state()
+            {
+                while (chunks != nullptr)
+                    ::operator delete(std::exchange(chunks, chunks->next), std::align_val_t{frame_align});
+            }
+
+            [[nodiscard]] auto grow() noexcept -> bool
+            {
+                std::size_t const count = next_chunk_frames;
+                if (count > (SIZE_MAX - frame_align) / stride)
+                    return false;
+                void *block = ::operator new(frame_align + count * stride, std::align_val_t{frame_align}, std::nothrow);
+                if (block == nullptr)
+                    return false;
+                chunks = ::new (block) chunk{chunks};
+                bump = static_cast<unsigned char *>(block) + frame_align;
+                bump_end = bump + count * stride;
+                next_chunk_frames = count * 2;
+                return true;
+            }
+
+            void start(child_link *link) noexcept
+            {
+                link->next = children;
+                if (children != nullptr)
+                    children->prev = link;
+                children = link;
+                if (cancelling)
+                    mco_cancel(link->co);
+            }
+
+            // The last child to finish wakes the joiner, and only if it is really parked: one
+            // re-queued for another reason re-checks running on its own.
+            void finish(child_link *link) noexcept
+            {
+                if (link->co != nullptr)
+                {
+                    if (link->prev != nullptr)
+                        link->prev->next = link->next;
                     else
-                        ++it;
+                        children = link->next;
+                    if (link->next != nullptr)
+                        link->next->prev = link->prev;
+                }
+                if (--running == 0 && joiner != nullptr && (joiner->sched_flags & mco_sched_parked) != 0)
+                    (void)mco_wake(joiner);
+            }
+
+            void cancel_children() noexcept
+            {
+                cancelling = true;
+                for (child_link *link = children; link != nullptr; link = link->next)
+                    mco_cancel(link->co);
+            }
+
+            static void *acquire(std::size_t size, void *allocator_data)
+            {
+                auto *self = static_cast<scope_state *>(allocator_data);
+                if (size != self->desc.coro_size)
+                    return nullptr;
+                void *frame = self->idle_head;
+                if (frame != nullptr)
+                    self->idle_head = self->idle_head->next;
+                else
+                {
+                    if (self->bump == self->bump_end && !self->grow())
+                        return nullptr;
+                    frame = std::exchange(self->bump, self->bump + self->stride);
+                    ++self->carved;
+                }
+                ++self->frames;
+                return frame;
+            }
+
+            static void release(void *ptr, std::size_t, void *allocator_data)
+            {
+                auto *self = static_cast<scope_state *>(allocator_data);
+                self->idle_head = ::new (ptr) idle_frame{self->idle_head};
+                if (--self->frames == 0 && self->orphaned)
+                    delete self;
+            }
+        };
+
+        // A child's callable: runs the body, then reports completion. Each live, unfinished
+        // one counts as running, so a child torn down early (or never created) still reports.
+        template <typename Fn>
+        class scope_child
+        {
+        public:
+            scope_child(scope_state *state, Fn &&fn) noexcept(std::is_nothrow_move_constructible_v<Fn>)
+                : state_{state}, fn_{std::move(fn)}
+            {
+                ++state_->running;
+            }
+
+            scope_child(scope_child &&other) noexcept(std::is_nothrow_move_constructible_v<Fn>)
+                : state_{other.state_}, fn_{std::move(other.fn_)}, finished_{std::exchange(other.finished_, true)} {}
+
+            scope_child(scope_child const &) = delete;
+            auto operator=(scope_child const &) -> scope_child & = delete;
+            auto operator=(scope_child &&) -> scope_child & = delete;
+
+            ~scope_child()
+            {
+                if (!finished_)
+                    finish();
+            }
+
+            // A throwing child cancels its siblings; join() rethrows. The try block is free
+            // until something throws.
+            void operator()(coroutine_handle h)
+            {
+                link_.co = h.raw();
+                state_->start(&link_);
+#if defined(__cpp_exceptions)
+                try
+                {
+                    std::invoke(fn_, h);
+                }
+                catch (...)
+                {
+                    if (!state_->failure)
+                        state_->failure = std::current_exception();
+                    state_->cancel_children();
                 }
+#else
+                std::invoke(fn_, h);
+#endif
+                finish();
+            }
+
+        private:
+            void finish() noexcept
+            {
+                finished_ = true;
+                state_->finish(&link_);
+            }
+
+            scope_state *state_;
+            Fn fn_;
+            scope_state::child_link link_{};
+            bool finished_{false};
+        };
+    } // namespace detail
+
+    // Owns a group of child coroutines: their frames come from one arena that is freed in bulk,
+    // and a counter of unfinished children lets join() park the parent until the last one is
+    // done, waking it once rather than polling. Children run on whatever runner they are added
+    // to. Leaving the scope without joining cancels the children still running; their frames
+    // stay valid until the runner tears them down.
+    class [[nodiscard]] scope
+    {
+    public:
+        static constexpr std::size_t inline_callable_size = 128;
+
+        // expected_children sizes the first chunk; later ones double.
+        [[nodiscard]] static auto create(std::size_t expected_children = 16, stack_size stack = default_stack_size, storage_size storage = default_storage_size) noexcept
+            -> std::expected<scope, error>
+        {
+            auto *state = new (std::nothrow) detail::scope_state{};
+            if (state == nullptr)
+                return std::unexpected{error::out_of_memory};
+            state->desc = detail::mco_desc_init(&coroutine::invoke<coroutine::function_type>, stack.value);
+            state->desc.storage_size = storage.value;
+            state->desc.user_size = inline_callable_size;
+            detail::mco_init_desc_sizes(&state->desc, state->desc.stack_size);
+            state->desc.alloc_cb = &detail::scope_state::acquire;
+            state->desc.dealloc_cb = &detail::scope_state::release;
+            state->desc.allocator_data = state;
+            state->stride = (state->desc.coro_size + detail::scope_state::frame_align - 1) & ~(detail::scope_state::frame_align - 1);
+            state->next_chunk_frames = expected_children == 0 ? 1 : expected_children;
+
+            scope s{state};
+            if (!state->grow())
+                return std::unexpected{error::out_of_memory};
+            return s;
+        }
+
+        scope(scope const &) = delete;
+        auto operator=(scope const &) -> scope & = delete;
+
+        scope(scope &&other) noexcept : state_{std::exchange(other.state_, nullptr)} {}
+
+        auto operator=(scope &&other) noexcept -> scope &
+        {
+            if (this != &other)
+            {
+                release();
+                state_ = std::exchange(other.state_, nullptr);
             }
+            return *this;
+        }
+
+        ~scope() { release(); }
+
+        // A child on a frame from the arena; add it to a runner to start it.
+        template <coroutine_body F>
+        [[nodiscard]] auto spawn(F &&func) noexcept -> std::expected<coroutine, error>
+        {
+            if (state_ == nullptr)
+                return std::unexpected{error::invalid_operation};
+            detail::mco_desc desc = state_->desc;
+            return coroutine::create_with_desc(detail::scope_child<std::decay_t<F>>{state_, std::decay_t<F>(std::forward<F>(func))}, desc);
+        }
+
+        // spawn() and runner.add() in one go.
+        template <typename Runner, coroutine_body F>
+            requires requires(Runner &r, coroutine &&c) { r.add(std::move(c)); }
+        [[nodiscard]] auto spawn(Runner &runner, F &&func) -> std::expected<void, error>
+        {
+            auto child = spawn(std::forward<F>(func));
+            if (!child)
+                return std::unexpected{child.error()};
+            runner.add(std::move(*child));
             return {};
         }
 
-        [[nodiscard]] auto step() noexcept -> std::expected<bool, error>
+        // Parks h until every child has finished. If a child threw, its exception is rethrown
+        // here (the others were cancelled). If h itself is cancelled, the children are too and
+        // join still waits for them, then returns error::cancelled.
+        [[nodiscard]] auto join(coroutine_handle h) -> std::expected<void, error>
         {
-            auto it = tasks_.begin();
-            while (it != tasks_.end())
+            detail::mco_coro *co = h.raw();
+            if (co == nullptr)
+                return std::unexpected{error::invalid_coroutine};
+            if (state_ == nullptr || (state_->joiner != nullptr && state_->joiner != co))
+                return std::unexpected{error::invalid_operation};
+            bool cancelled = false;
+            while (state_->running != 0)
             {
-                if (it->done())
+                state_->joiner = co;
+                auto const result = detail::mco_park(co, !cancelled);
+                state_->joiner = nullptr;
+                if (result == detail::mco_result::cancelled)
                 {
-                    it = tasks_.erase(it);
-                    continue;
+                    cancelled = true;
+                    state_->cancel_children();
                 }
-                auto result = it->resume();
-                if (!result && result.error() != error::not_suspended)
-                    return std::unexpected{result.error()};
-                if (it->done())
-                    it = tasks_.erase(it);
-                else
-                    ++it;
+                else if (result != detail::mco_result::success)
+                    return std::unexpected{from_impl_result(result)};
             }
-            return !tasks_.empty();
+#if defined(__cpp_exceptions)
+            if (state_->failure)
+                std::rethrow_exception(std::exchange(state_->failure, nullptr));
+#endif
+            if (cancelled)
+                return std::unexpected{error::cancelled};
+            return {};
         }
 
-        [[nodiscard]] auto size() const noexcept -> std::size_t { return tasks_.size(); }
-        [[nodiscard]] auto empty() const noexcept -> bool { return tasks_.empty(); }
+        // Cancels every running child, and any spawned later as it starts.
+        void cancel() noexcept
+        {
+            if (state_ != nullptr)
+                state_->cancel_children();
+        }
+
+        [[nodiscard]] auto running() const noexcept -> std::size_t { return state_ ? state_->running : 0; }
+        [[nodiscard]] auto frames() const noexcept -> std::size_t { return state_ ? state_->frames : 0; }
+        // Frames carved from the arena so far, in use or on its free list.
+        [[nodiscard]] auto capacity() const noexcept -> std::size_t { return state_ ? state_->carved : 0; }
+        [[nodiscard]] auto valid() const noexcept -> bool { return state_ != nullptr; }
+        [[nodiscard]] explicit operator bool() const noexcept { return valid(); }
 
     private:
-        std::vector<coroutine> tasks_;
+        explicit scope(detail::scope_state *state) noexcept : state_{state} {}
+
+        void release() noexcept
+        {
+            if (state_ == nullptr)
+                return;
+            state_->cancel_children();
+            if (state_->frames == 0)
+                delete state_;
+            else
+                state_->orphaned = true;
+            state_ = nullptr;
+        }
+
+        detail::scope_state *state_{nullptr};
     };
 } // namespace coro
 
@@ -785,10 +5808,51 @@ namespace coro
 
 #include <cstdlib> // calloc, free
 
+#if defined(_WIN32)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <linux/mempolicy.h>
+#include <sys/syscall.h>
+#include <ctime>
+#else
+#include <condition_variable>
+#include <mutex>
+#endif
+
+// Detect ASan
+#if defined(__has_feature)
+#if __has_feature(address_sanitizer)
+#define UCORO_ASAN_ENABLED
+#endif
+#endif
+#if defined(__SANITIZE_ADDRESS__) && !defined(UCORO_ASAN_ENABLED)
+#define UCORO_ASAN_ENABLED
+#endif
+
+#if defined(UCORO_ASAN_ENABLED)
+#include <sanitizer/asan_interface.h>
+#endif
+
 namespace coro::detail
 {
     thread_local mco_coro *mco_current_co = nullptr;
 
+    UCORO_NOINLINE mco_coro *mco_get_current_co(void) { return mco_current_co; }
+    UCORO_NOINLINE void mco_set_current_co(mco_coro *co) { mco_current_co = co; }
+    UCORO_NOINLINE mco_coro *mco_exchange_current_co(mco_coro *co) { return std::exchange(mco_current_co, co); }
+
 #if defined(_WIN32) && (defined(_M_X64) || defined(__x86_64__))
 // -----------------------------------------------------------------------------------------
 // Windows x64 Implementation (via raw assembly blobs)
@@ -918,7 +5982,278 @@ namespace coro::detail
         0xe0,
         0x00,
         0x00,
-        0x00, /* movups %xmm15,0xe0(%rcx)   */
+        0x00, /* movups %xmm15,0xe0(%rcx)   */
+        0x65,
+        0x4c,
+        0x8b,
+        0x14,
+        0x25,
+        0x30,
+        0x00,
+        0x00,
+        0x00, /* mov    %gs:0x30,%r10       */
+        0x49,
+        0x8b,
+        0x42,
+        0x20, /* mov    0x20(%r10),%rax     */
+        0x48,
+        0x89,
+        0x81,
+        0xf0,
+        0x00,
+        0x00,
+        0x00, /* mov    %rax,0xf0(%rcx)     */
+        0x49,
+        0x8b,
+        0x82,
+        0x78,
+        0x14,
+        0x00,
+        0x00, /* mov    0x1478(%r10),%rax   */
+        0x48,
+        0x89,
+        0x81,
+        0xf8,
+        0x00,
+        0x00,
+        0x00, /* mov    %rax,0xf8(%rcx)     */
+        0x49,
+        0x8b,
+        0x42,
+        0x10, /* mov    0x10(%r10),%rax     */
+        0x48,
+        0x89,
+        0x81,
+        0x00,
+        0x01,
+        0x00,
+        0x00, /* mov    %rax,0x100(%rcx)    */
+        0x49,
+        0x8b,
+        0x42,
+        0x08, /* mov    0x8(%r10),%rax      */
+        0x48,
+        0x89,
+        0x81,
+        0x08,
+        0x01,
+        0x00,
+        0x00, /* mov    %rax,0x108(%rcx)    */
+        0x48,
+        0x8b,
+        0x82,
+        0x08,
+        0x01,
+        0x00,
+        0x00, /* mov    0x108(%rdx),%rax    */
+        0x49,
+        0x89,
+        0x42,
+        0x08, /* mov    %rax,0x8(%r10)      */
+        0x48,
+        0x8b,
+        0x82,
+        0x00,
+        0x01,
+        0x00,
+        0x00, /* mov    0x100(%rdx),%rax    */
+        0x49,
+        0x89,
+        0x42,
+        0x10, /* mov    %rax,0x10(%r10)     */
+        0x48,
+        0x8b,
+        0x82,
+        0xf8,
+        0x00,
+        0x00,
+        0x00, /* mov    0xf8(%rdx),%rax     */
+        0x49,
+        0x89,
+        0x82,
+        0x78,
+        0x14,
+        0x00,
+        0x00, /* mov    %rax,0x1478(%r10)   */
+        0x48,
+        0x8b,
+        0x82,
+        0xf0,
+        0x00,
+        0x00,
+        0x00, /* mov    0xf0(%rdx),%rax     */
+        0x49,
+        0x89,
+        0x42,
+        0x20, /* mov    %rax,0x20(%r10)     */
+        0x44,
+        0x0f,
+        0x10,
+        0xba,
+        0xe0,
+        0x00,
+        0x00,
+        0x00, /* movups 0xe0(%rdx),%xmm15   */
+        0x44,
+        0x0f,
+        0x10,
+        0xb2,
+        0xd0,
+        0x00,
+        0x00,
+        0x00, /* movups 0xd0(%rdx),%xmm14   */
+        0x44,
+        0x0f,
+        0x10,
+        0xaa,
+        0xc0,
+        0x00,
+        0x00,
+        0x00, /* movups 0xc0(%rdx),%xmm13   */
+        0x44,
+        0x0f,
+        0x10,
+        0xa2,
+        0xb0,
+        0x00,
+        0x00,
+        0x00, /* movups 0xb0(%rdx),%xmm12   */
+        0x44,
+        0x0f,
+        0x10,
+        0x9a,
+        0xa0,
+        0x00,
+        0x00,
+        0x00, /* movups 0xa0(%rdx),%xmm11   */
+        0x44,
+        0x0f,
+        0x10,
+        0x92,
+        0x90,
+        0x00,
+        0x00,
+        0x00, /* movups 0x90(%rdx),%xmm10   */
+        0x44,
+        0x0f,
+        0x10,
+        0x8a,
+        0x80,
+        0x00,
+        0x00,
+        0x00, /* movups 0x80(%rdx),%xmm9    */
+        0x44,
+        0x0f,
+        0x10,
+        0x42,
+        0x70, /* movups 0x70(%rdx),%xmm8    */
+        0x0f,
+        0x10,
+        0x7a,
+        0x60, /* movups 0x60(%rdx),%xmm7    */
+        0x0f,
+        0x10,
+        0x72,
+        0x50, /* movups 0x50(%rdx),%xmm6    */
+        0x48,
+        0x8b,
+        0x72,
+        0x48, /* mov    0x48(%rdx),%rsi     */
+        0x48,
+        0x8b,
+        0x7a,
+        0x40, /* mov    0x40(%rdx),%rdi     */
+        0x4c,
+        0x8b,
+        0x7a,
+        0x38, /* mov    0x38(%rdx),%r15     */
+        0x4c,
+        0x8b,
+        0x72,
+        0x30, /* mov    0x30(%rdx),%r14     */
+        0x4c,
+        0x8b,
+        0x6a,
+        0x28, /* mov    0x28(%rdx),%r13     */
+        0x4c,
+        0x8b,
+        0x62,
+        0x20, /* mov    0x20(%rdx),%r12     */
+        0x48,
+        0x8b,
+        0x5a,
+        0x18, /* mov    0x18(%rdx),%rbx     */
+        0x48,
+        0x8b,
+        0x6a,
+        0x10, /* mov    0x10(%rdx),%rbp     */
+        0x48,
+        0x8b,
+        0x62,
+        0x08, /* mov    0x8(%rdx),%rsp      */
+        0xff,
+        0x22, /* jmpq   *(%rdx)             */
+        0xc3, /* retq                       */
+        0x90,
+        0x90,
+        0x90,
+        0x90,
+        0x90,
+        0x90,
+        0x90,
+        0x90, /* nop                        */
+        0x90,
+        0x90, /* nop                        */
+    };
+
+    // _mco_switch_code without the xmm6-xmm15 stores; the loads stay so it can resume any context.
+    MCO_ASM_BLOB static unsigned char _mco_switch_int_code[] = {
+        0x48,
+        0x8d,
+        0x05,
+        0xf9,
+        0x00,
+        0x00,
+        0x00, /* lea    0xf9(%rip),%rax     */
+        0x48,
+        0x89,
+        0x01, /* mov    %rax,(%rcx)         */
+        0x48,
+        0x89,
+        0x61,
+        0x08, /* mov    %rsp,0x8(%rcx)      */
+        0x48,
+        0x89,
+        0x69,
+        0x10, /* mov    %rbp,0x10(%rcx)     */
+        0x48,
+        0x89,
+        0x59,
+        0x18, /* mov    %rbx,0x18(%rcx)     */
+        0x4c,
+        0x89,
+        0x61,
+        0x20, /* mov    %r12,0x20(%rcx)     */
+        0x4c,
+        0x89,
+        0x69,
+        0x28, /* mov    %r13,0x28(%rcx)     */
+        0x4c,
+        0x89,
+        0x71,
+        0x30, /* mov    %r14,0x30(%rcx)     */
+        0x4c,
+        0x89,
+        0x79,
+        0x38, /* mov    %r15,0x38(%rcx)     */
+        0x48,
+        0x89,
+        0x79,
+        0x40, /* mov    %rdi,0x40(%rcx)     */
+        0x48,
+        0x89,
+        0x71,
+        0x48, /* mov    %rsi,0x48(%rcx)     */
         0x65,
         0x4c,
         0x8b,
@@ -1140,10 +6475,12 @@ namespace coro::detail
         0x90, /* nop                        */
         0x90,
         0x90, /* nop                        */
+
     };
 
     void (*_mco_wrap_main)(void) = (void (*)(void))(void *)_mco_wrap_main_code;
     void (*_mco_switch)(mco_ctxbuf *from, mco_ctxbuf *to) = (void (*)(mco_ctxbuf *from, mco_ctxbuf *to))(void *)_mco_switch_code;
+    void (*_mco_switch_int)(mco_ctxbuf *from, mco_ctxbuf *to) = (void (*)(mco_ctxbuf *from, mco_ctxbuf *to))(void *)_mco_switch_int_code;
 
     static void mco_main(mco_coro *co);
 
@@ -1294,6 +6631,45 @@ namespace coro::detail
 #endif
     );
 
+    // _mco_switch without the d8-d15 stores; the loads stay so it can resume any context.
+    __asm__(
+        ".text\n"
+#ifdef __MACH__
+        ".globl __mco_switch_int\n"
+        "__mco_switch_int:\n"
+#else
+        ".globl _mco_switch_int\n"
+        ".type _mco_switch_int #function\n"
+        ".hidden _mco_switch_int\n"
+        "_mco_switch_int:\n"
+#endif
+        "  mov x10, sp\n"
+        "  mov x11, x30\n"
+        "  stp x19, x20, [x0, #(0*16)]\n"
+        "  stp x21, x22, [x0, #(1*16)]\n"
+        "  stp x23, x24, [x0, #(2*16)]\n"
+        "  stp x25, x26, [x0, #(3*16)]\n"
+        "  stp x27, x28, [x0, #(4*16)]\n"
+        "  stp x29, x30, [x0, #(5*16)]\n"
+        "  stp x10, x11, [x0, #(6*16)]\n"
+        "  ldp x19, x20, [x1, #(0*16)]\n"
+        "  ldp x21, x22, [x1, #(1*16)]\n"
+        "  ldp d8, d9, [x1, #(7*16)]\n"
+        "  ldp x23, x24, [x1, #(2*16)]\n"
+        "  ldp d10, d11, [x1, #(8*16)]\n"
+        "  ldp x25, x26, [x1, #(3*16)]\n"
+        "  ldp d12, d13, [x1, #(9*16)]\n"
+        "  ldp x27, x28, [x1, #(4*16)]\n"
+        "  ldp d14, d15, [x1, #(10*16)]\n"
+        "  ldp x29, x30, [x1, #(5*16)]\n"
+        "  ldp x10, x11, [x1, #(6*16)]\n"
+        "  mov sp, x10\n"
+        "  br x11\n"
+#ifndef __MACH__
+        ".size _mco_switch_int, .-_mco_switch_int\n"
+#endif
+    );
+
     __asm__(
         ".text\n"
 #ifdef __MACH__
@@ -1343,48 +6719,283 @@ namespace coro::detail
     {
         co->func(co);
         co->state = mco_state::dead;
-        mco_context *context = static_cast<mco_context *>(co->context);
+        mco_wake_all(co->done_waiters);
+        mco_context *context = mco_context_of(co);
         mco_prepare_jumpout(co);
         _mco_switch(&context->ctx, &context->back_ctx);
     }
 
     static void mco_jumpin(mco_coro *co)
     {
-        mco_context *context = static_cast<mco_context *>(co->context);
+        mco_context *context = mco_context_of(co);
         mco_prepare_jumpin(co);
         _mco_switch(&context->back_ctx, &context->ctx);
     }
 
     static void mco_jumpout(mco_coro *co)
     {
-        mco_context *context = static_cast<mco_context *>(co->context);
+        mco_context *context = mco_context_of(co);
         mco_prepare_jumpout(co);
         _mco_switch(&context->ctx, &context->back_ctx);
     }
 
+    // -----------------------------------------------------------------------------------------
+    // Virtual memory
+    // -----------------------------------------------------------------------------------------
+    // the PMD size on x86-64 and 4K-page arm64; THP only backs aligned 2 MiB spans
+    [[maybe_unused]] static constexpr std::size_t huge_page = std::size_t{2} << 20;
+
+    static void mco_vm_touch(void *ptr, std::size_t size)
+    {
+        auto *bytes = static_cast<unsigned char volatile *>(ptr);
+        for (std::size_t offset = 0; offset < size; offset += mco_vm_page_size())
+            bytes[offset] = 0;
+    }
+
+#if defined(_WIN32)
+    std::size_t mco_vm_page_size(void)
+    {
+        static std::size_t const page = []
+        {
+            SYSTEM_INFO info;
+            GetSystemInfo(&info);
+            return static_cast<std::size_t>(info.dwPageSize);
+        }();
+        return page;
+    }
+
+    void *mco_vm_reserve(std::size_t size)
+    {
+        // MEM_COMMIT only charges the commit limit; pages enter the working set on first touch
+        return VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+    }
+
+    void mco_vm_release(void *ptr, std::size_t size)
+    {
+        (void)size;
+        if (ptr)
+            VirtualFree(ptr, 0, MEM_RELEASE);
+    }
+
+    bool mco_vm_protect_none(void *ptr, std::size_t size)
+    {
+        DWORD old_protect;
+        return VirtualProtect(ptr, size, PAGE_NOACCESS, &old_protect) != 0;
+    }
+
+    void *mco_vm_reserve_slab(std::size_t size, bool prefault, bool huge_pages)
+    {
+        (void)huge_pages; // large pages need SeLockMemoryPrivilege; not worth failing over
+        void *ptr = mco_vm_reserve(size);
+        if (ptr != nullptr && prefault)
+            mco_vm_touch(ptr, size);
+        return ptr;
+    }
+#else
+    std::size_t mco_vm_page_size(void)
+    {
+        static std::size_t const page = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+        return page;
+    }
+
+    void *mco_vm_reserve(std::size_t size)
+    {
+        int flags = MAP_PRIVATE | MAP_ANON;
+#ifdef MAP_NORESERVE
+        flags |= MAP_NORESERVE;
+#endif
+#ifdef MAP_STACK
+        flags |= MAP_STACK;
+#endif
+        void *ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, flags, -1, 0);
+        return ptr == MAP_FAILED ? nullptr : ptr;
+    }
+
+    void mco_vm_release(void *ptr, std::size_t size)
+    {
+        if (ptr)
+            munmap(ptr, size);
+    }
+
+    bool mco_vm_protect_none(void *ptr, std::size_t size) { return mprotect(ptr, size, PROT_NONE) == 0; }
+
+    void *mco_vm_reserve_slab(std::size_t size, bool prefault, bool huge_pages)
+    {
+        size = mco_align_forward(size, mco_vm_page_size());
+        std::size_t const span = huge_pages ? size + huge_page : size;
+        int flags = MAP_PRIVATE | MAP_ANON;
+        bool populated = false;
+#ifdef MAP_POPULATE
+        if (prefault && !huge_pages) // populating before madvise would fault in small pages
+        {
+            flags |= MAP_POPULATE;
+            populated = true;
+        }
+#endif
+        void *raw = mmap(nullptr, span, PROT_READ | PROT_WRITE, flags, -1, 0);
+        if (raw == MAP_FAILED)
+            return nullptr;
+        auto *ptr = static_cast<unsigned char *>(raw);
+        if (huge_pages)
+        {
+            ptr = reinterpret_cast<unsigned char *>(mco_align_forward(reinterpret_cast<std::uintptr_t>(raw), huge_page));
+            auto const head = static_cast<std::size_t>(ptr - static_cast<unsigned char *>(raw));
+            if (head != 0)
+                munmap(raw, head);
+            if (huge_page - head != 0)
+                munmap(ptr + size, huge_page - head);
+#ifdef MADV_HUGEPAGE
+            (void)madvise(ptr, size, MADV_HUGEPAGE);
+#endif
+        }
+        if (prefault && !populated)
+            mco_vm_touch(ptr, size);
+        return ptr;
+    }
+#endif
+
+#if defined(__linux__)
+    void mco_futex_wait(std::atomic<std::uint32_t> *word, std::uint32_t seen, std::int64_t timeout_ns)
+    {
+        timespec ts{};
+        if (timeout_ns >= 0)
+        {
+            ts.tv_sec = static_cast<time_t>(timeout_ns / 1'000'000'000);
+            ts.tv_nsec = static_cast<long>(timeout_ns % 1'000'000'000);
+        }
+        (void)syscall(SYS_futex, reinterpret_cast<std::uint32_t *>(word), FUTEX_WAIT_PRIVATE, seen, timeout_ns >= 0 ? &ts : nullptr, nullptr, 0);
+    }
+
+    void mco_futex_wake(std::atomic<std::uint32_t> *word)
+    {
+        (void)syscall(SYS_futex, reinterpret_cast<std::uint32_t *>(word), FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+    }
+#else
+    // One condition variable for every sleeper in the process: wakes are rare (only an idle
+    // runner sleeps), so the occasional spurious wake-up of another runner costs nothing.
+    static std::mutex mco_futex_mutex;
+    static std::condition_variable mco_futex_cv;
+
+    void mco_futex_wait(std::atomic<std::uint32_t> *word, std::uint32_t seen, std::int64_t timeout_ns)
+    {
+        std::unique_lock lock{mco_futex_mutex};
+        auto const changed = [&]
+        { return word->load(std::memory_order_acquire) != seen; };
+        if (timeout_ns < 0)
+            mco_futex_cv.wait(lock, changed);
+        else
+            (void)mco_futex_cv.wait_for(lock, std::chrono::nanoseconds{timeout_ns}, changed);
+    }
+
+    void mco_futex_wake(std::atomic<std::uint32_t> *word)
+    {
+        (void)word;
+        {
+            std::lock_guard const lock{mco_futex_mutex}; // orders the change before a waiter's check
+        }
+        mco_futex_cv.notify_all();
+    }
+#endif
+
+    // -----------------------------------------------------------------------------------------
+    // NUMA
+    // -----------------------------------------------------------------------------------------
+#if defined(_WIN32)
+    int mco_numa_node(void)
+    {
+        PROCESSOR_NUMBER cpu;
+        GetCurrentProcessorNumberEx(&cpu);
+        USHORT node = 0;
+        return GetNumaProcessorNodeEx(&cpu, &node) ? static_cast<int>(node) : 0;
+    }
+
+    void *mco_vm_reserve_node(std::size_t *size, int node, page_kind kind)
+    {
+        (void)kind; // large pages need SeLockMemoryPrivilege
+        if (node < 0)
+            return mco_vm_reserve(*size);
+        return VirtualAllocExNuma(GetCurrentProcess(), nullptr, *size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE, static_cast<DWORD>(node));
+    }
+#else
+    int mco_numa_node(void)
+    {
+#if defined(__linux__)
+        unsigned cpu = 0;
+        unsigned node = 0;
+        if (syscall(SYS_getcpu, &cpu, &node, nullptr) == 0)
+            return static_cast<int>(node);
+#endif
+        return 0;
+    }
+
+    void *mco_vm_reserve_node(std::size_t *size, int node, page_kind kind)
+    {
+        void *ptr = nullptr;
+#ifdef MAP_HUGETLB
+        if (kind == page_kind::explicit_huge)
+        {
+            // the default hugetlb size, 2 MiB on x86-64; none reserved falls through to THP
+            std::size_t const huge = mco_align_forward(*size, huge_page);
+            ptr = mmap(nullptr, huge, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON | MAP_HUGETLB, -1, 0);
+            if (ptr == MAP_FAILED)
+                ptr = nullptr;
+            else
+                *size = huge;
+        }
+#endif
+        if (ptr == nullptr)
+        {
+            *size = mco_align_forward(*size, mco_vm_page_size());
+            ptr = mco_vm_reserve_slab(*size, false, kind != page_kind::normal);
+        }
+#if defined(__linux__)
+        // preferred, not bound: a full node spills over instead of failing the page fault
+        if (ptr != nullptr && node >= 0 && node < 64)
+        {
+            unsigned long mask = 1ul << node;
+            (void)syscall(SYS_mbind, ptr, *size, MPOL_PREFERRED, &mask, sizeof(mask) * 8 + 1, 0u);
+        }
+#else
+        (void)node;
+#endif
+        return ptr;
+    }
+#endif
+
     static mco_result mco_create_context(mco_coro *co, mco_desc *desc)
     {
         std::uintptr_t co_addr = reinterpret_cast<std::uintptr_t>(co);
-        std::uintptr_t context_addr = mco_align_forward(co_addr + sizeof(mco_coro), 16);
-        std::uintptr_t storage_addr = mco_align_forward(context_addr + sizeof(mco_context), 16);
-        std::uintptr_t stack_addr = mco_align_forward(storage_addr + desc->storage_size, 16);
+        mco_context *context = mco_context_of(co);
+        std::uintptr_t user_addr = mco_align_forward(reinterpret_cast<std::uintptr_t>(context) + sizeof(mco_context), 16);
+        std::uintptr_t storage_addr = mco_align_forward(user_addr + desc->user_size, 16);
 
-        mco_context *context = reinterpret_cast<mco_context *>(context_addr);
         std::memset(context, 0, sizeof(mco_context));
 
         unsigned char *storage = reinterpret_cast<unsigned char *>(storage_addr);
-        void *stack_base = reinterpret_cast<void *>(stack_addr);
         std::size_t stack_size = desc->stack_size;
+        void *stack_base = nullptr; // a lazy frame gets one in mco_attach_stack()
 
-        mco_result res = mco_makectx(co, &context->ctx, stack_base, stack_size);
-        if (res != mco_result::success)
-            return res;
+        if (!desc->lazy_stack)
+        {
+            std::uintptr_t stack_addr = desc->guard_size != 0
+                                            ? co_addr + mco_guard_offset(desc) + desc->guard_size
+                                            : mco_align_forward(storage_addr + desc->storage_size, 16);
+            stack_base = reinterpret_cast<void *>(stack_addr);
+
+            if constexpr (stack_painting)
+                std::memset(stack_base, mco_stack_paint_byte, stack_size);
+
+            mco_result res = mco_makectx(co, &context->ctx, stack_base, stack_size);
+            if (res != mco_result::success)
+                return res;
+        }
 
-        co->context = context;
         co->stack_base = stack_base;
         co->stack_size = stack_size;
         co->storage = storage;
         co->storage_size = desc->storage_size;
+        co->guard_size = desc->guard_size;
+        co->user_data = desc->user_size != 0 ? reinterpret_cast<void *>(user_addr) : desc->user_data;
         return mco_result::success;
     }
 
@@ -1394,10 +7005,10 @@ namespace coro::detail
             return mco_result::invalid_coroutine;
         if (!desc || !desc->func)
             return mco_result::invalid_arguments;
-        if (desc->stack_size < min_stack_size.value)
+        if (desc->stack_size < min_stack_size.value || desc->storage_size > UINT32_MAX)
             return mco_result::invalid_arguments;
 
-        std::memset(co, 0, sizeof(mco_coro));
+        ::new (static_cast<void *>(co)) mco_coro{};
         mco_result res = mco_create_context(co, desc);
         if (res != mco_result::success)
             return res;
@@ -1407,11 +7018,159 @@ namespace coro::detail
         co->coro_size = desc->coro_size;
         co->allocator_data = desc->allocator_data;
         co->func = desc->func;
-        co->user_data = desc->user_data;
+        if (desc->shared_stack != nullptr)
+            co->shared_stack = desc->shared_stack;
+        else if (desc->lazy_stack)
+        {
+            co->stack_alloc_cb = desc->alloc_cb;
+            co->guard_cb = desc->guard_cb;
+        }
         co->magic_number = magic_number;
         return mco_result::success;
     }
 
+    // -----------------------------------------------------------------------------------------
+    // Shared stacks
+    // -----------------------------------------------------------------------------------------
+#if defined(UCORO_ASAN_ENABLED)
+    // A suspended stack still has its frames' redzones poisoned, which memcpy's interceptor
+    // would report; copy byte by byte (volatile, so it is not turned back into memcpy).
+#if defined(_MSC_VER) && !defined(__clang__)
+    __declspec(no_sanitize_address)
+#else
+    __attribute__((no_sanitize_address))
+#endif
+    static void mco_copy_stack(void *dst, void const *src, std::size_t len)
+    {
+        auto *to = static_cast<unsigned char volatile *>(dst);
+        auto const *from = static_cast<unsigned char const *>(src);
+        for (std::size_t i = 0; i < len; ++i)
+            to[i] = from[i];
+    }
+#else
+    static void mco_copy_stack(void *dst, void const *src, std::size_t len) { std::memcpy(dst, src, len); }
+#endif
+
+    // Copies the occupant's live stack, from the red zone below its saved sp up to the top,
+    // into its save buffer (grown if it no longer fits) and frees the shared stack for someone else.
+    static mco_result mco_stash_stack(mco_coro *co)
+    {
+        mco_shared_stack *shared = co->shared_stack;
+        auto *base = static_cast<unsigned char *>(shared->base);
+        auto *top = base + shared->size;
+        auto *sp = static_cast<unsigned char *>(mco_ctx_sp(mco_context_of(co)->ctx));
+        sp -= std::min(mco_red_zone, static_cast<std::size_t>(sp - base));
+        auto const len = static_cast<std::size_t>(top - sp);
+        if (len > co->stack_copy_capacity)
+        {
+            std::size_t const capacity = mco_align_forward(len, mco_frame_align);
+            auto *copy = static_cast<unsigned char *>(std::malloc(capacity));
+            if (copy == nullptr)
+                return mco_result::out_of_memory;
+            std::free(co->stack_copy);
+            co->stack_copy = copy;
+            co->stack_copy_capacity = capacity;
+        }
+        mco_copy_stack(co->stack_copy, sp, len);
+        co->stack_copy_size = len;
+        co->stack_base = nullptr;
+        co->stack_block = nullptr;
+        shared->occupant = nullptr;
+        ++shared->copies;
+        return mco_result::success;
+    }
+
+    // Moves the current occupant off (it must be suspended: one still executing on the stack
+    // can't be) and puts co's frames back where they were, or a fresh context the first time.
+    static mco_result mco_attach_shared(mco_coro *co)
+    {
+        mco_shared_stack *shared = co->shared_stack;
+        if (!mco_can_enter(co))
+            return mco_result::invalid_operation;
+        if (shared->occupant != nullptr)
+        {
+            mco_result res = mco_stash_stack(shared->occupant);
+            if (res != mco_result::success)
+                return res;
+        }
+#if defined(UCORO_ASAN_ENABLED)
+        // drop the shadow the previous occupant's frames left behind
+        __asan_unpoison_memory_region(shared->base, shared->size);
+#endif
+        if (co->stack_copy == nullptr)
+        {
+            mco_result res = mco_makectx(co, &mco_context_of(co)->ctx, shared->base, shared->size);
+            if (res != mco_result::success)
+                return res;
+        }
+        else
+        {
+            mco_copy_stack(static_cast<unsigned char *>(shared->base) + shared->size - co->stack_copy_size, co->stack_copy, co->stack_copy_size);
+        }
+        shared->occupant = co;
+        co->stack_base = shared->base;
+        co->stack_block = shared->base; // so finishing releases it like a lazy stack
+        return mco_result::success;
+    }
+
+    static void mco_leave_shared(mco_coro *co)
+    {
+        if (co->shared_stack->occupant == co)
+            co->shared_stack->occupant = nullptr;
+        std::free(co->stack_copy);
+        co->stack_copy = nullptr;
+        co->stack_copy_size = 0;
+        co->stack_copy_capacity = 0;
+        co->stack_block = nullptr;
+        co->stack_base = nullptr;
+    }
+
+    mco_result mco_attach_stack(mco_coro *co)
+    {
+        if (co->shared_stack != nullptr && co->state == mco_state::suspended)
+            return mco_attach_shared(co);
+        if (co->stack_alloc_cb == nullptr || co->state != mco_state::suspended)
+            return mco_result::invalid_operation;
+        std::size_t const block_size = mco_stack_block_size(co->guard_size, co->stack_size);
+        auto *block = static_cast<unsigned char *>(co->stack_alloc_cb(block_size, co->allocator_data));
+        if (block == nullptr)
+            return mco_result::out_of_memory;
+        if (co->guard_size != 0 && co->guard_cb != nullptr && !co->guard_cb(block, co->guard_size, co->allocator_data))
+        {
+            co->dealloc_cb(block, block_size, co->allocator_data);
+            return mco_result::out_of_memory;
+        }
+        void *stack_base = co->guard_size != 0
+                               ? static_cast<void *>(block + co->guard_size)
+                               : reinterpret_cast<void *>(mco_align_forward(reinterpret_cast<std::uintptr_t>(block), 16));
+
+        if constexpr (stack_painting)
+            std::memset(stack_base, mco_stack_paint_byte, co->stack_size);
+
+        mco_result res = mco_makectx(co, &mco_context_of(co)->ctx, stack_base, co->stack_size);
+        if (res != mco_result::success)
+        {
+            co->dealloc_cb(block, block_size, co->allocator_data);
+            return res;
+        }
+        co->stack_block = block;
+        co->stack_base = stack_base;
+        return mco_result::success;
+    }
+
+    void mco_release_stack(mco_coro *co)
+    {
+        if (co->shared_stack != nullptr)
+            return mco_leave_shared(co);
+        if (co->stack_block == nullptr)
+            return;
+        if constexpr (stack_painting)
+            co->released_peak = mco_stack_peak(co);
+        co->dealloc_cb(co->stack_block, mco_stack_block_size(co->guard_size, co->stack_size), co->allocator_data);
+        co->stack_block = nullptr;
+        co->stack_base = nullptr;
+    }
+
     mco_result mco_uninit(mco_coro *co)
     {
         if (!co)
@@ -1419,6 +7178,15 @@ namespace coro::detail
         if (!(co->state == mco_state::suspended || co->state == mco_state::dead))
             return mco_result::invalid_operation;
         co->state = mco_state::dead;
+        mco_wake_all(co->done_waiters); // destroyed before finishing: nothing left to wait for
+        mco_release_stack(co);
+#if UCORO_TRACY
+        if (co->counters.fiber != nullptr)
+        {
+            mco_fiber_release(co->counters.fiber);
+            co->counters.fiber = nullptr;
+        }
+#endif
         return mco_result::success;
     }
 
@@ -1432,9 +7200,19 @@ namespace coro::detail
             return mco_result::invalid_arguments;
         }
 
-        mco_coro *co = static_cast<mco_coro *>(desc->alloc_cb(desc->coro_size, desc->allocator_data));
-        if (!co)
+        auto *block = static_cast<unsigned char *>(desc->alloc_cb(desc->coro_size, desc->allocator_data));
+        if (!block)
+        {
+            *out_co = nullptr;
+            return mco_result::out_of_memory;
+        }
+        // coro_size includes the slack for this unless the block is page-aligned already
+        auto *co = reinterpret_cast<mco_coro *>(mco_align_forward(reinterpret_cast<std::uintptr_t>(block), mco_frame_align));
+        // an unprotected guard would let an overflow run into the frame: fail instead
+        if (desc->guard_cb && desc->guard_size != 0 && !desc->lazy_stack &&
+            !desc->guard_cb(reinterpret_cast<unsigned char *>(co) + mco_guard_offset(desc), desc->guard_size, desc->allocator_data))
         {
+            desc->dealloc_cb(block, desc->coro_size, desc->allocator_data);
             *out_co = nullptr;
             return mco_result::out_of_memory;
         }
@@ -1442,10 +7220,11 @@ namespace coro::detail
         mco_result res = mco_init(co, desc);
         if (res != mco_result::success)
         {
-            desc->dealloc_cb(co, desc->coro_size, desc->allocator_data);
+            desc->dealloc_cb(block, desc->coro_size, desc->allocator_data);
             *out_co = nullptr;
             return res;
         }
+        co->frame_offset = static_cast<std::size_t>(reinterpret_cast<unsigned char *>(co) - block);
         *out_co = co;
         return mco_result::success;
     }
@@ -1459,7 +7238,7 @@ namespace coro::detail
             return res;
         if (!co->dealloc_cb)
             return mco_result::invalid_pointer;
-        co->dealloc_cb(co, co->coro_size, co->allocator_data);
+        co->dealloc_cb(reinterpret_cast<unsigned char *>(co) - co->frame_offset, co->coro_size, co->allocator_data);
         return mco_result::success;
     }
 
@@ -1469,34 +7248,34 @@ namespace coro::detail
             return mco_result::invalid_coroutine;
         if (co->state != mco_state::suspended)
             return mco_result::not_suspended;
+        if (co->stack_base == nullptr)
+        {
+            mco_result res = mco_attach_stack(co);
+            if (res != mco_result::success)
+                return res;
+        }
         co->state = mco_state::running;
         mco_jumpin(co);
+        if (co->state == mco_state::dead)
+            mco_release_stack(co);
         return mco_result::success;
     }
 
-// Detect ASan
-#if defined(__has_feature)
-#if __has_feature(address_sanitizer)
-#define UCORO_ASAN_ENABLED
-#endif
-#endif
-#if defined(__SANITIZE_ADDRESS__) && !defined(UCORO_ASAN_ENABLED)
-#define UCORO_ASAN_ENABLED
-#endif
-
     mco_result mco_yield(mco_coro *co)
     {
         if (!co)
             return mco_result::invalid_coroutine;
 
 #ifndef UCORO_ASAN_ENABLED
-        // Check for stack overflow if not running under ASan
+        // Check for stack overflow if not running under ASan: both checks read only the
+        // header's first line. Guarded stacks pass the range check unless sp has gone astray.
+        if (co->magic_number != magic_number)
+            return mco_result::stack_overflow;
         volatile std::size_t dummy;
         std::uintptr_t stack_addr = reinterpret_cast<std::uintptr_t>(&dummy);
         std::uintptr_t stack_min = reinterpret_cast<std::uintptr_t>(co->stack_base);
         std::uintptr_t stack_max = stack_min + co->stack_size;
-
-        if (co->magic_number != magic_number || stack_addr < stack_min || stack_addr > stack_max)
+        if (stack_addr < stack_min || stack_addr > stack_max)
             return mco_result::stack_overflow;
 #endif
 
@@ -1507,6 +7286,27 @@ namespace coro::detail
         return mco_result::success;
     }
 
+    mco_result mco_transfer(mco_coro *from, mco_coro *to)
+    {
+        if (!from || !to)
+            return mco_result::invalid_coroutine;
+        if (from == to)
+            return mco_result::invalid_operation;
+        if (from->state != mco_state::running || from != mco_get_current_co())
+            return mco_result::not_running;
+        if (to->state != mco_state::suspended)
+            return mco_result::not_suspended;
+        if (to->stack_base == nullptr)
+        {
+            mco_result res = mco_attach_stack(to);
+            if (res != mco_result::success)
+                return res;
+        }
+        mco_prepare_transfer(from, to);
+        _mco_switch(&mco_context_of(from)->ctx, &mco_context_of(to)->ctx);
+        return mco_result::success;
+    }
+
     mco_state mco_status(mco_coro *co) { return co ? co->state : mco_state::dead; }
     void *mco_get_user_data(mco_coro *co) { return co ? co->user_data : nullptr; }
 
@@ -1522,7 +7322,7 @@ namespace coro::detail
             if (!src)
                 return mco_result::invalid_pointer;
             std::memcpy(&co->storage[co->bytes_stored], src, len);
-            co->bytes_stored = bytes_stored;
+            co->bytes_stored = static_cast<std::uint32_t>(bytes_stored);
         }
         return mco_result::success;
     }
@@ -1538,7 +7338,7 @@ namespace coro::detail
             std::size_t bytes_stored = co->bytes_stored - len;
             if (dest)
                 std::memcpy(dest, &co->storage[bytes_stored], len);
-            co->bytes_stored = bytes_stored;
+            co->bytes_stored = static_cast<std::uint32_t>(bytes_stored);
         }
         return mco_result::success;
     }
@@ -1560,7 +7360,7 @@ namespace coro::detail
 
     std::size_t mco_get_bytes_stored(mco_coro *co) { return co ? co->bytes_stored : 0; }
     std::size_t mco_get_storage_size(mco_coro *co) { return co ? co->storage_size : 0; }
-    mco_coro *mco_running(void) { return mco_current_co; }
+    mco_coro *mco_running(void) { return mco_get_current_co(); }
 
 } // namespace coro::detail
 
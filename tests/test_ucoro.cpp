@@ -9,15 +9,32 @@
 // define implementation before including the wrapper
 #define UCORO_IMPL
 #include "ucoro/ucoro.hpp"
+#include "ucoro/io.hpp"
 
 #include <array>
 #include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <memory>
 #include <fmt/core.h>
 #include <numeric>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <stop_token>
 #include <string>
 #include <thread>
+#include <variant>
 #include <vector>
 
+#if defined(__linux__)
+#include <netinet/in.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
 // ============================================================================
 // error enum tests
 // ============================================================================
@@ -39,6 +56,11 @@ TEST_SUITE("error enum")
         CHECK(coro::to_string(coro::error::invalid_arguments) == "invalid arguments");
         CHECK(coro::to_string(coro::error::invalid_operation) == "invalid operation");
         CHECK(coro::to_string(coro::error::stack_overflow) == "stack overflow");
+        CHECK(coro::to_string(coro::error::closed) == "closed");
+        CHECK(coro::to_string(coro::error::would_block) == "would block");
+        CHECK(coro::to_string(coro::error::io_error) == "I/O error");
+        CHECK(coro::to_string(coro::error::timeout) == "timed out");
+        CHECK(coro::to_string(coro::error::cancelled) == "cancelled");
     }
 
     TEST_CASE("comparison operators work")
@@ -611,6 +633,440 @@ TEST_SUITE("generator")
     }
 }
 
+// ============================================================================
+// ref_generator tests
+// ============================================================================
+
+namespace
+{
+    struct big_record
+    {
+        std::array<std::uint64_t, 1024> words; // 8 KiB: too big for storable
+        int id;
+    };
+}
+
+TEST_SUITE("ref_generator")
+{
+    TEST_CASE("large records are read in place")
+    {
+        static_assert(!coro::storable<big_record>);
+        std::vector<big_record const *> producer_addresses;
+
+        auto gen = coro::ref_generator<big_record>::create([&producer_addresses](coro::coroutine_handle h)
+                                                           {
+            big_record record{};
+            for (int i = 0; i < 3; ++i)
+            {
+                record.id = i;
+                record.words.back() = static_cast<std::uint64_t>(i) * 100;
+                producer_addresses.push_back(&record);
+                [[maybe_unused]] auto _ = coro::yield_ref(h, record);
+            } });
+        REQUIRE(gen.has_value());
+
+        std::vector<int> ids;
+        std::vector<big_record const *> consumer_addresses;
+        for (auto const &record : *gen)
+        {
+            ids.push_back(record.id);
+            CHECK(record.words.back() == static_cast<std::uint64_t>(record.id) * 100);
+            consumer_addresses.push_back(&record);
+        }
+        CHECK(ids == std::vector<int>{0, 1, 2});
+        CHECK(consumer_addresses == producer_addresses);
+        CHECK(gen->done());
+    }
+
+    TEST_CASE("non-trivial types and temporaries can be yielded")
+    {
+        auto gen = coro::ref_generator<std::string>::create([](coro::coroutine_handle h)
+                                                            {
+            [[maybe_unused]] auto _ = coro::yield_ref(h, std::string{"a temporary that outlives the yield"});
+            std::string local = "local";
+            _ = coro::yield_ref(h, local); });
+        REQUIRE(gen.has_value());
+
+        auto first = gen->next();
+        REQUIRE(first.has_value());
+        REQUIRE(*first != nullptr);
+        CHECK(**first == "a temporary that outlives the yield");
+
+        auto second = gen->next();
+        REQUIRE(second.has_value());
+        REQUIRE(*second != nullptr);
+        CHECK((*second)->size() == 5);
+
+        auto end = gen->next();
+        REQUIRE(end.has_value());
+        CHECK(*end == nullptr);
+        auto after = gen->next();
+        REQUIRE(after.has_value());
+        CHECK(*after == nullptr);
+    }
+
+    TEST_CASE("empty ref_generator")
+    {
+        auto gen = coro::ref_generator<int>::create([](coro::coroutine_handle) {});
+        REQUIRE(gen.has_value());
+        int count = 0;
+        for ([[maybe_unused]] auto const &v : *gen)
+            ++count;
+        CHECK(count == 0);
+    }
+}
+
+// ============================================================================
+// batch_generator tests
+// ============================================================================
+
+TEST_SUITE("batch_generator")
+{
+    TEST_CASE("values arrive in batches sized by storage")
+    {
+        auto gen = coro::batch_generator<std::uint32_t>::create([](coro::coroutine_handle h)
+                                                                {
+            for (std::uint32_t i = 0; i < 10; ++i)
+                [[maybe_unused]] auto _ = coro::yield_batched(h, i); },
+                                                                coro::storage_size{4 * sizeof(std::uint32_t)});
+        REQUIRE(gen.has_value());
+        CHECK(gen->capacity() == 4);
+
+        std::vector<std::size_t> sizes;
+        std::vector<std::uint32_t> values;
+        while (true)
+        {
+            auto batch = gen->next();
+            REQUIRE(batch.has_value());
+            if (batch->empty())
+                break;
+            sizes.push_back(batch->size());
+            values.insert(values.end(), batch->begin(), batch->end());
+        }
+        CHECK(sizes == std::vector<std::size_t>{4, 4, 2});
+        CHECK(values == std::vector<std::uint32_t>{0, 1, 2, 3, 4, 5, 6, 7, 8, 9});
+        CHECK(gen->done());
+    }
+
+    TEST_CASE("range-for is element at a time")
+    {
+        auto gen = coro::batch_generator<int>::create([](coro::coroutine_handle h)
+                                                      {
+            for (int i = 0; i < 1000; ++i)
+                [[maybe_unused]] auto _ = coro::yield_batched(h, i); });
+        REQUIRE(gen.has_value());
+        CHECK(gen->capacity() == coro::default_storage_size.value / sizeof(int));
+
+        int expected = 0;
+        bool in_order = true;
+        for (int v : *gen)
+            in_order = in_order && v == expected++;
+        CHECK(in_order);
+        CHECK(expected == 1000);
+    }
+
+    TEST_CASE("flush_batch hands over a partial batch")
+    {
+        auto gen = coro::batch_generator<int>::create([](coro::coroutine_handle h)
+                                                      {
+            [[maybe_unused]] auto _ = coro::yield_batched(h, 1);
+            _ = coro::flush_batch(h);
+            _ = coro::flush_batch(h); // nothing pending: no switch
+            _ = coro::yield_batched(h, 2); });
+        REQUIRE(gen.has_value());
+
+        auto first = gen->next();
+        REQUIRE(first.has_value());
+        REQUIRE(first->size() == 1);
+        CHECK((*first)[0] == 1);
+
+        auto second = gen->next();
+        REQUIRE(second.has_value());
+        REQUIRE(second->size() == 1);
+        CHECK((*second)[0] == 2);
+        CHECK(gen->done());
+    }
+
+    TEST_CASE("storage smaller than one value is rejected")
+    {
+        auto gen = coro::batch_generator<std::uint64_t>::create([](coro::coroutine_handle) {}, coro::storage_size{4});
+        CHECK_FALSE(gen.has_value());
+        CHECK(gen.error() == coro::error::invalid_arguments);
+    }
+
+    TEST_CASE("empty producer yields no batches")
+    {
+        auto gen = coro::batch_generator<int>::create([](coro::coroutine_handle) {});
+        REQUIRE(gen.has_value());
+        int count = 0;
+        for ([[maybe_unused]] int v : *gen)
+            ++count;
+        CHECK(count == 0);
+    }
+}
+
+// ============================================================================
+// generator combinator tests
+// ============================================================================
+
+namespace
+{
+    // Yields 0..count-1 and counts how many times the producer was resumed past its start.
+    auto counting_source(int count, int &resumes)
+    {
+        return coro::generator<int>::create([count, &resumes](coro::coroutine_handle h)
+                                            {
+            for (int i = 0; i < count; ++i)
+            {
+                [[maybe_unused]] auto _ = coro::yield_value(h, i);
+                ++resumes;
+            } });
+    }
+}
+
+TEST_SUITE("generator combinators")
+{
+    static_assert(std::ranges::input_range<coro::generator<int>>);
+    static_assert(std::ranges::input_range<coro::ref_generator<int>>);
+    static_assert(std::ranges::input_range<coro::batch_generator<int>>);
+
+    TEST_CASE("map, filter and take fuse into one pass")
+    {
+        int resumes = 0;
+        auto gen = counting_source(100, resumes);
+        REQUIRE(gen.has_value());
+
+        auto pipeline = *gen | coro::map([](int x) { return x * 3; }) | coro::filter([](int x) { return x % 2 == 0; }) | coro::take(4);
+        static_assert(std::ranges::input_range<decltype(pipeline)>);
+        static_assert(std::ranges::view<decltype(pipeline)>);
+
+        std::vector<int> values;
+        std::ranges::copy(pipeline, std::back_inserter(values));
+        CHECK(values == std::vector<int>{0, 6, 12, 18});
+        // 0..6 were produced; take stops at 6 without resuming the producer again.
+        CHECK(resumes == 6);
+        CHECK_FALSE(gen->done());
+    }
+
+    TEST_CASE("take never resumes past the last element")
+    {
+        int resumes = 0;
+        auto gen = counting_source(10, resumes);
+        REQUIRE(gen.has_value());
+        int sum = 0;
+        for (int v : *gen | coro::take(3))
+            sum += v;
+        CHECK(sum == 3);
+        CHECK(resumes == 2);
+
+        auto empty = counting_source(10, resumes);
+        REQUIRE(empty.has_value());
+        CHECK(std::ranges::distance(*empty | coro::take(0)) == 0);
+        CHECK(std::ranges::distance(*empty | coro::take(50)) == 10);
+    }
+
+    TEST_CASE("enumerate pairs indices with references")
+    {
+        std::vector<std::string> words{"a", "bb", "ccc"};
+        std::vector<std::size_t> indices;
+        for (auto [i, word] : words | coro::enumerate())
+        {
+            CHECK(&word == &words[i]);
+            indices.push_back(i);
+        }
+        CHECK(indices == std::vector<std::size_t>{0, 1, 2});
+    }
+
+    TEST_CASE("zip ends with the shorter input")
+    {
+        int resumes = 0;
+        auto left = counting_source(5, resumes);
+        auto right = coro::generator<int>::create([](coro::coroutine_handle h)
+                                                  {
+            for (int i = 1; i <= 3; ++i)
+                [[maybe_unused]] auto _ = coro::yield_value(h, i * 100); });
+        REQUIRE(left.has_value());
+        REQUIRE(right.has_value());
+
+        std::vector<std::pair<int, int>> pairs;
+        for (auto [a, b] : *left | coro::zip(std::move(*right)))
+            pairs.emplace_back(a, b);
+        CHECK(pairs == std::vector<std::pair<int, int>>{{0, 100}, {1, 200}, {2, 300}});
+    }
+
+    TEST_CASE("flatten concatenates generated generators")
+    {
+        std::vector<int> counts{2, 0, 3, 1};
+        auto nested = counts | coro::map([](int n)
+                                         { return *coro::generator<int>::create([n](coro::coroutine_handle h)
+                                                                                {
+            for (int i = 0; i < n; ++i)
+                [[maybe_unused]] auto _ = coro::yield_value(h, n * 10 + i); }); }) |
+                      coro::flatten();
+        std::vector<int> values;
+        for (int v : nested)
+            values.push_back(v);
+        CHECK(values == std::vector<int>{20, 21, 30, 31, 32, 10});
+
+        std::vector<std::vector<int>> empties(3);
+        CHECK(std::ranges::distance(empties | coro::flatten()) == 0);
+    }
+
+    TEST_CASE("pipelines work with std::ranges algorithms")
+    {
+        auto gen = coro::generator<int>::create([](coro::coroutine_handle h)
+                                                {
+            for (int i = 0; i < 50; ++i)
+                [[maybe_unused]] auto _ = coro::yield_value(h, i); });
+        REQUIRE(gen.has_value());
+        auto squares = *gen | coro::map([](int x) { return x * x; });
+        auto it = std::ranges::find_if(squares, [](int x) { return x > 200; });
+        REQUIRE(it != squares.end());
+        CHECK(*it == 225);
+
+        auto batches = coro::batch_generator<int>::create([](coro::coroutine_handle h)
+                                                          {
+            for (int i = 0; i < 1000; ++i)
+                [[maybe_unused]] auto _ = coro::yield_batched(h, i); });
+        REQUIRE(batches.has_value());
+        CHECK(std::ranges::count_if(*batches | coro::filter([](int x) { return x % 7 == 0; }), [](int) { return true; }) == 143);
+
+        int total = 0;
+        std::vector<int> plain{1, 2, 3, 4};
+        std::ranges::for_each(plain | coro::take(2) | coro::map([](int x) { return x + 1; }), [&total](int x) { total += x; });
+        CHECK(total == 5);
+    }
+}
+
+// ============================================================================
+// typed_coroutine tests
+// ============================================================================
+
+TEST_SUITE("typed_coroutine")
+{
+    TEST_CASE("call sends a request and returns the reply")
+    {
+        auto doubler = coro::typed_coroutine<int, long>::create([](coro::typed_handle<int, long> h)
+                                                               {
+            int request = h.receive();
+            while (true)
+            {
+                auto next = h.reply(static_cast<long>(request) * 2);
+                if (!next)
+                    return;
+                request = *next;
+            } });
+        REQUIRE(doubler.has_value());
+        for (int i = 0; i < 10; ++i)
+        {
+            auto reply = doubler->call(i);
+            REQUIRE(reply.has_value());
+            CHECK(*reply == 2L * i);
+        }
+        CHECK(doubler->suspended());
+    }
+
+    TEST_CASE("the frame holds exactly the two slots")
+    {
+        auto typed = coro::typed_coroutine<int, int>::create([](coro::typed_handle<int, int>) {});
+        auto plain = coro::coroutine::create([](coro::coroutine_handle) {});
+        REQUIRE(typed.has_value());
+        REQUIRE(plain.has_value());
+        CHECK(typed->handle().storage_capacity() == sizeof(int) * 2);
+        CHECK(plain->raw()->coro_size - typed->raw()->coro_size >= coro::default_storage_size.value - 16);
+    }
+
+    TEST_CASE("struct messages and the unchecked calls")
+    {
+        struct request
+        {
+            std::uint16_t port;
+            std::uint32_t length;
+        };
+        struct verdict
+        {
+            bool accept;
+            std::uint32_t budget;
+        };
+
+        auto filter = coro::typed_coroutine<request, verdict>::create([](coro::typed_handle<request, verdict> h)
+                                                                     {
+            std::uint32_t budget = 100;
+            request r = h.receive();
+            while (true)
+            {
+                bool const accept = r.port == 443 && r.length <= budget;
+                if (accept)
+                    budget -= r.length;
+                r = h.reply_unchecked(verdict{accept, budget});
+            } });
+        REQUIRE(filter.has_value());
+
+        auto v = filter->call_unchecked(request{443, 60});
+        CHECK(v.accept);
+        CHECK(v.budget == 40);
+        v = filter->call_unchecked(request{80, 1});
+        CHECK_FALSE(v.accept);
+        v = filter->call_unchecked(request{443, 60});
+        CHECK_FALSE(v.accept);
+        CHECK(v.budget == 40);
+    }
+
+    TEST_CASE("send, resume and receive separately")
+    {
+        auto c = coro::typed_coroutine<int, int>::create([](coro::typed_handle<int, int> h)
+                                                        {
+            h.send(h.receive() + 1);
+            [[maybe_unused]] auto _ = h.yield();
+            h.send(h.receive() * 10); });
+        REQUIRE(c.has_value());
+        CHECK(c->receive() == 0); // slots start value-initialised
+        c->send(1);
+        REQUIRE(c->resume().has_value());
+        CHECK(c->receive() == 2);
+        c->send(5);
+        REQUIRE(c->resume().has_value());
+        CHECK(c->receive() == 50);
+        CHECK(c->done());
+
+        auto late = c->call(7);
+        REQUIRE_FALSE(late.has_value());
+        CHECK(late.error() == coro::error::not_suspended);
+    }
+
+    TEST_CASE("frames can come from a stack allocator")
+    {
+        coro::malloc_allocator alloc;
+        int seen = 0;
+        auto c = coro::typed_coroutine<int, int>::create([&seen](coro::typed_handle<int, int> h)
+                                                        { seen = h.receive(); },
+                                                        coro::default_stack_size, alloc);
+        REQUIRE(c.has_value());
+        auto reply = c->call(9);
+        REQUIRE(reply.has_value());
+        CHECK(seen == 9);
+        CHECK(c->done());
+    }
+
+    TEST_CASE("released coroutine runs on a task_runner")
+    {
+        int total = 0;
+        auto c = coro::typed_coroutine<int, int>::create([&total](coro::typed_handle<int, int> h)
+                                                        {
+            for (int i = 0; i < 3; ++i)
+            {
+                total += h.receive();
+                [[maybe_unused]] auto _ = h.yield();
+            } });
+        REQUIRE(c.has_value());
+        c->send(4);
+        coro::task_runner runner;
+        runner.add(std::move(*c).release());
+        REQUIRE(runner.run().has_value());
+        CHECK(total == 12);
+    }
+}
+
 // ============================================================================
 // task_runner tests
 // ============================================================================
@@ -746,6 +1202,4406 @@ TEST_SUITE("task_runner")
         CHECK(log[2] == "long-2");
         CHECK(log[3] == "long-3");
     }
+
+    TEST_CASE("parked task is not resumed until woken")
+    {
+        int resumes = 0;
+        coro::coroutine_handle sleeper;
+        coro::task_runner runner;
+
+        auto task = coro::coroutine::create([&](coro::coroutine_handle h)
+                                            {
+            sleeper = h;
+            ++resumes;
+            [[maybe_unused]] auto _ = h.park();
+            ++resumes; });
+        REQUIRE(task.has_value());
+        runner.add(std::move(*task));
+
+        REQUIRE(runner.run().has_value());
+        CHECK(resumes == 1);
+        CHECK(runner.size() == 1);
+        CHECK(runner.parked() == 1);
+        CHECK(runner.ready() == 0);
+
+        auto again = runner.step();
+        REQUIRE(again.has_value());
+        CHECK(*again);
+        CHECK(resumes == 1);
+
+        REQUIRE(runner.wake(sleeper).has_value());
+        CHECK(runner.parked() == 0);
+        CHECK(runner.ready() == 1);
+        REQUIRE(runner.run().has_value());
+        CHECK(resumes == 2);
+        CHECK(runner.empty());
+    }
+
+    TEST_CASE("tasks wake each other")
+    {
+        std::vector<int> order;
+        coro::coroutine_handle consumer;
+        coro::task_runner runner;
+
+        auto cons = coro::coroutine::create([&](coro::coroutine_handle h)
+                                            {
+            consumer = h;
+            order.push_back(1);
+            [[maybe_unused]] auto _ = h.park();
+            order.push_back(4); });
+        auto prod = coro::coroutine::create([&](coro::coroutine_handle h)
+                                            {
+            order.push_back(2);
+            [[maybe_unused]] auto _ = h.yield();
+            order.push_back(3);
+            _ = runner.wake(consumer); });
+        REQUIRE(cons.has_value());
+        REQUIRE(prod.has_value());
+        runner.add(std::move(*cons));
+        runner.add(std::move(*prod));
+
+        REQUIRE(runner.run().has_value());
+        CHECK(order == std::vector<int>{1, 2, 3, 4});
+        CHECK(runner.empty());
+    }
+
+    TEST_CASE("wake before park is not lost")
+    {
+        int parks_returned = 0;
+        coro::task_runner runner;
+        auto task = coro::coroutine::create([&parks_returned](coro::coroutine_handle h)
+                                            {
+            [[maybe_unused]] auto _ = h.yield();
+            _ = h.park(); // already notified: returns without suspending
+            ++parks_returned; });
+        REQUIRE(task.has_value());
+        auto handle = task->handle();
+        runner.add(std::move(*task));
+
+        REQUIRE(runner.step().has_value());
+        REQUIRE(runner.wake(handle).has_value());
+        REQUIRE(runner.run().has_value());
+        CHECK(parks_returned == 1);
+        CHECK(runner.empty());
+        CHECK(runner.parked() == 0);
+    }
+
+    TEST_CASE("wake rejects foreign and null handles")
+    {
+        coro::task_runner runner;
+        auto stranger = coro::coroutine::create([](coro::coroutine_handle) {});
+        REQUIRE(stranger.has_value());
+
+        auto foreign = runner.wake(stranger->handle());
+        CHECK_FALSE(foreign.has_value());
+        CHECK(foreign.error() == coro::error::invalid_operation);
+
+        auto null = runner.wake(coro::coroutine_handle{});
+        CHECK_FALSE(null.has_value());
+        CHECK(null.error() == coro::error::invalid_coroutine);
+    }
+
+    TEST_CASE("parked tasks cost nothing per step")
+    {
+        constexpr int sleepers = 1000;
+        int sleeper_resumes = 0;
+        int busy_resumes = 0;
+        std::vector<coro::coroutine_handle> handles;
+        coro::task_runner runner;
+
+        for (int i = 0; i < sleepers; ++i)
+        {
+            auto c = coro::coroutine::create([&sleeper_resumes](coro::coroutine_handle h)
+                                             {
+                ++sleeper_resumes;
+                [[maybe_unused]] auto _ = h.park();
+                ++sleeper_resumes; });
+            REQUIRE(c.has_value());
+            handles.push_back(c->handle());
+            runner.add(std::move(*c));
+        }
+        auto busy = coro::coroutine::create([&busy_resumes](coro::coroutine_handle h)
+                                            {
+            for (int i = 0; i < 10; ++i)
+            {
+                ++busy_resumes;
+                [[maybe_unused]] auto _ = h.yield();
+            } });
+        REQUIRE(busy.has_value());
+        runner.add(std::move(*busy));
+
+        (void)runner.step(); // everyone runs once; sleepers park
+        CHECK(sleeper_resumes == sleepers);
+        CHECK(runner.parked() == sleepers);
+
+        for (int i = 0; i < 5; ++i)
+            (void)runner.step();
+        CHECK(sleeper_resumes == sleepers);
+        CHECK(busy_resumes == 6);
+
+        for (auto h : handles)
+            REQUIRE(runner.wake(h).has_value());
+        REQUIRE(runner.run().has_value());
+        CHECK(sleeper_resumes == 2 * sleepers);
+        CHECK(runner.empty());
+    }
+
+    TEST_CASE("finishing tasks out of order keeps the rest scheduled")
+    {
+        constexpr int tasks = 500;
+        int finished = 0;
+        coro::task_runner runner;
+        for (int i = 0; i < tasks; ++i)
+        {
+            auto c = coro::coroutine::create([&finished, i](coro::coroutine_handle h)
+                                             {
+                for (int s = 0; s < (i * 7) % 13; ++s)
+                    [[maybe_unused]] auto _ = h.yield();
+                ++finished; });
+            REQUIRE(c.has_value());
+            runner.add(std::move(*c));
+        }
+        REQUIRE(runner.run().has_value());
+        CHECK(finished == tasks);
+        CHECK(runner.empty());
+    }
+
+    TEST_CASE("moved runner still wakes its tasks")
+    {
+        bool done = false;
+        coro::coroutine_handle sleeper;
+        coro::task_runner first;
+        auto task = coro::coroutine::create([&](coro::coroutine_handle h)
+                                            {
+            sleeper = h;
+            [[maybe_unused]] auto _ = h.park();
+            done = true; });
+        REQUIRE(task.has_value());
+        first.add(std::move(*task));
+        REQUIRE(first.run().has_value());
+
+        coro::task_runner second{std::move(first)};
+        CHECK(second.parked() == 1);
+        REQUIRE(second.wake(sleeper).has_value());
+        REQUIRE(second.run().has_value());
+        CHECK(done);
+    }
+
+    TEST_CASE("parking hands off to the next ready task without breaking step")
+    {
+        std::vector<int> order;
+        coro::coroutine_handle first_handle;
+        coro::task_runner runner;
+
+        auto first = coro::coroutine::create([&](coro::coroutine_handle h)
+                                             {
+            order.push_back(1);
+            [[maybe_unused]] auto _ = h.park();
+            order.push_back(4); });
+        auto second = coro::coroutine::create([&](coro::coroutine_handle h)
+                                              {
+            order.push_back(2);
+            REQUIRE(runner.wake(first_handle).has_value());
+            [[maybe_unused]] auto _ = h.park();
+            order.push_back(5); });
+        REQUIRE(first.has_value());
+        REQUIRE(second.has_value());
+        first_handle = first->handle();
+        auto second_handle = second->handle();
+        runner.add(std::move(*first)).add(std::move(*second));
+
+        // both were ready at the start; first is woken mid-step and must wait for the next one
+        REQUIRE(runner.step().has_value());
+        order.push_back(3);
+        CHECK(runner.ready() == 1);
+        CHECK(runner.parked() == 1);
+
+        REQUIRE(runner.step().has_value());
+        CHECK(runner.size() == 1);
+        REQUIRE(runner.wake(second_handle).has_value());
+        REQUIRE(runner.run().has_value());
+        CHECK(runner.empty());
+        CHECK(runner.parked() == 0);
+        CHECK(order == std::vector<int>{1, 2, 3, 4, 5});
+    }
+
+    TEST_CASE("post hands coroutines over from other threads")
+    {
+        coro::task_runner runner;
+        std::stop_source stop;
+        std::atomic<int> ran{0};
+        constexpr int per_thread = 100;
+
+        std::vector<std::thread> producers;
+        for (int t = 0; t < 4; ++t)
+            producers.emplace_back([&]
+                                   {
+                for (int i = 0; i < per_thread; ++i)
+                    REQUIRE(runner.post([&](coro::coroutine_handle)
+                                        { if (ran.fetch_add(1) + 1 == 4 * per_thread) stop.request_stop(); })
+                                .has_value()); });
+
+        REQUIRE(runner.run(stop.get_token()).has_value());
+        for (auto &t : producers)
+            t.join();
+        CHECK(ran.load() == 4 * per_thread);
+        CHECK(runner.empty());
+    }
+
+    TEST_CASE("post keeps each producer's order")
+    {
+        coro::task_runner runner;
+        std::vector<int> order;
+        std::thread producer{[&]
+                             {
+            for (int i = 0; i < 3; ++i)
+                REQUIRE(runner.post([&order, i](coro::coroutine_handle)
+                                    { order.push_back(i); })
+                            .has_value()); }};
+        producer.join();
+        CHECK(runner.size() == 0); // nothing is adopted before the runner's next tick
+        REQUIRE(runner.run().has_value());
+        CHECK(order == std::vector<int>{0, 1, 2});
+    }
+
+    TEST_CASE("wake_remote resumes a parked task from another thread")
+    {
+        coro::task_runner runner;
+        std::stop_source stop;
+        std::thread waker;
+        bool woken = false;
+
+        auto task = coro::coroutine::create([&](coro::coroutine_handle h)
+                                            {
+            waker = std::thread{[&runner, h]
+                                { REQUIRE(runner.wake_remote(h).has_value()); }};
+            REQUIRE(h.park().has_value());
+            woken = true;
+            stop.request_stop(); });
+        REQUIRE(task.has_value());
+        runner.add(std::move(*task));
+
+        REQUIRE(runner.run(stop.get_token()).has_value());
+        waker.join();
+        CHECK(woken);
+        CHECK(runner.empty());
+        CHECK(runner.parked() == 0);
+    }
+
+    TEST_CASE("a remote wake cuts the idle sleep short")
+    {
+        using namespace std::chrono_literals;
+        coro::task_runner runner;
+        bool woken = false;
+
+        // the sleeper keeps run() asleep for 10s unless the posted task cancels it
+        auto sleeper = coro::coroutine::create([](coro::coroutine_handle h)
+                                               { CHECK(coro::sleep_for(h, 10s).error() == coro::error::cancelled); });
+        auto waiter = coro::coroutine::create([&](coro::coroutine_handle h)
+                                              {
+            REQUIRE(h.park().has_value());
+            woken = true; });
+        REQUIRE(sleeper.has_value());
+        REQUIRE(waiter.has_value());
+        auto const sleeper_handle = sleeper->handle();
+        auto const waiter_handle = waiter->handle();
+        runner.add(std::move(*sleeper)).add(std::move(*waiter));
+        REQUIRE(runner.step().has_value());
+
+        auto const start = std::chrono::steady_clock::now();
+        std::thread remote{[&]
+                           {
+            std::this_thread::sleep_for(5ms);
+            REQUIRE(runner.wake_remote(waiter_handle).has_value());
+            REQUIRE(runner.post([sleeper_handle](coro::coroutine_handle)
+                                { REQUIRE(sleeper_handle.cancel().has_value()); })
+                        .has_value()); }};
+        REQUIRE(runner.run().has_value());
+        remote.join();
+        CHECK(woken);
+        CHECK(runner.empty());
+        CHECK(std::chrono::steady_clock::now() - start < 5s);
+    }
+
+    TEST_CASE("run with a stop token returns once stop is requested")
+    {
+        using namespace std::chrono_literals;
+        coro::task_runner runner;
+        std::stop_source stop;
+        std::thread stopper{[&]
+                            {
+            std::this_thread::sleep_for(5ms);
+            stop.request_stop(); }};
+        REQUIRE(runner.run(stop.get_token()).has_value());
+        stopper.join();
+        CHECK(runner.empty());
+    }
+}
+
+// ============================================================================
+// scheduling policy tests
+// ============================================================================
+
+namespace
+{
+    // Appends id to order on every resume, yielding between them.
+    auto logging_task(std::vector<int> &order, int id, int resumes)
+    {
+        return [&order, id, resumes](coro::coroutine_handle h)
+        {
+            for (int i = 0; i < resumes; ++i)
+            {
+                order.push_back(id);
+                if (i + 1 != resumes)
+                    [[maybe_unused]] auto _ = h.yield();
+            }
+        };
+    }
+
+    // round_robin whose reserve() runs out of memory on request.
+    struct strained_policy : coro::round_robin
+    {
+        static inline bool out_of_memory = false;
+
+        void reserve(std::size_t n)
+        {
+            if (out_of_memory)
+                throw std::bad_alloc{};
+            round_robin::reserve(n);
+        }
+    };
+}
+
+TEST_SUITE("scheduling policies")
+{
+    TEST_CASE("shipped policies model scheduling_policy")
+    {
+        static_assert(coro::scheduling_policy<coro::round_robin>);
+        static_assert(coro::scheduling_policy<coro::priority_levels<>>);
+        static_assert(coro::scheduling_policy<coro::earliest_deadline>);
+        static_assert(coro::scheduling_policy<coro::fair_share<>>);
+        static_assert(!coro::scheduling_policy<int>);
+        static_assert(std::same_as<coro::task_runner, coro::basic_task_runner<coro::round_robin>>);
+    }
+
+    TEST_CASE("priority_levels runs the most urgent level first, FIFO within one")
+    {
+        std::vector<int> order;
+        coro::basic_task_runner<coro::priority_levels<4>> runner;
+        runner.add(std::move(*coro::coroutine::create(logging_task(order, 30, 1))), coro::priority{3});
+        runner.add(std::move(*coro::coroutine::create(logging_task(order, 10, 2))), coro::priority{1});
+        runner.add(std::move(*coro::coroutine::create(logging_task(order, 11, 2))), coro::priority{1});
+        runner.add(std::move(*coro::coroutine::create(logging_task(order, 0, 1))), coro::priority{0});
+        runner.add(std::move(*coro::coroutine::create(logging_task(order, 99, 1))), coro::priority{42}); // clamped to 3
+        REQUIRE(runner.ready() == 5);
+
+        REQUIRE(runner.run().has_value());
+        CHECK((order == std::vector<int>{0, 10, 11, 10, 11, 30, 99}));
+    }
+
+    TEST_CASE("priority_levels lets a woken urgent task overtake queued bulk work in the same step")
+    {
+        std::vector<int> order;
+        coro::basic_task_runner<coro::priority_levels<>> runner;
+        coro::coroutine_handle urgent;
+        runner.add(std::move(*coro::coroutine::create([&](coro::coroutine_handle h)
+                                                      {
+            urgent = h;
+            [[maybe_unused]] auto _ = h.park();
+            order.push_back(0); })),
+                   coro::priority{0});
+        REQUIRE(runner.step().has_value()); // urgent parks
+        REQUIRE(runner.parked() == 1);
+
+        runner.add(std::move(*coro::coroutine::create([&](coro::coroutine_handle)
+                                                      {
+            order.push_back(1);
+            (void)runner.wake(urgent); })),
+                   coro::priority{10});
+        for (int id = 2; id < 5; ++id)
+            runner.add(std::move(*coro::coroutine::create(logging_task(order, id, 1))), coro::priority{10});
+
+        REQUIRE(runner.step().has_value());
+        REQUIRE(runner.step().has_value());
+        CHECK((order == std::vector<int>{1, 0, 2, 3, 4}));
+        CHECK(runner.empty());
+    }
+
+    TEST_CASE("earliest_deadline orders by deadline and set_key moves the next one")
+    {
+        using namespace std::chrono_literals;
+        auto const now = std::chrono::steady_clock::now();
+        std::vector<int> order;
+        coro::basic_task_runner<coro::earliest_deadline> runner;
+
+        runner.add(std::move(*coro::coroutine::create(logging_task(order, 3, 1)))); // no deadline: last
+        runner.add(std::move(*coro::coroutine::create(logging_task(order, 2, 1))), now + 30ms);
+        runner.add(std::move(*coro::coroutine::create([&](coro::coroutine_handle h)
+                                                      {
+            order.push_back(1);
+            (void)runner.set_key(h, now + 40ms); // next job is due after task 2's
+            [[maybe_unused]] auto _ = h.yield();
+            order.push_back(1); })),
+                   now + 10ms);
+        runner.add(std::move(*coro::coroutine::create(logging_task(order, 4, 1))), now + 30ms); // tie: FIFO after 2
+
+        REQUIRE(runner.run().has_value());
+        CHECK((order == std::vector<int>{1, 2, 4, 1, 3}));
+    }
+
+    TEST_CASE("fair_share splits resumes by weight and caps a class per step")
+    {
+        std::vector<int> order;
+        coro::basic_task_runner<coro::fair_share<2>> runner;
+        runner.policy().configure(coro::share_class{0}, 3);
+        runner.policy().configure(coro::share_class{1}, 1);
+        runner.add(std::move(*coro::coroutine::create(logging_task(order, 0, 6))), coro::share_class{0});
+        runner.add(std::move(*coro::coroutine::create(logging_task(order, 1, 2))), coro::share_class{1});
+
+        REQUIRE(runner.run().has_value());
+        CHECK((order == std::vector<int>{0, 0, 0, 1, 0, 0, 0, 1}));
+
+        order.clear();
+        coro::basic_task_runner<coro::fair_share<2>> capped;
+        capped.policy().configure(coro::share_class{0}, 8, 2); // bulk: at most 2 resumes per step
+        for (int i = 0; i < 8; ++i)
+            capped.add(std::move(*coro::coroutine::create(logging_task(order, 0, 1))), coro::share_class{0});
+        capped.add(std::move(*coro::coroutine::create(logging_task(order, 1, 3))), coro::share_class{1});
+
+        REQUIRE(capped.step().has_value()); // the step's leftover budget goes to class 1
+        CHECK((order == std::vector<int>{0, 0, 1, 1, 1}));
+        CHECK(capped.ready() == 6);
+        REQUIRE(capped.run().has_value()); // run() opens a new tick whenever everything ready is capped
+        CHECK(capped.empty());
+        CHECK(std::ranges::count(order, 0) == 8);
+    }
+
+    TEST_CASE("fair_share treats a cap of 0 as 1")
+    {
+        std::vector<int> order;
+        coro::basic_task_runner<coro::fair_share<2>> runner;
+        runner.policy().configure(coro::share_class{0}, 1, 0);
+        for (int i = 0; i < 3; ++i)
+            runner.add(std::move(*coro::coroutine::create(logging_task(order, 0, 1))), coro::share_class{0});
+
+        REQUIRE(runner.step().has_value());
+        CHECK(runner.ready() == 2);
+        REQUIRE(runner.run().has_value()); // would spin opening ticks if the class could never run
+        CHECK(runner.empty());
+        CHECK((order == std::vector<int>{0, 0, 0}));
+    }
+
+    TEST_CASE("a post the runner has no room to adopt is dropped and reported")
+    {
+        std::vector<int> order;
+        coro::basic_task_runner<strained_policy> runner;
+        std::thread{[&]
+                    {
+                        REQUIRE(runner.post(std::move(*coro::coroutine::create(logging_task(order, 1, 1)))).has_value());
+                        REQUIRE(runner.post(std::move(*coro::coroutine::create(logging_task(order, 2, 1)))).has_value());
+                    }}
+            .join();
+
+        strained_policy::out_of_memory = true;
+        auto result = runner.step();
+        strained_policy::out_of_memory = false;
+        REQUIRE_FALSE(result.has_value());
+        CHECK(result.error() == coro::error::out_of_memory);
+        CHECK(runner.empty());
+
+        std::thread{[&]
+                    { REQUIRE(runner.post(std::move(*coro::coroutine::create(logging_task(order, 3, 1)))).has_value()); }}
+            .join();
+        REQUIRE(runner.run().has_value());
+        CHECK((order == std::vector<int>{3}));
+    }
+
+    TEST_CASE("posted tasks keep their key and a moved runner keeps its order")
+    {
+        std::vector<int> order;
+        coro::basic_task_runner<coro::priority_levels<>> runner;
+        runner.add(std::move(*coro::coroutine::create(logging_task(order, 2, 1))), coro::priority{5});
+        std::thread{[&]
+                    { (void)runner.post(std::move(*coro::coroutine::create(logging_task(order, 1, 1))), coro::priority{1}); }}
+            .join();
+        auto moved = std::move(runner);
+        CHECK(runner.ready() == 0);
+
+        REQUIRE(moved.run().has_value());
+        CHECK((order == std::vector<int>{1, 2}));
+        CHECK(runner.run().has_value());
+    }
+
+    TEST_CASE("set_key rejects handles the runner doesn't own")
+    {
+        coro::basic_task_runner<coro::earliest_deadline> runner;
+        CHECK(runner.set_key(coro::coroutine_handle{}, {}).error() == coro::error::invalid_coroutine);
+        auto loose = coro::coroutine::create([](coro::coroutine_handle) {});
+        REQUIRE(loose.has_value());
+        CHECK(runner.set_key(loose->handle(), {}).error() == coro::error::invalid_operation);
+    }
+}
+
+// ============================================================================
+// timer tests
+// ============================================================================
+
+TEST_SUITE("timers")
+{
+    using namespace std::chrono_literals;
+    using clock = std::chrono::steady_clock;
+
+    TEST_CASE("wheel fires each timer at its deadline across every level")
+    {
+        auto const t0 = clock::now();
+        coro::detail::timer_wheel wheel{t0};
+        // both sides of each level boundary, plus one past the wheel's direct range
+        std::vector<std::chrono::milliseconds> const delays{1ms, 5ms, 63ms, 64ms, 65ms, 200ms, 4095ms, 4096ms, 4097ms,
+                                                            70'000ms, 262'147ms, 17'000'000ms};
+        std::vector<coro::detail::timer_node> nodes(delays.size());
+        for (std::size_t i = 0; i < delays.size(); ++i)
+            wheel.insert(&nodes[i], t0 + delays[i]);
+        CHECK(wheel.size() == delays.size());
+
+        std::vector<coro::detail::timer_node *> fired;
+        auto record = [&](coro::detail::timer_node *node) noexcept
+        { fired.push_back(node); };
+        for (std::size_t i = 0; i < delays.size(); ++i)
+        {
+            auto const next = wheel.next_deadline();
+            REQUIRE(next.has_value());
+            CHECK(*next <= t0 + delays[i]);
+
+            CHECK(wheel.advance(t0 + delays[i] - 1ms, record) == 0);
+            CHECK(fired.size() == i);
+            CHECK(wheel.advance(t0 + delays[i], record) == 1);
+            REQUIRE(fired.size() == i + 1);
+            CHECK(fired.back() == &nodes[i]);
+            CHECK_FALSE(nodes[i].linked);
+        }
+        CHECK(wheel.empty());
+        CHECK_FALSE(wheel.next_deadline().has_value());
+    }
+
+    TEST_CASE("cancelled timers never fire")
+    {
+        auto const t0 = clock::now();
+        coro::detail::timer_wheel wheel{t0};
+        coro::detail::timer_node kept, cancelled, far;
+        wheel.insert(&kept, t0 + 10ms);
+        wheel.insert(&cancelled, t0 + 10ms);
+        wheel.insert(&far, t0 + 100'000ms);
+        wheel.cancel(&cancelled);
+        wheel.cancel(&far);
+        wheel.cancel(&far); // cancelling an unlinked node is a no-op
+        CHECK(wheel.size() == 1);
+
+        std::vector<coro::detail::timer_node *> fired;
+        CHECK(wheel.advance(t0 + 200'000ms, [&](coro::detail::timer_node *node) noexcept
+                            { fired.push_back(node); }) == 1);
+        CHECK(fired == std::vector<coro::detail::timer_node *>{&kept});
+    }
+
+    TEST_CASE("a timer re-armed past due from its own firing fires on the next tick")
+    {
+        auto const t0 = clock::now();
+        coro::detail::timer_wheel wheel{t0};
+        coro::detail::timer_node node;
+        wheel.insert(&node, t0 + 10ms);
+
+        int fired = 0;
+        auto rearm = [&](coro::detail::timer_node *n) noexcept
+        {
+            if (++fired == 1)
+                wheel.insert(n, t0); // already due
+        };
+        CHECK(wheel.advance(t0 + 10ms, rearm) == 1);
+        CHECK(wheel.size() == 1);
+        CHECK(*wheel.next_deadline() == t0 + 11ms);
+        CHECK(wheel.advance(t0 + 11ms, rearm) == 1);
+        CHECK(fired == 2);
+        CHECK(wheel.empty());
+    }
+
+    TEST_CASE("sleep_for parks the task until it is due")
+    {
+        coro::task_runner runner;
+        bool woke = false;
+        auto const start = clock::now();
+        auto sleeper = coro::coroutine::create([&](coro::coroutine_handle h)
+                                               {
+            REQUIRE(coro::sleep_for(h, 20ms).has_value());
+            woke = true; });
+        REQUIRE(sleeper.has_value());
+        runner.add(std::move(*sleeper));
+
+        REQUIRE(runner.step().has_value());
+        CHECK(runner.sleeping() == 1);
+        CHECK(runner.parked() == 1);
+        CHECK(runner.ready() == 0);
+        auto const deadline = runner.next_deadline();
+        REQUIRE(deadline.has_value());
+        CHECK(*deadline >= start + 20ms);
+        CHECK(*deadline <= clock::now() + 21ms);
+
+        // stepping before the deadline resumes nothing
+        bool stepped = true;
+        while (clock::now() < start + 19ms)
+            stepped = runner.step().has_value() && stepped;
+        CHECK(stepped);
+        CHECK_FALSE(woke);
+        REQUIRE(runner.run().has_value());
+        CHECK(woke);
+        CHECK(clock::now() - start >= 20ms);
+        CHECK(runner.empty());
+        CHECK(runner.sleeping() == 0);
+        CHECK_FALSE(runner.next_deadline().has_value());
+    }
+
+    TEST_CASE("run sleeps until the sleepers are due, in deadline order")
+    {
+        coro::task_runner runner;
+        std::vector<int> order;
+        auto const start = clock::now();
+        for (int ms : {30, 10, 20})
+        {
+            auto task = coro::coroutine::create([&order, ms](coro::coroutine_handle h)
+                                                {
+                REQUIRE(coro::sleep_for(h, std::chrono::milliseconds{ms}).has_value());
+                order.push_back(ms); });
+            REQUIRE(task.has_value());
+            runner.add(std::move(*task));
+        }
+        REQUIRE(runner.run().has_value());
+        CHECK(order == std::vector<int>{10, 20, 30});
+        CHECK(clock::now() - start >= 30ms);
+    }
+
+    TEST_CASE("a wake does not cut a sleep short")
+    {
+        coro::task_runner runner;
+        clock::time_point woke_at{};
+        coro::coroutine_handle sleeper_handle;
+        auto const start = clock::now();
+        auto sleeper = coro::coroutine::create([&](coro::coroutine_handle h)
+                                               {
+            REQUIRE(coro::sleep_until(h, start + 15ms).has_value());
+            woke_at = clock::now(); });
+        auto waker = coro::coroutine::create([&](coro::coroutine_handle)
+                                             { REQUIRE(runner.wake(sleeper_handle).has_value()); });
+        REQUIRE(sleeper.has_value());
+        REQUIRE(waker.has_value());
+        sleeper_handle = sleeper->handle();
+        runner.add(std::move(*sleeper)).add(std::move(*waker));
+        REQUIRE(runner.run().has_value());
+        CHECK(woke_at >= start + 15ms);
+    }
+
+    TEST_CASE("park_for times out unless woken first")
+    {
+        coro::task_runner runner;
+        std::optional<coro::error> timed_out, woken;
+        coro::coroutine_handle second_handle;
+        auto first = coro::coroutine::create([&](coro::coroutine_handle h)
+                                             {
+            auto r = coro::park_for(h, 5ms);
+            timed_out = r ? coro::error::success : r.error();
+            REQUIRE(runner.wake(second_handle).has_value()); });
+        auto second = coro::coroutine::create([&](coro::coroutine_handle h)
+                                              {
+            auto r = coro::park_for(h, 10s);
+            woken = r ? coro::error::success : r.error(); });
+        REQUIRE(first.has_value());
+        REQUIRE(second.has_value());
+        second_handle = second->handle();
+        auto const start = clock::now();
+        runner.add(std::move(*first)).add(std::move(*second));
+        REQUIRE(runner.run().has_value());
+
+        CHECK(timed_out == coro::error::timeout);
+        CHECK(woken == coro::error::success);
+        CHECK(clock::now() - start < 5s); // the 10 s timer was disarmed, run() didn't wait for it
+        CHECK(runner.sleeping() == 0);
+    }
+
+    TEST_CASE("sleeping needs a scheduler with timers")
+    {
+        auto task = coro::coroutine::create([](coro::coroutine_handle h)
+                                            {
+            auto slept = coro::sleep_for(h, 1ms);
+            REQUIRE_FALSE(slept.has_value());
+            CHECK(slept.error() == coro::error::invalid_operation);
+            auto parked = coro::park_for(h, 1ms);
+            REQUIRE_FALSE(parked.has_value());
+            CHECK(parked.error() == coro::error::invalid_operation); });
+        REQUIRE(task.has_value());
+        REQUIRE(task->resume().has_value());
+        CHECK(task->done());
+
+        auto invalid = coro::sleep_for(coro::coroutine_handle{}, 1ms);
+        REQUIRE_FALSE(invalid.has_value());
+        CHECK(invalid.error() == coro::error::invalid_coroutine);
+    }
+
+    TEST_CASE("past deadlines return without suspending")
+    {
+        coro::task_runner runner;
+        int resumes = 0;
+        auto task = coro::coroutine::create([&](coro::coroutine_handle h)
+                                            {
+            ++resumes;
+            REQUIRE(coro::sleep_for(h, 0ms).has_value());
+            REQUIRE(coro::sleep_until(h, clock::now() - 1s).has_value());
+            auto parked = coro::park_until(h, clock::now() - 1s);
+            REQUIRE_FALSE(parked.has_value());
+            CHECK(parked.error() == coro::error::timeout); });
+        REQUIRE(task.has_value());
+        runner.add(std::move(*task));
+        REQUIRE(runner.step().has_value());
+        CHECK(runner.empty());
+        CHECK(resumes == 1);
+    }
+
+    TEST_CASE("a moved runner keeps its sleepers")
+    {
+        coro::task_runner first;
+        bool done = false;
+        auto task = coro::coroutine::create([&](coro::coroutine_handle h)
+                                            {
+            REQUIRE(coro::sleep_for(h, 5ms).has_value());
+            done = true; });
+        REQUIRE(task.has_value());
+        first.add(std::move(*task));
+        REQUIRE(first.step().has_value());
+        REQUIRE(first.sleeping() == 1);
+
+        coro::task_runner second{std::move(first)};
+        CHECK(first.sleeping() == 0);
+        CHECK(second.sleeping() == 1);
+        REQUIRE(second.run().has_value());
+        CHECK(done);
+    }
+}
+
+// ============================================================================
+// cancellation tests
+// ============================================================================
+
+TEST_SUITE("cancellation")
+{
+    using namespace std::chrono_literals;
+
+    TEST_CASE("cancel sets the flag the coroutine and its tokens read")
+    {
+        coro::cancellation_token seen;
+        auto task = coro::coroutine::create([&](coro::coroutine_handle h)
+                                            {
+            seen = h.token();
+            CHECK_FALSE(h.cancellation_requested());
+            [[maybe_unused]] auto _ = h.yield();
+            CHECK(h.cancellation_requested()); });
+        REQUIRE(task.has_value());
+        REQUIRE(task->resume().has_value());
+        CHECK_FALSE(seen.requested());
+        CHECK_FALSE(task->cancellation_requested());
+
+        REQUIRE(task->cancel().has_value());
+        CHECK(task->cancellation_requested());
+        CHECK(seen.requested());
+        REQUIRE(task->resume().has_value());
+        CHECK(task->done());
+        CHECK(task->cancel().has_value()); // finished: no-op
+
+        CHECK_FALSE(coro::cancellation_token{}.requested());
+        auto invalid = coro::coroutine_handle{}.cancel();
+        REQUIRE_FALSE(invalid.has_value());
+        CHECK(invalid.error() == coro::error::invalid_coroutine);
+    }
+
+    TEST_CASE("checked yield reports cancellation so loops unwind")
+    {
+        coro::task_runner runner;
+        int iterations = 0;
+        coro::coroutine_handle spinner;
+        auto task = coro::coroutine::create([&](coro::coroutine_handle h)
+                                            {
+            while (h.yield())
+                ++iterations; });
+        REQUIRE(task.has_value());
+        spinner = task->handle();
+        runner.add(std::move(*task));
+        for (int i = 0; i < 3; ++i)
+            REQUIRE(runner.step().has_value());
+        REQUIRE(spinner.cancel().has_value());
+        REQUIRE(runner.run().has_value());
+        CHECK(runner.empty());
+        CHECK(iterations == 2);
+    }
+
+    TEST_CASE("a parked task is woken with error::cancelled")
+    {
+        coro::task_runner runner;
+        std::optional<coro::error> parked;
+        auto task = coro::coroutine::create([&](coro::coroutine_handle h)
+                                            {
+            auto r = h.park();
+            parked = r ? coro::error::success : r.error();
+            auto again = h.park(); // stays cancelled: returns at once
+            CHECK(again.error() == coro::error::cancelled); });
+        REQUIRE(task.has_value());
+        auto handle = task->handle();
+        runner.add(std::move(*task));
+        REQUIRE(runner.run().has_value());
+        REQUIRE(runner.parked() == 1);
+
+        REQUIRE(handle.cancel().has_value());
+        CHECK(runner.parked() == 0);
+        CHECK(runner.ready() == 1);
+        REQUIRE(runner.run().has_value());
+        CHECK(parked == coro::error::cancelled);
+        CHECK(runner.empty());
+    }
+
+    TEST_CASE("cancel cuts sleeps and timed parks short")
+    {
+        coro::task_runner runner;
+        std::optional<coro::error> slept, waited;
+        auto sleeper = coro::coroutine::create([&](coro::coroutine_handle h)
+                                               {
+            auto r = coro::sleep_for(h, 10s);
+            slept = r ? coro::error::success : r.error(); });
+        auto waiter = coro::coroutine::create([&](coro::coroutine_handle h)
+                                              {
+            auto r = coro::park_for(h, 10s);
+            waited = r ? coro::error::success : r.error(); });
+        REQUIRE(sleeper.has_value());
+        REQUIRE(waiter.has_value());
+        runner.add(std::move(*sleeper)).add(std::move(*waiter));
+        REQUIRE(runner.step().has_value());
+        REQUIRE(runner.sleeping() == 2);
+
+        auto const start = std::chrono::steady_clock::now();
+        runner.cancel_all();
+        REQUIRE(runner.run().has_value());
+        CHECK(std::chrono::steady_clock::now() - start < 5s);
+        CHECK(slept == coro::error::cancelled);
+        CHECK(waited == coro::error::cancelled);
+        CHECK(runner.sleeping() == 0);
+        CHECK(runner.empty());
+    }
+
+    TEST_CASE("a cancelled channel waiter passes its wake on")
+    {
+        auto ch = coro::channel<int>::create(1);
+        REQUIRE(ch.has_value());
+        coro::task_runner runner;
+        std::optional<coro::error> first_result;
+        std::optional<int> second_value;
+        auto first = coro::coroutine::create([&](coro::coroutine_handle h)
+                                             {
+            auto v = ch->receive(h);
+            first_result = v ? coro::error::success : v.error(); });
+        auto second = coro::coroutine::create([&](coro::coroutine_handle h)
+                                              {
+            if (auto v = ch->receive(h))
+                second_value = *v; });
+        REQUIRE(first.has_value());
+        REQUIRE(second.has_value());
+        auto first_handle = first->handle();
+        runner.add(std::move(*first)).add(std::move(*second));
+        REQUIRE(runner.run().has_value());
+        REQUIRE(runner.parked() == 2);
+
+        // the send wakes `first`, which is then cancelled before it runs
+        REQUIRE(ch->try_send(7).has_value());
+        REQUIRE(first_handle.cancel().has_value());
+        REQUIRE(runner.run().has_value());
+        CHECK(first_result == coro::error::cancelled);
+        CHECK(second_value == 7);
+        CHECK(runner.empty());
+    }
+
+    TEST_CASE("cancel_all evicts stalled tasks")
+    {
+        auto ch = coro::channel<int>::create(1);
+        REQUIRE(ch.has_value());
+        coro::task_runner runner;
+        int unwound = 0;
+        for (int i = 0; i < 100; ++i)
+        {
+            auto task = coro::coroutine::create([&](coro::coroutine_handle h)
+                                                {
+                while (ch->receive(h))
+                {
+                }
+                ++unwound; });
+            REQUIRE(task.has_value());
+            runner.add(std::move(*task));
+        }
+        REQUIRE(runner.run().has_value());
+        REQUIRE(runner.parked() == 100);
+        runner.cancel_all();
+        REQUIRE(runner.run().has_value());
+        CHECK(runner.empty());
+        CHECK(unwound == 100);
+    }
+}
+
+// ============================================================================
+// scope tests
+// ============================================================================
+
+TEST_SUITE("scope")
+{
+    TEST_CASE("join parks the parent until the last child finishes")
+    {
+        coro::task_runner runner;
+        std::vector<int> finished;
+        bool joined = false;
+        auto parent = coro::coroutine::create([&](coro::coroutine_handle h)
+                                              {
+            auto sc = coro::scope::create(4);
+            REQUIRE(sc.has_value());
+            for (int i = 0; i < 4; ++i)
+            {
+                REQUIRE(sc->spawn(runner, [&finished, i](coro::coroutine_handle c)
+                                  {
+                    for (int n = 0; n < i; ++n)
+                        [[maybe_unused]] auto _ = c.yield();
+                    finished.push_back(i); })
+                            .has_value());
+            }
+            CHECK(sc->running() == 4);
+            REQUIRE(sc->join(h).has_value());
+            CHECK(sc->running() == 0);
+            joined = true; });
+        REQUIRE(parent.has_value());
+        runner.add(std::move(*parent));
+
+        REQUIRE(runner.step().has_value()); // parent spawns and parks
+        while (finished.size() < 4)
+        {
+            CHECK_FALSE(joined);
+            CHECK(runner.parked() == 1);
+            REQUIRE(runner.step().has_value());
+        }
+        REQUIRE(runner.run().has_value());
+        CHECK(joined);
+        CHECK(finished == std::vector<int>{0, 1, 2, 3});
+        CHECK(runner.empty());
+    }
+
+    TEST_CASE("children share the arena and reuse released frames")
+    {
+        auto sc = coro::scope::create(16);
+        REQUIRE(sc.has_value());
+        CHECK(sc->capacity() == 0);
+        coro::task_runner runner;
+        int ran = 0;
+        for (int i = 0; i < 100; ++i)
+            REQUIRE(sc->spawn(runner, [&](coro::coroutine_handle)
+                              { ++ran; })
+                        .has_value());
+        CHECK(sc->frames() == 100);
+        CHECK(sc->capacity() == 100);
+        REQUIRE(runner.run().has_value());
+        CHECK(ran == 100);
+        CHECK(sc->frames() == 0);
+        CHECK(sc->running() == 0);
+
+        for (int i = 0; i < 100; ++i)
+            REQUIRE(sc->spawn(runner, [&](coro::coroutine_handle)
+                              { ++ran; })
+                        .has_value());
+        CHECK(sc->capacity() == 100); // came off the free list
+        REQUIRE(runner.run().has_value());
+        CHECK(ran == 200);
+    }
+
+    TEST_CASE("a throwing child cancels its siblings and join rethrows")
+    {
+        auto ch = coro::channel<int>::create(1);
+        REQUIRE(ch.has_value());
+        coro::task_runner runner;
+        int cancelled_siblings = 0;
+        bool caught = false;
+        auto parent = coro::coroutine::create([&](coro::coroutine_handle h)
+                                              {
+            auto sc = coro::scope::create();
+            REQUIRE(sc.has_value());
+            for (int i = 0; i < 3; ++i)
+            {
+                REQUIRE(sc->spawn(runner, [&](coro::coroutine_handle c)
+                                  {
+                    auto v = ch->receive(c);
+                    if (!v && v.error() == coro::error::cancelled)
+                        ++cancelled_siblings; })
+                            .has_value());
+            }
+            REQUIRE(sc->spawn(runner, [](coro::coroutine_handle c)
+                              {
+                [[maybe_unused]] auto _ = c.yield();
+                throw std::runtime_error{"child failed"}; })
+                        .has_value());
+            try
+            {
+                (void)sc->join(h);
+            }
+            catch (std::runtime_error const &e)
+            {
+                caught = std::string_view{e.what()} == "child failed";
+            } });
+        REQUIRE(parent.has_value());
+        runner.add(std::move(*parent));
+        REQUIRE(runner.run().has_value());
+        CHECK(caught);
+        CHECK(cancelled_siblings == 3);
+        CHECK(runner.empty());
+    }
+
+    TEST_CASE("cancelling the parent cancels the children and join still waits")
+    {
+        coro::task_runner runner;
+        int unwound = 0;
+        std::optional<coro::error> join_result;
+        auto parent = coro::coroutine::create([&](coro::coroutine_handle h)
+                                              {
+            auto sc = coro::scope::create();
+            REQUIRE(sc.has_value());
+            for (int i = 0; i < 5; ++i)
+            {
+                REQUIRE(sc->spawn(runner, [&](coro::coroutine_handle c)
+                                  {
+                    while (c.park())
+                    {
+                    }
+                    ++unwound; })
+                            .has_value());
+            }
+            auto joined = sc->join(h);
+            join_result = joined ? coro::error::success : joined.error();
+            CHECK(sc->running() == 0); });
+        REQUIRE(parent.has_value());
+        auto parent_handle = parent->handle();
+        runner.add(std::move(*parent));
+        REQUIRE(runner.run().has_value());
+        REQUIRE(runner.parked() == 6);
+
+        REQUIRE(parent_handle.cancel().has_value());
+        REQUIRE(runner.run().has_value());
+        CHECK(join_result == coro::error::cancelled);
+        CHECK(unwound == 5);
+        CHECK(runner.empty());
+    }
+
+    TEST_CASE("leaving a scope unjoined cancels its children and keeps their frames alive")
+    {
+        coro::task_runner runner;
+        int unwound = 0;
+        {
+            auto sc = coro::scope::create(2);
+            REQUIRE(sc.has_value());
+            for (int i = 0; i < 3; ++i)
+            {
+                REQUIRE(sc->spawn(runner, [&](coro::coroutine_handle c)
+                                  {
+                    std::array<int, 64> locals{};
+                    locals.fill(7);
+                    while (c.park())
+                    {
+                    }
+                    unwound += locals[63] == 7 ? 1 : 0; })
+                            .has_value());
+            }
+            REQUIRE(runner.step().has_value()); // all three parked
+            REQUIRE(runner.parked() == 3);
+        }
+        CHECK(runner.ready() == 3);
+        REQUIRE(runner.run().has_value());
+        CHECK(unwound == 3);
+        CHECK(runner.empty());
+    }
+
+    TEST_CASE("a child spawned after cancel starts cancelled")
+    {
+        auto sc = coro::scope::create();
+        REQUIRE(sc.has_value());
+        sc->cancel();
+        bool saw_cancel = false;
+        auto child = sc->spawn([&](coro::coroutine_handle c)
+                               { saw_cancel = c.cancellation_requested(); });
+        REQUIRE(child.has_value());
+        REQUIRE(child->resume().has_value());
+        CHECK(saw_cancel);
+        CHECK(sc->running() == 0);
+
+        coro::scope moved{std::move(*sc)};
+        auto invalid = sc->spawn([](coro::coroutine_handle) {}); // NOLINT(bugprone-use-after-move)
+        REQUIRE_FALSE(invalid.has_value());
+        CHECK(invalid.error() == coro::error::invalid_operation);
+        CHECK(moved.valid());
+    }
+}
+
+// ============================================================================
+// thread_pool_runner tests
+// ============================================================================
+
+TEST_SUITE("thread_pool_runner")
+{
+    TEST_CASE("empty runner completes immediately")
+    {
+        coro::thread_pool_runner runner{4};
+        CHECK(runner.worker_count() == 4);
+        CHECK(runner.empty());
+        CHECK(runner.run().has_value());
+        CHECK(coro::thread_pool_runner{0}.worker_count() == 1);
+    }
+
+    TEST_CASE("every task runs to completion across workers")
+    {
+        constexpr int tasks = 256;
+        constexpr int steps = 20;
+        std::atomic<int> total{0};
+
+        coro::thread_pool_runner runner{4};
+        for (int i = 0; i < tasks; ++i)
+        {
+            auto c = coro::coroutine::create([&total](coro::coroutine_handle h)
+                                             {
+                for (int s = 0; s < steps; ++s)
+                {
+                    total.fetch_add(1, std::memory_order_relaxed);
+                    [[maybe_unused]] auto _ = h.yield();
+                } });
+            REQUIRE(c.has_value());
+            runner.add(std::move(*c));
+        }
+        CHECK(runner.size() == tasks);
+
+        REQUIRE(runner.run().has_value());
+        CHECK(total.load() == tasks * steps);
+        CHECK(runner.empty());
+    }
+
+    TEST_CASE("running coroutine is tracked correctly after migrating")
+    {
+        constexpr int tasks = 64;
+        std::atomic<int> mismatches{0};
+
+        coro::thread_pool_runner runner{4};
+        for (int i = 0; i < tasks; ++i)
+        {
+            auto c = coro::coroutine::create([&](coro::coroutine_handle h)
+                                             {
+                for (int s = 0; s < 50; ++s)
+                {
+                    if (coro::running().raw() != h.raw() || h.status() != coro::state::running)
+                        mismatches.fetch_add(1, std::memory_order_relaxed);
+                    [[maybe_unused]] auto _ = h.yield();
+                } });
+            REQUIRE(c.has_value());
+            runner.add(std::move(*c));
+        }
+
+        REQUIRE(runner.run().has_value());
+        CHECK(mismatches.load() == 0);
+        CHECK(coro::detail::mco_running() == nullptr);
+    }
+
+    TEST_CASE("single worker round-robins like task_runner")
+    {
+        std::vector<int> order;
+        coro::thread_pool_runner runner{1};
+        for (int id = 1; id <= 2; ++id)
+        {
+            auto c = coro::coroutine::create([&order, id](coro::coroutine_handle h)
+                                             {
+                order.push_back(id);
+                [[maybe_unused]] auto _ = h.yield();
+                order.push_back(id * 10); });
+            REQUIRE(c.has_value());
+            runner.add(std::move(*c));
+        }
+
+        REQUIRE(runner.run().has_value());
+        CHECK(order == std::vector<int>{1, 2, 10, 20});
+    }
+
+    TEST_CASE("idle workers sleep instead of spinning through a long task")
+    {
+        constexpr auto nap = std::chrono::milliseconds{200};
+        coro::thread_pool_runner runner{4};
+        auto slow = coro::coroutine::create([&](coro::coroutine_handle h)
+                                            {
+            std::this_thread::sleep_for(nap);
+            [[maybe_unused]] auto _ = h.yield();
+            std::this_thread::sleep_for(nap); });
+        REQUIRE(slow.has_value());
+        runner.add(std::move(*slow));
+        for (int i = 0; i < 3; ++i)
+        {
+            auto quick = coro::coroutine::create([](coro::coroutine_handle) {});
+            REQUIRE(quick.has_value());
+            runner.add(std::move(*quick));
+        }
+
+        std::clock_t const start = std::clock();
+        REQUIRE(runner.run().has_value());
+        double const cpu_ms = 1000.0 * static_cast<double>(std::clock() - start) / CLOCKS_PER_SEC;
+        // three spinning workers would burn about as much CPU as the task sleeps
+        CHECK(cpu_ms < 100.0);
+        CHECK(runner.empty());
+    }
+
+    TEST_CASE("runner can be refilled and run again")
+    {
+        std::atomic<int> runs{0};
+        coro::thread_pool_runner runner{2};
+        for (int round = 0; round < 3; ++round)
+        {
+            for (int i = 0; i < 8; ++i)
+            {
+                auto c = coro::coroutine::create([&runs](coro::coroutine_handle)
+                                                 { runs.fetch_add(1, std::memory_order_relaxed); });
+                REQUIRE(c.has_value());
+                runner.add(std::move(*c));
+            }
+            REQUIRE(runner.run().has_value());
+        }
+        CHECK(runs.load() == 24);
+    }
+}
+
+// ============================================================================
+// channel tests
+// ============================================================================
+
+TEST_SUITE("channel")
+{
+    TEST_CASE("create rejects zero capacity")
+    {
+        auto ch = coro::channel<int>::create(0);
+        REQUIRE_FALSE(ch.has_value());
+        CHECK(ch.error() == coro::error::invalid_arguments);
+    }
+
+    TEST_CASE("try_send and try_receive keep FIFO order across wrap-around")
+    {
+        auto ch = coro::channel<int>::create(3);
+        REQUIRE(ch.has_value());
+        CHECK(ch->capacity() == 3);
+        CHECK(ch->empty());
+
+        for (int round = 0; round < 4; ++round)
+        {
+            CHECK(ch->try_send(round * 10 + 0).has_value());
+            CHECK(ch->try_send(round * 10 + 1).has_value());
+            CHECK(ch->try_send(round * 10 + 2).has_value());
+            CHECK(ch->full());
+            auto overflow = ch->try_send(99);
+            REQUIRE_FALSE(overflow.has_value());
+            CHECK(overflow.error() == coro::error::would_block);
+
+            CHECK(ch->try_receive() == round * 10 + 0);
+            CHECK(ch->try_receive() == round * 10 + 1);
+            CHECK(ch->try_send(round * 10 + 3).has_value());
+            CHECK(ch->try_receive() == round * 10 + 2);
+            CHECK(ch->try_receive() == round * 10 + 3);
+        }
+        auto none = ch->try_receive();
+        REQUIRE_FALSE(none.has_value());
+        CHECK(none.error() == coro::error::would_block);
+    }
+
+    TEST_CASE("close rejects sends but drains buffered values")
+    {
+        auto ch = coro::channel<std::unique_ptr<int>>::create(2);
+        REQUIRE(ch.has_value());
+        CHECK(ch->try_send(std::make_unique<int>(7)).has_value());
+        ch->close();
+        CHECK(ch->closed());
+
+        auto rejected = ch->try_send(std::make_unique<int>(8));
+        REQUIRE_FALSE(rejected.has_value());
+        CHECK(rejected.error() == coro::error::closed);
+
+        auto value = ch->try_receive();
+        REQUIRE(value.has_value());
+        CHECK(**value == 7);
+        auto drained = ch->try_receive();
+        REQUIRE_FALSE(drained.has_value());
+        CHECK(drained.error() == coro::error::closed);
+    }
+
+    TEST_CASE("buffered values are destroyed with the channel")
+    {
+        auto counter = std::make_shared<int>(0);
+        {
+            auto ch = coro::channel<std::shared_ptr<int>>::create(4);
+            REQUIRE(ch.has_value());
+            CHECK(ch->try_send(counter).has_value());
+            CHECK(ch->try_send(counter).has_value());
+            CHECK(counter.use_count() == 3);
+        }
+        CHECK(counter.use_count() == 1);
+    }
+
+    TEST_CASE("consumer parks instead of polling")
+    {
+        constexpr int count = 100;
+        auto ch = coro::channel<int>::create(4);
+        REQUIRE(ch.has_value());
+        std::vector<int> received;
+        int consumer_wakeups = 0;
+        coro::task_runner runner;
+
+        auto consumer = coro::coroutine::create([&](coro::coroutine_handle h)
+                                                {
+            for (;;)
+            {
+                ++consumer_wakeups;
+                auto v = ch->receive(h);
+                if (!v)
+                {
+                    CHECK(v.error() == coro::error::closed);
+                    return;
+                }
+                received.push_back(*v);
+            } });
+        auto producer = coro::coroutine::create([&](coro::coroutine_handle h)
+                                                {
+            for (int i = 0; i < count; ++i)
+            {
+                REQUIRE(ch->send(h, i).has_value());
+                if (i % 10 == 9)
+                    [[maybe_unused]] auto _ = h.yield(); // let unrelated work happen now and then
+            }
+            ch->close(); });
+        REQUIRE(consumer.has_value());
+        REQUIRE(producer.has_value());
+        runner.add(std::move(*consumer)).add(std::move(*producer));
+
+        REQUIRE(runner.run().has_value());
+        CHECK(runner.empty());
+        REQUIRE(received.size() == count);
+        for (int i = 0; i < count; ++i)
+            CHECK(received[static_cast<std::size_t>(i)] == i);
+        CHECK(consumer_wakeups == count + 1);
+    }
+
+    TEST_CASE("ping-pong over two channels")
+    {
+        constexpr int rounds = 1000;
+        auto ping = coro::channel<int>::create(1);
+        auto pong = coro::channel<int>::create(1);
+        REQUIRE(ping.has_value());
+        REQUIRE(pong.has_value());
+        int last = -1;
+        coro::task_runner runner;
+
+        auto left = coro::coroutine::create([&](coro::coroutine_handle h)
+                                            {
+            for (int i = 0; i < rounds; ++i)
+            {
+                REQUIRE(ping->send(h, i).has_value());
+                auto back = pong->receive(h);
+                REQUIRE(back.has_value());
+                last = *back;
+            }
+            ping->close(); });
+        auto right = coro::coroutine::create([&](coro::coroutine_handle h)
+                                             {
+            while (auto v = ping->receive(h))
+                REQUIRE(pong->send(h, *v + 1).has_value()); });
+        REQUIRE(left.has_value());
+        REQUIRE(right.has_value());
+        runner.add(std::move(*left)).add(std::move(*right));
+
+        REQUIRE(runner.run().has_value());
+        CHECK(runner.empty());
+        CHECK(runner.parked() == 0);
+        CHECK(last == rounds);
+    }
+
+    TEST_CASE("close wakes every blocked receiver")
+    {
+        auto ch = coro::channel<int>::create(1);
+        REQUIRE(ch.has_value());
+        int closed_seen = 0;
+        coro::task_runner runner;
+        for (int i = 0; i < 3; ++i)
+        {
+            auto c = coro::coroutine::create([&](coro::coroutine_handle h)
+                                             {
+                auto v = ch->receive(h);
+                if (!v && v.error() == coro::error::closed)
+                    ++closed_seen; });
+            REQUIRE(c.has_value());
+            runner.add(std::move(*c));
+        }
+        REQUIRE(runner.run().has_value());
+        CHECK(runner.parked() == 3);
+
+        ch->close();
+        CHECK(runner.ready() == 3);
+        REQUIRE(runner.run().has_value());
+        CHECK(closed_seen == 3);
+        CHECK(runner.empty());
+    }
+
+    TEST_CASE("blocked sender resumes once there is room")
+    {
+        auto ch = coro::channel<int>::create(1);
+        REQUIRE(ch.has_value());
+        int sent = 0;
+        coro::task_runner runner;
+        auto sender = coro::coroutine::create([&](coro::coroutine_handle h)
+                                              {
+            for (int i = 0; i < 3; ++i)
+            {
+                REQUIRE(ch->send(h, i).has_value());
+                ++sent;
+            } });
+        REQUIRE(sender.has_value());
+        runner.add(std::move(*sender));
+
+        REQUIRE(runner.run().has_value());
+        CHECK(sent == 1);
+        CHECK(runner.parked() == 1);
+        CHECK(ch->try_receive() == 0);
+        REQUIRE(runner.run().has_value());
+        CHECK(sent == 2);
+        CHECK(ch->try_receive() == 1);
+        CHECK(ch->try_receive().error() == coro::error::would_block);
+        REQUIRE(runner.run().has_value());
+        CHECK(sent == 3);
+        CHECK(runner.empty());
+    }
+
+    TEST_CASE("hand-driven coroutines retry after each resume")
+    {
+        auto ch = coro::channel<int>::create(1);
+        REQUIRE(ch.has_value());
+        int got = 0;
+        auto consumer = coro::coroutine::create([&](coro::coroutine_handle h)
+                                                {
+            auto v = ch->receive(h);
+            REQUIRE(v.has_value());
+            got = *v; });
+        REQUIRE(consumer.has_value());
+
+        CHECK(consumer->resume().has_value());
+        CHECK(consumer->suspended());
+        CHECK(consumer->resume().has_value()); // still empty: yields again
+        CHECK(consumer->suspended());
+        CHECK(ch->try_send(42).has_value());
+        CHECK(consumer->resume().has_value());
+        CHECK(consumer->done());
+        CHECK(got == 42);
+    }
+
+    TEST_CASE("moving the channel keeps blocked waiters valid")
+    {
+        auto made = coro::channel<int>::create(1);
+        REQUIRE(made.has_value());
+        std::optional<coro::channel<int>> ch{std::move(*made)};
+        int got = 0;
+        coro::task_runner runner;
+        auto consumer = coro::coroutine::create([&](coro::coroutine_handle h)
+                                                {
+            auto v = ch->receive(h);
+            REQUIRE(v.has_value());
+            got = *v; });
+        REQUIRE(consumer.has_value());
+        runner.add(std::move(*consumer));
+        REQUIRE(runner.run().has_value());
+
+        auto moved = std::move(*ch);
+        CHECK(moved.try_send(5).has_value());
+        REQUIRE(runner.run().has_value());
+        CHECK(got == 5);
+    }
+
+    TEST_CASE("send and receive reject invalid handles")
+    {
+        auto ch = coro::channel<int>::create(1);
+        REQUIRE(ch.has_value());
+        CHECK(ch->send(coro::coroutine_handle{}, 1).error() == coro::error::invalid_coroutine);
+        CHECK(ch->receive(coro::coroutine_handle{}).error() == coro::error::invalid_coroutine);
+    }
+}
+
+// ============================================================================
+// select tests
+// ============================================================================
+
+TEST_SUITE("select")
+{
+    TEST_CASE("select parks once and returns the channel that was sent to")
+    {
+        auto numbers = coro::channel<int>::create(2);
+        auto words = coro::channel<std::string>::create(2);
+        REQUIRE(numbers.has_value());
+        REQUIRE(words.has_value());
+        coro::task_runner runner;
+        std::vector<std::size_t> order;
+        auto selector = coro::coroutine::create([&](coro::coroutine_handle h)
+                                                {
+            for (int i = 0; i < 2; ++i)
+            {
+                auto got = coro::select(h, *numbers, *words);
+                REQUIRE(got.has_value());
+                order.push_back(got->index());
+                if (got->index() == 0)
+                    CHECK(std::get<0>(*got) == 7);
+                else
+                    CHECK(std::get<1>(*got) == "seven");
+            } });
+        REQUIRE(selector.has_value());
+        runner.add(std::move(*selector));
+
+        REQUIRE(runner.step().has_value());
+        CHECK(runner.parked() == 1);
+        CHECK(words->try_send("seven").has_value());
+        CHECK(runner.parked() == 0);
+        REQUIRE(runner.step().has_value()); // takes the word, parks again
+        CHECK(runner.parked() == 1);
+        CHECK(numbers->try_send(7).has_value());
+        REQUIRE(runner.run().has_value());
+        CHECK(order == std::vector<std::size_t>{1, 0});
+        CHECK(numbers->empty());
+        CHECK(words->empty());
+    }
+
+    TEST_CASE("a ready channel is taken without parking, lowest index first")
+    {
+        auto a = coro::channel<int>::create(2);
+        auto b = coro::channel<int>::create(2);
+        REQUIRE(a.has_value());
+        REQUIRE(b.has_value());
+        CHECK(a->try_send(1).has_value());
+        CHECK(b->try_send(2).has_value());
+        std::vector<int> got;
+        auto c = coro::coroutine::create([&](coro::coroutine_handle h)
+                                         {
+            for (int i = 0; i < 2; ++i)
+            {
+                auto r = coro::select(h, *a, *b);
+                REQUIRE(r.has_value());
+                got.push_back(std::visit([](int v) { return v; }, *r));
+            } });
+        REQUIRE(c.has_value());
+        REQUIRE(c->resume().has_value());
+        CHECK(c->done());
+        CHECK(got == std::vector<int>{1, 2});
+    }
+
+    TEST_CASE("closed channels are skipped until every one is closed and drained")
+    {
+        auto a = coro::channel<int>::create(1);
+        auto b = coro::channel<int>::create(1);
+        REQUIRE(a.has_value());
+        REQUIRE(b.has_value());
+        coro::task_runner runner;
+        std::vector<int> got;
+        coro::error last = coro::error::success;
+        auto c = coro::coroutine::create([&](coro::coroutine_handle h)
+                                         {
+            for (;;)
+            {
+                auto r = coro::select(h, *a, *b);
+                if (!r)
+                {
+                    last = r.error();
+                    return;
+                }
+                got.push_back(std::visit([](int v) { return v; }, *r));
+            } });
+        REQUIRE(c.has_value());
+        runner.add(std::move(*c));
+
+        CHECK(b->try_send(5).has_value());
+        a->close();
+        REQUIRE(runner.step().has_value()); // takes 5, parks on b alone
+        CHECK(runner.parked() == 1);
+        CHECK(b->try_send(6).has_value());
+        REQUIRE(runner.step().has_value());
+        CHECK(runner.parked() == 1);
+        b->close();
+        REQUIRE(runner.run().has_value());
+        CHECK(got == std::vector<int>{5, 6});
+        CHECK(last == coro::error::closed);
+    }
+
+    TEST_CASE("a wake absorbed by a select goes to the next receiver")
+    {
+        auto a = coro::channel<int>::create(1);
+        auto b = coro::channel<int>::create(1);
+        REQUIRE(a.has_value());
+        REQUIRE(b.has_value());
+        coro::task_runner runner;
+        int selected = 0;
+        int received = 0;
+        auto selector = coro::coroutine::create([&](coro::coroutine_handle h)
+                                                {
+            auto r = coro::select(h, *a, *b);
+            REQUIRE(r.has_value());
+            selected = std::visit([](int v) { return v; }, *r); });
+        auto receiver = coro::coroutine::create([&](coro::coroutine_handle h)
+                                                {
+            auto r = b->receive(h);
+            REQUIRE(r.has_value());
+            received = *r; });
+        REQUIRE(selector.has_value());
+        REQUIRE(receiver.has_value());
+        runner.add(std::move(*selector)).add(std::move(*receiver));
+        REQUIRE(runner.step().has_value());
+        REQUIRE(runner.step().has_value());
+        CHECK(runner.parked() == 2);
+
+        // the selector is first on b's list, but a's send already woke it
+        CHECK(a->try_send(1).has_value());
+        CHECK(b->try_send(2).has_value());
+        CHECK(runner.parked() == 0);
+        REQUIRE(runner.run().has_value());
+        CHECK(selected == 1);
+        CHECK(received == 2);
+    }
+
+    TEST_CASE("the run-time form handles more channels than fit on the stack")
+    {
+        constexpr std::size_t count = 40;
+        std::vector<coro::channel<int>> owned;
+        std::vector<coro::channel<int> *> chans;
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            auto ch = coro::channel<int>::create(1);
+            REQUIRE(ch.has_value());
+            owned.push_back(std::move(*ch));
+        }
+        for (auto &ch : owned)
+            chans.push_back(&ch);
+
+        coro::task_runner runner;
+        std::vector<std::size_t> from;
+        auto c = coro::coroutine::create([&](coro::coroutine_handle h)
+                                         {
+            for (int i = 0; i < 2; ++i)
+            {
+                auto r = coro::select(h, chans);
+                REQUIRE(r.has_value());
+                CHECK(r->value == static_cast<int>(r->index) * 10);
+                from.push_back(r->index);
+            } });
+        REQUIRE(c.has_value());
+        runner.add(std::move(*c));
+        REQUIRE(runner.step().has_value());
+        CHECK(runner.parked() == 1);
+        CHECK(owned[33].try_send(330).has_value());
+        REQUIRE(runner.step().has_value());
+        CHECK(owned[2].try_send(20).has_value());
+        REQUIRE(runner.run().has_value());
+        CHECK(from == std::vector<std::size_t>{33, 2});
+
+        CHECK(coro::select(coro::coroutine_handle{}, chans).error() == coro::error::invalid_coroutine);
+    }
+
+    TEST_CASE("cancelling a blocked select unlinks every registration")
+    {
+        auto a = coro::channel<int>::create(1);
+        auto b = coro::channel<int>::create(1);
+        REQUIRE(a.has_value());
+        REQUIRE(b.has_value());
+        coro::task_runner runner;
+        coro::error seen = coro::error::success;
+        auto c = coro::coroutine::create([&](coro::coroutine_handle h)
+                                         {
+            auto r = coro::select(h, *a, *b);
+            REQUIRE_FALSE(r.has_value());
+            seen = r.error(); });
+        REQUIRE(c.has_value());
+        auto handle = c->handle();
+        runner.add(std::move(*c));
+        REQUIRE(runner.step().has_value());
+        REQUIRE(handle.cancel().has_value());
+        REQUIRE(runner.run().has_value());
+        CHECK(seen == coro::error::cancelled);
+        CHECK(a->try_send(1).has_value()); // nothing left on the lists to wake
+        CHECK(b->try_send(2).has_value());
+    }
+
+    TEST_CASE("select_any returns the first coroutine to finish")
+    {
+        coro::task_runner runner;
+        std::vector<coro::coroutine_handle> workers;
+        for (int laps : {4, 1, 2})
+        {
+            auto w = coro::coroutine::create([laps](coro::coroutine_handle h)
+                                             {
+                for (int i = 0; i < laps; ++i)
+                    [[maybe_unused]] auto _ = h.yield(); });
+            REQUIRE(w.has_value());
+            workers.push_back(w->handle());
+            runner.add(std::move(*w));
+        }
+        std::vector<std::size_t> winners;
+        int parent_resumes = 0;
+        auto parent = coro::coroutine::create([&](coro::coroutine_handle h)
+                                              {
+            auto first = coro::select_any(h, workers[0], workers[1], workers[2]);
+            ++parent_resumes;
+            REQUIRE(first.has_value());
+            winners.push_back(*first);
+            auto second = coro::select_any(h, std::span<coro::coroutine_handle const>{std::array{workers[0], workers[2]}});
+            ++parent_resumes;
+            REQUIRE(second.has_value());
+            winners.push_back(*second); });
+        REQUIRE(parent.has_value());
+        runner.add(std::move(*parent));
+        REQUIRE(runner.run().has_value());
+        CHECK(winners == std::vector<std::size_t>{1, 1});
+        CHECK(parent_resumes == 2);
+    }
+
+    TEST_CASE("select_any reports finished and destroyed coroutines")
+    {
+        auto finished = coro::coroutine::create([](coro::coroutine_handle) {});
+        REQUIRE(finished.has_value());
+        REQUIRE(finished->resume().has_value());
+        auto pending = coro::coroutine::create([](coro::coroutine_handle h)
+                                               { [[maybe_unused]] auto _ = h.yield(); });
+        REQUIRE(pending.has_value());
+        REQUIRE(pending->resume().has_value());
+
+        coro::task_runner runner;
+        std::expected<std::size_t, coro::error> early = std::unexpected{coro::error::generic_error};
+        std::expected<std::size_t, coro::error> late = std::unexpected{coro::error::generic_error};
+        auto waiter = coro::coroutine::create([&](coro::coroutine_handle h)
+                                              {
+            early = coro::select_any(h, pending->handle(), finished->handle());
+            late = coro::select_any(h, pending->handle());
+            CHECK(coro::select_any(h, h).error() == coro::error::invalid_operation);
+            CHECK(coro::select_any(h, coro::coroutine_handle{}).error() == coro::error::invalid_coroutine); });
+        REQUIRE(waiter.has_value());
+        runner.add(std::move(*waiter));
+        REQUIRE(runner.step().has_value());
+        CHECK(early == 1u);
+        CHECK(runner.parked() == 1);
+        { auto gone = std::move(*pending); } // destroyed while suspended
+        REQUIRE(runner.run().has_value());
+        CHECK(late == 0u);
+    }
+}
+
+// ============================================================================
+// async I/O tests
+// ============================================================================
+
+#if defined(UCORO_IO_AVAILABLE)
+namespace
+{
+    // every backend this host can actually create; io_uring may be disabled by the kernel or
+    // a seccomp profile, in which case only the readiness backend is exercised
+    auto io_backends() -> std::vector<coro::io::backend>
+    {
+        std::vector<coro::io::backend> found;
+        for (auto b : {coro::io::backend::io_uring, coro::io::readiness_backend})
+        {
+            if (coro::io::runner::create(b, 64))
+                found.push_back(b);
+            else
+                MESSAGE(coro::io::to_string(b) << " unavailable (errno " << coro::io::last_errno() << ")");
+        }
+        return found;
+    }
+
+    auto as_bytes(std::string_view s) -> std::span<std::byte const>
+    {
+        return std::as_bytes(std::span{s.data(), s.size()});
+    }
+}
+
+TEST_SUITE("async io")
+{
+    TEST_CASE("automatic picks a backend")
+    {
+        auto runner = coro::io::runner::create();
+        REQUIRE(runner.has_value());
+        CHECK(runner->backend() != coro::io::backend::automatic);
+        CHECK(coro::io::to_string(runner->backend()) != "unknown backend");
+    }
+
+    TEST_CASE("read and write over a pipe")
+    {
+        for (auto backend : io_backends())
+        {
+            INFO(coro::io::to_string(backend));
+            auto runner = coro::io::runner::create(backend, 64);
+            REQUIRE(runner.has_value());
+            CHECK(runner->backend() == backend);
+            std::array<int, 2> fds{};
+            REQUIRE(pipe(fds.data()) == 0);
+            std::string received;
+
+            auto reader = coro::coroutine::create([&](coro::coroutine_handle h)
+                                                  {
+                std::array<std::byte, 64> buf{};
+                auto n = coro::io::read(h, fds[0], buf);
+                REQUIRE(n.has_value());
+                received.assign(reinterpret_cast<char const *>(buf.data()), *n); });
+            auto writer = coro::coroutine::create([&](coro::coroutine_handle h)
+                                                  {
+                auto n = coro::io::write(h, fds[1], as_bytes("hello reactor"));
+                REQUIRE(n.has_value());
+                CHECK(*n == 13); });
+            REQUIRE(reader.has_value());
+            REQUIRE(writer.has_value());
+            runner->add(std::move(*reader)).add(std::move(*writer));
+
+            REQUIRE(runner->run().has_value());
+            CHECK(runner->empty());
+            CHECK(runner->in_flight() == 0);
+            CHECK(received == "hello reactor");
+            close(fds[0]);
+            close(fds[1]);
+        }
+    }
+
+    TEST_CASE("positional file reads and writes")
+    {
+        for (auto backend : io_backends())
+        {
+            INFO(coro::io::to_string(backend));
+            auto runner = coro::io::runner::create(backend, 64);
+            REQUIRE(runner.has_value());
+            std::FILE *file = std::tmpfile();
+            REQUIRE(file != nullptr);
+            int const fd = fileno(file);
+            std::string back;
+
+            auto task = coro::coroutine::create([&](coro::coroutine_handle h)
+                                                {
+                REQUIRE(coro::io::write(h, fd, as_bytes("0123456789"), 0).has_value());
+                REQUIRE(coro::io::write(h, fd, as_bytes("abc"), 4).has_value());
+                std::array<std::byte, 16> buf{};
+                auto n = coro::io::read(h, fd, buf, 2);
+                REQUIRE(n.has_value());
+                back.assign(reinterpret_cast<char const *>(buf.data()), *n); });
+            REQUIRE(task.has_value());
+            runner->add(std::move(*task));
+
+            REQUIRE(runner->run().has_value());
+            CHECK(back == "23abc789");
+            std::fclose(file);
+        }
+    }
+
+    TEST_CASE("accept and connect over loopback")
+    {
+        for (auto backend : io_backends())
+        {
+            INFO(coro::io::to_string(backend));
+            auto runner = coro::io::runner::create(backend, 64);
+            REQUIRE(runner.has_value());
+            int const listener = socket(AF_INET, SOCK_STREAM, 0);
+            REQUIRE(listener >= 0);
+            sockaddr_in addr{};
+            addr.sin_family = AF_INET;
+            addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            REQUIRE(bind(listener, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) == 0);
+            REQUIRE(listen(listener, 4) == 0);
+            socklen_t len = sizeof(addr);
+            REQUIRE(getsockname(listener, reinterpret_cast<sockaddr *>(&addr), &len) == 0);
+            std::string echoed;
+
+            auto server = coro::coroutine::create([&](coro::coroutine_handle h)
+                                                  {
+                auto conn = coro::io::accept(h, listener);
+                REQUIRE(conn.has_value());
+                std::array<std::byte, 32> buf{};
+                auto n = coro::io::read(h, *conn, buf);
+                REQUIRE(n.has_value());
+                REQUIRE(coro::io::write(h, *conn, std::span<std::byte const>{buf.data(), *n}).has_value());
+                CHECK(coro::io::close(*conn).has_value()); });
+            auto client = coro::coroutine::create([&](coro::coroutine_handle h)
+                                                  {
+                int const sock = socket(AF_INET, SOCK_STREAM, 0);
+                REQUIRE(sock >= 0);
+                REQUIRE(coro::io::connect(h, sock, reinterpret_cast<sockaddr const *>(&addr), sizeof(addr)).has_value());
+                REQUIRE(coro::io::write(h, sock, as_bytes("ping")).has_value());
+                std::array<std::byte, 32> buf{};
+                auto n = coro::io::read(h, sock, buf);
+                REQUIRE(n.has_value());
+                echoed.assign(reinterpret_cast<char const *>(buf.data()), *n);
+                CHECK(coro::io::close(sock).has_value()); });
+            REQUIRE(server.has_value());
+            REQUIRE(client.has_value());
+            runner->add(std::move(*server)).add(std::move(*client));
+
+            REQUIRE(runner->run().has_value());
+            CHECK(echoed == "ping");
+            close(listener);
+        }
+    }
+
+    TEST_CASE("connect to a closed port fails with the socket error")
+    {
+        for (auto backend : io_backends())
+        {
+            INFO(coro::io::to_string(backend));
+            auto runner = coro::io::runner::create(backend, 64);
+            REQUIRE(runner.has_value());
+            // bind a port, then close it so nothing is listening there
+            int const probe = socket(AF_INET, SOCK_STREAM, 0);
+            REQUIRE(probe >= 0);
+            sockaddr_in addr{};
+            addr.sin_family = AF_INET;
+            addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            REQUIRE(bind(probe, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) == 0);
+            socklen_t len = sizeof(addr);
+            REQUIRE(getsockname(probe, reinterpret_cast<sockaddr *>(&addr), &len) == 0);
+            close(probe);
+            bool refused = false;
+
+            auto client = coro::coroutine::create([&](coro::coroutine_handle h)
+                                                  {
+                int const sock = socket(AF_INET, SOCK_STREAM, 0);
+                REQUIRE(sock >= 0);
+                auto connected = coro::io::connect(h, sock, reinterpret_cast<sockaddr const *>(&addr), sizeof(addr));
+                REQUIRE_FALSE(connected.has_value());
+                CHECK(connected.error() == coro::error::io_error);
+                refused = coro::io::last_errno() == ECONNREFUSED;
+                (void)coro::io::close(sock); });
+            REQUIRE(client.has_value());
+            runner->add(std::move(*client));
+            REQUIRE(runner->run().has_value());
+            CHECK(refused);
+        }
+    }
+
+    TEST_CASE("one reactor call serves a whole tick")
+    {
+        constexpr std::size_t count = 32;
+        for (auto backend : io_backends())
+        {
+            INFO(coro::io::to_string(backend));
+            auto runner = coro::io::runner::create(backend, 64);
+            REQUIRE(runner.has_value());
+            std::vector<std::array<int, 2>> pipes(count);
+            for (auto &p : pipes)
+                REQUIRE(pipe(p.data()) == 0);
+            std::size_t bytes = 0;
+            for (auto &p : pipes)
+            {
+                auto c = coro::coroutine::create([&bytes, fd = p[0]](coro::coroutine_handle h)
+                                                 {
+                    std::array<std::byte, 8> buf{};
+                    auto n = coro::io::read(h, fd, buf);
+                    REQUIRE(n.has_value());
+                    bytes += *n; });
+                REQUIRE(c.has_value());
+                runner->add(std::move(*c));
+            }
+            // everyone blocks on an empty pipe; one writer then feeds them all
+            auto feeder = coro::coroutine::create([&](coro::coroutine_handle h)
+                                                  {
+                [[maybe_unused]] auto _ = h.yield();
+                for (auto &p : pipes)
+                    REQUIRE(coro::io::write(h, p[1], as_bytes("x")).has_value()); });
+            REQUIRE(feeder.has_value());
+            runner->add(std::move(*feeder));
+
+            REQUIRE(runner->run().has_value());
+            CHECK(bytes == count);
+            // io_uring: one enter per write plus the reads' batch; epoll: each wait sees many edges
+            CHECK(runner->reactor_calls() <= count + 3);
+            for (auto &p : pipes)
+            {
+                close(p[0]);
+                close(p[1]);
+            }
+        }
+    }
+
+    TEST_CASE("registered buffers and fixed files")
+    {
+        for (auto backend : io_backends())
+        {
+            INFO(coro::io::to_string(backend));
+            auto runner = coro::io::runner::create(backend, 64);
+            REQUIRE(runner.has_value());
+            std::array<int, 2> fds{};
+            REQUIRE(pipe(fds.data()) == 0);
+            alignas(64) std::array<std::byte, 128> arena{};
+            std::array<iovec, 1> buffers{{{arena.data(), arena.size()}}};
+            auto registered = runner->register_buffers(buffers);
+            if (!registered)
+            {
+                MESSAGE("buffer registration refused (errno " << coro::io::last_errno() << ")");
+                close(fds[0]);
+                close(fds[1]);
+                continue;
+            }
+            REQUIRE(runner->register_files(std::span<int const>{fds}).has_value());
+            std::string got;
+
+            auto task = coro::coroutine::create([&](coro::coroutine_handle h)
+                                                {
+                auto out = std::span{arena}.first(5);
+                std::memcpy(out.data(), "fixed", 5);
+                auto w = coro::io::write_fixed(h, coro::io::fixed_file{1}, out, 0);
+                REQUIRE(w.has_value());
+                CHECK(*w == 5);
+                auto in = std::span{arena}.subspan(64, 16);
+                auto r = coro::io::read_fixed(h, coro::io::fixed_file{0}, in, 0);
+                REQUIRE(r.has_value());
+                got.assign(reinterpret_cast<char const *>(in.data()), *r); });
+            REQUIRE(task.has_value());
+            runner->add(std::move(*task));
+
+            REQUIRE(runner->run().has_value());
+            CHECK(got == "fixed");
+            close(fds[0]);
+            close(fds[1]);
+        }
+    }
+
+    TEST_CASE("kernel errors surface as io_error with errno")
+    {
+        for (auto backend : io_backends())
+        {
+            INFO(coro::io::to_string(backend));
+            auto runner = coro::io::runner::create(backend, 64);
+            REQUIRE(runner.has_value());
+            bool checked = false;
+            auto task = coro::coroutine::create([&](coro::coroutine_handle h)
+                                                {
+                std::array<std::byte, 8> buf{};
+                auto n = coro::io::read(h, -1, buf);
+                REQUIRE_FALSE(n.has_value());
+                CHECK(n.error() == coro::error::io_error);
+                CHECK(coro::io::last_errno() == EBADF);
+                auto unregistered = coro::io::read(h, coro::io::fixed_file{3}, buf);
+                CHECK_FALSE(unregistered.has_value());
+                checked = true; });
+            REQUIRE(task.has_value());
+            runner->add(std::move(*task));
+            REQUIRE(runner->run().has_value());
+            CHECK(checked);
+        }
+    }
+
+    TEST_CASE("a closed and reused descriptor number registers afresh")
+    {
+        auto runner = coro::io::runner::create(coro::io::readiness_backend);
+        REQUIRE(runner.has_value());
+        std::array<int, 2> first{};
+        std::array<int, 2> second{};
+        REQUIRE(pipe(first.data()) == 0);
+        int reused = -1;
+        std::string got;
+
+        auto task = coro::coroutine::create([&](coro::coroutine_handle h)
+                                            {
+            REQUIRE(coro::io::write(h, first[1], as_bytes("a")).has_value());
+            std::array<std::byte, 4> buf{};
+            REQUIRE(coro::io::read(h, first[0], buf).has_value());
+            REQUIRE(coro::io::close(first[0]).has_value());
+            REQUIRE(coro::io::close(first[1]).has_value());
+
+            REQUIRE(pipe(second.data()) == 0); // lowest free numbers: same as before
+            reused = second[0];
+            auto n = coro::io::read(h, second[0], buf); // parks until the other task writes
+            REQUIRE(n.has_value());
+            got.assign(reinterpret_cast<char const *>(buf.data()), *n); });
+        auto writer = coro::coroutine::create([&](coro::coroutine_handle h)
+                                              {
+            while (reused < 0)
+                [[maybe_unused]] auto _ = h.yield();
+            [[maybe_unused]] auto _ = h.yield();
+            REQUIRE(coro::io::write(h, second[1], as_bytes("b")).has_value()); });
+        REQUIRE(task.has_value());
+        REQUIRE(writer.has_value());
+        runner->add(std::move(*task)).add(std::move(*writer));
+
+        REQUIRE(runner->run().has_value());
+        CHECK(reused == first[0]);
+        CHECK(got == "b");
+        close(second[0]);
+        close(second[1]);
+    }
+
+    TEST_CASE("operations outside runner::run are rejected")
+    {
+        bool checked = false;
+        auto task = coro::coroutine::create([&](coro::coroutine_handle h)
+                                            {
+            std::array<std::byte, 8> buf{};
+            auto n = coro::io::read(h, 0, buf);
+            REQUIRE_FALSE(n.has_value());
+            CHECK(n.error() == coro::error::invalid_operation);
+            checked = true; });
+        REQUIRE(task.has_value());
+        CHECK(task->resume().has_value());
+        CHECK(checked);
+    }
+
+    TEST_CASE("sleepers bound how long the reactor blocks")
+    {
+        using namespace std::chrono_literals;
+        for (auto backend : io_backends())
+        {
+            INFO(coro::io::to_string(backend));
+            auto runner = coro::io::runner::create(backend, 64);
+            REQUIRE(runner.has_value());
+            std::array<int, 2> fds{};
+            REQUIRE(pipe(fds.data()) == 0);
+            std::string received;
+            auto const start = std::chrono::steady_clock::now();
+
+            // the reader is blocked in the kernel; only the timer can get the writer going
+            auto reader = coro::coroutine::create([&](coro::coroutine_handle h)
+                                                  {
+                std::array<std::byte, 16> buf{};
+                auto n = coro::io::read(h, fds[0], buf);
+                REQUIRE(n.has_value());
+                received.assign(reinterpret_cast<char const *>(buf.data()), *n); });
+            auto writer = coro::coroutine::create([&](coro::coroutine_handle h)
+                                                  {
+                REQUIRE(coro::sleep_for(h, 20ms).has_value());
+                REQUIRE(coro::io::write(h, fds[1], as_bytes("late")).has_value()); });
+            REQUIRE(reader.has_value());
+            REQUIRE(writer.has_value());
+            runner->add(std::move(*reader)).add(std::move(*writer));
+
+            REQUIRE(runner->run().has_value());
+            CHECK(received == "late");
+            CHECK(std::chrono::steady_clock::now() - start >= 20ms);
+            CHECK(runner->reactor_calls() < 10); // blocked for the timeout instead of spinning
+            close(fds[0]);
+            close(fds[1]);
+        }
+    }
+
+    TEST_CASE("cancelling a task blocked in I/O wakes it with error::cancelled")
+    {
+        using namespace std::chrono_literals;
+        for (auto backend : io_backends())
+        {
+            INFO(coro::io::to_string(backend));
+            auto runner = coro::io::runner::create(backend, 64);
+            REQUIRE(runner.has_value());
+            std::array<int, 2> fds{};
+            REQUIRE(pipe(fds.data()) == 0);
+            std::optional<coro::error> read_result, after;
+            coro::coroutine_handle reader_handle;
+
+            auto reader = coro::coroutine::create([&](coro::coroutine_handle h)
+                                                  {
+                std::array<std::byte, 16> buf{};
+                auto n = coro::io::read(h, fds[0], buf); // nobody ever writes
+                read_result = n ? coro::error::success : n.error();
+                auto again = coro::io::read(h, fds[0], buf);
+                after = again ? coro::error::success : again.error(); });
+            auto canceller = coro::coroutine::create([&](coro::coroutine_handle h)
+                                                     {
+                REQUIRE(coro::sleep_for(h, 5ms).has_value());
+                REQUIRE(reader_handle.cancel().has_value()); });
+            REQUIRE(reader.has_value());
+            REQUIRE(canceller.has_value());
+            reader_handle = reader->handle();
+            runner->add(std::move(*reader)).add(std::move(*canceller));
+
+            REQUIRE(runner->run().has_value());
+            CHECK(runner->empty());
+            CHECK(runner->in_flight() == 0);
+            CHECK(read_result == coro::error::cancelled);
+            CHECK(after == coro::error::cancelled);
+            close(fds[0]);
+            close(fds[1]);
+        }
+    }
+
+    TEST_CASE("posts from another thread wake a runner blocked in its reactor")
+    {
+        using namespace std::chrono_literals;
+        for (auto backend : io_backends())
+        {
+            INFO(coro::io::to_string(backend));
+            auto runner = coro::io::runner::create(backend, 64);
+            REQUIRE(runner.has_value());
+            std::array<int, 2> fds{};
+            REQUIRE(pipe(fds.data()) == 0);
+            std::stop_source stop;
+            std::string received;
+
+            // the reader blocks in the kernel until a posted writer shows up
+            auto reader = coro::coroutine::create([&](coro::coroutine_handle h)
+                                                  {
+                std::array<std::byte, 16> buf{};
+                auto n = coro::io::read(h, fds[0], buf);
+                REQUIRE(n.has_value());
+                received.assign(reinterpret_cast<char const *>(buf.data()), *n);
+                stop.request_stop(); });
+            REQUIRE(reader.has_value());
+            runner->add(std::move(*reader));
+
+            std::thread producer{[&]
+                                 {
+                std::this_thread::sleep_for(5ms);
+                REQUIRE(runner->post([&](coro::coroutine_handle h)
+                                     { REQUIRE(coro::io::write(h, fds[1], as_bytes("posted")).has_value()); })
+                            .has_value()); }};
+            REQUIRE(runner->run(stop.get_token()).has_value());
+            producer.join();
+            CHECK(received == "posted");
+            CHECK(runner->empty());
+            CHECK(runner->reactor_calls() < 10); // slept in the reactor instead of spinning
+            close(fds[0]);
+            close(fds[1]);
+        }
+    }
+
+    TEST_CASE("wake_remote reaches a task parked while the reactor sleeps")
+    {
+        for (auto backend : io_backends())
+        {
+            INFO(coro::io::to_string(backend));
+            auto runner = coro::io::runner::create(backend, 64);
+            REQUIRE(runner.has_value());
+            std::stop_source stop;
+            std::thread waker;
+            bool woken = false;
+
+            auto task = coro::coroutine::create([&](coro::coroutine_handle h)
+                                                {
+                waker = std::thread{[&runner, h]
+                                    { REQUIRE(runner->wake_remote(h).has_value()); }};
+                REQUIRE(h.park().has_value());
+                woken = true;
+                stop.request_stop(); });
+            REQUIRE(task.has_value());
+            runner->add(std::move(*task));
+
+            REQUIRE(runner->run(stop.get_token()).has_value());
+            waker.join();
+            CHECK(woken);
+            CHECK(runner->empty());
+        }
+    }
+}
+#endif
+
+// ============================================================================
+// symmetric transfer tests
+// ============================================================================
+
+TEST_SUITE("transfer")
+{
+    TEST_CASE("pipeline hops return to the original resumer")
+    {
+        std::vector<int> trace;
+        std::optional<coro::coroutine> stage_c;
+        std::optional<coro::coroutine> stage_b;
+
+        auto c = coro::coroutine::create([&trace](coro::coroutine_handle h)
+                                         {
+            trace.push_back(3);
+            [[maybe_unused]] auto _ = h.yield();
+            trace.push_back(6); });
+        REQUIRE(c.has_value());
+        stage_c.emplace(std::move(*c));
+
+        auto b = coro::coroutine::create([&trace, &stage_c](coro::coroutine_handle h)
+                                         {
+            trace.push_back(2);
+            [[maybe_unused]] auto _ = h.transfer(stage_c->handle());
+            trace.push_back(5);
+            _ = h.transfer(stage_c->handle()); });
+        REQUIRE(b.has_value());
+        stage_b.emplace(std::move(*b));
+
+        auto a = coro::coroutine::create([&trace, &stage_b](coro::coroutine_handle h)
+                                         {
+            trace.push_back(1);
+            [[maybe_unused]] auto _ = h.transfer(stage_b->handle());
+            trace.push_back(4);
+            _ = h.transfer(stage_b->handle()); });
+        REQUIRE(a.has_value());
+
+        REQUIRE(a->resume().has_value());
+        CHECK(trace == std::vector<int>{1, 2, 3});
+        CHECK(a->suspended());
+        CHECK(stage_b->suspended());
+        CHECK(stage_c->suspended());
+        CHECK(coro::detail::mco_running() == nullptr);
+
+        REQUIRE(a->resume().has_value());
+        CHECK(trace == std::vector<int>{1, 2, 3, 4, 5, 6});
+        CHECK(stage_c->done());
+        CHECK(a->suspended());
+        CHECK(stage_b->suspended());
+    }
+
+    TEST_CASE("transfer hands over storage and resumes after the call site")
+    {
+        std::optional<coro::coroutine> consumer;
+        auto cons = coro::coroutine::create([](coro::coroutine_handle h)
+                                            {
+            while (true)
+            {
+                auto v = h.pop<int>();
+                if (v)
+                    [[maybe_unused]] auto _ = h.push(*v + 1);
+                [[maybe_unused]] auto _ = h.yield();
+            } });
+        REQUIRE(cons.has_value());
+        consumer.emplace(std::move(*cons));
+
+        int received = 0;
+        auto producer = coro::coroutine::create([&consumer, &received](coro::coroutine_handle h)
+                                                {
+            [[maybe_unused]] auto _ = consumer->push(41);
+            _ = h.transfer(consumer->handle());
+            auto v = consumer->pop<int>();
+            if (v)
+                received = *v; });
+        REQUIRE(producer.has_value());
+
+        (void)producer->resume(); // producer -> consumer -> back here
+        CHECK(received == 0);
+        (void)producer->resume(); // producer continues after transfer
+        CHECK(received == 42);
+        CHECK(producer->done());
+    }
+
+    TEST_CASE("nested transfer keeps the parent coroutine chain")
+    {
+        coro::detail::mco_coro *parent_raw = nullptr;
+        bool parent_normal = false;
+        bool back_in_parent = false;
+
+        auto target = coro::coroutine::create([&](coro::coroutine_handle h)
+                                              {
+            parent_normal = coro::detail::mco_status(parent_raw) == coro::detail::mco_state::normal;
+            [[maybe_unused]] auto _ = h.yield(); });
+        REQUIRE(target.has_value());
+
+        auto parent = coro::coroutine::create([&](coro::coroutine_handle h)
+                                              {
+            parent_raw = h.raw();
+            auto child = coro::coroutine::create([&target](coro::coroutine_handle ch)
+                                                 { [[maybe_unused]] auto _ = ch.transfer(target->handle()); });
+            if (child)
+                (void)child->resume();
+            back_in_parent = coro::detail::mco_running() == h.raw() && h.status() == coro::state::running; });
+        REQUIRE(parent.has_value());
+
+        (void)parent->resume();
+        CHECK(parent_normal);
+        CHECK(back_in_parent);
+        CHECK(parent->done());
+        CHECK(target->suspended());
+    }
+
+    TEST_CASE("invalid transfers are rejected")
+    {
+        auto dead = coro::coroutine::create([](coro::coroutine_handle) {});
+        REQUIRE(dead.has_value());
+        (void)dead->resume();
+        REQUIRE(dead->done());
+
+        coro::error self_error = coro::error::success;
+        coro::error dead_error = coro::error::success;
+        coro::error null_error = coro::error::success;
+        auto c = coro::coroutine::create([&](coro::coroutine_handle h)
+                                         {
+            self_error = h.transfer(h).error();
+            dead_error = h.transfer(dead->handle()).error();
+            null_error = h.transfer(coro::coroutine_handle{}).error(); });
+        REQUIRE(c.has_value());
+        (void)c->resume();
+        CHECK(self_error == coro::error::invalid_operation);
+        CHECK(dead_error == coro::error::not_suspended);
+        CHECK(null_error == coro::error::invalid_coroutine);
+
+        // not running: a suspended coroutine cannot transfer from outside
+        auto idle = coro::coroutine::create([](coro::coroutine_handle) {});
+        REQUIRE(idle.has_value());
+        auto result = idle->handle().transfer(dead->handle());
+        CHECK_FALSE(result.has_value());
+        CHECK(result.error() == coro::error::not_running);
+    }
+}
+
+// ============================================================================
+// switch kind tests
+// ============================================================================
+
+namespace
+{
+    // Keeps integer and floating-point values live across every switch on both stacks. The
+    // integers wrap (unsigned), so the optimiser can't fold them away as overflow.
+    template <coro::switch_kind Resume, coro::switch_kind Yield>
+    void check_values_survive_switches()
+    {
+        std::uint64_t inner_sum = 0;
+        double inner_product = 1.0;
+        auto c = coro::coroutine::create([&](coro::coroutine_handle h)
+                                         {
+            std::uint64_t a = 1, b = 2;
+            double x = 1.5, y = 0.5;
+            for (int i = 0; i < 64; ++i)
+            {
+                h.yield_unchecked<Yield>();
+                a += b;
+                b += a;
+                x *= y + 1.0;
+                y *= 1.0001;
+            }
+            inner_sum = a + b;
+            inner_product = x + y; });
+        REQUIRE(c.has_value());
+
+        std::uint64_t outer = 7;
+        double outer_fp = 3.25;
+        for (std::uint64_t i = 0; i < 65; ++i)
+        {
+            c->template resume_unchecked<Resume>();
+            outer = outer * 3 + i;
+            outer_fp = outer_fp * 0.75 + 1.0;
+        }
+        CHECK(c->done());
+
+        std::uint64_t a = 1, b = 2;
+        double x = 1.5, y = 0.5;
+        for (int i = 0; i < 64; ++i)
+        {
+            a += b;
+            b += a;
+            x *= y + 1.0;
+            y *= 1.0001;
+        }
+        CHECK(inner_sum == a + b);
+        CHECK(inner_product == doctest::Approx(x + y));
+
+        std::uint64_t expected = 7;
+        double expected_fp = 3.25;
+        for (std::uint64_t i = 0; i < 65; ++i)
+        {
+            expected = expected * 3 + i;
+            expected_fp = expected_fp * 0.75 + 1.0;
+        }
+        CHECK(outer == expected);
+        CHECK(outer_fp == doctest::Approx(expected_fp));
+    }
+}
+
+TEST_SUITE("switch kinds")
+{
+    TEST_CASE("values survive the clobber switch on both sides")
+    {
+        check_values_survive_switches<coro::switch_kind::clobber, coro::switch_kind::clobber>();
+    }
+
+    TEST_CASE("kinds can be mixed on one coroutine")
+    {
+        check_values_survive_switches<coro::switch_kind::clobber, coro::switch_kind::full>();
+        check_values_survive_switches<coro::switch_kind::full, coro::switch_kind::clobber>();
+        check_values_survive_switches<coro::switch_kind::clobber, coro::switch_kind::integer_only>();
+    }
+
+    TEST_CASE("integer_only switches an integer-only coroutine")
+    {
+        std::uint32_t checksum = 0;
+        auto c = coro::coroutine::create([&checksum](coro::coroutine_handle h)
+                                         {
+            for (std::uint32_t i = 0; i < 100; ++i)
+            {
+                checksum = (checksum << 5) ^ (checksum >> 27) ^ i;
+                h.yield_unchecked<coro::switch_kind::integer_only>();
+            } });
+        REQUIRE(c.has_value());
+        int resumes = 0;
+        while (!c->done())
+        {
+            c->resume_unchecked<coro::switch_kind::integer_only>();
+            ++resumes;
+        }
+        CHECK(resumes == 101);
+        std::uint32_t expected = 0;
+        for (std::uint32_t i = 0; i < 100; ++i)
+            expected = (expected << 5) ^ (expected >> 27) ^ i;
+        CHECK(checksum == expected);
+    }
+
+    TEST_CASE("checked yield returns into a clobber resume")
+    {
+        int steps = 0;
+        auto c = coro::coroutine::create([&steps](coro::coroutine_handle h)
+                                         {
+            ++steps;
+            [[maybe_unused]] auto _ = h.yield();
+            ++steps; });
+        REQUIRE(c.has_value());
+        c->resume_unchecked<coro::switch_kind::clobber>();
+        CHECK(steps == 1);
+        REQUIRE(c->resume().has_value());
+        CHECK(steps == 2);
+        CHECK(c->done());
+    }
+
+    TEST_CASE("clobber transfer hops and returns to the resumer")
+    {
+        std::vector<int> trace;
+        std::optional<coro::coroutine> next;
+        auto b = coro::coroutine::create([&trace](coro::coroutine_handle h)
+                                         {
+            trace.push_back(2);
+            h.yield_unchecked<coro::switch_kind::clobber>();
+            trace.push_back(4); });
+        REQUIRE(b.has_value());
+        next.emplace(std::move(*b));
+
+        auto a = coro::coroutine::create([&trace, &next](coro::coroutine_handle h)
+                                         {
+            trace.push_back(1);
+            h.transfer_unchecked<coro::switch_kind::clobber>(next->handle());
+            trace.push_back(3); });
+        REQUIRE(a.has_value());
+
+        a->resume_unchecked<coro::switch_kind::clobber>();
+        CHECK(trace == std::vector<int>{1, 2});
+        CHECK(coro::detail::mco_running() == nullptr);
+        a->resume_unchecked<coro::switch_kind::clobber>();
+        CHECK(trace == std::vector<int>{1, 2, 3});
+        next->resume_unchecked<coro::switch_kind::clobber>();
+        CHECK(trace == std::vector<int>{1, 2, 3, 4});
+        CHECK(next->done());
+    }
+}
+
+// ============================================================================
+// pool tests
+// ============================================================================
+
+TEST_SUITE("pool")
+{
+    TEST_CASE("create pre-allocates idle frames")
+    {
+        auto p = coro::pool::create(4);
+        REQUIRE(p.has_value());
+        CHECK(p->idle() == 4);
+        CHECK(p->active() == 0);
+        CHECK(p->capacity() == 4);
+        CHECK(p->high_watermark() == 0);
+    }
+
+    TEST_CASE("spawned coroutine runs and returns its frame")
+    {
+        auto p = coro::pool::create(2);
+        REQUIRE(p.has_value());
+
+        int steps = 0;
+        {
+            auto c = p->spawn([&steps](coro::coroutine_handle h)
+                              {
+                ++steps;
+                [[maybe_unused]] auto _ = h.yield();
+                ++steps; });
+            REQUIRE(c.has_value());
+            CHECK(p->active() == 1);
+            CHECK(p->idle() == 1);
+
+            (void)c->resume();
+            (void)c->resume();
+            CHECK(c->done());
+        }
+        CHECK(steps == 2);
+        CHECK(p->active() == 0);
+        CHECK(p->idle() == 2);
+    }
+
+    TEST_CASE("frames are recycled instead of reallocated")
+    {
+        auto p = coro::pool::create(1);
+        REQUIRE(p.has_value());
+
+        coro::detail::mco_coro *first = nullptr;
+        {
+            auto c = p->spawn([](coro::coroutine_handle) {});
+            REQUIRE(c.has_value());
+            first = c->raw();
+        }
+        auto c = p->spawn([](coro::coroutine_handle) {});
+        REQUIRE(c.has_value());
+        CHECK(c->raw() == first);
+        CHECK(c->suspended());
+        CHECK(c->bytes_stored() == 0);
+    }
+
+    TEST_CASE("pool grows past its capacity and tracks the high watermark")
+    {
+        auto p = coro::pool::create(1);
+        REQUIRE(p.has_value());
+
+        {
+            std::vector<coro::coroutine> live;
+            for (int i = 0; i < 3; ++i)
+            {
+                auto c = p->spawn([](coro::coroutine_handle) {});
+                REQUIRE(c.has_value());
+                live.push_back(std::move(*c));
+            }
+            CHECK(p->active() == 3);
+            CHECK(p->idle() == 0);
+        }
+        CHECK(p->active() == 0);
+        CHECK(p->idle() == 3);
+        CHECK(p->high_watermark() == 3);
+
+        p->shrink();
+        CHECK(p->idle() == 0);
+    }
+
+    TEST_CASE("custom storage size is honoured")
+    {
+        auto p = coro::pool::create(1, coro::default_stack_size, coro::storage_size{256});
+        REQUIRE(p.has_value());
+        auto c = p->spawn([](coro::coroutine_handle) {});
+        REQUIRE(c.has_value());
+        CHECK(c->storage_capacity() == 256);
+    }
+
+    TEST_CASE("spawn with null function returns error")
+    {
+        auto p = coro::pool::create(1);
+        REQUIRE(p.has_value());
+        auto c = p->spawn(nullptr);
+        CHECK_FALSE(c.has_value());
+        CHECK(c.error() == coro::error::invalid_arguments);
+        CHECK(p->active() == 0);
+    }
+
+    TEST_CASE("coroutine may outlive its pool")
+    {
+        std::optional<coro::coroutine> survivor;
+        {
+            auto p = coro::pool::create(2);
+            REQUIRE(p.has_value());
+            auto c = p->spawn([](coro::coroutine_handle h)
+                              { [[maybe_unused]] auto _ = h.yield(); });
+            REQUIRE(c.has_value());
+            survivor.emplace(std::move(*c));
+        }
+        (void)survivor->resume();
+        (void)survivor->resume();
+        CHECK(survivor->done());
+        survivor.reset();
+    }
+
+    TEST_CASE("pooled coroutines run on a task_runner")
+    {
+        auto p = coro::pool::create(8);
+        REQUIRE(p.has_value());
+
+        int total = 0;
+        coro::task_runner runner;
+        for (int i = 0; i < 8; ++i)
+        {
+            auto c = p->spawn([&total](coro::coroutine_handle h)
+                              {
+                ++total;
+                [[maybe_unused]] auto _ = h.yield();
+                ++total; });
+            REQUIRE(c.has_value());
+            runner.add(std::move(*c));
+        }
+        (void)runner.run();
+        CHECK(total == 16);
+        CHECK(p->active() == 0);
+        CHECK(p->idle() == 8);
+    }
+}
+
+// ============================================================================
+// slab tests
+// ============================================================================
+
+TEST_SUITE("slabs")
+{
+    TEST_CASE("create_many lays frames out back to back")
+    {
+        std::vector<int> ran(64, 0);
+        auto s = coro::coroutine::create_many(ran.size(), [&ran](std::size_t i)
+                                              { return [&ran, i](coro::coroutine_handle)
+                                                { ++ran[i]; }; },
+                                              coro::min_stack_size);
+        REQUIRE(s.has_value());
+        REQUIRE(s->size() == 64);
+        CHECK(s->frames() == 64);
+        CHECK(s->frame_size() % 64 == 0);
+
+        auto const first = reinterpret_cast<std::uintptr_t>((*s)[0].raw());
+        CHECK(first % 64 == 0);
+        for (std::size_t i = 0; i < s->size(); ++i)
+        {
+            CHECK(reinterpret_cast<std::uintptr_t>((*s)[i].raw()) == first + i * s->frame_size());
+            CHECK((*s)[i].stack_capacity() >= coro::min_stack_size.value);
+        }
+
+        for (auto &c : *s)
+            REQUIRE(c.resume().has_value());
+        CHECK(std::ranges::all_of(ran, [](int n)
+                                  { return n == 1; }));
+        CHECK(std::ranges::all_of(*s, [](coro::coroutine const &c)
+                                  { return c.done(); }));
+    }
+
+    TEST_CASE("coroutines moved out of a slab outlive it")
+    {
+        int total = 0;
+        coro::task_runner runner;
+        {
+            auto s = coro::coroutine::create_many(16, [&total](std::size_t)
+                                                  { return [&total](coro::coroutine_handle h)
+                                                    {
+                    ++total;
+                    [[maybe_unused]] auto _ = h.yield();
+                    ++total; }; },
+                                                  coro::min_stack_size);
+            REQUIRE(s.has_value());
+            for (auto &c : *s)
+                runner.add(std::move(c));
+            CHECK(s->frames() == 16);
+        }
+        (void)runner.run();
+        CHECK(total == 32);
+    }
+
+    TEST_CASE("slab frames carry storage and callables of any size")
+    {
+        struct big_body
+        {
+            std::array<std::uint64_t, 32> words{};
+            void operator()(coro::coroutine_handle h) const
+            {
+                [[maybe_unused]] auto _ = h.push(words[31]);
+            }
+        };
+        auto s = coro::coroutine::create_many(4, [](std::size_t i)
+                                              {
+            big_body b;
+            b.words[31] = i * 10;
+            return b; },
+                                              coro::min_stack_size, coro::storage_size{256});
+        REQUIRE(s.has_value());
+        for (std::size_t i = 0; i < s->size(); ++i)
+        {
+            CHECK((*s)[i].storage_capacity() == 256);
+            REQUIRE((*s)[i].resume().has_value());
+            auto v = (*s)[i].pop<std::uint64_t>();
+            REQUIRE(v.has_value());
+            CHECK(*v == i * 10);
+        }
+    }
+
+    TEST_CASE("prefaulted and huge-page slabs behave like plain ones")
+    {
+        for (auto const options : {coro::slab_options{.prefault = true}, coro::slab_options{.huge_pages = true},
+                                   coro::slab_options{.prefault = true, .huge_pages = true}})
+        {
+            int total = 0;
+            auto s = coro::coroutine::create_many(8, [&total](std::size_t)
+                                                  { return [&total](coro::coroutine_handle)
+                                                    { ++total; }; },
+                                                  coro::min_stack_size, coro::default_storage_size, options);
+            REQUIRE(s.has_value());
+            for (auto &c : *s)
+                REQUIRE(c.resume().has_value());
+            CHECK(total == 8);
+        }
+    }
+
+    TEST_CASE("an empty or moved-from slab is an empty range")
+    {
+        auto s = coro::coroutine::create_many(0, [](std::size_t)
+                                              { return [](coro::coroutine_handle) {}; });
+        REQUIRE(s.has_value());
+        CHECK(s->empty());
+        CHECK(s->begin() == s->end());
+
+        auto full = coro::coroutine::create_many(2, [](std::size_t)
+                                                 { return [](coro::coroutine_handle) {}; },
+                                                 coro::min_stack_size);
+        REQUIRE(full.has_value());
+        coro::slab moved = std::move(*full);
+        CHECK(moved.size() == 2);
+        CHECK_FALSE(full->valid());
+        CHECK(full->empty());
+    }
+}
+
+// ============================================================================
+// stack allocator tests
+// ============================================================================
+
+namespace
+{
+    struct counting_allocator
+    {
+        std::size_t allocations = 0;
+        std::size_t deallocations = 0;
+        std::size_t last_size = 0;
+
+        auto allocate(std::size_t size) noexcept -> void *
+        {
+            ++allocations;
+            last_size = size;
+            return std::malloc(size);
+        }
+
+        void deallocate(void *ptr, std::size_t size) noexcept
+        {
+            ++deallocations;
+            CHECK(size == last_size);
+            std::free(ptr);
+        }
+    };
+}
+
+TEST_SUITE("stack allocators")
+{
+    TEST_CASE("shipped allocators model stack_allocator")
+    {
+        static_assert(coro::stack_allocator<coro::malloc_allocator>);
+        static_assert(coro::stack_allocator<coro::arena_allocator>);
+        static_assert(coro::stack_allocator<coro::freelist_allocator>);
+        static_assert(coro::stack_allocator<coro::numa_stack_allocator>);
+        static_assert(coro::stack_allocator<counting_allocator>);
+        static_assert(!coro::stack_allocator<int>);
+    }
+
+    TEST_CASE("custom allocator is used for the frame")
+    {
+        counting_allocator alloc;
+        int value = 0;
+        {
+            auto c = coro::coroutine::create([&value](coro::coroutine_handle h)
+                                             {
+                value = 1;
+                [[maybe_unused]] auto _ = h.yield();
+                value = 2; },
+                                             coro::default_stack_size, coro::default_storage_size, alloc);
+            REQUIRE(c.has_value());
+            CHECK(alloc.allocations == 1);
+            (void)c->resume();
+            (void)c->resume();
+            CHECK(c->done());
+        }
+        CHECK(value == 2);
+        CHECK(alloc.deallocations == 1);
+        CHECK(alloc.last_size >= coro::default_stack_size.value);
+    }
+
+    TEST_CASE("malloc_allocator frames work with storage")
+    {
+        coro::malloc_allocator alloc;
+        auto c = coro::coroutine::create([](coro::coroutine_handle h)
+                                         {
+            auto v = h.pop<int>();
+            if (v)
+                [[maybe_unused]] auto _ = h.push(*v * 2); },
+                                         coro::default_stack_size, coro::storage_size{64}, alloc);
+        REQUIRE(c.has_value());
+        CHECK(c->bytes_stored() == 0);
+        CHECK(c->storage_capacity() == 64);
+        (void)c->push(21);
+        (void)c->resume();
+        auto out = c->pop<int>();
+        REQUIRE(out.has_value());
+        CHECK(*out == 42);
+    }
+
+    TEST_CASE("arena_allocator hands out aligned frames until exhausted")
+    {
+        coro::arena_allocator arena{std::size_t{3 * 40 * 1024}};
+        REQUIRE(arena.capacity() == 3 * 40 * 1024);
+
+        std::vector<coro::coroutine> live;
+        for (int i = 0; i < 3; ++i)
+        {
+            auto c = coro::coroutine::create([](coro::coroutine_handle) {}, coro::min_stack_size, coro::default_storage_size, arena);
+            REQUIRE(c.has_value());
+            CHECK(reinterpret_cast<std::uintptr_t>(c->raw()) % 16 == 0);
+            live.push_back(std::move(*c));
+        }
+
+        auto overflow = coro::coroutine::create([](coro::coroutine_handle) {}, coro::default_stack_size, coro::default_storage_size, arena);
+        CHECK_FALSE(overflow.has_value());
+        CHECK(overflow.error() == coro::error::out_of_memory);
+
+        for (auto &c : live)
+            (void)c.resume();
+        live.clear();
+        arena.reset();
+        CHECK(arena.used() == 0);
+    }
+
+    TEST_CASE("arena_allocator reclaims frames freed in LIFO order")
+    {
+        std::vector<std::byte> buffer(128 * 1024);
+        coro::arena_allocator arena{std::span<std::byte>{buffer}};
+
+        auto a = coro::coroutine::create([](coro::coroutine_handle) {}, coro::min_stack_size, coro::default_storage_size, arena);
+        REQUIRE(a.has_value());
+        auto const after_a = arena.used();
+        {
+            auto b = coro::coroutine::create([](coro::coroutine_handle) {}, coro::min_stack_size, coro::default_storage_size, arena);
+            REQUIRE(b.has_value());
+            CHECK(arena.used() > after_a);
+        }
+        CHECK(arena.used() == after_a);
+    }
+
+    TEST_CASE("frame headers and contexts start on a cache line whatever the block alignment")
+    {
+        std::vector<std::byte> buffer(128 * 1024);
+        auto const misaligned = (64 - reinterpret_cast<std::uintptr_t>(buffer.data()) % 64 + 16) % 64;
+        coro::arena_allocator arena{std::span<std::byte>{buffer}.subspan(misaligned)};
+        {
+            auto c = coro::coroutine::create([](coro::coroutine_handle h)
+                                             { [[maybe_unused]] auto _ = h.yield(); },
+                                             coro::min_stack_size, coro::default_storage_size, arena);
+            REQUIRE(c.has_value());
+            auto *co = c->raw();
+            CHECK(reinterpret_cast<std::uintptr_t>(co) % coro::detail::mco_frame_align == 0);
+            CHECK(reinterpret_cast<std::uintptr_t>(coro::detail::mco_context_of(co)) % coro::detail::mco_frame_align == 0);
+            CHECK(co->frame_offset != 0); // the arena's block started 16 bytes into a line
+            REQUIRE(c->resume().has_value());
+            REQUIRE(c->resume().has_value());
+            CHECK(c->done());
+        }
+        CHECK(arena.used() == 0); // freed with the block's own address
+    }
+
+    TEST_CASE("freelist_allocator recycles frames of the same size")
+    {
+        coro::freelist_allocator alloc;
+        coro::detail::mco_coro *first = nullptr;
+        {
+            auto c = coro::coroutine::create([](coro::coroutine_handle) {}, coro::default_stack_size, coro::default_storage_size, alloc);
+            REQUIRE(c.has_value());
+            first = c->raw();
+        }
+        auto c = coro::coroutine::create([](coro::coroutine_handle) {}, coro::default_stack_size, coro::default_storage_size, alloc);
+        REQUIRE(c.has_value());
+        CHECK(c->raw() == first);
+        (void)c->resume();
+        CHECK(c->done());
+        coro::freelist_allocator::trim();
+    }
+
+    TEST_CASE("pool maps its frames from a custom allocator")
+    {
+        counting_allocator alloc;
+        {
+            auto p = coro::pool::create(2, coro::default_stack_size, coro::default_storage_size, alloc);
+            REQUIRE(p.has_value());
+            CHECK(alloc.allocations == 2);
+
+            auto c = p->spawn([](coro::coroutine_handle) {});
+            REQUIRE(c.has_value());
+            (void)c->resume();
+            CHECK(alloc.allocations == 2);
+        }
+        CHECK(alloc.deallocations == 2);
+    }
+
+    TEST_CASE("numa_stack_allocator serves the caller's node and recycles per size")
+    {
+        coro::numa_stack_allocator alloc;
+        CHECK(alloc.node() == coro::numa_stack_allocator::caller_node);
+
+        void *a = alloc.allocate(16 * 1024);
+        void *b = alloc.allocate(16 * 1024);
+        void *c = alloc.allocate(24 * 1024);
+        REQUIRE(a != nullptr);
+        REQUIRE(b != nullptr);
+        REQUIRE(c != nullptr);
+        CHECK(reinterpret_cast<std::uintptr_t>(a) % 64 == 0);
+        CHECK(static_cast<unsigned char *>(b) - static_cast<unsigned char *>(a) >= 16 * 1024);
+        CHECK(coro::numa_stack_allocator::node_of(a) == coro::numa_stack_allocator::current_node());
+        std::memset(a, 0xab, 16 * 1024);
+
+        alloc.deallocate(a, 16 * 1024);
+        CHECK(alloc.allocate(16 * 1024) == a); // same size comes back off the free list
+        CHECK(alloc.allocate(24 * 1024) != c);
+
+        void *big = alloc.allocate(std::size_t{1} << 20); // past a quarter chunk: its own mapping
+        REQUIRE(big != nullptr);
+        std::memset(big, 0, std::size_t{1} << 20);
+        alloc.deallocate(big, std::size_t{1} << 20);
+    }
+
+    TEST_CASE("numa_stack_allocator returns blocks freed on another thread to their node")
+    {
+        coro::numa_stack_allocator alloc{0};
+        void *block = alloc.allocate(32 * 1024);
+        REQUIRE(block != nullptr);
+        CHECK(coro::numa_stack_allocator::node_of(block) == 0);
+        std::thread{[&]
+                    { alloc.deallocate(block, 32 * 1024); }}
+            .join();
+        CHECK(alloc.allocate(32 * 1024) == block);
+    }
+
+    TEST_CASE("numa_stack_allocator maps large stacks on their own, with or without huge pages")
+    {
+        for (auto pages : {coro::page_kind::normal, coro::page_kind::transparent_huge, coro::page_kind::explicit_huge})
+        {
+            coro::numa_stack_allocator alloc{0, pages};
+            for (std::size_t size : {std::size_t{1024 * 1024}, std::size_t{3 * 1024 * 1024 + 4096}})
+            {
+                auto *block = static_cast<unsigned char *>(alloc.allocate(size));
+                REQUIRE(block != nullptr);
+                block[0] = 1;
+                block[size - 1] = 1;
+                alloc.deallocate(block, size);
+            }
+        }
+    }
+
+    TEST_CASE("numa_stack_allocator backs a pool, with or without huge pages")
+    {
+        for (auto pages : {coro::page_kind::normal, coro::page_kind::transparent_huge, coro::page_kind::explicit_huge})
+        {
+            coro::numa_stack_allocator alloc{coro::numa_stack_allocator::caller_node, pages};
+            auto p = coro::pool::create(8, coro::stack_size{16 * 1024}, coro::default_storage_size, alloc);
+            REQUIRE(p.has_value());
+
+            int sum = 0;
+            for (int round = 0; round < 3; ++round)
+            {
+                std::vector<coro::coroutine> live;
+                for (int i = 0; i < 8; ++i)
+                {
+                    auto c = p->spawn([&sum, i](coro::coroutine_handle h)
+                                      {
+                        sum += i;
+                        [[maybe_unused]] auto _ = h.yield();
+                        sum += i; });
+                    REQUIRE(c.has_value());
+                    CHECK(coro::numa_stack_allocator::node_of(c->raw()) == coro::numa_stack_allocator::current_node());
+                    live.push_back(std::move(*c));
+                }
+                for (auto &c : live)
+                    (void)c.resume();
+                for (auto &c : live)
+                    (void)c.resume();
+            }
+            CHECK(sum == 3 * 2 * 28);
+        }
+    }
+
+    TEST_CASE("thread_pool_runner runs coroutines on caller-node stacks")
+    {
+        coro::numa_stack_allocator alloc;
+        std::atomic<int> steps{0};
+        coro::thread_pool_runner runner{2};
+        for (int i = 0; i < 16; ++i)
+        {
+            auto c = coro::coroutine::create([&steps](coro::coroutine_handle h)
+                                             {
+                for (int k = 0; k < 4; ++k)
+                {
+                    steps.fetch_add(1, std::memory_order_relaxed);
+                    [[maybe_unused]] auto _ = h.yield();
+                } },
+                                             coro::stack_size{32 * 1024}, coro::default_storage_size, alloc);
+            REQUIRE(c.has_value());
+            runner.add(std::move(*c));
+        }
+        REQUIRE(runner.run().has_value());
+        CHECK(runner.empty());
+        CHECK(steps.load() == 64);
+    }
+}
+
+// ============================================================================
+// in-frame callable tests
+// ============================================================================
+
+namespace
+{
+    struct drop_counter
+    {
+        int *drops;
+        int *calls;
+
+        drop_counter(int *d, int *c) noexcept : drops{d}, calls{c} {}
+        drop_counter(drop_counter &&other) noexcept : drops{std::exchange(other.drops, nullptr)}, calls{other.calls} {}
+        drop_counter(drop_counter const &) = delete;
+        ~drop_counter()
+        {
+            if (drops != nullptr)
+                ++*drops;
+        }
+
+        void operator()(coro::coroutine_handle h) const
+        {
+            ++*calls;
+            [[maybe_unused]] auto _ = h.yield();
+            ++*calls;
+        }
+    };
+
+    struct alignas(64) overaligned_body
+    {
+        int *seen;
+        void operator()(coro::coroutine_handle) const
+        {
+            *seen = reinterpret_cast<std::uintptr_t>(this) % 64 == 0 ? 1 : -1;
+        }
+    };
+
+    auto inside_frame(coro::coroutine const &c, void const *p) -> bool
+    {
+        auto const *begin = reinterpret_cast<unsigned char const *>(c.raw());
+        auto const *ptr = static_cast<unsigned char const *>(p);
+        return ptr >= begin && ptr < static_cast<unsigned char const *>(c.raw()->stack_base);
+    }
+}
+
+TEST_SUITE("in-frame callables")
+{
+    TEST_CASE("lambda captures live inside the coroutine frame")
+    {
+        std::array<int, 8> payload{1, 2, 3, 4, 5, 6, 7, 8};
+        int sum = 0;
+        void const *captured = nullptr;
+        auto c = coro::coroutine::create([payload, &sum, &captured](coro::coroutine_handle)
+                                         {
+            captured = &payload;
+            sum = std::accumulate(payload.begin(), payload.end(), 0); });
+        REQUIRE(c.has_value());
+        CHECK(inside_frame(*c, c->handle().get_user_data<void>()));
+        (void)c->resume();
+        CHECK(sum == 36);
+        CHECK(inside_frame(*c, captured));
+    }
+
+    TEST_CASE("move-only callables are accepted and destroyed once")
+    {
+        int drops = 0;
+        int calls = 0;
+        {
+            auto c = coro::coroutine::create(drop_counter{&drops, &calls});
+            REQUIRE(c.has_value());
+            (void)c->resume();
+            CHECK(calls == 1);
+
+            auto moved = std::move(*c);
+            CHECK(drops == 0);
+            (void)moved.resume();
+            CHECK(calls == 2);
+            CHECK(moved.done());
+        }
+        CHECK(drops == 1);
+
+        // destroyed mid-run and never-started coroutines drop their callable too
+        {
+            auto suspended = coro::coroutine::create(drop_counter{&drops, &calls});
+            auto fresh = coro::coroutine::create(drop_counter{&drops, &calls});
+            REQUIRE(suspended.has_value());
+            REQUIRE(fresh.has_value());
+            (void)suspended->resume();
+        }
+        CHECK(drops == 3);
+    }
+
+    TEST_CASE("unique_ptr capture works without std::function")
+    {
+        auto owned = std::make_unique<int>(7);
+        int seen = 0;
+        auto c = coro::coroutine::create([p = std::move(owned), &seen](coro::coroutine_handle)
+                                         { seen = *p; });
+        REQUIRE(c.has_value());
+        (void)c->resume();
+        CHECK(seen == 7);
+    }
+
+    TEST_CASE("over-aligned callables are boxed with their alignment")
+    {
+        int seen = 0;
+        auto c = coro::coroutine::create(overaligned_body{&seen});
+        REQUIRE(c.has_value());
+        (void)c->resume();
+        CHECK(seen == 1);
+    }
+
+    TEST_CASE("custom allocator overload takes a plain lambda")
+    {
+        counting_allocator alloc;
+        int value = 0;
+        auto c = coro::coroutine::create([&value](coro::coroutine_handle)
+                                         { value = 1; },
+                                         coro::default_stack_size, coro::default_storage_size, alloc);
+        REQUIRE(c.has_value());
+        CHECK(alloc.allocations == 1);
+        CHECK(inside_frame(*c, c->handle().get_user_data<void>()));
+        (void)c->resume();
+        CHECK(value == 1);
+    }
+
+    TEST_CASE("pool stores small callables inline and boxes large ones")
+    {
+        auto p = coro::pool::create(2);
+        REQUIRE(p.has_value());
+
+        int small_seen = 0;
+        auto small = p->spawn([&small_seen](coro::coroutine_handle)
+                              { small_seen = 1; });
+        REQUIRE(small.has_value());
+        CHECK(inside_frame(*small, small->handle().get_user_data<void>()));
+
+        std::array<std::uint64_t, 16> big{};
+        big[15] = 5;
+        std::uint64_t big_seen = 0;
+        auto large = p->spawn([big, &big_seen](coro::coroutine_handle)
+                              { big_seen = big[15]; });
+        REQUIRE(large.has_value());
+        static_assert(sizeof(big) > coro::pool::inline_callable_size);
+
+        (void)small->resume();
+        (void)large->resume();
+        CHECK(small_seen == 1);
+        CHECK(big_seen == 5);
+        CHECK(p->frame_size() == small->raw()->coro_size);
+    }
+}
+
+// ============================================================================
+// guard page tests
+// ============================================================================
+
+namespace
+{
+    // burns ~1 KiB of stack per level; the volatile buffer keeps the frames from being folded
+    auto recurse(int depth) -> int
+    {
+        volatile char pad[1024];
+        pad[0] = 1;
+        if (depth == 0)
+            return 0;
+        int const below = recurse(depth - 1);
+        return below + pad[0];
+    }
+
+#if defined(__linux__) && !UCORO_STACK_PAINT
+    auto resident_bytes() -> std::size_t
+    {
+        std::FILE *f = std::fopen("/proc/self/statm", "r");
+        if (f == nullptr)
+            return 0;
+        unsigned long size = 0;
+        unsigned long resident = 0;
+        int const n = std::fscanf(f, "%lu %lu", &size, &resident);
+        std::fclose(f);
+        return n == 2 ? resident * static_cast<std::size_t>(sysconf(_SC_PAGESIZE)) : 0;
+    }
+#endif
+}
+
+TEST_SUITE("guard pages")
+{
+    TEST_CASE("virtual_stack_allocator models guarded_stack_allocator")
+    {
+        static_assert(coro::guarded_stack_allocator<coro::virtual_stack_allocator>);
+        static_assert(!coro::guarded_stack_allocator<coro::malloc_allocator>);
+        CHECK(coro::virtual_stack_allocator{}.guard_size() == coro::detail::mco_vm_page_size());
+    }
+
+    TEST_CASE("guarded stacks are page aligned and sit above the guard")
+    {
+        coro::virtual_stack_allocator alloc;
+        auto const page = alloc.guard_size();
+        auto c = coro::coroutine::create([](coro::coroutine_handle) {}, coro::stack_size{1024 * 1024}, coro::default_storage_size, alloc);
+        REQUIRE(c.has_value());
+
+        auto const base = reinterpret_cast<std::uintptr_t>(c->raw());
+        auto const stack = reinterpret_cast<std::uintptr_t>(c->raw()->stack_base);
+        CHECK(base % page == 0);
+        CHECK(stack % page == 0);
+        CHECK(stack - base >= 2 * page); // header page(s) + guard
+        CHECK(c->raw()->guard_size == page);
+        CHECK(c->raw()->stack_size % page == 0);
+        CHECK(reinterpret_cast<std::uintptr_t>(c->raw()->storage) + c->raw()->storage_size <= stack - page);
+        (void)c->resume();
+        CHECK(c->done());
+    }
+
+    TEST_CASE("deep recursion fits a large guarded stack")
+    {
+        coro::virtual_stack_allocator alloc;
+        int result = -1;
+        auto c = coro::coroutine::create([&result](coro::coroutine_handle h)
+                                         {
+            result = recurse(512);
+            [[maybe_unused]] auto _ = h.yield(); },
+                                         coro::stack_size{1024 * 1024}, coro::default_storage_size, alloc);
+        REQUIRE(c.has_value());
+        REQUIRE(c->resume().has_value());
+        CHECK(result == 512);
+        (void)c->resume();
+        CHECK(c->done());
+    }
+
+    TEST_CASE("pool protects guard pages on the frames it maps")
+    {
+        coro::virtual_stack_allocator alloc;
+        auto p = coro::pool::create(2, coro::stack_size{256 * 1024}, coro::default_storage_size, alloc);
+        REQUIRE(p.has_value());
+        CHECK(p->frame_size() % alloc.guard_size() == 0);
+
+        for (int round = 0; round < 3; ++round)
+        {
+            int result = -1;
+            auto c = p->spawn([&result](coro::coroutine_handle) { result = recurse(64); });
+            REQUIRE(c.has_value());
+            CHECK(c->raw()->guard_size == alloc.guard_size());
+            (void)c->resume();
+            CHECK(result == 64);
+        }
+        CHECK(p->capacity() == 2);
+    }
+
+    TEST_CASE("a guard that can't be protected fails the allocation")
+    {
+        // mprotect failing as it does once vm.max_map_count is reached
+        struct unprotectable_allocator
+        {
+            coro::virtual_stack_allocator vm;
+            std::size_t live = 0;
+
+            auto allocate(std::size_t size) noexcept -> void *
+            {
+                ++live;
+                return vm.allocate(size);
+            }
+            void deallocate(void *ptr, std::size_t size) noexcept
+            {
+                --live;
+                vm.deallocate(ptr, size);
+            }
+            [[nodiscard]] auto guard_size() const noexcept -> std::size_t { return vm.guard_size(); }
+            [[nodiscard]] auto protect(void *, std::size_t) noexcept -> bool { return false; }
+        };
+        static_assert(coro::guarded_stack_allocator<unprotectable_allocator>);
+
+        unprotectable_allocator alloc;
+        auto c = coro::coroutine::create([](coro::coroutine_handle) {}, coro::default_stack_size, coro::default_storage_size, alloc);
+        REQUIRE_FALSE(c.has_value());
+        CHECK(c.error() == coro::error::out_of_memory);
+        CHECK(alloc.live == 0);
+
+        auto lazy = coro::coroutine::create_lazy([](coro::coroutine_handle) {}, coro::default_stack_size, coro::default_storage_size, alloc);
+        REQUIRE(lazy.has_value());
+        auto result = lazy->resume();
+        REQUIRE_FALSE(result.has_value());
+        CHECK(result.error() == coro::error::out_of_memory);
+        CHECK(lazy->suspended());
+        CHECK(alloc.live == 1); // just the frame; the stack went back
+
+        auto p = coro::pool::create(2, coro::default_stack_size, coro::default_storage_size, alloc);
+        REQUIRE_FALSE(p.has_value());
+        CHECK(p.error() == coro::error::out_of_memory);
+    }
+
+#if defined(__linux__) && !UCORO_STACK_PAINT
+    // painting writes every stack byte up front, so this only holds in normal builds
+    TEST_CASE("untouched stack pages are not resident")
+    {
+        constexpr std::size_t count = 64;
+        constexpr std::size_t stack = 1024 * 1024;
+        coro::virtual_stack_allocator alloc;
+
+        auto const before = resident_bytes();
+        std::vector<coro::coroutine> live;
+        live.reserve(count);
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            auto c = coro::coroutine::create([](coro::coroutine_handle h)
+                                             { [[maybe_unused]] auto _ = h.yield(); },
+                                             coro::stack_size{stack}, coro::default_storage_size, alloc);
+            REQUIRE(c.has_value());
+            (void)c->resume();
+            live.push_back(std::move(*c));
+        }
+        auto const after = resident_bytes();
+        REQUIRE(before != 0);
+        // a committed implementation would add count * stack (64 MiB)
+        CHECK(after - before < count * stack / 4);
+    }
+#endif
+
+#if defined(__linux__)
+    TEST_CASE("overflowing a guarded stack traps instead of corrupting memory")
+    {
+        pid_t const child = fork();
+        REQUIRE(child != -1);
+        if (child == 0)
+        {
+            coro::virtual_stack_allocator alloc;
+            auto c = coro::coroutine::create([](coro::coroutine_handle)
+                                             { (void)recurse(1 << 20); },
+                                             coro::min_stack_size, coro::default_storage_size, alloc);
+            if (c)
+                (void)c->resume();
+            _exit(0); // reaching this means the overflow went unnoticed
+        }
+
+        int status = 0;
+        REQUIRE(waitpid(child, &status, 0) == child);
+        CHECK_FALSE((WIFEXITED(status) && WEXITSTATUS(status) == 0));
+    }
+#endif
+}
+
+// ============================================================================
+// lazy stack tests
+// ============================================================================
+
+namespace
+{
+    // Tracks every block it hands out, so frames and lazy stacks can be told apart by size.
+    struct tracking_allocator
+    {
+        std::size_t allocations = 0;
+        std::size_t live = 0;
+        std::size_t live_bytes = 0;
+        std::size_t peak_bytes = 0;
+
+        auto allocate(std::size_t size) noexcept -> void *
+        {
+            ++allocations;
+            ++live;
+            live_bytes += size;
+            peak_bytes = std::max(peak_bytes, live_bytes);
+            return std::malloc(size);
+        }
+
+        void deallocate(void *ptr, std::size_t size) noexcept
+        {
+            --live;
+            live_bytes -= size;
+            std::free(ptr);
+        }
+    };
+}
+
+TEST_SUITE("lazy stacks")
+{
+    TEST_CASE("no stack until the first resume, none after the last")
+    {
+        tracking_allocator alloc;
+        int step = 0;
+        auto c = coro::coroutine::create_lazy([&step](coro::coroutine_handle h)
+                                              {
+            step = 1;
+            [[maybe_unused]] auto _ = h.yield();
+            step = 2; },
+                                              coro::stack_size{256 * 1024}, coro::default_storage_size, alloc);
+        REQUIRE(c.has_value());
+        CHECK(alloc.live == 1);
+        CHECK(alloc.live_bytes < 64 * 1024);
+        CHECK(c->raw()->stack_base == nullptr);
+        CHECK(c->stack_capacity() == 256 * 1024);
+        CHECK(c->suspended());
+
+        REQUIRE(c->resume().has_value());
+        CHECK(step == 1);
+        CHECK(alloc.live == 2);
+        CHECK(alloc.live_bytes > 256 * 1024);
+        CHECK(c->raw()->stack_base != nullptr);
+
+        REQUIRE(c->resume().has_value());
+        CHECK(step == 2);
+        CHECK(c->done());
+        CHECK(alloc.live == 1); // stack went back before the coroutine object did
+        CHECK(c->raw()->stack_base == nullptr);
+
+        c = coro::coroutine::create_lazy([](coro::coroutine_handle) {}, coro::stack_size{256 * 1024}, coro::default_storage_size, alloc);
+        REQUIRE(c.has_value());
+        { auto gone = std::move(*c); }
+        CHECK(alloc.live == 0);
+        CHECK(alloc.allocations == 3); // two frames, one stack: the second never ran
+    }
+
+    TEST_CASE("storage and the callable work before the stack exists")
+    {
+        int seen = 0;
+        auto c = coro::coroutine::create_lazy([&seen](coro::coroutine_handle h)
+                                              {
+            auto v = h.pop<int>();
+            if (v)
+                seen = *v; });
+        REQUIRE(c.has_value());
+        REQUIRE(c->push(7).has_value());
+        REQUIRE(c->resume().has_value());
+        CHECK(seen == 7);
+        CHECK(c->done());
+    }
+
+    TEST_CASE("a stack that can't be allocated leaves the coroutine suspended")
+    {
+        struct one_block_allocator
+        {
+            bool used = false;
+
+            auto allocate(std::size_t size) noexcept -> void *
+            {
+                return std::exchange(used, true) ? nullptr : std::malloc(size);
+            }
+
+            void deallocate(void *ptr, std::size_t) noexcept { std::free(ptr); }
+        };
+
+        one_block_allocator alloc;
+        bool ran = false;
+        auto c = coro::coroutine::create_lazy([&ran](coro::coroutine_handle) { ran = true; }, coro::default_stack_size, coro::default_storage_size, alloc);
+        REQUIRE(c.has_value());
+        auto result = c->resume();
+        REQUIRE_FALSE(result.has_value());
+        CHECK(result.error() == coro::error::out_of_memory);
+        CHECK(c->suspended());
+        CHECK_FALSE(ran);
+
+        alloc.used = false;
+        REQUIRE(c->resume().has_value());
+        CHECK(ran);
+    }
+
+    TEST_CASE("resume_unchecked attaches and releases the stack too")
+    {
+        tracking_allocator alloc;
+        int runs = 0;
+        auto c = coro::coroutine::create_lazy([&runs](coro::coroutine_handle h)
+                                              {
+            ++runs;
+            h.yield_unchecked();
+            ++runs; },
+                                              coro::default_stack_size, coro::default_storage_size, alloc);
+        REQUIRE(c.has_value());
+        c->resume_unchecked();
+        CHECK(alloc.live == 2);
+        c->resume_unchecked();
+        CHECK(runs == 2);
+        CHECK(c->done());
+        CHECK(alloc.live == 1);
+    }
+
+    TEST_CASE("guarded lazy stacks are protected when attached")
+    {
+        coro::virtual_stack_allocator alloc;
+        auto const page = alloc.guard_size();
+        int result = -1;
+        auto c = coro::coroutine::create_lazy([&result](coro::coroutine_handle h)
+                                              {
+            result = recurse(256);
+            [[maybe_unused]] auto _ = h.yield(); },
+                                              coro::stack_size{512 * 1024}, coro::default_storage_size, alloc);
+        REQUIRE(c.has_value());
+        CHECK(c->raw()->stack_base == nullptr);
+        REQUIRE(c->resume().has_value());
+        CHECK(result == 256);
+        CHECK(reinterpret_cast<std::uintptr_t>(c->raw()->stack_base) % page == 0);
+        CHECK(c->raw()->stack_size % page == 0);
+        (void)c->resume();
+        CHECK(c->done());
+    }
+
+    TEST_CASE("transfer into a lazy coroutine attaches its stack")
+    {
+        std::vector<int> trace;
+        auto target = coro::coroutine::create_lazy([&trace](coro::coroutine_handle) { trace.push_back(2); });
+        REQUIRE(target.has_value());
+
+        auto source = coro::coroutine::create([&trace, &target](coro::coroutine_handle h)
+                                              {
+            trace.push_back(1);
+            [[maybe_unused]] auto _ = h.transfer(target->handle());
+            trace.push_back(3); });
+        REQUIRE(source.has_value());
+
+        REQUIRE(source->resume().has_value());
+        CHECK(trace == std::vector<int>{1, 2});
+        CHECK(target->done());
+        REQUIRE(source->resume().has_value());
+        CHECK(trace == std::vector<int>{1, 2, 3});
+    }
+
+    TEST_CASE("task_runner drives lazy tasks and frees each stack as it finishes")
+    {
+        tracking_allocator alloc;
+        coro::task_runner runner;
+        int finished = 0;
+        for (int i = 0; i < 8; ++i)
+        {
+            auto c = coro::coroutine::create_lazy([&finished](coro::coroutine_handle h)
+                                                  {
+                if (h.yield())
+                    ++finished; },
+                                                  coro::default_stack_size, coro::default_storage_size, alloc);
+            REQUIRE(c.has_value());
+            runner.add(std::move(*c));
+        }
+        CHECK(alloc.live == 8);
+        REQUIRE(runner.step().has_value());
+        CHECK(alloc.live == 16);
+        runner.cancel_all();
+        REQUIRE(runner.run().has_value());
+        CHECK(finished == 0);
+        CHECK(runner.empty());
+        CHECK(alloc.live == 0);
+    }
+
+    TEST_CASE("a handoff whose stack can't be allocated leaves the next task queued")
+    {
+        struct one_block_allocator
+        {
+            bool used = false;
+
+            auto allocate(std::size_t size) noexcept -> void *
+            {
+                return std::exchange(used, true) ? nullptr : std::malloc(size);
+            }
+
+            void deallocate(void *ptr, std::size_t) noexcept { std::free(ptr); }
+        };
+
+        one_block_allocator alloc;
+        coro::task_runner runner;
+        std::vector<int> order;
+        auto first = coro::coroutine::create([&order](coro::coroutine_handle h)
+                                             {
+            order.push_back(1);
+            [[maybe_unused]] auto _ = h.park();
+            order.push_back(3); });
+        auto second = coro::coroutine::create_lazy([&order](coro::coroutine_handle) { order.push_back(2); },
+                                                   coro::default_stack_size, coro::default_storage_size, alloc);
+        REQUIRE(first.has_value());
+        REQUIRE(second.has_value());
+        auto first_handle = first->handle();
+        runner.add(std::move(*first)).add(std::move(*second));
+
+        // first parks and can't hand off to second; second's own resume then reports the failure
+        auto result = runner.step();
+        REQUIRE_FALSE(result.has_value());
+        CHECK(result.error() == coro::error::out_of_memory);
+        CHECK(runner.ready() == 1);
+        CHECK(runner.parked() == 1);
+
+        alloc.used = false;
+        REQUIRE(runner.wake(first_handle).has_value());
+        REQUIRE(runner.run().has_value());
+        CHECK(runner.empty());
+        CHECK(runner.parked() == 0);
+        CHECK(order == std::vector<int>{1, 2, 3});
+    }
+
+#if UCORO_STACK_PAINT
+    TEST_CASE("stack_peak survives the stack being given back")
+    {
+        auto c = coro::coroutine::create_lazy([](coro::coroutine_handle) { (void)recurse(32); }, coro::stack_size{64 * 1024});
+        REQUIRE(c.has_value());
+        CHECK(*c->stack_peak() == 0);
+        REQUIRE(c->resume().has_value());
+        CHECK(c->raw()->stack_base == nullptr);
+        CHECK(*c->stack_peak() > 32 * 64);
+    }
+#endif
+}
+
+// ============================================================================
+// stack introspection tests
+// ============================================================================
+
+// ============================================================================
+// shared stack tests
+// ============================================================================
+
+namespace
+{
+    // Recurses `depth` frames, each holding a buffer stamped with id, yields at the bottom and
+    // checks every stamp on the way back up.
+    auto stamped_descent(coro::coroutine_handle h, int id, int depth) -> bool
+    {
+        std::array<int, 32> stamp{};
+        stamp.fill(id * 1000 + depth);
+        bool ok = true;
+        if (depth == 0)
+            ok = h.yield().has_value();
+        else
+            ok = stamped_descent(h, id, depth - 1);
+        return ok && std::ranges::all_of(stamp, [&](int v)
+                                         { return v == id * 1000 + depth; });
+    }
+}
+
+TEST_SUITE("shared stacks")
+{
+    TEST_CASE("members taking turns keep their own frames")
+    {
+        auto stack = coro::shared_stack::create();
+        REQUIRE(stack.has_value());
+
+        std::array<bool, 4> intact{};
+        std::vector<coro::coroutine> members;
+        for (int id = 0; id < 4; ++id)
+        {
+            auto c = coro::coroutine::create_shared([&intact, id](coro::coroutine_handle h)
+                                                    { intact[static_cast<std::size_t>(id)] = stamped_descent(h, id, 8 + id); },
+                                                    *stack);
+            REQUIRE(c.has_value());
+            CHECK(c->stack_capacity() == stack->size());
+            members.push_back(std::move(*c));
+        }
+
+        for (auto &c : members)
+            REQUIRE(c.resume().has_value());
+        CHECK(stack->copies() == 3); // the last one is still on the stack
+        for (std::size_t i = 0; i + 1 < members.size(); ++i)
+        {
+            CHECK(members[i].raw()->stack_base == nullptr);
+            CHECK(members[i].stack_used() > 0);
+            CHECK(members[i].stack_used() < 16 * 1024);
+        }
+
+        for (auto &c : members)
+            REQUIRE(c.resume().has_value());
+        CHECK(std::ranges::all_of(members, [](coro::coroutine const &c)
+                                  { return c.done(); }));
+        CHECK(std::ranges::all_of(intact, [](bool b)
+                                  { return b; }));
+        CHECK_FALSE(stack->occupied());
+    }
+
+    TEST_CASE("a stashed member keeps the red zone below its saved sp")
+    {
+        auto stack = coro::shared_stack::create();
+        REQUIRE(stack.has_value());
+        auto body = [](coro::coroutine_handle h)
+        { h.yield_unchecked<coro::switch_kind::clobber>(); };
+        auto first = coro::coroutine::create_shared(body, *stack);
+        auto second = coro::coroutine::create_shared(body, *stack);
+        REQUIRE(first.has_value());
+        REQUIRE(second.has_value());
+
+        first->resume_unchecked();
+        auto const *shared = first->raw()->shared_stack;
+        auto *top = static_cast<unsigned char *>(shared->base) + shared->size;
+        auto *sp = static_cast<unsigned char *>(coro::detail::mco_ctx_sp(coro::detail::mco_context_of(first->raw())->ctx));
+        second->resume_unchecked();
+        CHECK(first->raw()->stack_copy_size == static_cast<std::size_t>(top - sp) + coro::detail::mco_red_zone);
+
+        first->resume_unchecked();
+        second->resume_unchecked();
+        CHECK(first->done());
+        CHECK(second->done());
+    }
+
+    TEST_CASE("resuming the member already on the stack copies nothing")
+    {
+        auto stack = coro::shared_stack::create(coro::stack_size{64 * 1024});
+        REQUIRE(stack.has_value());
+        int steps = 0;
+        auto c = coro::coroutine::create_shared([&steps](coro::coroutine_handle h)
+                                                {
+            for (int i = 0; i < 10; ++i)
+            {
+                ++steps;
+                h.yield_unchecked();
+            } },
+                                                *stack);
+        REQUIRE(c.has_value());
+        while (!c->done())
+            c->resume_unchecked();
+        CHECK(steps == 10);
+        CHECK(stack->copies() == 0);
+    }
+
+    TEST_CASE("a member can't resume or transfer to one of its own group")
+    {
+        auto stack = coro::shared_stack::create();
+        REQUIRE(stack.has_value());
+        bool sibling_ran = false;
+        auto sibling = coro::coroutine::create_shared([&sibling_ran](coro::coroutine_handle)
+                                                      { sibling_ran = true; },
+                                                      *stack);
+        REQUIRE(sibling.has_value());
+
+        std::optional<coro::error> resumed, transferred;
+        auto c = coro::coroutine::create_shared([&](coro::coroutine_handle h)
+                                                {
+            if (auto r = sibling->resume(); !r)
+                resumed = r.error();
+            if (auto r = h.transfer(sibling->handle()); !r)
+                transferred = r.error(); },
+                                                *stack);
+        REQUIRE(c.has_value());
+        REQUIRE(c->resume().has_value());
+        CHECK(c->done());
+        CHECK(resumed == coro::error::invalid_operation);
+        CHECK(transferred == coro::error::invalid_operation);
+        CHECK_FALSE(sibling_ran);
+
+        // from outside the group it runs
+        REQUIRE(sibling->resume().has_value());
+        CHECK(sibling_ran);
+    }
+
+    TEST_CASE("a plain coroutine may drive shared-stack members")
+    {
+        auto stack = coro::shared_stack::create();
+        REQUIRE(stack.has_value());
+        int total = 0;
+        auto driver = coro::coroutine::create([&](coro::coroutine_handle)
+                                              {
+            std::vector<coro::coroutine> members;
+            for (int i = 0; i < 3; ++i)
+                if (auto m = coro::coroutine::create_shared([&total](coro::coroutine_handle h)
+                                                            {
+                    int local = 1;
+                    [[maybe_unused]] auto _ = h.yield();
+                    total += local; },
+                                                            *stack))
+                    members.push_back(std::move(*m));
+            for (int round = 0; round < 2; ++round)
+                for (auto &m : members)
+                    (void)m.resume(); });
+        REQUIRE(driver.has_value());
+        REQUIRE(driver->resume().has_value());
+        CHECK(total == 3);
+    }
+
+    TEST_CASE("members park and wake on a task_runner")
+    {
+        constexpr int members = 50;
+        constexpr int rounds = 3;
+        auto stack = coro::shared_stack::create();
+        REQUIRE(stack.has_value());
+
+        coro::task_runner runner;
+        std::vector<coro::coroutine_handle> parked;
+        int woken = 0;
+        bool intact = true;
+        for (int i = 0; i < members; ++i)
+        {
+            auto c = coro::coroutine::create_shared([&, i](coro::coroutine_handle h)
+                                                    {
+                std::array<int, 16> mine{};
+                mine.fill(i);
+                for (int r = 0; r < rounds; ++r)
+                {
+                    parked.push_back(h);
+                    if (!h.park())
+                        return;
+                    ++woken;
+                    intact = intact && std::ranges::all_of(mine, [i](int v)
+                                                           { return v == i; });
+                } },
+                                                    *stack);
+            REQUIRE(c.has_value());
+            runner.add(std::move(*c));
+        }
+        auto waker = coro::coroutine::create([&](coro::coroutine_handle h)
+                                             {
+            while (woken < members * rounds)
+            {
+                for (auto p : std::exchange(parked, {}))
+                    (void)runner.wake(p);
+                [[maybe_unused]] auto _ = h.yield();
+            } });
+        REQUIRE(waker.has_value());
+        runner.add(std::move(*waker));
+        REQUIRE(runner.run().has_value());
+        CHECK(woken == members * rounds);
+        CHECK(intact);
+        CHECK(stack->copies() >= static_cast<std::size_t>(members * rounds));
+        CHECK_FALSE(stack->occupied());
+    }
+
+    TEST_CASE("waits with nodes on the stack refuse stack-copying members")
+    {
+        auto stack = coro::shared_stack::create();
+        REQUIRE(stack.has_value());
+        auto ch = coro::channel<int>::create(1);
+        REQUIRE(ch.has_value());
+
+        std::optional<coro::error> received, slept;
+        coro::task_runner runner;
+        auto c = coro::coroutine::create_shared([&](coro::coroutine_handle h)
+                                                {
+            if (auto v = ch->receive(h); !v)
+                received = v.error();
+            if (auto r = coro::sleep_for(h, std::chrono::milliseconds{1}); !r)
+                slept = r.error(); },
+                                                *stack);
+        REQUIRE(c.has_value());
+        runner.add(std::move(*c));
+        REQUIRE(runner.run().has_value());
+        CHECK(received == coro::error::invalid_operation);
+        CHECK(slept == coro::error::invalid_operation);
+
+        // nothing was left linked: the channel still works for everyone else
+        REQUIRE(ch->try_send(1).has_value());
+        CHECK(ch->try_receive() == 1);
+    }
+
+    TEST_CASE("destroying a parked member gives its saved stack back")
+    {
+        auto stack = coro::shared_stack::create();
+        REQUIRE(stack.has_value());
+        auto body = [](coro::coroutine_handle h)
+        { [[maybe_unused]] auto _ = h.yield(); };
+        auto a = coro::coroutine::create_shared(body, *stack);
+        auto b = coro::coroutine::create_shared(body, *stack);
+        REQUIRE(a.has_value());
+        REQUIRE(b.has_value());
+        REQUIRE(a->resume().has_value());
+        REQUIRE(b->resume().has_value());
+        CHECK(a->raw()->stack_copy != nullptr);
+        CHECK(stack->occupied());
+
+        *b = coro::coroutine::create_shared(body, *stack).value(); // the occupant goes away
+        CHECK_FALSE(stack->occupied());
+        REQUIRE(a->resume().has_value());
+        CHECK(a->done());
+        CHECK(a->raw()->stack_copy == nullptr);
+    }
+}
+
+namespace
+{
+    struct session
+    {
+        int *served;
+        void operator()(coro::coroutine_handle h) const
+        {
+            for (int i = 0; i < 3; ++i)
+            {
+                ++*served;
+                [[maybe_unused]] auto _ = h.yield();
+            }
+        }
+    };
+
+    struct connection
+    {
+        int id = 0;
+        coro::static_coroutine<coro::min_stack_size.value, 64, session> handler;
+    };
+
+    template <typename Static>
+    auto inside_object(Static const &sc, void const *p) -> bool
+    {
+        auto const *begin = reinterpret_cast<unsigned char const *>(&sc);
+        auto const *ptr = static_cast<unsigned char const *>(p);
+        return ptr >= begin && ptr < begin + sizeof(Static);
+    }
+}
+
+TEST_SUITE("static coroutines")
+{
+    TEST_CASE("frame, callable, storage and stack all live in the object")
+    {
+        using small = coro::static_coroutine<coro::min_stack_size.value, 128, session>;
+        static_assert(sizeof(small) >= small::frame_size);
+        static_assert(small::frame_size > coro::min_stack_size.value);
+        static_assert(alignof(small) == coro::detail::mco_frame_align);
+        static_assert(!std::is_copy_constructible_v<small> && !std::is_move_constructible_v<small>);
+
+        int served = 0;
+        small sc{session{&served}};
+        REQUIRE(sc.valid());
+        CHECK(sc.in_use());
+        auto *co = sc->raw();
+        CHECK(inside_object(sc, co));
+        CHECK(inside_object(sc, coro::detail::mco_context_of(co)));
+        CHECK(inside_object(sc, co->user_data));
+        CHECK(inside_object(sc, co->storage));
+        CHECK(inside_object(sc, co->stack_base));
+        CHECK(co->frame_offset == 0);
+        CHECK(sc->storage_capacity() == 128);
+        CHECK(sc->stack_capacity() >= coro::min_stack_size.value);
+
+        REQUIRE(sc->resume().has_value());
+        CHECK(served == 1);
+        REQUIRE(sc->push(7).has_value());
+        CHECK(sc->pop<int>().value() == 7);
+        while (!sc->done())
+            REQUIRE(sc->resume().has_value());
+        CHECK(served == 3);
+    }
+
+    TEST_CASE("emplace rebuilds in place and drops the previous callable")
+    {
+        int drops = 0;
+        int calls = 0;
+        coro::static_coroutine<coro::min_stack_size.value, 64, drop_counter> sc;
+        CHECK_FALSE(sc.valid());
+        CHECK_FALSE(sc.in_use());
+
+        REQUIRE(sc.emplace(drop_counter{&drops, &calls}).has_value());
+        REQUIRE(sc->resume().has_value());
+        CHECK(calls == 1);
+        auto *first = sc->raw();
+
+        REQUIRE(sc.emplace(drop_counter{&drops, &calls}).has_value()); // suspended one is dropped
+        CHECK(drops == 1);
+        CHECK(sc->raw() == first);
+        CHECK(sc->suspended());
+        REQUIRE(sc->resume().has_value());
+        REQUIRE(sc->resume().has_value());
+        CHECK(sc->done());
+        CHECK(calls == 3);
+
+        sc.reset();
+        CHECK(drops == 2);
+        CHECK_FALSE(sc.in_use());
+    }
+
+    TEST_CASE("emplace is refused from inside the coroutine and while a moved-out one lives")
+    {
+        using self_builder = coro::static_coroutine<coro::min_stack_size.value, 64, void (*)(coro::coroutine_handle)>;
+        static self_builder sc;
+        static coro::error seen = coro::error::success;
+        REQUIRE(sc.emplace([](coro::coroutine_handle)
+                           { seen = sc.emplace([](coro::coroutine_handle) {}).error(); })
+                    .has_value());
+        REQUIRE(sc->resume().has_value());
+        CHECK(seen == coro::error::invalid_operation);
+        CHECK(sc.emplace(nullptr).error() == coro::error::invalid_arguments);
+
+        REQUIRE(sc.emplace([](coro::coroutine_handle h)
+                           { [[maybe_unused]] auto _ = h.yield(); })
+                    .has_value());
+        {
+            coro::coroutine lent = std::move(sc.get());
+            CHECK_FALSE(sc.valid());
+            CHECK(sc.in_use());
+            CHECK(sc.emplace([](coro::coroutine_handle) {}).error() == coro::error::invalid_operation);
+        }
+        CHECK_FALSE(sc.in_use());
+        CHECK(sc.emplace([](coro::coroutine_handle) {}).has_value());
+        sc.reset();
+    }
+
+    TEST_CASE("an array of connections runs on a task_runner and is reused")
+    {
+        int served = 0;
+        std::array<connection, 4> connections{};
+        coro::task_runner runner;
+        runner.reserve(connections.size());
+        for (int round = 0; round < 2; ++round)
+        {
+            for (auto &c : connections)
+            {
+                REQUIRE(c.handler.emplace(session{&served}).has_value());
+                runner.add(std::move(c.handler.get()));
+                CHECK(c.handler.in_use());
+            }
+            CHECK(runner.size() == connections.size());
+            REQUIRE(runner.run().has_value());
+            CHECK(runner.empty());
+            for (auto const &c : connections)
+                CHECK_FALSE(c.handler.in_use());
+        }
+        CHECK(served == 2 * 4 * 3);
+    }
+
+    TEST_CASE("a generator can drive a static coroutine")
+    {
+        auto const count_to_three = [](coro::coroutine_handle h)
+        {
+            for (int i = 1; i <= 3; ++i)
+            {
+                [[maybe_unused]] auto pushed = h.push(i);
+                [[maybe_unused]] auto yielded = h.yield();
+            }
+        };
+        coro::static_coroutine<coro::min_stack_size.value, 64, decltype(count_to_three)> sc{count_to_three};
+        auto gen = coro::generator<int>::from(std::move(sc.get()));
+        REQUIRE(gen.has_value());
+
+        std::vector<int> values;
+        for (int v : *gen)
+            values.push_back(v);
+        CHECK((values == std::vector<int>{1, 2, 3}));
+        CHECK(coro::generator<int>::from(std::move(sc.get())).error() == coro::error::invalid_coroutine);
+    }
+}
+
+TEST_SUITE("stack introspection")
+{
+    TEST_CASE("stack_used grows with call depth")
+    {
+        std::size_t shallow = 0;
+        std::size_t deep = 0;
+        auto result = coro::coroutine::create(
+            [&](coro::coroutine_handle h)
+            {
+                shallow = h.stack_used();
+                (void)recurse(8);
+                h.yield_unchecked();
+            },
+            coro::stack_size{64 * 1024});
+        REQUIRE(result.has_value());
+        auto &c = *result;
+
+        REQUIRE(c.resume().has_value());
+        CHECK(shallow > 0);
+        CHECK(shallow < c.stack_capacity());
+        deep = c.stack_used();
+        CHECK(deep > 0);
+        CHECK(c.stack_used() + c.stack_remaining() == c.stack_capacity());
+    }
+
+    TEST_CASE("stack_used of a suspended coroutine reflects its parked frames")
+    {
+        auto result = coro::coroutine::create(
+            [](coro::coroutine_handle h)
+            {
+                volatile char pad[4096];
+                pad[0] = 1;
+                h.yield_unchecked();
+                (void)pad[0];
+            },
+            coro::stack_size{64 * 1024});
+        REQUIRE(result.has_value());
+        auto &c = *result;
+
+        CHECK(c.resume().has_value());
+        CHECK(c.stack_used() >= 4096);
+        CHECK(c.stack_used() < c.stack_capacity());
+    }
+
+    TEST_CASE("stack_used of a normal coroutine is read from its child")
+    {
+        std::size_t outer_used = 0;
+        coro::coroutine *outer_ptr = nullptr;
+
+        auto inner = coro::coroutine::create([&](coro::coroutine_handle) { outer_used = outer_ptr->stack_used(); });
+        REQUIRE(inner.has_value());
+        auto outer = coro::coroutine::create(
+            [&](coro::coroutine_handle)
+            {
+                volatile char pad[2048];
+                pad[0] = 1;
+                (void)inner->resume();
+                (void)pad[0];
+            },
+            coro::stack_size{64 * 1024});
+        REQUIRE(outer.has_value());
+        outer_ptr = &*outer;
+
+        CHECK(outer->resume().has_value());
+        CHECK(outer_used >= 2048);
+        CHECK(outer_used < outer->stack_capacity());
+    }
+
+    TEST_CASE("stack_used is zero once the coroutine is dead")
+    {
+        auto result = coro::coroutine::create([](coro::coroutine_handle) {});
+        REQUIRE(result.has_value());
+        CHECK(result->resume().has_value());
+        CHECK(result->done());
+        CHECK(result->stack_used() == 0);
+        CHECK(result->stack_remaining() == result->stack_capacity());
+    }
+
+#if UCORO_STACK_PAINT
+    TEST_CASE("stack_peak records the deepest excursion")
+    {
+        auto result = coro::coroutine::create(
+            [](coro::coroutine_handle h)
+            {
+                (void)recurse(16);
+                h.yield_unchecked();
+            },
+            coro::stack_size{64 * 1024});
+        REQUIRE(result.has_value());
+        auto &c = *result;
+
+        auto before = c.stack_peak();
+        REQUIRE(before.has_value());
+        CHECK(c.resume().has_value());
+        auto after = c.stack_peak();
+        REQUIRE(after.has_value());
+        CHECK(*after >= 16 * 1024);
+        CHECK(*after > c.stack_used());
+        CHECK(*after <= c.stack_capacity());
+    }
+
+    TEST_CASE("task_runner reports the peak of finished tasks")
+    {
+        coro::task_runner runner;
+        std::size_t reported = 0;
+        int calls = 0;
+        runner.on_stack_peak(
+            [&](coro::coroutine_handle, std::size_t peak)
+            {
+                reported = peak;
+                ++calls;
+            });
+
+        auto task = coro::coroutine::create([](coro::coroutine_handle) { (void)recurse(8); }, coro::stack_size{64 * 1024});
+        REQUIRE(task.has_value());
+        runner.add(std::move(*task));
+        CHECK(runner.run().has_value());
+        CHECK(calls == 1);
+        CHECK(reported >= 8 * 1024);
+    }
+
+    TEST_CASE("pool reports the peak of returned frames")
+    {
+        auto p = coro::pool::create(1, coro::stack_size{64 * 1024});
+        REQUIRE(p.has_value());
+        std::size_t reported = 0;
+        p->on_stack_peak([&](coro::coroutine_handle, std::size_t peak) { reported = peak; });
+
+        {
+            auto c = p->spawn([](coro::coroutine_handle) { (void)recurse(8); });
+            REQUIRE(c.has_value());
+            CHECK(c->resume().has_value());
+        }
+        CHECK(reported >= 8 * 1024);
+    }
+#else
+    TEST_CASE("stack_peak needs UCORO_STACK_PAINT")
+    {
+        auto result = coro::coroutine::create([](coro::coroutine_handle) {});
+        REQUIRE(result.has_value());
+        auto peak = result->stack_peak();
+        REQUIRE_FALSE(peak.has_value());
+        CHECK(peak.error() == coro::error::invalid_operation);
+    }
+#endif
+}
+
+// ============================================================================
+// instrumentation tests
+// ============================================================================
+
+#if UCORO_INSTRUMENT
+namespace
+{
+    // keeps the caller on the CPU for a while without touching memory the optimizer can drop
+    void spin_for(std::chrono::microseconds span)
+    {
+        auto const until = std::chrono::steady_clock::now() + span;
+        while (std::chrono::steady_clock::now() < until)
+        {
+        }
+    }
+}
+#endif
+
+TEST_SUITE("instrumentation")
+{
+#if UCORO_INSTRUMENT
+    TEST_CASE("stats count resumes and yields")
+    {
+        auto result = coro::coroutine::create([](coro::coroutine_handle h)
+                                              {
+            for (int i = 0; i < 3; ++i)
+                h.yield_unchecked(); });
+        REQUIRE(result.has_value());
+        auto &c = *result;
+        auto fresh = c.stats();
+        REQUIRE(fresh.has_value());
+        CHECK(fresh->resumes == 0);
+        CHECK(fresh->yields == 0);
+        CHECK(std::string_view{fresh->name} == "coroutine");
+
+        static constexpr char const worker[] = "worker";
+        c.set_trace_name(worker);
+        while (!c.done())
+            REQUIRE(c.resume().has_value());
+        auto done = c.stats();
+        REQUIRE(done.has_value());
+        CHECK(done->resumes == 4);
+        CHECK(done->yields == 3); // finishing is not a yield
+        CHECK(done->name == worker);
+        CHECK(done->cpu_ticks > 0);
+    }
+
+    TEST_CASE("a nested coroutine's time is not billed to its resumer")
+    {
+        auto inner = coro::coroutine::create([](coro::coroutine_handle)
+                                             { spin_for(std::chrono::milliseconds{20}); });
+        REQUIRE(inner.has_value());
+        auto outer = coro::coroutine::create([&](coro::coroutine_handle)
+                                             { REQUIRE(inner->resume().has_value()); });
+        REQUIRE(outer.has_value());
+        REQUIRE(outer->resume().has_value());
+        auto const in = inner->stats();
+        auto const out = outer->stats();
+        REQUIRE(in.has_value());
+        REQUIRE(out.has_value());
+        CHECK(out->cpu_ticks * 10 < in->cpu_ticks);
+    }
+
+    TEST_CASE("task_runner reports the stats of finished tasks, handoffs included")
+    {
+        auto ch = coro::channel<int>::create(1);
+        REQUIRE(ch.has_value());
+        coro::task_runner runner;
+        std::vector<coro::coroutine_stats> reports;
+        runner.on_task_stats([&](coro::coroutine_handle, coro::coroutine_stats const &s)
+                             { reports.push_back(s); });
+
+        static constexpr char const producer_name[] = "producer";
+        static constexpr char const consumer_name[] = "consumer";
+        auto producer = coro::coroutine::create([&](coro::coroutine_handle h)
+                                                {
+            h.set_trace_name(producer_name);
+            for (int i = 0; i < 100; ++i)
+                REQUIRE(ch->send(h, i).has_value());
+            ch->close(); });
+        auto consumer = coro::coroutine::create([&](coro::coroutine_handle h)
+                                                {
+            h.set_trace_name(consumer_name);
+            while (ch->receive(h))
+                spin_for(std::chrono::microseconds{50}); });
+        REQUIRE(producer.has_value());
+        REQUIRE(consumer.has_value());
+        runner.add(std::move(*producer)).add(std::move(*consumer));
+        REQUIRE(runner.run().has_value());
+
+        REQUIRE(reports.size() == 2);
+        std::uint64_t producer_ticks = 0;
+        std::uint64_t consumer_ticks = 0;
+        for (auto const &s : reports)
+        {
+            CHECK(s.resumes == s.yields + 1);
+            CHECK(s.resumes > 50);
+            (s.name == producer_name ? producer_ticks : consumer_ticks) += s.cpu_ticks;
+        }
+        CHECK(consumer_ticks > producer_ticks);
+    }
+#else
+    TEST_CASE("stats needs UCORO_INSTRUMENT")
+    {
+        auto result = coro::coroutine::create([](coro::coroutine_handle) {});
+        REQUIRE(result.has_value());
+        result->set_trace_name("ignored");
+        CHECK(result->stats().error() == coro::error::invalid_operation);
+        CHECK(coro::coroutine_handle{}.stats().error() == coro::error::invalid_coroutine);
+    }
+#endif
 }
 
 // ============================================================================